@@ -6,13 +6,38 @@ include $(CLEAR_VARS)
 # Set up the OpenCore variables.
 include external/opencore/Config.mk
 LOCAL_C_INCLUDES := $(PV_INCLUDES)\
-                    hardware/msm7k/libgralloc-qsd8k
+                    hardware/msm7k/libgralloc-qsd8k \
+                    external/opencore/extern_libs_v2/khronos/openmax/include
 
-ifeq ($(call is-board-platform-in-list,msm7627a msm7627_surf msm7627_6x),true)
+# Shared by the MSM video outputs, which build on msm_surface_output.h
+MSM_VIDEO_OUTPUT_SRC_FILES := \
+    omx_display_sink.cpp \
+    yuv_rgb_convert.cpp \
+    duplicate_frame_filter.cpp \
+    pmem_frame_writer.cpp \
+    row_band_pipeline.cpp \
+    frame_capture.cpp \
+    frame_trace.cpp \
+    quality_ladder.cpp \
+    video_output_manager.cpp \
+    pmem_heap_registry.cpp \
+    frame_slot_heap.cpp \
+    frame_deinterlacer.cpp
+
+# Headless boards (transcoding, analysis) can ask for the shared memory
+# backend even on MSM platforms with BOARD_USES_SHM_VIDEO_OUTPUT := true.
+ifeq ($(BOARD_USES_SHM_VIDEO_OUTPUT),true)
+  LOCAL_SRC_FILES := android_surface_output_shm.cpp
+else ifeq ($(call is-board-platform-in-list,msm7627a msm7627_surf msm7627_6x),true)
   LOCAL_SRC_FILES := android_surface_output_msm72xx.cpp
-endif
-ifeq ($(call is-board-platform-in-list,msm7630_surf msm7630_fusion msm8660),true)
+  LOCAL_SRC_FILES += $(MSM_VIDEO_OUTPUT_SRC_FILES)
+else ifeq ($(call is-board-platform-in-list,msm7630_surf msm7630_fusion msm8660),true)
   LOCAL_SRC_FILES := android_surface_output_msm7x30.cpp
+  LOCAL_SRC_FILES += $(MSM_VIDEO_OUTPUT_SRC_FILES)
+  LOCAL_ARM_NEON := true
+else
+  # no pmem/overlay: publish frames to a shared memory ring
+  LOCAL_SRC_FILES := android_surface_output_shm.cpp
 endif
 
 
@@ -41,4 +66,97 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_LDLIBS += 
 
 include $(BUILD_SHARED_LIBRARY)
+
+########################
+# Per-resolution comparison of the software frame kernels on cached and
+# write-combined pmem
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := tools/pmem_convert_bench.cpp pmem_frame_writer.cpp
+LOCAL_SHARED_LIBRARIES := libutils libcutils
+ifeq ($(call is-board-platform-in-list,msm7630_surf msm7630_fusion msm8660),true)
+  LOCAL_ARM_NEON := true
+endif
+LOCAL_MODULE := pmem_convert_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+ifeq ($(HOST_OS),linux)
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := tools/pmem_convert_bench.cpp pmem_frame_writer.cpp
+LOCAL_STATIC_LIBRARIES := libutils libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := pmem_convert_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+endif
+
+########################
+# Host run of the video output pmem/overlay sharing policy against
+# stand-in surfaces and overlays
+ifeq ($(HOST_OS),linux)
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := tools/video_output_sim.cpp video_output_manager.cpp
+LOCAL_STATIC_LIBRARIES := libutils libcutils liblog
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE := video_output_sim
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+endif
+
+########################
+# Host replay of persist.pv.trace frame traces into either MSM video
+# output, against the stand-ins in tools/trace_replay/include
+ifeq ($(HOST_OS),linux)
+TRACE_REPLAY_C_INCLUDES := \
+    $(LOCAL_PATH)/tools/trace_replay/include \
+    $(LOCAL_PATH) \
+    external/opencore/extern_libs_v2/khronos/openmax/include
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := tools/trace_replay/trace_replay.cpp android_surface_output_msm72xx.cpp
+LOCAL_SRC_FILES += $(MSM_VIDEO_OUTPUT_SRC_FILES)
+LOCAL_C_INCLUDES := $(TRACE_REPLAY_C_INCLUDES)
+LOCAL_STATIC_LIBRARIES := libutils libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := trace_replay_msm72xx
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := tools/trace_replay/trace_replay.cpp android_surface_output_msm7x30.cpp
+LOCAL_SRC_FILES += $(MSM_VIDEO_OUTPUT_SRC_FILES)
+LOCAL_C_INCLUDES := $(TRACE_REPLAY_C_INCLUDES)
+LOCAL_CFLAGS := -DREPLAY_MSM7X30
+LOCAL_STATIC_LIBRARIES := libutils libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := trace_replay_msm7x30
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+########################
+# Host comparison of a stand-in decoder tunneled to the display sink with
+# the same decoder written through the MIO, on the stand-in OMX core
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := tools/tunnel_bench.cpp android_surface_output_msm72xx.cpp
+LOCAL_SRC_FILES += $(MSM_VIDEO_OUTPUT_SRC_FILES)
+LOCAL_C_INCLUDES := $(TRACE_REPLAY_C_INCLUDES)
+LOCAL_SHARED_LIBRARIES := libOmxCore
+LOCAL_STATIC_LIBRARIES := libutils libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := tunnel_bench_msm72xx
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := tools/tunnel_bench.cpp android_surface_output_msm7x30.cpp
+LOCAL_SRC_FILES += $(MSM_VIDEO_OUTPUT_SRC_FILES)
+LOCAL_C_INCLUDES := $(TRACE_REPLAY_C_INCLUDES)
+LOCAL_CFLAGS := -DBENCH_MSM7X30
+LOCAL_SHARED_LIBRARIES := libOmxCore
+LOCAL_STATIC_LIBRARIES := libutils libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := tunnel_bench_msm7x30
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+endif
 endif
@@ -25,8 +25,6 @@
 
 #include <cutils/properties.h>
 
-#define PLATFORM_PRIVATE_PMEM 1
-
 #if HAVE_ANDROID_OS
 #include <linux/android_pmem.h>
 #endif
@@ -36,250 +34,240 @@
 using namespace android;
 
 static const char* pmem_adsp = "/dev/pmem_adsp";
-static const char* pmem = "/dev/pmem";
 
-OSCL_EXPORT_REF AndroidSurfaceOutputMsm72xx::AndroidSurfaceOutputMsm72xx() :
-    AndroidSurfaceOutput()
+const char* const AndroidSurfaceOutputMsm72xx::kName = "AndroidSurfaceOutputMsm72xx";
+
+// decoder output registered with SurfaceFlinger in place
+struct Nv21Format {
+    static const int kHalFormat = HAL_PIXEL_FORMAT_YCrCb_420_SP;
+};
+struct Nv21InterlacedFormat {
+    static const int kHalFormat = HAL_PIXEL_FORMAT_YCrCb_420_SP ^ HAL_PIXEL_FORMAT_INTERLACE;
+};
+
+OSCL_EXPORT_REF AndroidSurfaceOutputMsm72xx::AndroidSurfaceOutputMsm72xx()
 {
-    mHardwareCodec = false;
-
-    //Statistics profiling
-    char value[PROPERTY_VALUE_MAX];
-    mStatistics = false;
-    mLastFrame = 0;
-    mLastFpsTime = 0;
-    mFpsSum = 0;
-    iFrameNumber = 0;
-    mNumFpsSamples = 0;
-    property_get("persist.debug.pv.statistics", value, "0");
-    if(atoi(value)) mStatistics = true;
 }
 
 OSCL_EXPORT_REF AndroidSurfaceOutputMsm72xx::~AndroidSurfaceOutputMsm72xx()
 {
-    if(mStatistics) AverageFPSPrint();
+    shutdownOutput();
 }
 
-// create a frame buffer for software codecs
-OSCL_EXPORT_REF bool AndroidSurfaceOutputMsm72xx::initCheck()
+// the configuration for iVideo*, see MsmSurfaceOutput::initCheck; the
+// slots and registrations all come with the first frame
+bool AndroidSurfaceOutputMsm72xx::buildState(OutputState& state, const OutputState* current)
 {
-
-    // initialize only when we have all the required parameters
-    if (((iVideoParameterFlags & VIDEO_SUBFORMAT_VALID) == 0) || !checkVideoParameterFlags())
-        return mInitialized;
-
-    // release resources if previously initialized
-    closeFrameBuf();
-
-    // reset flags in case display format changes in the middle of a stream
-    resetVideoParameterFlags();
-
-    // copy parameters in case we need to adjust them
-    int displayWidth = iVideoDisplayWidth;
-    int displayHeight = iVideoDisplayHeight;
-    int frameWidth = iVideoWidth;
-    int frameHeight = iVideoHeight;
-    int frameSize;
+    int frameWidth = state.width;
+    int frameHeight = state.height;
+    // YUV420 frames are 1.5 bytes/pixel
+    int frameSize = state.frameBytes();
+    VideoOutputManager* manager = VideoOutputManager::instance();
 
     // MSM72xx hardware codec uses semi-planar format
-    if ((iVideoSubFormat == PVMF_MIME_YUV420_SEMIPLANAR_YVU) ||
-        (iVideoSubFormat == PVMF_MIME_YUV420_SEMIPLANAR_YVU_INTERLACE)) {
+    if ((state.subFormat == PVMF_MIME_YUV420_SEMIPLANAR_YVU) ||
+        (state.subFormat == PVMF_MIME_YUV420_SEMIPLANAR_YVU_INTERLACE)) {
         LOGV("using hardware codec");
-        mHardwareCodec = true;
+        state.hardwareCodec = true;
         mNumberOfFramesToHold = 2;
+
+        int mode = FrameDeinterlacer::configuredMode();
+        if ((state.subFormat == PVMF_MIME_YUV420_SEMIPLANAR_YVU_INTERLACE) &&
+            (mode != FrameDeinterlacer::MODE_OFF)) {
+            // progressive copies in NV21 slots like the software path
+            int wanted = FrameSlotHeap::slotsNeeded(1, kBufferCount);
+            if (manager->reserveBuffers(mStream, frameSize, wanted, 1) == 0) {
+                LOGE("No pmem left to deinterlace into, leaving it to SurfaceFlinger");
+            } else {
+                state.configureSlots(pmem_adsp, frameSize, MemoryHeapBase::NO_CACHING, wanted);
+                char value[PROPERTY_VALUE_MAX];
+                property_get("persist.pv.deinterlace.threads", value, "0");
+                state.deinterlacer = new FrameDeinterlacer(mode, frameWidth, frameHeight, atoi(value));
+            }
+        }
+        if (state.slotsWanted == 0) manager->releaseBuffers(mStream);
     } else {
         LOGV("using software codec");
 
-        // YUV420 frames are 1.5 bytes/pixel
-        frameSize = (frameWidth * frameHeight * 3) / 2;
+        // SurfaceFlinger recomposes from the last posted slot, and the next
+        // frame needs another one to go into.  Decoder buffers are copied
+        // out of, so mNumberOfFramesToHold does not add to this.
+        int wanted = FrameSlotHeap::slotsNeeded(1, kBufferCount);
 
-        // create frame buffer heap
-        sp<MemoryHeapBase> master = new MemoryHeapBase(pmem_adsp, frameSize * kBufferCount, MemoryHeapBase::NO_CACHING);
-        if (master->heapID() < 0) {
-            LOGE("Error creating frame buffer heap");
+        // as many as other video outputs leave room for
+        if (manager->reserveBuffers(mStream, frameSize, wanted, 1) == 0) {
+            LOGE("No pmem left for the frame buffer heap");
             return false;
         }
-        master->setDevice(pmem);
-        sp<MemoryHeapPmem> heap = new MemoryHeapPmem(master, 0);
-        heap->slap();
-        mBufferHeap = ISurface::BufferHeap(displayWidth, displayHeight, 
-                frameWidth, frameHeight, HAL_PIXEL_FORMAT_YCrCb_420_SP, heap);
-        master.clear();
-        mSurface->registerBuffers(mBufferHeap);
-
-        // create frame buffers
-        for (int i = 0; i < kBufferCount; i++) {
-            mFrameBuffers[i] = i * frameSize;
-        }
+        state.configureSlots(pmem_adsp, frameSize, MemoryHeapBase::NO_CACHING, wanted);
 
-        LOGV("video = %d x %d", displayWidth, displayHeight);
+        LOGV("video = %d x %d", state.displayWidth, state.displayHeight);
         LOGV("frame = %d x %d", frameWidth, frameHeight);
         LOGV("frame #bytes = %d", frameSize);
-
-        // register frame buffers with SurfaceFlinger
-        mFrameBufferIndex = 0;
     }
 
-    mInitialized = true;
-    LOGV("sendEvent(MEDIA_SET_VIDEO_SIZE, %d, %d)", iVideoDisplayWidth, iVideoDisplayHeight);
-    mPvPlayer->sendEvent(MEDIA_SET_VIDEO_SIZE, iVideoDisplayWidth, iVideoDisplayHeight);
-    return mInitialized;
+    // both codec paths post NV21
+    state.captureFormat = CAPTURE_FORMAT_NV21;
+    return true;
 }
 
-PVMFStatus AndroidSurfaceOutputMsm72xx::writeFrameBuf(uint8* aData, uint32 aDataLen, const PvmiMediaXferHeader& data_header_info)
+// the path every frame of state takes
+AndroidSurfaceOutputMsm72xx::FrameHandler AndroidSurfaceOutputMsm72xx::selectFrameHandler(const OutputState& state)
 {
-    // OK to drop frames if no surface
-    if (mSurface == 0) return PVMFSuccess;
-
-    // hardware codec
-    if (mHardwareCodec) {
-
-        // initialize frame buffer heap
-        if (mBufferHeap.heap == 0) {
-            LOGV("initializing for hardware");
-            LOGV("private data pointer is 0%p\n", data_header_info.private_data_ptr);
-
-            // check for correct video format
-            if ((iVideoSubFormat != PVMF_MIME_YUV420_SEMIPLANAR_YVU) &&
-                (iVideoSubFormat != PVMF_MIME_YUV420_SEMIPLANAR_YVU_INTERLACE))
-                    return PVMFFailure;
-
-            uint32 fd;
-            if (!getPmemFd(data_header_info.private_data_ptr, &fd)) {
-                LOGE("Error getting pmem heap from private_data_ptr");
-                return PVMFFailure;
-            }
+    if (!state.hardwareCodec)
+        return &AndroidSurfaceOutputMsm72xx::writeConvertedFrame<SurfaceSink>;
+    if (state.deinterlacer != NULL)
+        return &AndroidSurfaceOutputMsm72xx::writeDeinterlacedFrame<SurfaceSink>;
+    if (state.subFormat == PVMF_MIME_YUV420_SEMIPLANAR_YVU) {
+        LOGV("creating buffers for PVMF_MIME_YUV420_SEMIPLANAR_YVU");
+        return &AndroidSurfaceOutputMsm72xx::writeRegisteredFrame<Nv21Format>;
+    }
+    LOGV("creating buffers for PVMF_MIME_YUV420_SEMIPLANAR_YVU_INTERLACE");
+    return &AndroidSurfaceOutputMsm72xx::writeRegisteredFrame<Nv21InterlacedFormat>;
+}
 
-            // ugly hack to pass an sp<MemoryHeapBase> as an int
-            sp<MemoryHeapBase> master = (MemoryHeapBase *) fd;
-            master->setDevice(pmem);
+template <class Format>
+PVMFStatus AndroidSurfaceOutputMsm72xx::writeRegisteredFrame(uint8* aData, const PvmiMediaXferHeader& header)
+{
+    PlatformPrivateInfo info;
+    bool isNew;
+    sp<MemoryHeapPmem> heap = decoderHeap<SurfaceSink>(header, &info, &isNew);
+    if (heap == 0) return PVMFFailure;
+
+    // register the heap the frame is in; a decoder that moved to
+    // another heap is followed without going through initCheck
+    if ((mBufferHeap.heap == 0) || (info.heapKey != mHeapKey)) {
+        LOGV("registering %s decoder heap 0x%x", isNew ? "new" : "known", info.heapKey);
+        if (mBufferHeap.heap != 0) mSurface->unregisterBuffers();
+        // register frame buffers with SurfaceFlinger
+        const OutputState& state = *mFrameState;
+        mBufferHeap = ISurface::BufferHeap(state.displayWidth, state.displayHeight,
+                state.width, state.height, Format::kHalFormat, heap);
+        mSurface->registerBuffers(mBufferHeap);
+        mHeapKey = info.heapKey;
+    }
 
-            // create new reference
-            uint32_t heap_flags = master->getFlags() & MemoryHeapBase::NO_CACHING;
-            sp<MemoryHeapPmem> heap = new MemoryHeapPmem(master, heap_flags);
-            heap->slap();
+    // post to SurfaceFlinger
+    mOffset = info.offset;
+    mSurface->postBuffer(mOffset);
+    captureFrame(mBufferHeap.heap->base(), mOffset);
+    return framePosted();
+}
 
-            if(iVideoSubFormat == PVMF_MIME_YUV420_SEMIPLANAR_YVU) {
-                // register frame buffers with SurfaceFlinger
-                LOGV("creating buffers for PVMF_MIME_YUV420_SEMIPLANAR_YVU");
-                mBufferHeap = ISurface::BufferHeap(iVideoDisplayWidth, iVideoDisplayHeight,
-                        iVideoWidth, iVideoHeight, HAL_PIXEL_FORMAT_YCrCb_420_SP, heap);
-            } else {
-                // register frame buffers with SurfaceFlinger
-                LOGV("creating buffers for PVMF_MIME_YUV420_SEMIPLANAR_YVU_INTERLACE");
-                mBufferHeap = ISurface::BufferHeap(iVideoDisplayWidth, iVideoDisplayHeight,
-                        iVideoWidth, iVideoHeight, HAL_PIXEL_FORMAT_YCrCb_420_SP ^ HAL_PIXEL_FORMAT_INTERLACE, heap);
-            }
+// post the last video frame to refresh screen after pause
+void AndroidSurfaceOutputMsm72xx::postLastFrame()
+{
+    // nothing to refresh while a new configuration is being attached
+    StateReader reader(mState);
+    if (reader.get() == NULL) return;
+
+    Mutex::Autolock lock(mFrameLock);
+    // frames are not coming through writeFrameBuf while tunneled
+    if ((mTunnelSink != NULL) && mTunnelSink->isActive()) {
+        mTunnelSink->postLastFrame();
+        return;
+    }
 
-            master.clear();
-            mSurface->registerBuffers(mBufferHeap);
-        }
+    // ignore if no surface or heap; until the next frame the one on screen
+    // is from the configuration the frame path is on
+    if ((mSurface == NULL) || (mBufferHeap.heap == NULL) || (mFrameState == 0)) return;
 
-        // get pmem offset and post to SurfaceFlinger
-        if (!getOffset(data_header_info.private_data_ptr, &mOffset)) {
-            LOGE("Error getting pmem offset from private_data_ptr");
-            return PVMFFailure;
-        }
+    if (mFrameState->hardwareCodec && (mFrameState->deinterlacer == NULL)) {
         mSurface->postBuffer(mOffset);
     } else {
-        // software codec
-        if (++mFrameBufferIndex == kBufferCount) mFrameBufferIndex = 0;
-        convertFrame(aData, static_cast<uint8*>(mBufferHeap.heap->base()) + mFrameBuffers[mFrameBufferIndex], aDataLen);
-        // post to SurfaceFlinger
         mSurface->postBuffer(mFrameBuffers[mFrameBufferIndex]);
     }
+}
 
-    //Average FPS profiling
-    if(mStatistics) AverageFPSProfiling();
-
-    return PVMFSuccess;
+// SurfaceFlinger lets go of whatever the frame path registered last
+void AndroidSurfaceOutputMsm72xx::detachState(const OutputState* published, const OutputState* adopted, bool replacing)
+{
+    AndroidSurfaceOutput::closeFrameBuf();
 }
 
-// post the last video frame to refresh screen after pause
-void AndroidSurfaceOutputMsm72xx::postLastFrame()
+void AndroidSurfaceOutputMsm72xx::convertRows(const uint8_t* src, size_t offset, int firstRow, int rows)
 {
-    // ignore if no surface or heap
-    if ((mSurface == NULL) || (mBufferHeap.heap == NULL)) return;
+    mFrameWriter.writeI420AsNv21Rows(src, offset, mFrameState->width, mFrameState->height, firstRow, rows);
+}
 
-    if (mHardwareCodec) {
-        mSurface->postBuffer(mOffset);
-    } else {
-        mSurface->postBuffer(mFrameBuffers[mFrameBufferIndex]);
-    }
+void AndroidSurfaceOutputMsm72xx::postRows(size_t offset)
+{
+    mSurface->postBuffer(offset);
+    // posted before writeFrameBuf sees the frame, so it carries the
+    // timestamp of the one before
+    captureFrame(mBufferHeap.heap->base(), offset);
 }
 
-bool AndroidSurfaceOutputMsm72xx::getPmemFd(OsclAny *private_data_ptr, uint32 *pmemFD)
+void AndroidSurfaceOutputMsm72xx::applyQualityLevel(int level)
 {
-    PLATFORM_PRIVATE_LIST *listPtr = NULL;
-    PLATFORM_PRIVATE_PMEM_INFO *pmemInfoPtr = NULL;
-    bool returnType = false;
-    LOGV("in getPmemfd - privatedataptr=%p\n",private_data_ptr);
-    listPtr = (PLATFORM_PRIVATE_LIST*) private_data_ptr;
-
-    for (uint32 i=0;i<listPtr->nEntries;i++)
-    {
-        if(listPtr->entryList->type == PLATFORM_PRIVATE_PMEM)
-        {
-            LOGV("in getPmemfd - entry type = %d\n",listPtr->entryList->type);
-          pmemInfoPtr = (PLATFORM_PRIVATE_PMEM_INFO*) (listPtr->entryList->entry);
-          returnType = true;
-          if(pmemInfoPtr){
-            *pmemFD = pmemInfoPtr->pmem_fd;
-            LOGV("in getPmemfd - pmemFD = %d\n",*pmemFD);
-          }
-          break;
-        }
-    }
-    return returnType;
+    bool half = (level >= QualityLadder::LEVEL_HALF_SIZE);
+    bool wasHalf = (mOutputLevel >= QualityLadder::LEVEL_HALF_SIZE);
+    mOutputLevel = level;
+    if (half != wasHalf) registerSlots();
+    // slots hold nothing reusable across a level change
+    for (int i = 0; i < kBufferCount; i++) mSlotUses[i] = 0;
 }
 
-bool AndroidSurfaceOutputMsm72xx::getOffset(OsclAny *private_data_ptr, uint32 *offset)
+// SurfaceFlinger scales the w x h corner of the buffers it is given to the
+// surface, so a half size frame only needs w and h halved
+void AndroidSurfaceOutputMsm72xx::registerSlots()
 {
-    PLATFORM_PRIVATE_LIST *listPtr = NULL;
-    PLATFORM_PRIVATE_PMEM_INFO *pmemInfoPtr = NULL;
-    bool returnType = false;
-
-    listPtr = (PLATFORM_PRIVATE_LIST*) private_data_ptr;
-    LOGV("in getOffset: listPtr = %p\n",listPtr);
-    for (uint32 i=0;i<listPtr->nEntries;i++)
-    {
-        if(listPtr->entryList->type == PLATFORM_PRIVATE_PMEM)
-        {
-            LOGV(" in getOffset: entrytype = %d\n",listPtr->entryList->type);
-
-          pmemInfoPtr = (PLATFORM_PRIVATE_PMEM_INFO*) (listPtr->entryList->entry);
-          returnType = true;
-          if(pmemInfoPtr){
-            *offset = pmemInfoPtr->offset;
-            LOGV("in getOffset: offset = %d\n",*offset);
-          }
-          break;
-        }
-    }
-    return returnType;
+    int scale = (mOutputLevel >= QualityLadder::LEVEL_HALF_SIZE) ? 2 : 1;
+    const OutputState& state = *mFrameState;
+    if (mBufferHeap.heap != 0) mSurface->unregisterBuffers();
+    mBufferHeap = ISurface::BufferHeap(state.displayWidth / scale, state.displayHeight / scale,
+            state.width, state.height, HAL_PIXEL_FORMAT_YCrCb_420_SP, mSlots.heap());
+    mSurface->registerBuffers(mBufferHeap);
 }
 
-static inline void* byteOffset(void* p, size_t offset) { return (void*)((uint8_t*)p + offset); }
+bool AndroidSurfaceOutputMsm72xx::grabFrame(uint8* dst, int width, int height, int dstStride, int rgbFormat)
+{
+    if ((dst == NULL) || (width <= 0) || (height <= 0)) return false;
+    StateReader reader(mState);
+    if (reader.get() == NULL) return false;
+
+    // keeps the software path from advancing onto the slot being read; the
+    // frame on screen is from the configuration the frame path is on
+    Mutex::Autolock lock(mFrameLock);
+    if ((mFrameState == 0) || (mBufferHeap.heap == 0)) return false;
+    const OutputState& state = *mFrameState;
+    const uint8* frame = static_cast<const uint8*>(mBufferHeap.heap->base());
+    frame += (state.hardwareCodec && (state.deinterlacer == NULL)) ? mOffset : mFrameBuffers[mFrameBufferIndex];
+
+    // both codec paths display NV21, software frames maybe at half size
+    int scale = (!state.hardwareCodec && (mOutputLevel >= QualityLadder::LEVEL_HALF_SIZE)) ? 2 : 1;
+    YuvImage src;
+    src.y = frame;
+    src.u = frame + state.width * state.height;
+    src.v = NULL;
+    src.yStride = state.width;
+    src.uvStride = state.width;
+    src.format = YUV_FORMAT_NV21;
+    return yuvToRgbScaled(src, state.displayWidth / scale, state.displayHeight / scale,
+                          dst, width, height, dstStride, rgbFormat);
+}
 
-void AndroidSurfaceOutputMsm72xx::convertFrame(void* src, void* dst, size_t len)
+// display sink for tunneling a hardware decoder straight to SurfaceFlinger
+OMX_HANDLETYPE AndroidSurfaceOutputMsm72xx::getTunnelSink()
 {
-    // copy the Y plane
-    size_t y_plane_size = iVideoWidth * iVideoHeight;
-    //LOGV("len=%u, y_plane_size=%u", len, y_plane_size);
-    memcpy(dst, src, y_plane_size + iVideoWidth);
-
-    // re-arrange U's and V's
-    uint16_t* pu = (uint16_t*)byteOffset(src, y_plane_size);
-    uint16_t* pv = (uint16_t*)byteOffset(pu, y_plane_size / 4);
-    uint32_t* p = (uint32_t*)byteOffset(dst, y_plane_size);
-
-    int count = y_plane_size / 8;
-    //LOGV("u = %p, v = %p, p = %p, count = %d", pu, pv, p, count);
-    do {
-        uint32_t u = *pu++;
-        uint32_t v = *pv++;
-        *p++ = ((u & 0xff) << 8) | ((u & 0xff00) << 16) | (v & 0xff) | ((v & 0xff00) << 8);
-    } while (--count);
+    // for the configuration published last; a tunneled decoder would
+    // bypass the deinterlacer
+    StateReader reader(mState);
+    const OutputState* state = reader.get();
+    if (!mTunnelEnabled || (state == NULL) || !state->hardwareCodec || (state->deinterlacer != NULL))
+        return NULL;
+
+    Mutex::Autolock lock(mFrameLock);
+    if (mTunnelSink == NULL) {
+        int format = HAL_PIXEL_FORMAT_YCrCb_420_SP;
+        if (state->subFormat == PVMF_MIME_YUV420_SEMIPLANAR_YVU_INTERLACE)
+            format ^= HAL_PIXEL_FORMAT_INTERLACE;
+        LOGV("creating tunnel sink");
+        mTunnelSink = new OmxDisplaySink(mSurface, sp<Overlay>(),
+                state->displayWidth, state->displayHeight, state->width, state->height,
+                format, mNumberOfFramesToHold);
+    }
+    return mTunnelSink->handle();
 }
 
 // factory function for playerdriver linkage
@@ -288,25 +276,39 @@ extern "C" AndroidSurfaceOutputMsm72xx* createVideoMio()
     return new AndroidSurfaceOutputMsm72xx();
 }
 
-void AndroidSurfaceOutputMsm72xx::AverageFPSProfiling()
+// tunnel hook for a decoder node, returns NULL when tunneling is off; only
+// tools/tunnel_bench.cpp calls it so far, no decoder node in this tree does,
+// so on a device persist.pv.tunnel alone changes nothing
+extern "C" OMX_HANDLETYPE getVideoMioTunnelSink(AndroidSurfaceOutputMsm72xx* mio)
 {
-    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
-    nsecs_t diff = now - mLastFpsTime;
-    iFrameNumber++;
-
-    if (diff > ms2ns(250)) {
-        float mFps =  ((iFrameNumber - mLastFrame) * float(s2ns(1))) / diff;
-        LOGE("AndroidSurfaceOutputMsm72xx: Frames Per Second: %.4f", mFps);
-        mFpsSum += mFps;
-        mNumFpsSamples++;
-        mLastFpsTime = now;
-        mLastFrame = iFrameNumber;
-    }
+    return mio->getTunnelSink();
+}
+
+// per stream control of duplicate frame skipping, and the number skipped so far
+extern "C" void setVideoMioDuplicateSkip(AndroidSurfaceOutputMsm72xx* mio, bool enable)
+{
+    mio->setDuplicateFrameSkip(enable);
+}
+
+extern "C" unsigned long getVideoMioSkippedFrames(AndroidSurfaceOutputMsm72xx* mio)
+{
+    return mio->getSkippedFrames();
+}
+
+// row-band hooks for low latency software decoders, see row_band_pipeline.h
+extern "C" bool beginVideoMioBandFrame(AndroidSurfaceOutputMsm72xx* mio, const uint8* frame)
+{
+    return mio->beginBandFrame(frame);
+}
+
+extern "C" void videoMioBandRowsDecoded(AndroidSurfaceOutputMsm72xx* mio, int rows)
+{
+    mio->bandRowsDecoded(rows);
 }
 
-void AndroidSurfaceOutputMsm72xx::AverageFPSPrint()
+// still of the displayed frame, see grabFrame
+extern "C" bool grabVideoMioFrame(AndroidSurfaceOutputMsm72xx* mio, uint8* dst,
+                                  int width, int height, int dstStride, int rgbFormat)
 {
-    LOGE("==========================================================");
-    LOGE("AndroidSurfaceOutputMsm72xx: Average Frames Per Second: %.4f", mFpsSum / mNumFpsSamples);
-    LOGE("==========================================================");
+    return mio->grabFrame(dst, width, height, dstStride, rgbFormat);
 }
@@ -19,69 +19,50 @@
 #ifndef ANDROID_SURFACE_OUTPUT_MSM72XXH_INCLUDED
 #define ANDROID_SURFACE_OUTPUT_MSM72XXH_INCLUDED
 
-#include "android_surface_output.h"
+#include "msm_surface_output.h"
 
-// support for shared contiguous physical memory
-#include <binder/MemoryHeapPmem.h>
 
-// data structures for tunneling buffers
-typedef struct PLATFORM_PRIVATE_PMEM_INFO
-{
-    /* pmem file descriptor */
-    uint32 pmem_fd;
-    uint32 offset;
-} PLATFORM_PRIVATE_PMEM_INFO;
-
-typedef struct PLATFORM_PRIVATE_ENTRY
-{
-    /* Entry type */
-    uint32 type;
-
-    /* Pointer to platform specific entry */
-    OsclAny* entry;
-} PLATFORM_PRIVATE_ENTRY;
-
-typedef struct PLATFORM_PRIVATE_LIST
-{
-    /* Number of entries */
-    uint32 nEntries;
-
-    /* Pointer to array of platform specific entries *
-     * Contiguous block of PLATFORM_PRIVATE_ENTRY elements */
-    PLATFORM_PRIVATE_ENTRY* entryList;
-} PLATFORM_PRIVATE_LIST;
-
-
-class AndroidSurfaceOutputMsm72xx : public AndroidSurfaceOutput
+class AndroidSurfaceOutputMsm72xx : public MsmSurfaceOutput<AndroidSurfaceOutputMsm72xx>
 {
 public:
     AndroidSurfaceOutputMsm72xx();
 
     // frame buffer interface
-    virtual bool initCheck();
-    virtual PVMFStatus writeFrameBuf(uint8* aData, uint32 aDataLen, const PvmiMediaXferHeader& data_header_info);
     virtual void postLastFrame();
 
-    OSCL_IMPORT_REF ~AndroidSurfaceOutputMsm72xx();
+    // tunneled decoder-to-display support
+    OMX_HANDLETYPE getTunnelSink();
 
-private:
-    bool getPmemFd(OsclAny *private_data_ptr, uint32 *pmemFD);
-    bool getOffset(OsclAny *private_data_ptr, uint32 *offset);
-    void convertFrame(void* src, void* dst, size_t len);
+    // RGB still of the frame on screen scaled to width x height, read in
+    // place from the displayed buffer; rgbFormat is RGB_FORMAT_565/X8888
+    bool grabFrame(uint8* dst, int width, int height, int dstStride, int rgbFormat);
 
-    // hardware frame buffer support
-    bool                        mHardwareCodec;
-    uint32                      mOffset;
+    OSCL_IMPORT_REF ~AndroidSurfaceOutputMsm72xx();
 
-    //Average FPS profiling
-    virtual void AverageFPSProfiling();
-    virtual void AverageFPSPrint();
-    bool                        mStatistics;
-    int                         mLastFrame;
-    float                       mFpsSum;
-    unsigned long               iFrameNumber;
-    unsigned long               mNumFpsSamples;
-    nsecs_t                     mLastFpsTime;
+private:
+    friend class MsmSurfaceOutput<AndroidSurfaceOutputMsm72xx>;
+    static const char* const kName;
+
+    // everything goes to SurfaceFlinger, registered by the frame path, so
+    // a configuration has nothing of its own to attach
+    typedef SurfaceSink SlotSink;
+    struct Display {};
+    bool buildState(OutputState& state, const OutputState* current);
+    bool attachState(OutputState& state) { return true; }
+    void detachState(const OutputState* published, const OutputState* adopted, bool replacing);
+    FrameHandler selectFrameHandler(const OutputState& state);
+
+    // hardware frames registered in place, Format gives the HAL format
+    // the decoder heap is registered as
+    template <class Format>
+    PVMFStatus writeRegisteredFrame(uint8* aData, const PvmiMediaXferHeader& header);
+
+    // started by the first beginBandFrame
+    virtual void convertRows(const uint8_t* src, size_t offset, int firstRow, int rows);
+    virtual void postRows(size_t offset);
+
+    void applyQualityLevel(int level);
+    void registerSlots();
 };
 
 #endif // ANDROID_SURFACE_OUTPUT_MSM72XX_H_INCLUDED
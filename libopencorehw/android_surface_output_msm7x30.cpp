@@ -26,8 +26,6 @@
 
 #include <cutils/properties.h>
 
-#define PLATFORM_PRIVATE_PMEM 1
-
 #if HAVE_ANDROID_OS
 #include <linux/android_pmem.h>
 #endif
@@ -39,131 +37,263 @@ using namespace android;
 static const char* pmem_adsp = "/dev/pmem_adsp";
 static const char* pmem = "/dev/pmem";
 
-OSCL_EXPORT_REF AndroidSurfaceOutputMsm7x30::AndroidSurfaceOutputMsm7x30() :
-    AndroidSurfaceOutput()
+const char* const AndroidSurfaceOutputMsm7x30::kName = "AndroidSurfaceOutputMsm7x30";
+
+// decoder output registered with SurfaceFlinger in place
+struct TiledFormat {
+    static const int kHalFormat = HAL_PIXEL_FORMAT_YCbCr_420_SP_TILED;
+};
+struct Nv12Format {
+    static const int kHalFormat = HAL_PIXEL_FORMAT_YCbCr_420_SP;
+};
+
+AndroidSurfaceOutputMsm7x30::Display::Display() :
+    overlayFormat(0),
+    slotFormat(HAL_PIXEL_FORMAT_YCbCr_420_SP),
+    softwareComposition(false),
+    rgbFormat(RGB_FORMAT_565),
+    rgbCount(0),
+    rgbFlags(0),
+    rgbFd(-1)
 {
-    mHardwareCodec = false;
-    mFd = 0;
-    mUseOverlay = false;
+}
 
-    //Statistics profiling
-    char value[PROPERTY_VALUE_MAX];
-    mStatistics = false;
-    mLastFrame = 0;
-    mLastFpsTime = 0;
-    mFpsSum = 0;
-    iFrameNumber = 0;
-    mNumFpsSamples = 0;
-    property_get("persist.debug.pv.statistics", value, "0");
-    if(atoi(value)) mStatistics = true;
+OSCL_EXPORT_REF AndroidSurfaceOutputMsm7x30::AndroidSurfaceOutputMsm7x30()
+{
+    mFd = 0;
+    mBridged = false;
+    mConverter = NULL;
 }
 
 OSCL_EXPORT_REF AndroidSurfaceOutputMsm7x30::~AndroidSurfaceOutputMsm7x30()
 {
-    if(mStatistics) AverageFPSPrint();
-    if (!mUseOverlay) {
+    sp<OutputState> state = mState.current();
+    bool useOverlay = (state != 0) && (state->display.overlay != 0);
+    shutdownOutput();
+    delete mConverter;
+    if (!useOverlay) {
         LOGV("Surface flinger - Unregister Buffers");
         mSurface->unregisterBuffers();
     }
 }
 
-// create a frame buffer for software codecs
-OSCL_EXPORT_REF bool AndroidSurfaceOutputMsm7x30::initCheck()
+// the configuration for iVideo*, see MsmSurfaceOutput::initCheck; overlays
+// are created and RGB buffers registered by attachState
+bool AndroidSurfaceOutputMsm7x30::buildState(OutputState& state, const OutputState* current)
 {
+    // a decoder port reconfiguration that only moves the crop keeps the
+    // overlay; writeFrameBuf follows the decoder if it changed heaps
+    if ((current != NULL) && canKeepOverlay(*current, state)) {
+        LOGV("keeping the overlay, crop %d x %d", state.displayWidth, state.displayHeight);
+        state.hardwareCodec = true;
+        state.display.overlay = current->display.overlay;
+        state.display.overlayFormat = current->display.overlayFormat;
+        return true;
+    }
 
-    // initialize only when we have all the required parameters
-    if (((iVideoParameterFlags & VIDEO_SUBFORMAT_VALID) == 0) || !checkVideoParameterFlags())
-        return mInitialized;
-
-    // release resources if previously initialized
-    closeFrameBuf();
-
-    // reset flags in case display format changes in the middle of a stream
-    resetVideoParameterFlags();
+    if (state.subFormat == PVMF_MIME_YUV420_PACKEDSEMIPLANAR_TILE) {
+        buildSurface(state);
+        return true;
+    }
+    return buildOverlay(state);
+}
 
-    if(iVideoSubFormat == PVMF_MIME_YUV420_PACKEDSEMIPLANAR_TILE) {
-        mUseOverlay = false;
-        initSurface();
+// the path every frame of state takes; one that keeps the overlay keeps
+// it too
+AndroidSurfaceOutputMsm7x30::FrameHandler AndroidSurfaceOutputMsm7x30::selectFrameHandler(const OutputState& state)
+{
+    if (state.display.softwareComposition) {
+        if (state.hardwareCodec)
+            return &AndroidSurfaceOutputMsm7x30::writeComposedFrame<Nv21Layout>;
+        return &AndroidSurfaceOutputMsm7x30::writeComposedFrame<I420Layout>;
     }
-    else {
-        mUseOverlay = true;
-        initOverlay();
+    if (!state.hardwareCodec)
+        return &AndroidSurfaceOutputMsm7x30::writeConvertedFrame<OverlaySink>;
+    if (state.deinterlacer != NULL)
+        return &AndroidSurfaceOutputMsm7x30::writeDeinterlacedFrame<OverlaySink>;
+    if (state.display.overlay != 0)
+        return &AndroidSurfaceOutputMsm7x30::writeOverlayFrame;
+    if (state.subFormat == PVMF_MIME_YUV420_PACKEDSEMIPLANAR_TILE)
+        return &AndroidSurfaceOutputMsm7x30::writeRegisteredFrame<TiledFormat>;
+    return &AndroidSurfaceOutputMsm7x30::writeRegisteredFrame<Nv12Format>;
+}
+
+bool AndroidSurfaceOutputMsm7x30::canKeepOverlay(const OutputState& current, const OutputState& state)
+{
+    if (!current.hardwareCodec || (current.display.overlay == 0)) return false;
+    // the deinterlacer and its slots are sized for the old frame
+    if (current.deinterlacer != NULL) return false;
+    // the sink programs the overlay itself
+    {
+        Mutex::Autolock lock(mFrameLock);
+        if (mTunnelSink != NULL) return false;
     }
+    return (state.subFormat == current.subFormat) &&
+           (state.width == current.width) && (state.height == current.height);
+}
 
-    return mInitialized;
+// the overlay there is only one of, and the buffers of the surface, are
+// let go by the configuration before first; detachState leaves its last
+// frame with SurfaceFlinger until the new one is attached
+bool AndroidSurfaceOutputMsm7x30::replacesDisplay(const OutputState& current, const OutputState& state)
+{
+    if ((current.display.overlay != 0) && (current.display.overlay != state.display.overlay)) return true;
+    if ((state.display.overlay == 0) && (state.display.overlayFormat != 0)) return true;
+    return state.display.softwareComposition;
 }
 
-void AndroidSurfaceOutputMsm7x30::initSurface()
+// a kept overlay shows the same decoder heaps and crop changes only
+bool AndroidSurfaceOutputMsm7x30::keepsFrameState(const OutputState& current, const OutputState& state)
 {
-    // copy parameters in case we need to adjust them
-    int displayWidth = iVideoDisplayWidth;
-    int displayHeight = iVideoDisplayHeight;
-    int frameWidth = iVideoWidth;
-    int frameHeight = iVideoHeight;
-    int frameSize;
-    LOGV("displayWidth = %d displayHeight = %d framewidth = %d frameHeight = %d\n", displayWidth, displayHeight, frameWidth, frameHeight);
+    return (current.display.overlay != 0) && (current.display.overlay == state.display.overlay);
+}
 
-    // Always set number of frames to hold to 2
-    mNumberOfFramesToHold = 2;
+// creates the overlay, or registers the RGB buffers, of a configuration
+// that is not published yet; nothing published holds either by now
+bool AndroidSurfaceOutputMsm7x30::attachState(OutputState& state)
+{
+    VideoOutputManager* manager = VideoOutputManager::instance();
+    Display& display = state.display;
+    int orientation = ISurface::BufferHeap::ROT_0;
 
-    // MSM72xx hardware codec uses semi-planar format
-    if (iVideoSubFormat == PVMF_MIME_YUV420_PACKEDSEMIPLANAR_TILE) {
-        LOGV("initSurface using hardware codec");
-        mHardwareCodec = true;
-    }else {
-        LOGV("initSurface using software codec");
+    if (display.overlay != 0) {
+        display.overlay->setCrop(0, 0, state.displayWidth, state.displayHeight);
+    } else if (display.overlayFormat != 0) {
+        sp<OverlayRef> ref = mSurface->createOverlay(state.width, state.height, display.overlayFormat, orientation);
+        sp<Overlay> overlay = new Overlay(ref);
+        if ((ref == 0) || (overlay->getStatus() != NO_ERROR)) {
+            LOGE("Create overlay failed, using software composition\n");
+            // the decoder output is converted straight from aData
+            display.overlayFormat = 0;
+            state.configureSlots(NULL, 0, 0, 0);
+            delete state.deinterlacer;
+            state.deinterlacer = NULL;
+            manager->releaseBuffers(mStream);
+            manager->releaseOverlay(mStream);
+            if (!buildSoftwareComposition(state)) return false;
+        } else {
+            LOGV("Create overlay successful\n");
+            overlay->setCrop(0, 0, state.displayWidth, state.displayHeight);
+            display.overlay = overlay;
+        }
+    }
 
-        // YUV420 frames are 1.5 bytes/pixel
-        frameSize = (frameWidth * frameHeight * 3) / 2;
+    if (display.softwareComposition && (mSurface->registerBuffers(display.rgbHeap) != NO_ERROR)) {
+        LOGE("Register RGB buffers failed");
+        return false;
+    }
+    if (display.overlay == 0) manager->releaseOverlay(mStream);
+    initCapture(state);
+    return true;
+}
 
-        // create frame buffer heap
-        sp<MemoryHeapBase> master = new MemoryHeapBase(pmem_adsp, frameSize * kBufferCount);
-        if (master->heapID() < 0) {
-            LOGE("Error creating frame buffer heap");
-            return;
-        }
-        master->setDevice(pmem);
-        sp<MemoryHeapPmem> heap = new MemoryHeapPmem(master, 0);
-        heap->slap();
-        mBufferHeap = ISurface::BufferHeap(displayWidth, displayHeight, frameWidth, frameHeight, HAL_PIXEL_FORMAT_YCbCr_420_SP, heap);
-        master.clear();
-        mSurface->registerBuffers(mBufferHeap);
-
-        // create frame buffers
-        for (int i = 0; i < kBufferCount; i++) {
-            mFrameBuffers[i] = i * frameSize;
-        }
+// caller holds mFrameLock with nothing published
+void AndroidSurfaceOutputMsm7x30::detachState(const OutputState* published, const OutputState* adopted, bool replacing)
+{
+    if (replacing && (adopted != NULL)) bridgeFrame(*adopted);
+    sp<Overlay> overlay;
+    if (published != NULL) overlay = published->display.overlay;
+    if (overlay != 0) overlay->destroy();
+    if ((adopted != NULL) && (adopted->display.overlay != 0) && (adopted->display.overlay != overlay))
+        adopted->display.overlay->destroy();
+    if (((published != NULL) && published->display.softwareComposition) ||
+        ((adopted != NULL) && adopted->display.softwareComposition)) {
+        // the RGB frame on screen is the bridge
+        if (!mBridged) mSurface->unregisterBuffers();
+        mBufferHeap.heap.clear();
+    } else if (mBridged && !replacing) {
+        // the configuration after a bridge failed to attach, or is closed
+        // before its first frame
+        mSurface->unregisterBuffers();
+    }
+    if (!replacing) mBridged = false;
+    // free heaps
+    LOGV("free mHeapPmem");
+    mHeapPmem.clear();
+    mFd = 0;
+}
 
-        LOGV("video = %d x %d", displayWidth, displayHeight);
-        LOGV("frame = %d x %d", frameWidth, frameHeight);
-        LOGV("frame #bytes = %d", frameSize);
+// caller holds mFrameLock
+void AndroidSurfaceOutputMsm7x30::adoptDisplay(const OutputState& state)
+{
+    // the display of state has the layer now, or gets it with this frame
+    mBridged = false;
+    mHeapPmem.clear();
+    mFd = 0;
+    const Display& display = state.display;
+    if (!display.softwareComposition) return;
+
+    // attachState registered the RGB buffers already
+    mBufferHeap = display.rgbHeap;
+    mFrameWriter.init(display.rgbFlags, display.rgbFd, mBufferHeap.heap->base());
+    size_t frameSize = mBufferHeap.hor_stride * mBufferHeap.h * mConverter->bytesPerPixel(display.rgbFormat);
+    for (int i = 0; i < display.rgbCount; i++) {
+        mFrameBuffers[i] = i * frameSize;
+    }
+    mBufferCount = display.rgbCount;
+}
 
-        // register frame buffers with SurfaceFlinger
-        mFrameBufferIndex = 0;
+/*
+ * The overlay is destroyed before the one of the next configuration can
+ * be created, which would leave the layer empty until its first frame.
+ * The frame the overlay shows is registered with SurfaceFlinger and posted
+ * first, from the heap the overlay reads it from; creating the new overlay,
+ * or registering new buffers, takes the layer back.  RGB buffers of
+ * software composition are simply left registered.
+ */
+void AndroidSurfaceOutputMsm7x30::bridgeFrame(const OutputState& adopted)
+{
+    const Display& display = adopted.display;
+    if (display.softwareComposition) {
+        mBridged = (mBufferHeap.heap != 0);
+        return;
+    }
+    // nothing queued to it yet
+    if ((display.overlay == 0) || (mHeapPmem == 0)) return;
+
+    size_t offset = mFrameBuffers[mFrameBufferIndex];
+    if (adopted.hardwareCodec && (adopted.deinterlacer == NULL)) offset = mOffset;
+    ISurface::BufferHeap bridge(adopted.displayWidth, adopted.displayHeight, adopted.width, adopted.height,
+            display.overlayFormat, ISurface::BufferHeap::ROT_0, 0, mHeapPmem);
+    if (mSurface->registerBuffers(bridge) != NO_ERROR) {
+        LOGE("Register Buffer Failed, the frame on screen goes with the overlay");
+        return;
     }
+    LOGV("frame at %u stays on screen while the overlay is replaced", offset);
+    mSurface->postBuffer(offset);
+    mBridged = true;
+}
+
+void AndroidSurfaceOutputMsm7x30::buildSurface(OutputState& state)
+{
+    LOGV("displayWidth = %d displayHeight = %d framewidth = %d frameHeight = %d\n",
+         state.displayWidth, state.displayHeight, state.width, state.height);
+
+    // Always set number of frames to hold to 2
+    mNumberOfFramesToHold = 2;
 
-    mInitialized = true;
-    LOGV("sendEvent(MEDIA_SET_VIDEO_SIZE, %d, %d)", iVideoDisplayWidth, iVideoDisplayHeight);
-    mPvPlayer->sendEvent(MEDIA_SET_VIDEO_SIZE, iVideoDisplayWidth, iVideoDisplayHeight);
+    // the tiled decoder heap is registered with SurfaceFlinger by the
+    // first frame
+    LOGV("initSurface using hardware codec");
+    state.hardwareCodec = true;
+    VideoOutputManager::instance()->releaseBuffers(mStream);
 }
 
-void AndroidSurfaceOutputMsm7x30::initOverlay()
+bool AndroidSurfaceOutputMsm7x30::buildOverlay(OutputState& state)
 {
-    // copy parameters in case we need to adjust them
-    int displayWidth = iVideoDisplayWidth;
-    int displayHeight = iVideoDisplayHeight;
-    int frameWidth = iVideoWidth;
-    int frameHeight = iVideoHeight;
-    int orientation = ISurface::BufferHeap::ROT_0;
+    int frameWidth = state.width;
+    int frameHeight = state.height;
     int frameSize;
-    //LOGE("iVideoSubFormat = %d \n", iVideoSubFormat);
-    LOGV("displayWidth = %d displayHeight = %d framewidth = %d frameHeight = %d\n", displayWidth, displayHeight, frameWidth, frameHeight);
+    LOGV("displayWidth = %d displayHeight = %d framewidth = %d frameHeight = %d\n",
+         state.displayWidth, state.displayHeight, frameWidth, frameHeight);
+    VideoOutputManager* manager = VideoOutputManager::instance();
 
     // MSM7x30 hardware codec uses semi-planar format
-    if ((iVideoSubFormat == PVMF_MIME_YUV420_SEMIPLANAR_YVU) || (iVideoSubFormat == PVMF_MIME_YUV420_SEMIPLANAR) ||(iVideoSubFormat == PVMF_MIME_YUV420_PACKEDSEMIPLANAR_TILE)) {
+    if ((state.subFormat == PVMF_MIME_YUV420_SEMIPLANAR_YVU) || (state.subFormat == PVMF_MIME_YUV420_SEMIPLANAR) ||
+        (state.subFormat == PVMF_MIME_YUV420_PACKEDSEMIPLANAR_TILE) ||
+        (state.subFormat == PVMF_MIME_YUV420_SEMIPLANAR_YVU_INTERLACE)) {
         LOGV("using hardware codec");
-        mHardwareCodec = true;
-        mUseOverlay = true;
+        state.hardwareCodec = true;
         /*
          * When target is 8660 number of buffers to hold 2
          * When HDMI is off or 720p clip, number of buffers to hold 1
@@ -181,285 +311,435 @@ void AndroidSurfaceOutputMsm7x30::initOverlay()
             else
                 mNumberOfFramesToHold = 2;
         }
-        sp<OverlayRef> ref;
-        if(iVideoSubFormat == PVMF_MIME_YUV420_PACKEDSEMIPLANAR_TILE)
-            ref = mSurface->createOverlay(frameWidth, frameHeight,  HAL_PIXEL_FORMAT_YCbCr_420_SP_TILED, orientation);
-        else
-            ref = mSurface->createOverlay(frameWidth, frameHeight, HAL_PIXEL_FORMAT_YCrCb_420_SP, orientation);
-        mOverlay = new Overlay(ref);
-        if (mOverlay  == 0){
-             mUseOverlay = false;
-             LOGE("Create overlay failed\n");
-             return;
-        }else {
-             LOGV("Create overlay successful\n");
-             mFd = 0;
-             mOverlay->setCrop(0,0,displayWidth,displayHeight);
+        int mode = FrameDeinterlacer::configuredMode();
+        if ((state.subFormat == PVMF_MIME_YUV420_SEMIPLANAR_YVU_INTERLACE) &&
+            (mode != FrameDeinterlacer::MODE_OFF)) {
+            return buildDeinterlacedOverlay(state, mode);
+        }
+        manager->releaseBuffers(mStream);
+        // another video output may hold the overlay already
+        if (!manager->reserveOverlay(mStream)) {
+            LOGE("No overlay left for this stream, using software composition\n");
+            return buildSoftwareComposition(state);
         }
+        if (state.subFormat == PVMF_MIME_YUV420_PACKEDSEMIPLANAR_TILE)
+            state.display.overlayFormat = HAL_PIXEL_FORMAT_YCbCr_420_SP_TILED;
+        else
+            state.display.overlayFormat = HAL_PIXEL_FORMAT_YCrCb_420_SP;
+        return true;
+    }
 
-    } else {
-        LOGV("using software codec");
-        /*
-         * For software codec use number of buffers to hold 1
-         */
-        mNumberOfFramesToHold = 1;
+    LOGV("using software codec");
+    /*
+     * For software codec use number of buffers to hold 1
+     */
+    mNumberOfFramesToHold = 1;
+
+    // YUV420 frames are 1.5 bytes/pixel
+    frameSize = state.frameBytes();
+
+    LOGV("video = %d x %d", state.displayWidth, state.displayHeight);
+    LOGV("frame = %d x %d", frameWidth, frameHeight);
+    LOGV("frame #bytes = %d", frameSize);
+
+    // the overlay, and the pmem to feed it, may be taken by another
+    // video output; SurfaceFlinger composes the frames then
+    if (manager->reserveOverlay(mStream))
+        return buildSoftwareOverlay(state, frameSize, HAL_PIXEL_FORMAT_YCbCr_420_SP);
+    LOGE("No overlay left for this stream, using software composition\n");
+    return buildSoftwareComposition(state);
+}
 
-        // YUV420 frames are 1.5 bytes/pixel
-        frameSize = (frameWidth * frameHeight * 3) / 2;
+// software frames converted to NV21 into a pmem heap the overlay reads
+bool AndroidSurfaceOutputMsm7x30::buildSoftwareOverlay(OutputState& state, int frameSize, int halFormat)
+{
+    // the overlay reads the slot on screen while the next one is written;
+    // decoder buffers are copied out of, so their hold count does not add
+    int wanted = FrameSlotHeap::slotsNeeded(1, kBufferCount);
+
+    // secondary streams get fewer buffers; the heap itself comes with the
+    // first frame and is handed to the overlay then
+    VideoOutputManager* manager = VideoOutputManager::instance();
+    if (manager->reserveBuffers(mStream, frameSize, wanted, 1) == 0) {
+        LOGE("No pmem left for the frame buffer heap, using software composition\n");
+        manager->releaseOverlay(mStream);
+        return buildSoftwareComposition(state);
+    }
+    state.configureSlots(pmem_adsp, frameSize, 0, wanted);
+    state.display.slotFormat = halFormat;
+    state.display.overlayFormat = halFormat;
+    return true;
+}
 
-        // create frame buffer heap
-        sp<MemoryHeapBase> master = new MemoryHeapBase(pmem_adsp, frameSize * kBufferCount);
-        if (master->heapID() < 0) {
-            LOGE("Error creating frame buffer heap");
-            return;
-        }
+// points the overlay at the slot heap; the ISurface BufferHeap is kept
+// for captures only
+void AndroidSurfaceOutputMsm7x30::registerSlots()
+{
+    const OutputState& state = *mFrameState;
+    mHeapPmem = mSlots.heap();
+    mBufferHeap = ISurface::BufferHeap(state.displayWidth, state.displayHeight,
+            state.width, state.height, state.display.slotFormat, mHeapPmem);
+    mFd = mHeapPmem->heapID();
+    LOGV("Calling setFd \n");
+    state.display.overlay->setFd(mFd);
+}
+
+// interlaced hardware frames deinterlaced into slots the overlay reads, in
+// the decoder's own YCrCb layout.  Without an overlay they are composed
+// as they are.
+bool AndroidSurfaceOutputMsm7x30::buildDeinterlacedOverlay(OutputState& state, int mode)
+{
+    if (!VideoOutputManager::instance()->reserveOverlay(mStream)) {
+        LOGE("No overlay left for this stream, using software composition\n");
+        VideoOutputManager::instance()->releaseBuffers(mStream);
+        return buildSoftwareComposition(state);
+    }
+    if (!buildSoftwareOverlay(state, state.frameBytes(), HAL_PIXEL_FORMAT_YCrCb_420_SP)) return false;
+    if (state.display.softwareComposition) return true;
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get("persist.pv.deinterlace.threads", value, "0");
+    state.deinterlacer = new FrameDeinterlacer(mode, state.width, state.height, atoi(value));
+    return true;
+}
+
+/*
+ * Fallback for when the overlay cannot be created (pipes in use, HDMI
+ * holding the overlay, ...): convert each frame to RGB and post it
+ * through ISurface so SurfaceFlinger composes it like any other layer.
+ * The buffers are registered by attachState.
+ */
+bool AndroidSurfaceOutputMsm7x30::buildSoftwareComposition(OutputState& state)
+{
+    Display& display = state.display;
+    display.overlayFormat = 0;
+
+    // no RGB kernel for the tiled layout; writeFrameBuf registers the
+    // decoder heap with SurfaceFlinger as YUV instead
+    if (state.subFormat == PVMF_MIME_YUV420_PACKEDSEMIPLANAR_TILE) {
+        LOGV("tiled frames go through ISurface unconverted");
+        return true;
+    }
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get("persist.pv.swcomp.format", value, "565");
+    display.rgbFormat = (atoi(value) == 8888) ? RGB_FORMAT_X8888 : RGB_FORMAT_565;
+    int halFormat = (display.rgbFormat == RGB_FORMAT_565) ? HAL_PIXEL_FORMAT_RGB_565 : HAL_PIXEL_FORMAT_RGBX_8888;
+
+    if (mConverter == NULL) {
+        property_get("persist.pv.swcomp.threads", value, "0");
+        mConverter = new YuvRgbConverter(atoi(value));
+    }
+
+    // only the visible area is converted
+    int width = state.displayWidth;
+    int height = state.displayHeight;
+    int frameSize = width * height * mConverter->bytesPerPixel(display.rgbFormat);
+
+    // pmem lets SurfaceFlinger blit with copybit, ashmem is uploaded as a
+    // texture; ashmem is also what is left once the pmem budget is spent
+    sp<IMemoryHeap> heap;
+    sp<MemoryHeapBase> master;
+    display.rgbCount = VideoOutputManager::instance()->reserveBuffers(mStream, frameSize, kBufferCount, 1);
+    if (display.rgbCount > 0) master = new MemoryHeapBase(pmem_adsp, frameSize * display.rgbCount);
+    if ((master != 0) && (master->heapID() >= 0)) {
         master->setDevice(pmem);
-        mHeapPmem = new MemoryHeapPmem(master, 0);
-        mHeapPmem->slap();
-        mBufferHeap = ISurface::BufferHeap(displayWidth, displayHeight,
-                frameWidth, frameHeight, HAL_PIXEL_FORMAT_YCbCr_420_SP, mHeapPmem);
-        master.clear();
-        //mSurface->registerBuffers(mBufferHeap);
-        // create frame buffers
-        for (int i = 0; i < kBufferCount; i++) {
-            mFrameBuffers[i] = i * frameSize;
-        }
-        mUseOverlay = true;
-        sp<OverlayRef> ref = mSurface->createOverlay(frameWidth, frameHeight, HAL_PIXEL_FORMAT_YCbCr_420_SP, orientation);
-        mOverlay = new Overlay(ref);
-        if (mOverlay  == 0){
-             mUseOverlay = false;
-             LOGE("Create overlay failed\n");
-             return;
-        }else {
-             LOGV("Create overlay successful\n");
-             mFd = mHeapPmem->heapID();
-             LOGV("Calling setFd \n");
-             mOverlay->setFd(mFd);
-             mOverlay->setCrop(0,0,displayWidth,displayHeight);
+        sp<MemoryHeapPmem> pmemHeap = new MemoryHeapPmem(master, 0);
+        pmemHeap->slap();
+        heap = pmemHeap;
+        display.rgbFlags = master->getFlags();
+        display.rgbFd = master->heapID();
+    } else {
+        LOGV("no pmem for the RGB heap, using ashmem");
+        VideoOutputManager::instance()->releaseBuffers(mStream);
+        display.rgbCount = kBufferCount;
+        heap = new MemoryHeapBase(frameSize * display.rgbCount, 0, "VideoMio7x3x");
+        if (heap->heapID() < 0) {
+            LOGE("Error creating RGB frame buffer heap");
+            return false;
         }
+        // nothing to clean for ashmem, SurfaceFlinger reads it through the cpu
+        display.rgbFlags = MemoryHeapBase::NO_CACHING;
+        display.rgbFd = -1;
+    }
+    master.clear();
 
-        LOGV("video = %d x %d", displayWidth, displayHeight);
-        LOGV("frame = %d x %d", frameWidth, frameHeight);
-        LOGV("frame #bytes = %d", frameSize);
+    display.rgbHeap = ISurface::BufferHeap(width, height, width, height, halFormat, heap);
+    display.softwareComposition = true;
 
-        mFrameBufferIndex = 0;
+    LOGV("software composition %d x %d, format %d, %d thread(s)", width, height, halFormat, mConverter->threads());
+    return true;
+}
+
+// the frame is posted as an RGB copy, so one identical to the frame on
+// screen need not be converted or posted again
+template <class Layout>
+PVMFStatus AndroidSurfaceOutputMsm7x30::writeComposedFrame(uint8* aData, const PvmiMediaXferHeader& header)
+{
+    // converted and posted band by band while it was being decoded
+    if (Layout::kPlanar && bandFramePosted(aData))
+        return framePosted();
+    const OutputState& state = *mFrameState;
+    if (mDuplicateFilter.isDuplicate(aData, state.width, state.height,
+            Layout::kPlanar ? state.width / 2 : state.width, Layout::kPlanar ? state.height : state.height / 2))
+        return PVMFSuccess;
+    {
+        Mutex::Autolock lock(mFrameLock);
+        YuvImage src = sourceImage<Layout>(aData);
+        if (++mFrameBufferIndex == mBufferCount) mFrameBufferIndex = 0;
+        uint8* dst = static_cast<uint8*>(mBufferHeap.heap->base()) + mFrameBuffers[mFrameBufferIndex];
+        int rgbFormat = state.display.rgbFormat;
+        int dstStride = mBufferHeap.hor_stride * mConverter->bytesPerPixel(rgbFormat);
+        mConverter->convert(src, mBufferHeap.w, mBufferHeap.h, dst, dstStride, rgbFormat);
+        mFrameWriter.finishWrite(mFrameBuffers[mFrameBufferIndex], dstStride * mBufferHeap.h);
+        mSurface->postBuffer(mFrameBuffers[mFrameBufferIndex]);
+        mDuplicateFilter.posted();
+        captureFrame(mBufferHeap.heap->base(), mFrameBuffers[mFrameBufferIndex]);
     }
+    return framePosted();
+}
 
-    mInitialized = true;
-    LOGV("sendEvent(MEDIA_SET_VIDEO_SIZE, %d, %d)", iVideoDisplayWidth, iVideoDisplayHeight);
-    mPvPlayer->sendEvent(MEDIA_SET_VIDEO_SIZE, iVideoDisplayWidth, iVideoDisplayHeight);
-}
-
-PVMFStatus AndroidSurfaceOutputMsm7x30::writeFrameBuf(uint8* aData, uint32 aDataLen, const PvmiMediaXferHeader& data_header_info)
-{
-    // OK to drop frames if no surface
-    if (mSurface == 0) return PVMFSuccess;
-
-    if (mHardwareCodec) {
-        if (mUseOverlay) {
-            if (!mFd){
-                LOGV("writeFrameBuf:: using hardware codec \n");
-                uint32 fd;
-                if (!getPmemFd(data_header_info.private_data_ptr, &fd)) {
-                    LOGE("Error getting pmem heap from private_data_ptr");
-                    return PVMFFailure;
-                }
-                sp<MemoryHeapBase> master = (MemoryHeapBase *) fd;
-                master->setDevice(pmem);
-                mHeapPmem = new MemoryHeapPmem(master, 0);
-                mHeapPmem->slap();
-                master.clear();
-                mFd = mHeapPmem->heapID();
-                LOGV("Calling setFd \n");
-                mOverlay->setFd(mFd);
-            }
-            // get pmem offset and post to SurfaceFlinger
-            if (!getOffset(data_header_info.private_data_ptr, &mOffset)) {
-                LOGE("Error getting pmem offset from private_data_ptr");
-                return PVMFFailure;
-            }
-            LOGV(" mOverlay queueBuffer \n");
-            mOverlay->queueBuffer((void *)mOffset);
-        }
-        else {
-            // Use ISurface
-            // initialize frame buffer heap
-            if (mBufferHeap.heap == 0) {
-                LOGV("initializing for hardware");
-                LOGV("private data pointer is 0%p\n", data_header_info.private_data_ptr);
-
-                uint32 fd;
-                if (!getPmemFd(data_header_info.private_data_ptr, &fd)) {
-                    LOGE("Error getting pmem heap from private_data_ptr");
-                    return PVMFFailure;
-                }
-
-                // ugly hack to pass an sp<MemoryHeapBase> as an int
-                sp<MemoryHeapBase> master = (MemoryHeapBase *) fd;
-                master->setDevice(pmem);
-
-                // create new reference
-                uint32_t heap_flags = master->getFlags() & MemoryHeapBase::NO_CACHING;
-                sp<MemoryHeapPmem> heap = new MemoryHeapPmem(master, heap_flags);
-                heap->slap();
-
-                uint32_t transform = ISurface::BufferHeap::ROT_0;
-                // register frame buffers with SurfaceFlinger
-                if (iVideoSubFormat == PVMF_MIME_YUV420_PACKEDSEMIPLANAR_TILE) {
-                    mBufferHeap = ISurface::BufferHeap(iVideoDisplayWidth, iVideoDisplayHeight,
-                        iVideoWidth, iVideoHeight, HAL_PIXEL_FORMAT_YCbCr_420_SP_TILED, transform, 0, heap);
-                }
-                else {
-                    mBufferHeap = ISurface::BufferHeap(iVideoDisplayWidth, iVideoDisplayHeight,
-                        iVideoWidth, iVideoHeight, HAL_PIXEL_FORMAT_YCbCr_420_SP, transform, 0, heap);
-                }
-                master.clear();
-                status_t err = mSurface->registerBuffers(mBufferHeap);
-                if (err != OK) {
-                    LOGE("Register Buffer Failed");
-                    return err;
-                }
-            }
-
-            // get pmem offset and post to SurfaceFlinger
-            if (!getOffset(data_header_info.private_data_ptr, &mOffset)) {
-                LOGE("Error getting pmem offset from private_data_ptr");
-                return PVMFFailure;
-            }
-            mSurface->postBuffer(mOffset);
-        }
-    }else {
-        LOGV("writeFrameBuf :: software codec \n");
-        // software codec
-        if (++mFrameBufferIndex == kBufferCount) mFrameBufferIndex = 0;
-        convertFrame(aData, static_cast<uint8*>(mBufferHeap.heap->base()) + mFrameBuffers[mFrameBufferIndex], aDataLen);
-
-        // Post to Overlay if it exists else post to SurfaceFlinger
-        if (mUseOverlay){
-            LOGV(" mOverlay queueBuffer \n");
-            mOverlay->queueBuffer((void*)mFrameBuffers[mFrameBufferIndex]);
-        }else {
-            // Use ISurface
-            if (++mFrameBufferIndex == kBufferCount) mFrameBufferIndex = 0;
-            convertFrame(aData, static_cast<uint8*>(mBufferHeap.heap->base()) + mFrameBuffers[mFrameBufferIndex], aDataLen);
-            // post to SurfaceFlinger
-            mSurface->postBuffer(mFrameBuffers[mFrameBufferIndex]);
-        }
+template <class Layout>
+YuvImage AndroidSurfaceOutputMsm7x30::sourceImage(const uint8* aData)
+{
+    int width = mFrameState->width;
+    int height = mFrameState->height;
+    YuvImage src;
+    src.y = aData;
+    src.yStride = width;
+    src.u = aData + width * height;
+    if (Layout::kPlanar) {
+        src.format = YUV_FORMAT_I420;
+        src.v = src.u + (width / 2) * (height / 2);
+        src.uvStride = width / 2;
+    } else {
+        // same layout the overlay is programmed with (YCrCb) for both sub-formats
+        src.format = YUV_FORMAT_NV21;
+        src.v = NULL;
+        src.uvStride = width;
     }
+    return src;
+}
 
-    //Average FPS profiling
-    if(mStatistics) AverageFPSProfiling();
+PVMFStatus AndroidSurfaceOutputMsm7x30::writeOverlayFrame(uint8* aData, const PvmiMediaXferHeader& header)
+{
+    PlatformPrivateInfo info;
+    bool isNew;
+    sp<MemoryHeapPmem> heap = decoderHeap<OverlaySink>(header, &info, &isNew);
+    if (heap == 0) return PVMFFailure;
+    mOffset = info.offset;
+    const sp<Overlay>& overlay = mFrameState->display.overlay;
+
+    // point the overlay at the heap the frame is in; it stays up
+    // when the decoder moves to another heap
+    if (info.heapKey != mHeapKey) {
+        LOGV("overlay moves to %s decoder heap 0x%x", isNew ? "new" : "known", info.heapKey);
+        mHeapPmem = heap;
+        mFd = mHeapPmem->heapID();
+        LOGV("Calling setFd \n");
+        overlay->setFd(mFd);
+        mHeapKey = info.heapKey;
+    }
+    LOGV(" mOverlay queueBuffer \n");
+    overlay->queueBuffer((void *)mOffset);
+    captureFrame(mHeapPmem->base(), mOffset);
+    return framePosted();
+}
 
-    return PVMFSuccess;
+template <class Format>
+PVMFStatus AndroidSurfaceOutputMsm7x30::writeRegisteredFrame(uint8* aData, const PvmiMediaXferHeader& header)
+{
+    PlatformPrivateInfo info;
+    bool isNew;
+    sp<MemoryHeapPmem> heap = decoderHeap<SurfaceSink>(header, &info, &isNew);
+    if (heap == 0) return PVMFFailure;
+    mOffset = info.offset;
+
+    // register the heap the frame is in with SurfaceFlinger
+    if ((mBufferHeap.heap == 0) || (info.heapKey != mHeapKey)) {
+        LOGV("registering %s decoder heap 0x%x", isNew ? "new" : "known", info.heapKey);
+        if (mBufferHeap.heap != 0) mSurface->unregisterBuffers();
+
+        uint32_t transform = ISurface::BufferHeap::ROT_0;
+        // register frame buffers with SurfaceFlinger
+        const OutputState& state = *mFrameState;
+        mBufferHeap = ISurface::BufferHeap(state.displayWidth, state.displayHeight,
+            state.width, state.height, Format::kHalFormat, transform, 0, heap);
+        status_t err = mSurface->registerBuffers(mBufferHeap);
+        if (err != OK) {
+            LOGE("Register Buffer Failed");
+            mBufferHeap.heap.clear();
+            return err;
+        }
+        mHeapKey = info.heapKey;
+    }
+
+    // post to SurfaceFlinger
+    mSurface->postBuffer(mOffset);
+    captureFrame(mBufferHeap.heap->base(), mOffset);
+    return framePosted();
 }
 
 // post the last video frame to refresh screen after pause
 void AndroidSurfaceOutputMsm7x30::postLastFrame()
 {
     LOGV("postLastFrame\n");
-    // ignore if no surface or heap
-    if ((mSurface == NULL) || (mBufferHeap.heap == NULL)) return;
+    // nothing to refresh while a new configuration is being attached
+    StateReader reader(mState);
+    if (reader.get() == NULL) return;
+
+    Mutex::Autolock lock(mFrameLock);
+    // frames are not coming through writeFrameBuf while tunneled
+    if ((mTunnelSink != NULL) && mTunnelSink->isActive()) {
+        mTunnelSink->postLastFrame();
+        return;
+    }
 
-    if(mHardwareCodec) {
-        if (mUseOverlay)
-            mOverlay->queueBuffer((void *)mOffset);
+    // ignore if no surface or heap; until the next frame the one on screen
+    // is from the configuration the frame path is on
+    if ((mSurface == NULL) || (mBufferHeap.heap == NULL) || (mFrameState == 0)) return;
+    const OutputState& state = *mFrameState;
+    const sp<Overlay>& overlay = state.display.overlay;
+
+    if (state.display.softwareComposition) {
+        mSurface->postBuffer(mFrameBuffers[mFrameBufferIndex]);
+    } else if (state.hardwareCodec && (state.deinterlacer == NULL)) {
+        if (overlay != 0)
+            overlay->queueBuffer((void *)mOffset);
         else
             mSurface->postBuffer(mOffset);
     }else {
-        if (mUseOverlay)
-            mOverlay->queueBuffer((void*)mFrameBuffers[mFrameBufferIndex]);
+        if (overlay != 0)
+            overlay->queueBuffer((void*)mFrameBuffers[mFrameBufferIndex]);
         else
             mSurface->postBuffer(mFrameBuffers[mFrameBufferIndex]);
     }
 }
 
-void AndroidSurfaceOutputMsm7x30::closeFrameBuf()
+
+void AndroidSurfaceOutputMsm7x30::convertRows(const uint8_t* src, size_t offset, int firstRow, int rows)
 {
-    if (!mInitialized) return;
-    LOGV("closeFrameBuf\n");
-    mInitialized = false;
-    if (mUseOverlay) {
-         mOverlay->destroy();
+    const OutputState& state = *mFrameState;
+    if (!state.display.softwareComposition) {
+        mFrameWriter.writeI420AsNv21Rows(src, offset, state.width, state.height, firstRow, rows);
+        return;
     }
-    // free heaps
-    LOGV("free mHeapPmem");
-    mHeapPmem.clear();
-}
 
+    // only the visible rows have room in the RGB slot
+    int height = mBufferHeap.h;
+    if (firstRow >= height) return;
+    if (firstRow + rows > height) rows = height - firstRow;
+    int rgbFormat = state.display.rgbFormat;
+    int dstStride = mBufferHeap.hor_stride * mConverter->bytesPerPixel(rgbFormat);
+    uint8* dst = static_cast<uint8*>(mBufferHeap.heap->base()) + offset;
+    yuvToRgbRows(sourceImage<I420Layout>(src), mBufferHeap.w, firstRow, rows, dst, dstStride, rgbFormat);
+    mFrameWriter.finishWrite(offset + firstRow * dstStride, rows * dstStride);
+}
 
-bool AndroidSurfaceOutputMsm7x30::getPmemFd(OsclAny *private_data_ptr, uint32 *pmemFD)
+void AndroidSurfaceOutputMsm7x30::postRows(size_t offset)
 {
-    PLATFORM_PRIVATE_LIST *listPtr = NULL;
-    PLATFORM_PRIVATE_PMEM_INFO *pmemInfoPtr = NULL;
-    bool returnType = false;
-    LOGV("in getPmemfd - privatedataptr=%p\n",private_data_ptr);
-    listPtr = (PLATFORM_PRIVATE_LIST*) private_data_ptr;
-
-    for (uint32 i=0;i<listPtr->nEntries;i++)
-    {
-        if(listPtr->entryList->type == PLATFORM_PRIVATE_PMEM)
-        {
-            LOGV("in getPmemfd - entry type = %d\n",listPtr->entryList->type);
-          pmemInfoPtr = (PLATFORM_PRIVATE_PMEM_INFO*) (listPtr->entryList->entry);
-          returnType = true;
-          if(pmemInfoPtr){
-            *pmemFD = pmemInfoPtr->pmem_fd;
-            LOGV("in getPmemfd - pmemFD = %d\n",*pmemFD);
-          }
-          break;
-        }
+    const sp<Overlay>& overlay = mFrameState->display.overlay;
+    if (overlay != 0) {
+        overlay->queueBuffer((void*)offset);
+    } else {
+        mSurface->postBuffer(offset);
     }
-    return returnType;
+    // posted before writeFrameBuf sees the frame, so it carries the
+    // timestamp of the one before
+    captureFrame(mBufferHeap.heap->base(), offset);
 }
 
-bool AndroidSurfaceOutputMsm7x30::getOffset(OsclAny *private_data_ptr, uint32 *offset)
+void AndroidSurfaceOutputMsm7x30::applyQualityLevel(int level)
 {
-    PLATFORM_PRIVATE_LIST *listPtr = NULL;
-    PLATFORM_PRIVATE_PMEM_INFO *pmemInfoPtr = NULL;
-    bool returnType = false;
-
-    listPtr = (PLATFORM_PRIVATE_LIST*) private_data_ptr;
-    LOGV("in getOffset: listPtr = %p\n",listPtr);
-    for (uint32 i=0;i<listPtr->nEntries;i++)
-    {
-        if(listPtr->entryList->type == PLATFORM_PRIVATE_PMEM)
-        {
-            LOGV(" in getOffset: entrytype = %d\n",listPtr->entryList->type);
-
-          pmemInfoPtr = (PLATFORM_PRIVATE_PMEM_INFO*) (listPtr->entryList->entry);
-          returnType = true;
-          if(pmemInfoPtr){
-            *offset = pmemInfoPtr->offset;
-            LOGV("in getOffset: offset = %d\n",*offset);
-          }
-          break;
-        }
+    const OutputState& state = *mFrameState;
+    bool half = (level >= QualityLadder::LEVEL_HALF_SIZE);
+    if ((state.display.overlay != 0) && (half != (mOutputLevel >= QualityLadder::LEVEL_HALF_SIZE))) {
+        // the half size frame sits in the top-left quarter, the overlay
+        // scales the crop up to the same destination
+        int scale = half ? 2 : 1;
+        state.display.overlay->setCrop(0, 0, state.displayWidth / scale, state.displayHeight / scale);
     }
-    return returnType;
+    // slots hold nothing reusable across a level change
+    for (int i = 0; i < kBufferCount; i++) mSlotUses[i] = 0;
+    mOutputLevel = level;
 }
 
-static inline void* byteOffset(void* p, size_t offset) { return (void*)((uint8_t*)p + offset); }
-
-void AndroidSurfaceOutputMsm7x30::convertFrame(void* src, void* dst, size_t len)
+void AndroidSurfaceOutputMsm7x30::initCapture(OutputState& state)
 {
-    // copy the Y plane
-    size_t y_plane_size = iVideoWidth * iVideoHeight;
-    //LOGV("len=%u, y_plane_size=%u", len, y_plane_size);
-    memcpy(dst, src, y_plane_size + iVideoWidth);
+    if (state.display.softwareComposition) {
+        int rgbFormat = state.display.rgbFormat;
+        state.captureFormat = (rgbFormat == RGB_FORMAT_565) ? CAPTURE_FORMAT_RGB565 : CAPTURE_FORMAT_RGBX8888;
+        state.captureWidth = state.display.rgbHeap.w;
+        state.captureHeight = state.display.rgbHeap.h;
+    } else if (state.subFormat == PVMF_MIME_YUV420_PACKEDSEMIPLANAR_TILE) {
+        state.captureFormat = CAPTURE_FORMAT_NV12_TILED;
+    }
+}
 
-    // re-arrange U's and V's
-    uint16_t* pu = (uint16_t*)byteOffset(src, y_plane_size);
-    uint16_t* pv = (uint16_t*)byteOffset(pu, y_plane_size / 4);
-    uint32_t* p = (uint32_t*)byteOffset(dst, y_plane_size);
+bool AndroidSurfaceOutputMsm7x30::grabFrame(uint8* dst, int width, int height, int dstStride, int rgbFormat)
+{
+    if ((dst == NULL) || (width <= 0) || (height <= 0)) return false;
+    StateReader reader(mState);
+    if (reader.get() == NULL) return false;
+
+    // keeps the software path from advancing onto the slot being read; the
+    // frame on screen is from the configuration the frame path is on
+    Mutex::Autolock lock(mFrameLock);
+    if (mFrameState == 0) return false;
+    const OutputState& state = *mFrameState;
+    // software composition posts RGB, there is no YUV frame to sample
+    if (state.display.softwareComposition) return false;
+
+    // overlay frames live in mHeapPmem, ISurface ones in mBufferHeap
+    sp<IMemoryHeap> heap = mHeapPmem;
+    if (heap == 0) heap = mBufferHeap.heap;
+    if (heap == 0) return false;
+
+    const uint8* frame = static_cast<const uint8*>(heap->base());
+    frame += (state.hardwareCodec && (state.deinterlacer == NULL)) ? mOffset : mFrameBuffers[mFrameBufferIndex];
+
+    YuvImage src;
+    src.y = frame;
+    src.v = NULL;
+    src.yStride = state.width;
+    src.uvStride = state.width;
+    if (state.subFormat == PVMF_MIME_YUV420_PACKEDSEMIPLANAR_TILE) {
+        // chroma tiles start on the 8K boundary after the luma tiles
+        int lumaSize = ((state.width + 127) & ~127) * ((state.height + 31) & ~31);
+        src.u = frame + ((lumaSize + 8191) & ~8191);
+        src.format = YUV_FORMAT_NV12_TILED;
+        src.tiledHeight = state.height;
+    } else {
+        // same layout writeComposedFrame assumes for both codec paths
+        src.u = frame + state.width * state.height;
+        src.format = YUV_FORMAT_NV21;
+    }
+    // software frames maybe at half size, see applyQualityLevel
+    int scale = (!state.hardwareCodec && (mOutputLevel >= QualityLadder::LEVEL_HALF_SIZE)) ? 2 : 1;
+    return yuvToRgbScaled(src, state.displayWidth / scale, state.displayHeight / scale,
+                          dst, width, height, dstStride, rgbFormat);
+}
 
-    int count = y_plane_size / 8;
-    //LOGV("u = %p, v = %p, p = %p, count = %d", pu, pv, p, count);
-    do {
-        uint32_t u = *pu++;
-        uint32_t v = *pv++;
-        *p++ = ((u & 0xff) << 8) | ((u & 0xff00) << 16) | (v & 0xff) | ((v & 0xff00) << 8);
-    } while (--count);
+// display sink for tunneling a hardware decoder straight to the overlay
+OMX_HANDLETYPE AndroidSurfaceOutputMsm7x30::getTunnelSink()
+{
+    // for the configuration published last; a tunneled decoder would
+    // bypass the deinterlacer
+    StateReader reader(mState);
+    const OutputState* state = reader.get();
+    if (!mTunnelEnabled || (state == NULL) || !state->hardwareCodec ||
+        state->display.softwareComposition || (state->deinterlacer != NULL)) return NULL;
+
+    Mutex::Autolock lock(mFrameLock);
+    if (mTunnelSink == NULL) {
+        int format = (state->subFormat == PVMF_MIME_YUV420_PACKEDSEMIPLANAR_TILE) ?
+                     HAL_PIXEL_FORMAT_YCbCr_420_SP_TILED : HAL_PIXEL_FORMAT_YCrCb_420_SP;
+        LOGV("creating tunnel sink, overlay = %d", state->display.overlay != 0);
+        mTunnelSink = new OmxDisplaySink(mSurface, state->display.overlay,
+                state->displayWidth, state->displayHeight, state->width, state->height,
+                format, mNumberOfFramesToHold);
+    }
+    return mTunnelSink->handle();
 }
 
 // factory function for playerdriver linkage
@@ -468,25 +748,39 @@ extern "C" AndroidSurfaceOutputMsm7x30* createVideoMio()
     return new AndroidSurfaceOutputMsm7x30();
 }
 
-void AndroidSurfaceOutputMsm7x30::AverageFPSProfiling()
+// tunnel hook for a decoder node, returns NULL when tunneling is off; only
+// tools/tunnel_bench.cpp calls it so far, no decoder node in this tree does,
+// so on a device persist.pv.tunnel alone changes nothing
+extern "C" OMX_HANDLETYPE getVideoMioTunnelSink(AndroidSurfaceOutputMsm7x30* mio)
 {
-    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
-    nsecs_t diff = now - mLastFpsTime;
-    iFrameNumber++;
+    return mio->getTunnelSink();
+}
 
-    if (diff > ms2ns(250)) {
-        float mFps =  ((iFrameNumber - mLastFrame) * float(s2ns(1))) / diff;
-        LOGE("AndroidSurfaceOutputMsm7x30: Frames Per Second: %.4f", mFps);
-        mFpsSum += mFps;
-        mNumFpsSamples++;
-        mLastFpsTime = now;
-        mLastFrame = iFrameNumber;
-    }
+// per stream control of duplicate frame skipping, and the number skipped so far
+extern "C" void setVideoMioDuplicateSkip(AndroidSurfaceOutputMsm7x30* mio, bool enable)
+{
+    mio->setDuplicateFrameSkip(enable);
+}
+
+extern "C" unsigned long getVideoMioSkippedFrames(AndroidSurfaceOutputMsm7x30* mio)
+{
+    return mio->getSkippedFrames();
+}
+
+// row-band hooks for low latency software decoders, see row_band_pipeline.h
+extern "C" bool beginVideoMioBandFrame(AndroidSurfaceOutputMsm7x30* mio, const uint8* frame)
+{
+    return mio->beginBandFrame(frame);
+}
+
+extern "C" void videoMioBandRowsDecoded(AndroidSurfaceOutputMsm7x30* mio, int rows)
+{
+    mio->bandRowsDecoded(rows);
 }
 
-void AndroidSurfaceOutputMsm7x30::AverageFPSPrint()
+// still of the displayed frame, see grabFrame
+extern "C" bool grabVideoMioFrame(AndroidSurfaceOutputMsm7x30* mio, uint8* dst,
+                                  int width, int height, int dstStride, int rgbFormat)
 {
-    LOGE("==========================================================");
-    LOGE("AndroidSurfaceOutputMsm7x30: Average Frames Per Second: %.4f", mFpsSum / mNumFpsSamples);
-    LOGE("==========================================================");
+    return mio->grabFrame(dst, width, height, dstStride, rgbFormat);
 }
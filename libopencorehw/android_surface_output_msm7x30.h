@@ -20,79 +20,108 @@
 #ifndef ANDROID_SURFACE_OUTPUT_MSM7X30H_INCLUDED
 #define ANDROID_SURFACE_OUTPUT_MSM7X30H_INCLUDED
 
-#include "android_surface_output.h"
+#include "msm_surface_output.h"
 
-// support for shared contiguous physical memory
-#include <binder/MemoryHeapPmem.h>
 #include <ui/Overlay.h>
 
-// data structures for tunneling buffers
-typedef struct PLATFORM_PRIVATE_PMEM_INFO
-{
-    /* pmem file descriptor */
-    uint32 pmem_fd;
-    uint32 offset;
-} PLATFORM_PRIVATE_PMEM_INFO;
-
-typedef struct PLATFORM_PRIVATE_ENTRY
-{
-    /* Entry type */
-    uint32 type;
 
-    /* Pointer to platform specific entry */
-    OsclAny* entry;
-} PLATFORM_PRIVATE_ENTRY;
-
-typedef struct PLATFORM_PRIVATE_LIST
-{
-    /* Number of entries */
-    uint32 nEntries;
-
-    /* Pointer to array of platform specific entries *
-     * Contiguous block of PLATFORM_PRIVATE_ENTRY elements */
-    PLATFORM_PRIVATE_ENTRY* entryList;
-} PLATFORM_PRIVATE_LIST;
-
-
-class AndroidSurfaceOutputMsm7x30 : public AndroidSurfaceOutput
+class AndroidSurfaceOutputMsm7x30 : public MsmSurfaceOutput<AndroidSurfaceOutputMsm7x30>
 {
 public:
     AndroidSurfaceOutputMsm7x30();
 
     // frame buffer interface
-    virtual bool initCheck();
-    virtual PVMFStatus writeFrameBuf(uint8* aData, uint32 aDataLen, const PvmiMediaXferHeader& data_header_info);
     virtual void postLastFrame();
-    virtual void closeFrameBuf();
+
+    // tunneled decoder-to-display support
+    OMX_HANDLETYPE getTunnelSink();
+
+    // RGB still of the frame on screen scaled to width x height, read in
+    // place from the displayed buffer; rgbFormat is RGB_FORMAT_565/X8888
+    bool grabFrame(uint8* dst, int width, int height, int dstStride, int rgbFormat);
 
     OSCL_IMPORT_REF ~AndroidSurfaceOutputMsm7x30();
 
 private:
-    bool getPmemFd(OsclAny *private_data_ptr, uint32 *pmemFD);
-    bool getOffset(OsclAny *private_data_ptr, uint32 *offset);
-    void convertFrame(void* src, void* dst, size_t len);
-
-    // hardware frame buffer support
-    bool                        mHardwareCodec;
-    uint32                      mOffset;
+    friend class MsmSurfaceOutput<AndroidSurfaceOutputMsm7x30>;
+    static const char* const kName;
+
+    // software and deinterlaced slots are only ever read by the overlay;
+    // without one the frames are composed by SurfaceFlinger
+    typedef OverlaySink SlotSink;
+
+    // what a configuration shows its frames with
+    struct Display {
+        Display();
+        // the overlay, created by attachState in overlayFormat; one kept
+        // across a crop change is shared with the configuration before
+        sp<Overlay>             overlay;
+        int                     overlayFormat;
+        // layout of the slots handed to the overlay
+        int                     slotFormat;
+        // RGB buffers registered with SurfaceFlinger when there is no
+        // overlay; rgbFlags and rgbFd are the pmem master's, -1 for ashmem
+        bool                    softwareComposition;
+        int                     rgbFormat;
+        ISurface::BufferHeap    rgbHeap;
+        int                     rgbCount;
+        uint32_t                rgbFlags;
+        int                     rgbFd;
+    };
+    bool buildState(OutputState& state, const OutputState* current);
+    bool attachState(OutputState& state);
+    bool replacesDisplay(const OutputState& current, const OutputState& state);
+    bool keepsFrameState(const OutputState& current, const OutputState& state);
+    void detachState(const OutputState* published, const OutputState* adopted, bool replacing);
+    void adoptDisplay(const OutputState& state);
+    FrameHandler selectFrameHandler(const OutputState& state);
+
+    // hardware frames the overlay is pointed at in place
+    PVMFStatus writeOverlayFrame(uint8* aData, const PvmiMediaXferHeader& header);
+    // hardware frames registered with SurfaceFlinger in place, Format gives
+    // the HAL format the decoder heap is registered as
+    template <class Format>
+    PVMFStatus writeRegisteredFrame(uint8* aData, const PvmiMediaXferHeader& header);
+    // decoder output of either Layout converted to RGB
+    template <class Layout>
+    PVMFStatus writeComposedFrame(uint8* aData, const PvmiMediaXferHeader& header);
+
+    // hardware frame buffer support; mHeapPmem is the heap the overlay
+    // is pointed at
     sp<MemoryHeapPmem>          mHeapPmem;
-    // overlay support
-    bool                        mUseOverlay;
-    sp<Overlay>                 mOverlay;
     uint32                      mFd;
 
-    void initOverlay();
-    void initSurface();
-
-        //Average FPS profiling
-    virtual void AverageFPSProfiling();
-    virtual void AverageFPSPrint();
-    bool                        mStatistics;
-    int                         mLastFrame;
-    float                       mFpsSum;
-    unsigned long               iFrameNumber;
-    unsigned long               mNumFpsSamples;
-    nsecs_t                     mLastFpsTime;
+    // the frame on screen is left registered with SurfaceFlinger while
+    // the overlay is replaced; mBridged until the next display has it
+    void bridgeFrame(const OutputState& adopted);
+    bool                        mBridged;
+
+    // the overlay of a hardware decoder is kept across a reconfiguration
+    // that leaves its coded size and format alone
+    bool canKeepOverlay(const OutputState& current, const OutputState& state);
+    bool buildOverlay(OutputState& state);
+    void buildSurface(OutputState& state);
+    bool buildSoftwareOverlay(OutputState& state, int frameSize, int halFormat);
+
+    // interlaced decoder output is made progressive into the software
+    // slots for the overlay, unless persist.pv.deinterlace is off
+    bool buildDeinterlacedOverlay(OutputState& state, int mode);
+
+    // RGB conversion for SurfaceFlinger when no overlay can be created
+    bool buildSoftwareComposition(OutputState& state);
+    template <class Layout>
+    YuvImage sourceImage(const uint8* aData);
+    YuvRgbConverter*            mConverter;
+
+    // started by the first beginBandFrame
+    virtual void convertRows(const uint8_t* src, size_t offset, int firstRow, int rows);
+    virtual void postRows(size_t offset);
+
+    void applyQualityLevel(int level);
+    // the slot heap is handed to the overlay
+    void registerSlots();
+
+    void initCapture(OutputState& state);
 };
 
 #endif // ANDROID_SURFACE_OUTPUT_MSM7X30_H_INCLUDED
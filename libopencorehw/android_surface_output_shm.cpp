@@ -0,0 +1,449 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "VideoMioShm"
+#include <utils/Log.h>
+
+#include "android_surface_output_shm.h"
+#include <media/PVPlayer.h>
+
+#include <cutils/ashmem.h>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace android;
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC         0x0001U
+#define MFD_ALLOW_SEALING   0x0002U
+#endif
+
+// how long a frame may wait for the consumer before it is dropped
+static const int kSlotWaitMs = 100;
+
+static const uint32 kDefaultSlots = 4;
+
+// outputs of one process that can serve a ring at the same time
+static const int kMaxServers = 8;
+
+static inline uint32 pageAlign(uint32 n)
+{
+    uint32 page = getpagesize();
+    return (n + page - 1) & ~(page - 1);
+}
+
+OSCL_EXPORT_REF AndroidSurfaceOutputShm::AndroidSurfaceOutputShm() :
+    AndroidSurfaceOutput()
+{
+    mRing = NULL;
+    mRingFd = -1;
+    mRingSize = 0;
+    mSlotSize = 0;
+    mSlotOffset = 0;
+    mWriteSeq = 0;
+    mDropped = 0;
+    mServerRunning = false;
+    mListenFd = -1;
+    pthread_mutex_init(&mServerLock, NULL);
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get("persist.pv.shm.slots", value, "4");
+    mSlotCount = atoi(value);
+    if (mSlotCount < 2 || mSlotCount > SHM_VIDEO_RING_MAX_SLOTS) mSlotCount = kDefaultSlots;
+
+    // wait for a slow consumer (transcoding) rather than drop (monitoring)
+    property_get("persist.pv.shm.blocking", value, "1");
+    mBlocking = atoi(value) ? true : false;
+
+    property_get("persist.pv.shm.socket", mSocketName, SHM_VIDEO_RING_SOCKET);
+
+    //Statistics profiling
+    mStatistics = false;
+    mLastFrame = 0;
+    mLastFpsTime = 0;
+    mFpsSum = 0;
+    iFrameNumber = 0;
+    mNumFpsSamples = 0;
+    property_get("persist.debug.pv.statistics", value, "0");
+    if(atoi(value)) mStatistics = true;
+}
+
+OSCL_EXPORT_REF AndroidSurfaceOutputShm::~AndroidSurfaceOutputShm()
+{
+    if(mStatistics) AverageFPSPrint();
+    stopServer();
+    destroyRing();
+    pthread_mutex_destroy(&mServerLock);
+}
+
+OSCL_EXPORT_REF bool AndroidSurfaceOutputShm::initCheck()
+{
+    // initialize only when we have all the required parameters
+    if (((iVideoParameterFlags & VIDEO_SUBFORMAT_VALID) == 0) || !checkVideoParameterFlags())
+        return mInitialized;
+
+    // release resources if previously initialized
+    closeFrameBuf();
+
+    // reset flags in case display format changes in the middle of a stream
+    resetVideoParameterFlags();
+
+    uint32 format;
+    if ((iVideoSubFormat == PVMF_MIME_YUV420_SEMIPLANAR_YVU) ||
+        (iVideoSubFormat == PVMF_MIME_YUV420_SEMIPLANAR_YVU_INTERLACE)) {
+        format = SHM_VIDEO_FORMAT_NV21;
+    } else if (iVideoSubFormat == PVMF_MIME_YUV420_SEMIPLANAR) {
+        format = SHM_VIDEO_FORMAT_NV12;
+    } else {
+        format = SHM_VIDEO_FORMAT_I420;
+    }
+
+    // YUV420 frames are 1.5 bytes/pixel
+    uint32 frameSize = (iVideoWidth * iVideoHeight * 3) / 2;
+    if (!createRing(format, frameSize)) {
+        return false;
+    }
+    if (!startServer()) {
+        LOGE("consumers cannot connect, frames will only be counted");
+    }
+
+    LOGV("video = %d x %d", iVideoDisplayWidth, iVideoDisplayHeight);
+    LOGV("frame = %d x %d, %u slots", iVideoWidth, iVideoHeight, mSlotCount);
+
+    mInitialized = true;
+    if (mPvPlayer) {
+        LOGV("sendEvent(MEDIA_SET_VIDEO_SIZE, %d, %d)", iVideoDisplayWidth, iVideoDisplayHeight);
+        mPvPlayer->sendEvent(MEDIA_SET_VIDEO_SIZE, iVideoDisplayWidth, iVideoDisplayHeight);
+    }
+    return mInitialized;
+}
+
+bool AndroidSurfaceOutputShm::createRing(uint32 format, uint32 frameSize)
+{
+    uint32 slotOffset = pageAlign(sizeof(ShmVideoRingHeader));
+    uint32 slotSize = pageAlign(frameSize);
+    uint32 size = slotOffset + slotSize * mSlotCount;
+
+    int fd = -1;
+#ifdef __NR_memfd_create
+    fd = syscall(__NR_memfd_create, "pv_video_ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if ((fd >= 0) && (ftruncate(fd, size) < 0)) {
+        LOGE("cannot size frame ring: %s", strerror(errno));
+        close(fd);
+        return false;
+    }
+#ifdef F_ADD_SEALS
+    // consumers can then trust the size they map
+    if (fd >= 0) fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+#endif
+#endif
+    // older kernels: ashmem gives the same sharing semantics
+    if (fd < 0) fd = ashmem_create_region("pv_video_ring", size);
+    if (fd < 0) {
+        LOGE("cannot create frame ring: %s", strerror(errno));
+        return false;
+    }
+
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        LOGE("cannot map frame ring: %s", strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    ShmVideoRingHeader* ring = (ShmVideoRingHeader*) base;
+    memset(ring, 0, sizeof(*ring));
+    ring->magic = SHM_VIDEO_RING_MAGIC;
+    ring->version = SHM_VIDEO_RING_VERSION;
+    ring->totalSize = size;
+    ring->format = format;
+    ring->width = iVideoWidth;
+    ring->height = iVideoHeight;
+    ring->displayWidth = iVideoDisplayWidth;
+    ring->displayHeight = iVideoDisplayHeight;
+    ring->slotCount = mSlotCount;
+    ring->slotSize = slotSize;
+    ring->slotOffset = slotOffset;
+    __sync_synchronize();
+    ring->state = SHM_VIDEO_RING_ACTIVE;
+
+    // the writer works from these, never from the shared header
+    mSlotSize = slotSize;
+    mSlotOffset = slotOffset;
+    mWriteSeq = 0;
+    mDropped = 0;
+
+    pthread_mutex_lock(&mServerLock);
+    mRing = ring;
+    mRingFd = fd;
+    mRingSize = size;
+    pthread_mutex_unlock(&mServerLock);
+    return true;
+}
+
+void AndroidSurfaceOutputShm::destroyRing()
+{
+    pthread_mutex_lock(&mServerLock);
+    ShmVideoRingHeader* ring = mRing;
+    int fd = mRingFd;
+    mRing = NULL;
+    mRingFd = -1;
+    pthread_mutex_unlock(&mServerLock);
+
+    if (ring == NULL) return;
+
+    // attached consumers see the close, drop their mapping and reconnect
+    ring->state = SHM_VIDEO_RING_CLOSED;
+    __sync_synchronize();
+    shmVideoFutexWake(&ring->writeSeq);
+    shmVideoFutexWake(&ring->consumer.readSeq);
+
+    munmap(ring, mRingSize);
+    close(fd);
+}
+
+// true when slot seq % mSlotCount may be overwritten
+bool AndroidSurfaceOutputShm::waitForSlot(uint32 seq)
+{
+    ShmVideoRingConsumer& consumer = mRing->consumer;
+    for (;;) {
+        pid_t pid = consumer.consumerPid;
+        if ((pid > 0) && (kill(pid, 0) < 0) && (errno == ESRCH)) {
+            LOGV("consumer %d went away", pid);
+            __sync_bool_compare_and_swap(&consumer.consumerPid, pid, 0);
+            pid = 0;
+        }
+
+        uint32 read = consumer.readSeq;
+        if (seq - read < mSlotCount) return true;
+
+        if (pid <= 0) {
+            // nobody is reading, keep the newest frames
+            consumer.readSeq = seq - mSlotCount + 1;
+            return true;
+        }
+        if (!mBlocking) return false;
+
+        if ((shmVideoFutexWait(&consumer.readSeq, read, kSlotWaitMs) < 0) && (errno == ETIMEDOUT))
+            return false;
+    }
+}
+
+PVMFStatus AndroidSurfaceOutputShm::writeFrameBuf(uint8* aData, uint32 aDataLen, const PvmiMediaXferHeader& data_header_info)
+{
+    // OK to drop frames if there is no ring
+    if (mRing == NULL) return PVMFSuccess;
+
+    if(mStatistics) mPostStats.begin();
+
+    uint32 seq = mWriteSeq;
+    if (!waitForSlot(seq)) {
+        mRing->dropped = ++mDropped;
+        LOGV("consumer behind, dropped frame %u", seq);
+        return PVMFSuccess;
+    }
+
+    uint32 len = (aDataLen < mSlotSize) ? aDataLen : mSlotSize;
+    memcpy((uint8*) mRing + mSlotOffset + (seq % mSlotCount) * mSlotSize, aData, len);
+
+    ShmVideoSlot& slot = mRing->slots[seq % mSlotCount];
+    slot.seq = seq;
+    slot.size = len;
+    slot.timestampUs = (int64_t) data_header_info.timestamp * 1000;
+
+    // publish: slot contents must be visible before the new writeSeq
+    __sync_synchronize();
+    mWriteSeq = seq + 1;
+    mRing->writeSeq = mWriteSeq;
+    shmVideoFutexWake(&mRing->writeSeq);
+
+    //Average FPS profiling
+    if(mStatistics) {
+        mPostStats.end();
+        AverageFPSProfiling();
+    }
+
+    return PVMFSuccess;
+}
+
+// nothing is on screen to refresh; the last frame stays in its slot
+void AndroidSurfaceOutputShm::postLastFrame()
+{
+}
+
+void AndroidSurfaceOutputShm::closeFrameBuf()
+{
+    if (mStatistics && (mRing != NULL) && mDropped)
+        LOGE("AndroidSurfaceOutputShm: %u frames dropped waiting for the consumer", mDropped);
+    destroyRing();
+    AndroidSurfaceOutput::closeFrameBuf();
+}
+
+bool AndroidSurfaceOutputShm::startServer()
+{
+    if (mServerRunning) return true;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        LOGE("socket: %s", strerror(errno));
+        return false;
+    }
+
+    // abstract namespace: leading NUL, no filesystem entry to clean up.
+    // Another output of this process may hold the name already, then
+    // this one takes the first free <name>-1, <name>-2, ...
+    char name[sizeof(mSocketName) + 8];
+    int err = 0;
+    for (int i = 0; i < kMaxServers; i++) {
+        if (i == 0) strcpy(name, mSocketName);
+        else snprintf(name, sizeof(name), "%s-%d", mSocketName, i);
+
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path + 1, name, sizeof(addr.sun_path) - 2);
+        socklen_t len = offsetof(struct sockaddr_un, sun_path) + 1 + strlen(addr.sun_path + 1);
+
+        err = (bind(fd, (struct sockaddr*) &addr, len) < 0) ? errno : 0;
+        if (err != EADDRINUSE) break;
+    }
+    if ((err != 0) || (listen(fd, 4) < 0)) {
+        LOGE("cannot listen on @%s: %s", name, strerror(err ? err : errno));
+        close(fd);
+        return false;
+    }
+    LOGV("serving frame ring on @%s", name);
+
+    mListenFd = fd;
+    mServerRunning = true;
+    if (pthread_create(&mServerThread, NULL, serverThread, this) != 0) {
+        LOGE("cannot start ring server thread");
+        mServerRunning = false;
+        close(fd);
+        mListenFd = -1;
+        return false;
+    }
+    return true;
+}
+
+void AndroidSurfaceOutputShm::stopServer()
+{
+    if (!mServerRunning) return;
+    mServerRunning = false;
+    // wakes the blocking accept()
+    shutdown(mListenFd, SHUT_RDWR);
+    pthread_join(mServerThread, NULL);
+    close(mListenFd);
+    mListenFd = -1;
+}
+
+void* AndroidSurfaceOutputShm::serverThread(void* arg)
+{
+    AndroidSurfaceOutputShm* self = (AndroidSurfaceOutputShm*) arg;
+    while (self->mServerRunning) {
+        int client = accept(self->mListenFd, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        self->serveClient(client);
+        close(client);
+    }
+    return NULL;
+}
+
+void AndroidSurfaceOutputShm::serveClient(int client)
+{
+    // decoded content is only handed to the media user or privileged callers
+    struct ucred cred;
+    socklen_t credLen = sizeof(cred);
+    if ((getsockopt(client, SOL_SOCKET, SO_PEERCRED, &cred, &credLen) < 0) ||
+        ((cred.uid != 0) && (cred.uid != getuid()))) {
+        LOGE("refusing frame ring to uid %d", (int) cred.uid);
+        return;
+    }
+
+    pthread_mutex_lock(&mServerLock);
+    int fd = mRingFd;
+    if (fd >= 0) fd = dup(fd);
+    pthread_mutex_unlock(&mServerLock);
+    if (fd < 0) return;     // no stream yet, consumer retries
+
+    uint32_t version = SHM_VIDEO_RING_VERSION;
+    struct iovec iov;
+    iov.iov_base = &version;
+    iov.iov_len = sizeof(version);
+
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    if (sendmsg(client, &msg, 0) < 0) {
+        LOGE("cannot pass frame ring to pid %d: %s", (int) cred.pid, strerror(errno));
+    } else {
+        LOGV("frame ring passed to pid %d", (int) cred.pid);
+    }
+    close(fd);
+}
+
+// factory function for playerdriver linkage
+extern "C" AndroidSurfaceOutputShm* createVideoMio()
+{
+    return new AndroidSurfaceOutputShm();
+}
+
+void AndroidSurfaceOutputShm::AverageFPSProfiling()
+{
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t diff = now - mLastFpsTime;
+    iFrameNumber++;
+
+    if (diff > ms2ns(250)) {
+        float mFps =  ((iFrameNumber - mLastFrame) * float(s2ns(1))) / diff;
+        LOGE("AndroidSurfaceOutputShm: Frames Per Second: %.4f", mFps);
+        mFpsSum += mFps;
+        mNumFpsSamples++;
+        mLastFpsTime = now;
+        mLastFrame = iFrameNumber;
+    }
+}
+
+void AndroidSurfaceOutputShm::AverageFPSPrint()
+{
+    LOGE("==========================================================");
+    LOGE("AndroidSurfaceOutputShm: Average Frames Per Second: %.4f", mFpsSum / mNumFpsSamples);
+    mPostStats.print("AndroidSurfaceOutputShm");
+    LOGE("==========================================================");
+}
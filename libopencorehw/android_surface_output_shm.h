@@ -0,0 +1,89 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef ANDROID_SURFACE_OUTPUT_SHM_H_INCLUDED
+#define ANDROID_SURFACE_OUTPUT_SHM_H_INCLUDED
+
+#include <pthread.h>
+#include <cutils/properties.h>
+
+#include "android_surface_output.h"
+
+#include "shm_video_ring.h"
+#include "video_post_stats.h"
+
+/*
+ * Video MIO for targets without pmem, overlay or a display: decoded frames
+ * go into a shared memory ring (see shm_video_ring.h) that another process
+ * maps and reads in place.
+ */
+class AndroidSurfaceOutputShm : public AndroidSurfaceOutput
+{
+public:
+    AndroidSurfaceOutputShm();
+
+    // frame buffer interface
+    virtual bool initCheck();
+    virtual PVMFStatus writeFrameBuf(uint8* aData, uint32 aDataLen, const PvmiMediaXferHeader& data_header_info);
+    virtual void postLastFrame();
+    virtual void closeFrameBuf();
+
+    OSCL_IMPORT_REF ~AndroidSurfaceOutputShm();
+
+private:
+    bool createRing(uint32 format, uint32 frameSize);
+    void destroyRing();
+    bool waitForSlot(uint32 seq);
+
+    // hands the current ring descriptor to connecting consumers
+    bool startServer();
+    void stopServer();
+    static void* serverThread(void* arg);
+    void serveClient(int client);
+
+    ShmVideoRingHeader*         mRing;
+    int                         mRingFd;
+    uint32                      mRingSize;
+    // slot layout and counters as written; the header copies are shared
+    // with the consumer and not read back
+    uint32                      mSlotCount;
+    uint32                      mSlotSize;
+    uint32                      mSlotOffset;
+    uint32                      mWriteSeq;
+    uint32                      mDropped;
+    bool                        mBlocking;
+
+    pthread_mutex_t             mServerLock;
+    pthread_t                   mServerThread;
+    volatile bool               mServerRunning;
+    int                         mListenFd;
+    char                        mSocketName[PROPERTY_VALUE_MAX];
+
+    //Average FPS profiling
+    virtual void AverageFPSProfiling();
+    virtual void AverageFPSPrint();
+    bool                        mStatistics;
+    int                         mLastFrame;
+    float                       mFpsSum;
+    unsigned long               iFrameNumber;
+    unsigned long               mNumFpsSamples;
+    nsecs_t                     mLastFpsTime;
+    VideoPostStats              mPostStats;
+};
+
+#endif // ANDROID_SURFACE_OUTPUT_SHM_H_INCLUDED
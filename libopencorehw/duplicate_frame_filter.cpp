@@ -0,0 +1,148 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DuplicateFrameFilter"
+#include <utils/Log.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/properties.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "duplicate_frame_filter.h"
+
+static const uint32_t kPrime1 = 2654435761U;
+static const uint32_t kPrime2 = 2246822519U;
+static const uint32_t kPrime3 = 3266489917U;
+static const uint32_t kPrime5 = 374761393U;
+
+static inline uint32_t rotl(uint32_t x, int r) { return (x << r) | (x >> (32 - r)); }
+
+static inline uint32_t round32(uint32_t acc, uint32_t in)
+{
+    return rotl(acc + in * kPrime2, 13) * kPrime1;
+}
+
+DuplicateFrameFilter::DuplicateFrameFilter() :
+    mHaveDisplayed(false),
+    mDisplayedHash(0),
+    mHavePending(false),
+    mPendingHash(0),
+    mChecked(0),
+    mSkipped(0)
+{
+    char value[PROPERTY_VALUE_MAX];
+    property_get("persist.pv.dupskip", value, "0");
+    mEnabled = atoi(value) ? true : false;
+    property_get("persist.pv.dupskip.rowstep", value, "1");
+    mRowStep = atoi(value);
+    if (mRowStep < 1) mRowStep = 1;
+}
+
+void DuplicateFrameFilter::setEnabled(bool enable)
+{
+    LOGV("duplicate frame skipping %s", enable ? "on" : "off");
+    mEnabled = enable;
+    reset();
+}
+
+uint32_t DuplicateFrameFilter::hashRows(const uint8_t* data, int width, int rows, int stride,
+                                        int rowStep, uint32_t seed)
+{
+    uint32_t lane[4] = { seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1 };
+    uint32_t tail = seed + kPrime5;
+
+#if defined(__ARM_NEON__)
+    uint32x4_t acc = vld1q_u32(lane);
+    const uint32x4_t p1 = vdupq_n_u32(kPrime1);
+    const uint32x4_t p2 = vdupq_n_u32(kPrime2);
+#endif
+
+    for (int row = 0; row < rows; row += rowStep) {
+        const uint8_t* p = data + row * stride;
+        int x = 0;
+#if defined(__ARM_NEON__)
+        for (; x + 16 <= width; x += 16) {
+            uint32x4_t in = vreinterpretq_u32_u8(vld1q_u8(p + x));
+            acc = vmlaq_u32(acc, in, p2);
+            acc = vorrq_u32(vshlq_n_u32(acc, 13), vshrq_n_u32(acc, 19));
+            acc = vmulq_u32(acc, p1);
+        }
+#else
+        for (; x + 16 <= width; x += 16) {
+            uint32_t in[4];
+            memcpy(in, p + x, sizeof(in));
+            lane[0] = round32(lane[0], in[0]);
+            lane[1] = round32(lane[1], in[1]);
+            lane[2] = round32(lane[2], in[2]);
+            lane[3] = round32(lane[3], in[3]);
+        }
+#endif
+        for (; x < width; x++) {
+            tail = rotl(tail ^ (p[x] * kPrime5), 11) * kPrime1;
+        }
+    }
+
+#if defined(__ARM_NEON__)
+    vst1q_u32(lane, acc);
+#endif
+    uint32_t h = rotl(lane[0], 1) + rotl(lane[1], 7) + rotl(lane[2], 12) + rotl(lane[3], 18);
+    h ^= tail;
+    h ^= h >> 15;
+    h *= kPrime2;
+    h ^= h >> 13;
+    h *= kPrime3;
+    h ^= h >> 16;
+    return h;
+}
+
+bool DuplicateFrameFilter::isDuplicate(const uint8_t* frame, int width, int height,
+                                       int chromaWidth, int chromaRows)
+{
+    if (!mEnabled) return false;
+
+    mChecked++;
+    uint32_t h = hashRows(frame, width, height, width, mRowStep, 0);
+    h = hashRows(frame + width * height, chromaWidth, chromaRows, chromaWidth, mRowStep, h);
+
+    if (mHaveDisplayed && (h == mDisplayedHash)) {
+        mSkipped++;
+        return true;
+    }
+    mPendingHash = h;
+    mHavePending = true;
+    return false;
+}
+
+void DuplicateFrameFilter::posted()
+{
+    if (!mHavePending) return;
+    mDisplayedHash = mPendingHash;
+    mHaveDisplayed = true;
+    mHavePending = false;
+}
+
+void DuplicateFrameFilter::print(const char* name) const
+{
+    if (mChecked == 0) return;
+    LOGE("%s: skipped %lu duplicate frames of %lu checked (row step %d)", name, mSkipped, mChecked, mRowStep);
+}
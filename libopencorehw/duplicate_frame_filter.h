@@ -0,0 +1,73 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef DUPLICATE_FRAME_FILTER_H_INCLUDED
+#define DUPLICATE_FRAME_FILTER_H_INCLUDED
+
+#include <stdint.h>
+
+/*
+ * Recognises a software decoded frame that is identical to the one on
+ * screen so the MIO can skip converting and posting it (slideshows,
+ * repeated frames from a paused decoder, static screencasts).
+ *
+ * The luma and chroma planes are hashed whole with a four lane xxHash32
+ * style mix; on NEON targets the lanes run in one vector.
+ * persist.pv.dupskip.rowstep above 1 hashes only every rowStep-th row,
+ * which is cheaper but misses a change confined to the rows in between
+ * (subtitles, a ticker, a thin cursor), so it is left to streams where
+ * that cannot happen.
+ */
+class DuplicateFrameFilter
+{
+public:
+    DuplicateFrameFilter();
+
+    // defaults come from persist.pv.dupskip and persist.pv.dupskip.rowstep
+    void setEnabled(bool enable);
+    bool enabled() const { return mEnabled; }
+
+    // forget the displayed frame, call when the stream (re)configures or
+    // something else reached the display
+    void reset() { mHaveDisplayed = false; mHavePending = false; }
+
+    // frame is width x height luma followed by chromaRows rows of
+    // chromaWidth bytes, both with stride equal to the width.  Returns true
+    // when it matches the frame on screen.
+    bool isDuplicate(const uint8_t* frame, int width, int height, int chromaWidth, int chromaRows);
+    // the frame last checked with isDuplicate was posted and is now the
+    // one on screen; one that was dropped or failed is never compared with
+    void posted();
+
+    unsigned long skipped() const { return mSkipped; }
+    void print(const char* name) const;
+
+    static uint32_t hashRows(const uint8_t* data, int width, int rows, int stride, int rowStep, uint32_t seed);
+
+private:
+    bool                        mEnabled;
+    int                         mRowStep;
+    bool                        mHaveDisplayed;
+    uint32_t                    mDisplayedHash;
+    bool                        mHavePending;
+    uint32_t                    mPendingHash;
+    unsigned long               mChecked;
+    unsigned long               mSkipped;
+};
+
+#endif // DUPLICATE_FRAME_FILTER_H_INCLUDED
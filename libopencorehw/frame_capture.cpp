@@ -0,0 +1,301 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FrameCapture"
+#include <utils/Log.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <cutils/properties.h>
+
+#include "frame_capture.h"
+
+using namespace android;
+
+#define ALIGN(x, a)     (((x) + (a) - 1) & ~((a) - 1))
+
+// streams captured so far in this process, later ones get a numbered file
+static int sCaptureCount = 0;
+
+size_t FrameCapture::frameSize(int format, int width, int height)
+{
+    switch (format) {
+    case CAPTURE_FORMAT_NV12_TILED:
+        // luma and chroma planes are each padded to 128x32 tiles and 8K
+        return ALIGN(ALIGN(width, 128) * ALIGN(height, 32), 8192) +
+               ALIGN(ALIGN(width, 128) * ALIGN(height / 2, 32), 8192);
+    case CAPTURE_FORMAT_RGB565:
+        return width * height * 2;
+    case CAPTURE_FORMAT_RGBX8888:
+        return width * height * 4;
+    default:
+        return (width * height * 3) / 2;
+    }
+}
+
+FrameCapture* FrameCapture::create(int format, int width, int height)
+{
+    char path[PROPERTY_VALUE_MAX];
+    property_get("persist.pv.capture", path, "");
+    if (path[0] == '\0') return NULL;
+
+    // keep the first stream at the given path, number the ones after it
+    char name[PROPERTY_VALUE_MAX + 16];
+    if (sCaptureCount == 0) {
+        strcpy(name, path);
+    } else {
+        const char* ext = strrchr(path, '.');
+        const char* slash = strrchr(path, '/');
+        if ((ext == NULL) || (slash > ext)) ext = path + strlen(path);
+        snprintf(name, sizeof(name), "%.*s-%d%s", (int)(ext - path), path, sCaptureCount, ext);
+    }
+    sCaptureCount++;
+
+    FrameCapture* capture = new FrameCapture();
+    if (!capture->init(name, format, width, height)) {
+        delete capture;
+        return NULL;
+    }
+    return capture;
+}
+
+FrameCapture::FrameCapture() :
+    mFd(-1),
+    mY4m(false),
+    mRing(NULL),
+    mRingSize(0),
+    mNumSlots(0),
+    mHead(0),
+    mTail(0),
+    mChunk(NULL),
+    mChunkUsed(0),
+    mPlanar(NULL),
+    mRunning(false),
+    mExit(false),
+    mCaptured(0),
+    mDropped(0),
+    mWritten(0),
+    mBytes(0),
+    mWriteError(false)
+{
+    memset(mSlots, 0, sizeof(mSlots));
+}
+
+bool FrameCapture::init(const char* path, int format, int width, int height)
+{
+    char value[PROPERTY_VALUE_MAX];
+    property_get("persist.pv.capture.slots", value, "8");
+    mNumSlots = atoi(value);
+    if (mNumSlots < 2) mNumSlots = 2;
+    if (mNumSlots > kMaxSlots) mNumSlots = kMaxSlots;
+
+    mFormat = format;
+    mWidth = width;
+    mHeight = height;
+    mFrameSize = frameSize(format, width, height);
+
+    // Y4M only describes planar 4:2:0, other layouts are written raw
+    const char* ext = strrchr(path, '.');
+    mY4m = (ext != NULL) && !strcmp(ext, ".y4m");
+    if (mY4m && (format != CAPTURE_FORMAT_NV21) && (format != CAPTURE_FORMAT_NV12)) {
+        LOGE("format %d cannot go into Y4M, capturing raw frames to %s", format, path);
+        mY4m = false;
+    }
+
+    mRingSize = ALIGN(mFrameSize * mNumSlots, 4096);
+    void* ring = mmap(NULL, mRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    void* chunk = mmap(NULL, kChunkSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ((ring == MAP_FAILED) || (chunk == MAP_FAILED)) {
+        LOGE("cannot allocate %d capture slots of %u bytes", mNumSlots, (unsigned)mFrameSize);
+        if (ring != MAP_FAILED) munmap(ring, mRingSize);
+        if (chunk != MAP_FAILED) munmap(chunk, kChunkSize);
+        return false;
+    }
+    mRing = static_cast<uint8_t*>(ring);
+    mChunk = static_cast<uint8_t*>(chunk);
+    if (mY4m) {
+        mPlanar = static_cast<uint8_t*>(malloc((width * height) / 2));
+        if (mPlanar == NULL) return false;
+    }
+
+    mFd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (mFd < 0) {
+        LOGE("cannot open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    if (mY4m) {
+        property_get("persist.pv.capture.fps", value, "30");
+        char header[128];
+        int len = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+                           width, height, atoi(value));
+        append(header, len);
+    }
+
+    if (pthread_create(&mThread, NULL, writerThread, this) != 0) {
+        LOGE("cannot start the capture writer");
+        return false;
+    }
+    mRunning = true;
+
+    LOGE("capturing %dx%d frames (format %d) to %s", width, height, format, path);
+    return true;
+}
+
+FrameCapture::~FrameCapture()
+{
+    if (mRunning) {
+        mLock.lock();
+        mExit = true;
+        mReady.signal();
+        mLock.unlock();
+        // the writer drains the frames already captured first
+        pthread_join(mThread, NULL);
+    }
+    if (mFd >= 0) {
+        if (mChunkUsed > 0) flush(mChunkUsed);
+        close(mFd);
+    }
+    if (mRing != NULL) munmap(mRing, mRingSize);
+    if (mChunk != NULL) munmap(mChunk, kChunkSize);
+    free(mPlanar);
+}
+
+void FrameCapture::capture(const void* frame, int64_t timestampMs)
+{
+    if (frame == NULL) return;
+
+    mLock.lock();
+    Slot& slot = mSlots[mTail];
+    if ((slot.state != SLOT_FREE) || mWriteError) {
+        mDropped++;
+        mLock.unlock();
+        return;
+    }
+    int index = mTail;
+    slot.state = SLOT_FILLING;
+    slot.timestampMs = timestampMs;
+    mTail = (mTail + 1) % mNumSlots;
+    mCaptured++;
+    mLock.unlock();
+
+    memcpy(mRing + index * mFrameSize, frame, mFrameSize);
+
+    mLock.lock();
+    mSlots[index].state = SLOT_READY;
+    mReady.signal();
+    mLock.unlock();
+}
+
+void* FrameCapture::writerThread(void* arg)
+{
+    static_cast<FrameCapture*>(arg)->writerLoop();
+    return NULL;
+}
+
+void FrameCapture::writerLoop()
+{
+    Mutex::Autolock lock(mLock);
+    for (;;) {
+        while (mSlots[mHead].state != SLOT_READY) {
+            if (mExit) return;
+            mReady.wait(mLock);
+        }
+        int index = mHead;
+        int64_t timestampMs = mSlots[index].timestampMs;
+
+        mLock.unlock();
+        writeFrame(mRing + index * mFrameSize, timestampMs);
+        mLock.lock();
+
+        mSlots[index].state = SLOT_FREE;
+        mHead = (mHead + 1) % mNumSlots;
+        mWritten++;
+    }
+}
+
+void FrameCapture::writeFrame(const uint8_t* frame, int64_t timestampMs)
+{
+    if (!mY4m) {
+        append(frame, mFrameSize);
+        return;
+    }
+
+    char header[48];
+    int len = snprintf(header, sizeof(header), "FRAME Xts=%lld\n", (long long)timestampMs);
+    append(header, len);
+
+    size_t ySize = mWidth * mHeight;
+    append(frame, ySize);
+
+    // de-interleave chroma into U then V
+    const uint8_t* uv = frame + ySize;
+    size_t count = ySize / 4;
+    uint8_t* u = mPlanar;
+    uint8_t* v = mPlanar + count;
+    int vFirst = (mFormat == CAPTURE_FORMAT_NV21) ? 1 : 0;
+    for (size_t i = 0; i < count; i++) {
+        u[i] = uv[2 * i + vFirst];
+        v[i] = uv[2 * i + 1 - vFirst];
+    }
+    append(mPlanar, 2 * count);
+}
+
+// packs into the chunk and writes whole chunks only
+void FrameCapture::append(const void* data, size_t size)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        size_t n = kChunkSize - mChunkUsed;
+        if (n > size) n = size;
+        memcpy(mChunk + mChunkUsed, p, n);
+        mChunkUsed += n;
+        p += n;
+        size -= n;
+        if (mChunkUsed == kChunkSize) flush(kChunkSize);
+    }
+}
+
+void FrameCapture::flush(size_t size)
+{
+    size_t done = 0;
+    while (!mWriteError && (done < size)) {
+        ssize_t n = write(mFd, mChunk + done, size - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOGE("capture write failed: %s, dropping the rest", strerror(errno));
+            mWriteError = true;
+            break;
+        }
+        done += n;
+    }
+    mBytes += done;
+    mChunkUsed = 0;
+}
+
+void FrameCapture::print(const char* name) const
+{
+    LOGE("%s: captured %lu frames, wrote %lu (%llu bytes), dropped %lu", name,
+         mCaptured, mWritten, mBytes, mDropped);
+}
@@ -0,0 +1,116 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef FRAME_CAPTURE_H_INCLUDED
+#define FRAME_CAPTURE_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <utils/threads.h>
+
+/*
+ * Records what the MIO posts to the display, for field debugging.
+ *
+ * Set persist.pv.capture to an output path to enable it for the next
+ * stream.  A path ending in .y4m produces a YUV4MPEG2 file (semi-planar
+ * frames are de-interleaved to planar on the way out, each FRAME carries
+ * the presentation time as Xts=<ms>), anything else gets the posted bytes
+ * unchanged.  persist.pv.capture.slots sizes the ring (default 8 frames)
+ * and persist.pv.capture.fps goes into the Y4M header (default 30).
+ *
+ * capture() only copies the posted buffer into a preallocated slot; a
+ * writer thread packs slots into 1 MiB page-aligned chunks and writes
+ * those.  If the writer falls behind and no slot is free, the frame is
+ * dropped and counted rather than stalling the frame path.
+ */
+
+enum {
+    CAPTURE_FORMAT_NV21 = 0,
+    CAPTURE_FORMAT_NV12,
+    CAPTURE_FORMAT_NV12_TILED,  // 64x32 macro tiles, written raw
+    CAPTURE_FORMAT_RGB565,      // software composition output, written raw
+    CAPTURE_FORMAT_RGBX8888
+};
+
+class FrameCapture
+{
+public:
+    // NULL unless persist.pv.capture names a file that can be opened
+    static FrameCapture* create(int format, int width, int height);
+    ~FrameCapture();
+
+    // copies frame into the ring, never blocks on the writer
+    void capture(const void* frame, int64_t timestampMs);
+
+    static size_t frameSize(int format, int width, int height);
+
+    void print(const char* name) const;
+
+private:
+    FrameCapture();
+    bool init(const char* path, int format, int width, int height);
+
+    static void* writerThread(void* arg);
+    void writerLoop();
+    void append(const void* data, size_t size);
+    void flush(size_t size);
+    void writeFrame(const uint8_t* frame, int64_t timestampMs);
+
+    enum { SLOT_FREE = 0, SLOT_FILLING, SLOT_READY };
+
+    struct Slot {
+        int             state;
+        int64_t         timestampMs;
+    };
+
+    static const size_t kChunkSize = 1024 * 1024;
+    static const int kMaxSlots = 32;
+
+    int                         mFd;
+    bool                        mY4m;
+    int                         mFormat;
+    int                         mWidth;
+    int                         mHeight;
+    size_t                      mFrameSize;
+
+    uint8_t*                    mRing;
+    size_t                      mRingSize;
+    Slot                        mSlots[kMaxSlots];
+    int                         mNumSlots;
+    int                         mHead;      // next slot the writer takes
+    int                         mTail;      // next slot capture() fills
+
+    uint8_t*                    mChunk;
+    size_t                      mChunkUsed;
+    uint8_t*                    mPlanar;    // de-interleave scratch for Y4M
+
+    android::Mutex              mLock;
+    android::Condition          mReady;
+    pthread_t                   mThread;
+    bool                        mRunning;
+    bool                        mExit;
+
+    unsigned long               mCaptured;
+    unsigned long               mDropped;
+    unsigned long               mWritten;
+    unsigned long long          mBytes;
+    bool                        mWriteError;
+};
+
+#endif // FRAME_CAPTURE_H_INCLUDED
@@ -0,0 +1,297 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FrameDeinterlacer"
+#include <utils/Log.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <cutils/properties.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "frame_deinterlacer.h"
+
+using namespace android;
+
+// a bottom field pixel that changed by more than this since the previous
+// frame is taken as moving and interpolated
+static const uint8_t kMotionThreshold = 12;
+
+static const char* const kModeNames[] = { "off", "bob", "blend", "adaptive" };
+
+// out = rounded average of a and b
+static void averageRow(const uint8_t* a, const uint8_t* b, uint8_t* out, int count)
+{
+    int i = 0;
+#if defined(__ARM_NEON__)
+    for (; i + 16 <= count; i += 16) {
+        vst1q_u8(out + i, vrhaddq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = (a[i] + b[i] + 1) >> 1;
+    }
+}
+
+// out = (a + 2b + c) / 4, as ((a + c) / 2 + b + 1) / 2 so both paths agree
+static void blendRow(const uint8_t* a, const uint8_t* b, const uint8_t* c, uint8_t* out, int count)
+{
+    int i = 0;
+#if defined(__ARM_NEON__)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t ac = vhaddq_u8(vld1q_u8(a + i), vld1q_u8(c + i));
+        vst1q_u8(out + i, vrhaddq_u8(ac, vld1q_u8(b + i)));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = (((a[i] + c[i]) >> 1) + b[i] + 1) >> 1;
+    }
+}
+
+// a bottom field row: cur where it matches the same row of the previous
+// frame, the average of above and below where it moved; prev becomes cur
+static void adaptiveRow(const uint8_t* above, const uint8_t* cur, const uint8_t* below,
+                        uint8_t* prev, uint8_t* out, int count)
+{
+    int i = 0;
+#if defined(__ARM_NEON__)
+    uint8x16_t threshold = vdupq_n_u8(kMotionThreshold);
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t c = vld1q_u8(cur + i);
+        uint8x16_t moving = vcgtq_u8(vabdq_u8(c, vld1q_u8(prev + i)), threshold);
+        uint8x16_t bob = vrhaddq_u8(vld1q_u8(above + i), vld1q_u8(below + i));
+        vst1q_u8(out + i, vbslq_u8(moving, bob, c));
+        vst1q_u8(prev + i, c);
+    }
+#endif
+    for (; i < count; i++) {
+        int diff = cur[i] - prev[i];
+        if ((diff > kMotionThreshold) || (-diff > kMotionThreshold)) {
+            out[i] = (above[i] + below[i] + 1) >> 1;
+        } else {
+            out[i] = cur[i];
+        }
+        prev[i] = cur[i];
+    }
+}
+
+// rows [firstRow, lastRow) of a plane of height rows of width bytes; prev
+// holds the plane's bottom field rows (adaptive only), compare says
+// whether they are from the previous frame yet
+static void deinterlacePlane(int mode, const uint8_t* src, uint8_t* dst, uint8_t* prev, bool compare,
+                             int width, int height, int firstRow, int lastRow)
+{
+    for (int y = firstRow; y < lastRow; y++) {
+        const uint8_t* cur = src + y * width;
+        const uint8_t* above = src + ((y > 0) ? y - 1 : y + 1) * width;
+        const uint8_t* below = src + ((y + 1 < height) ? y + 1 : y - 1) * width;
+        uint8_t* out = dst + y * width;
+
+        if (mode == FrameDeinterlacer::MODE_BLEND) {
+            blendRow(above, cur, below, out, width);
+        } else if ((y & 1) == 0) {
+            // the top field is kept as is
+            memcpy(out, cur, width);
+        } else if (prev == NULL) {
+            averageRow(above, below, out, width);
+        } else if (!compare) {
+            averageRow(above, below, out, width);
+            memcpy(prev + (y >> 1) * width, cur, width);
+        } else {
+            adaptiveRow(above, cur, below, prev + (y >> 1) * width, out, width);
+        }
+    }
+}
+
+int FrameDeinterlacer::configuredMode()
+{
+    char value[PROPERTY_VALUE_MAX];
+    property_get("persist.pv.deinterlace", value, "adaptive");
+    for (int i = 0; i <= MODE_ADAPTIVE; i++) {
+        if (!strcmp(value, kModeNames[i])) return i;
+    }
+    LOGE("unknown persist.pv.deinterlace %s, using adaptive", value);
+    return MODE_ADAPTIVE;
+}
+
+FrameDeinterlacer::FrameDeinterlacer(int mode, int width, int height, int threads) :
+    mMode(mode),
+    mWidth(width),
+    mHeight(height),
+    mPrevious(NULL),
+    mHavePrevious(false),
+    mCompare(false),
+    mNumWorkers(0),
+    mNextWorker(0),
+    mGeneration(0),
+    mPending(0),
+    mExit(false),
+    mFrames(0),
+    mTotalTime(0),
+    mMaxTime(0)
+{
+    // the edge rows borrow from two rows away in both planes
+    if (mHeight < 4) mMode = MODE_OFF;
+
+    if (mMode == MODE_ADAPTIVE) {
+        // odd rows of the Y plane and of the h/2 rows of VU
+        mPrevious = (uint8_t*) malloc((mHeight / 2 + mHeight / 4) * mWidth);
+        if (mPrevious == NULL) {
+            LOGE("no memory for the field history, deinterlacing with bob");
+            mMode = MODE_BOB;
+        }
+    }
+
+    if (threads <= 0) {
+        threads = sysconf(_SC_NPROCESSORS_CONF);
+    }
+    if (threads > kMaxWorkers + 1) threads = kMaxWorkers + 1;
+    if (mMode == MODE_OFF) threads = 1;
+
+    for (int i = 0; i < threads - 1; i++) {
+        if (pthread_create(&mWorkers[mNumWorkers], NULL, workerThread, this) != 0) {
+            LOGE("failed to start deinterlace worker %d", i);
+            break;
+        }
+        mNumWorkers++;
+    }
+    LOGV("%s deinterlacing %d x %d with %d thread(s)", kModeNames[mMode], mWidth, mHeight, mNumWorkers + 1);
+}
+
+FrameDeinterlacer::~FrameDeinterlacer()
+{
+    mLock.lock();
+    mExit = true;
+    mStart.broadcast();
+    mLock.unlock();
+    for (int i = 0; i < mNumWorkers; i++) {
+        pthread_join(mWorkers[i], NULL);
+    }
+    free(mPrevious);
+}
+
+void* FrameDeinterlacer::workerThread(void* arg)
+{
+    FrameDeinterlacer* self = static_cast<FrameDeinterlacer*>(arg);
+    self->mLock.lock();
+    int index = self->mNextWorker++;
+    self->mLock.unlock();
+    self->workerLoop(index);
+    return NULL;
+}
+
+void FrameDeinterlacer::workerLoop(int index)
+{
+    Mutex::Autolock lock(mLock);
+    // workers start in the constructor, before any frame is handed out
+    uint32_t seen = 0;
+    for (;;) {
+        while (!mExit && (mGeneration == seen)) {
+            mStart.wait(mLock);
+        }
+        if (mExit) break;
+        seen = mGeneration;
+
+        Job job = mJobs[index];
+        mLock.unlock();
+        processRows(job.src, job.dst, job.firstRow, job.rows);
+        mLock.lock();
+
+        if (--mPending == 0) mDone.signal();
+    }
+}
+
+void FrameDeinterlacer::processRows(const uint8_t* src, uint8_t* dst, int firstRow, int rows)
+{
+    if (rows <= 0) return;
+    int lastRow = firstRow + rows;
+    int chromaHeight = mHeight / 2;
+    int chromaFirst = firstRow / 2;
+    int chromaLast = (lastRow >= mHeight) ? chromaHeight : lastRow / 2;
+
+    uint8_t* prevY = mPrevious;
+    uint8_t* prevVu = (mPrevious != NULL) ? mPrevious + (mHeight / 2) * mWidth : NULL;
+    size_t ySize = mWidth * mHeight;
+
+    deinterlacePlane(mMode, src, dst, prevY, mCompare, mWidth, mHeight, firstRow, lastRow);
+    deinterlacePlane(mMode, src + ySize, dst + ySize, prevVu, mCompare, mWidth, chromaHeight,
+                     chromaFirst, chromaLast);
+}
+
+void FrameDeinterlacer::process(const uint8_t* src, uint8_t* dst)
+{
+    if (mMode == MODE_OFF) {
+        memcpy(dst, src, mWidth * mHeight * 3 / 2);
+        return;
+    }
+
+    nsecs_t start = systemTime();
+    mCompare = mHavePrevious;
+
+    if ((mNumWorkers == 0) || (mWidth * mHeight <= kBandThreshold)) {
+        processRows(src, dst, 0, mHeight);
+    } else {
+        // even band heights keep both fields, and every chroma row, inside
+        // one band
+        int bands = mNumWorkers + 1;
+        int bandRows = ((mHeight + bands - 1) / bands + 1) & ~1;
+
+        mLock.lock();
+        int row = bandRows;
+        for (int i = 0; i < mNumWorkers; i++) {
+            Job& job = mJobs[i];
+            job.src = src;
+            job.dst = dst;
+            job.firstRow = row < mHeight ? row : mHeight;
+            job.rows = (mHeight - job.firstRow) < bandRows ? (mHeight - job.firstRow) : bandRows;
+            row += bandRows;
+        }
+        mPending = mNumWorkers;
+        mGeneration++;
+        mStart.broadcast();
+        mLock.unlock();
+
+        // the caller takes the first band
+        processRows(src, dst, 0, bandRows < mHeight ? bandRows : mHeight);
+
+        mLock.lock();
+        while (mPending > 0) {
+            mDone.wait(mLock);
+        }
+        mLock.unlock();
+    }
+
+    mHavePrevious = (mPrevious != NULL);
+    nsecs_t elapsed = systemTime() - start;
+    mFrames++;
+    mTotalTime += elapsed;
+    if (elapsed > mMaxTime) mMaxTime = elapsed;
+}
+
+void FrameDeinterlacer::print(const char* name) const
+{
+    if (mFrames == 0) return;
+    LOGE("%s: deinterlaced %lu frames (%s, %d thread(s)): %lld us per frame, %lld us max",
+         name, mFrames, kModeNames[mMode], mNumWorkers + 1,
+         (long long)(mTotalTime / mFrames / 1000), (long long)(mMaxTime / 1000));
+}
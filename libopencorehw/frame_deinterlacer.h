@@ -0,0 +1,123 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef FRAME_DEINTERLACER_H_INCLUDED
+#define FRAME_DEINTERLACER_H_INCLUDED
+
+#include <stdint.h>
+#include <pthread.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+
+/*
+ * Turns interlaced semi-planar frames (PVMF_MIME_YUV420_SEMIPLANAR_YVU_INTERLACE,
+ * top field first) into progressive ones while copying them out of the
+ * decoder's buffer, for displays that cannot deinterlace themselves.
+ *
+ *  - bob keeps the top field and interpolates the bottom field rows from
+ *    the rows above and below
+ *  - blend runs a vertical [1 2 1] filter over every row, mixing the two
+ *    fields
+ *  - adaptive weaves the bottom field where it matches the bottom field
+ *    of the previous frame and bobs where it moved
+ *
+ * The Y plane and the interleaved VU plane are processed separately, each
+ * with its own row count; the vertical filters do not care which of V or U
+ * a byte is.  All kernels work 16 bytes at a time on NEON targets and fall
+ * back to C for the tail of each row and elsewhere, with identical output.
+ *
+ * Frames larger than kBandThreshold pixels are split into row bands done
+ * in parallel by a small pool of worker threads, as in YuvRgbConverter.
+ *
+ * persist.pv.deinterlace (off, bob, blend, adaptive) picks the mode and
+ * persist.pv.deinterlace.threads the thread count.
+ */
+class FrameDeinterlacer
+{
+public:
+    enum {
+        MODE_OFF = 0,
+        MODE_BOB,
+        MODE_BLEND,
+        MODE_ADAPTIVE
+    };
+
+    // the mode set in persist.pv.deinterlace, adaptive by default
+    static int configuredMode();
+
+    // width x height frames; threads <= 0 picks a count from the number of
+    // online cpus.  An adaptive deinterlacer that cannot allocate its field
+    // history runs as bob.
+    FrameDeinterlacer(int mode, int width, int height, int threads = 0);
+    ~FrameDeinterlacer();
+
+    // src and dst hold width x height Y followed by height / 2 rows of
+    // interleaved VU, both with stride == width
+    void process(const uint8_t* src, uint8_t* dst);
+
+    // the next frame has no previous one to compare with (seek, flush)
+    void reset() { mHavePrevious = false; }
+
+    int mode() const { return mMode; }
+    int threads() const { return mNumWorkers + 1; }
+
+    void print(const char* name) const;
+
+    // CIF and smaller are not worth waking the workers for
+    static const int kBandThreshold = 352 * 288;
+
+private:
+    struct Job {
+        const uint8_t*  src;
+        uint8_t*        dst;
+        int             firstRow;
+        int             rows;
+    };
+
+    static const int kMaxWorkers = 3;
+
+    static void* workerThread(void* arg);
+    void workerLoop(int index);
+    // luma rows [firstRow, firstRow + rows) and the chroma rows under them
+    void processRows(const uint8_t* src, uint8_t* dst, int firstRow, int rows);
+
+    int                         mMode;
+    int                         mWidth;
+    int                         mHeight;
+    // the bottom field of the last frame, luma then chroma, for adaptive
+    uint8_t*                    mPrevious;
+    bool                        mHavePrevious;
+    bool                        mCompare;       // mHavePrevious for the frame in process()
+
+    android::Mutex              mLock;
+    android::Condition          mStart;
+    android::Condition          mDone;
+    pthread_t                   mWorkers[kMaxWorkers];
+    int                         mNumWorkers;
+    int                         mNextWorker;    // hands out worker indices at startup
+    Job                         mJobs[kMaxWorkers];
+    uint32_t                    mGeneration;    // bumped for every frame handed out
+    int                         mPending;       // bands still being processed
+    bool                        mExit;
+
+    unsigned long               mFrames;
+    nsecs_t                     mTotalTime;
+    nsecs_t                     mMaxTime;
+};
+
+#endif // FRAME_DEINTERLACER_H_INCLUDED
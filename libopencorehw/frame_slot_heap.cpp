@@ -0,0 +1,96 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FrameSlotHeap"
+#include <utils/Log.h>
+
+#include <string.h>
+
+#include "frame_slot_heap.h"
+
+using namespace android;
+
+static const char* pmem = "/dev/pmem";
+
+FrameSlotHeap::FrameSlotHeap() :
+    mDevice(NULL),
+    mFrameSize(0),
+    mHeapFlags(0),
+    mCount(0),
+    mResizes(0)
+{
+}
+
+void FrameSlotHeap::configure(const char* device, size_t frameSize, uint32_t heapFlags)
+{
+    release();
+    mDevice = device;
+    mFrameSize = frameSize;
+    mHeapFlags = heapFlags;
+}
+
+int FrameSlotHeap::resize(int count, int keep)
+{
+    if ((mDevice == NULL) || (count <= 0)) return -1;
+
+    sp<MemoryHeapBase> master = new MemoryHeapBase(mDevice, mFrameSize * count, mHeapFlags);
+    if (master->heapID() < 0) {
+        LOGE("Error creating a frame buffer heap of %d slots", count);
+        return -1;
+    }
+    master->setDevice(pmem);
+    sp<MemoryHeapPmem> heap = new MemoryHeapPmem(master, 0);
+    heap->slap();
+
+    int slot = 0;
+    if ((keep >= 0) && (keep < mCount)) {
+        slot = (keep < count) ? keep : 0;
+        memcpy(static_cast<uint8_t*>(master->base()) + offset(slot),
+               static_cast<uint8_t*>(mMaster->base()) + offset(keep), mFrameSize);
+    }
+    LOGV("%d -> %d slots of %u bytes", mCount, count, (unsigned)mFrameSize);
+
+    mMaster = master;
+    mHeap = heap;
+    mCount = count;
+    mResizes++;
+    return slot;
+}
+
+void FrameSlotHeap::release()
+{
+    mHeap.clear();
+    mMaster.clear();
+    mCount = 0;
+}
+
+uint32_t FrameSlotHeap::masterFlags() const
+{
+    return (mMaster != 0) ? mMaster->getFlags() : mHeapFlags;
+}
+
+int FrameSlotHeap::masterFd() const
+{
+    return (mMaster != 0) ? mMaster->heapID() : -1;
+}
+
+void* FrameSlotHeap::base() const
+{
+    return (mMaster != 0) ? mMaster->base() : NULL;
+}
@@ -0,0 +1,79 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef FRAME_SLOT_HEAP_H_INCLUDED
+#define FRAME_SLOT_HEAP_H_INCLUDED
+
+#include <stddef.h>
+#include <binder/MemoryHeapPmem.h>
+
+/*
+ * The pmem heap software frames are converted into, sized by the MIO as
+ * it goes rather than once when the stream is configured.
+ *
+ * Nothing is allocated until the first frame needs a slot.  resize()
+ * replaces the heap with one of another slot count and carries the frame
+ * on screen over, so an idle stream can give back every slot but that one
+ * and grow again when frames come.  The display has to be pointed at the
+ * new heap (setFd, registerBuffers) before the old one is let go; the MIO
+ * keeps a reference across that.
+ */
+class FrameSlotHeap
+{
+public:
+    FrameSlotHeap();
+
+    // slots of frameSize bytes from device, heapFlags as for the master
+    // MemoryHeapBase; drops the current heap
+    void configure(const char* device, size_t frameSize, uint32_t heapFlags);
+    // a heap of count slots holding the frame from slot keep (-1: none);
+    // returns the slot it is in now, or -1 if no heap could be had
+    int resize(int count, int keep);
+    void release();
+
+    // slots a software path keeps: those the display may still be reading
+    // plus the one being written, at most maxSlots
+    static int slotsNeeded(int onScreen, int maxSlots)
+    {
+        return (onScreen + 1 < maxSlots) ? onScreen + 1 : maxSlots;
+    }
+
+    int count() const { return mCount; }
+    size_t frameSize() const { return mFrameSize; }
+    size_t offset(int slot) const { return slot * mFrameSize; }
+    size_t residentBytes() const { return mCount * mFrameSize; }
+
+    const android::sp<android::MemoryHeapPmem>& heap() const { return mHeap; }
+    // for PmemFrameWriter::init
+    uint32_t masterFlags() const;
+    int masterFd() const;
+    void* base() const;
+
+    unsigned long resizes() const { return mResizes; }
+
+private:
+    const char*                             mDevice;
+    size_t                                  mFrameSize;
+    uint32_t                                mHeapFlags;
+    int                                     mCount;
+    android::sp<android::MemoryHeapBase>    mMaster;
+    android::sp<android::MemoryHeapPmem>    mHeap;
+    unsigned long                           mResizes;
+};
+
+#endif // FRAME_SLOT_HEAP_H_INCLUDED
@@ -0,0 +1,193 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FrameTrace"
+#include <utils/Log.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/properties.h>
+
+#include "frame_trace.h"
+#include "qcom_platform_private.h"
+
+// streams traced so far in this process, later ones get a numbered file
+static int sTraceCount = 0;
+
+static const char* kTraceHeader = "# pv frame trace 1";
+
+FrameTraceRecorder* FrameTraceRecorder::create()
+{
+    char path[PROPERTY_VALUE_MAX];
+    property_get("persist.pv.trace", path, "");
+    if (path[0] == '\0') return NULL;
+
+    // keep the first stream at the given path, number the ones after it
+    char name[PROPERTY_VALUE_MAX + 16];
+    if (sTraceCount == 0) {
+        strcpy(name, path);
+    } else {
+        const char* ext = strrchr(path, '.');
+        const char* slash = strrchr(path, '/');
+        if ((ext == NULL) || (slash > ext)) ext = path + strlen(path);
+        snprintf(name, sizeof(name), "%.*s-%d%s", (int)(ext - path), path, sTraceCount, ext);
+    }
+    sTraceCount++;
+
+    FILE* file = fopen(name, "w");
+    if (file == NULL) {
+        LOGE("Cannot open frame trace %s", name);
+        return NULL;
+    }
+    FrameTraceRecorder* trace = new FrameTraceRecorder();
+    trace->mFile = file;
+    trace->mBuffer = (char*) malloc(kBufferSize);
+    if (trace->mBuffer != NULL) setvbuf(file, trace->mBuffer, _IOFBF, kBufferSize);
+    fprintf(file, "%s\n", kTraceHeader);
+    LOGV("tracing frames to %s", name);
+    return trace;
+}
+
+FrameTraceRecorder::FrameTraceRecorder() :
+    mFile(NULL),
+    mBuffer(NULL),
+    mStart(0),
+    mFrames(0),
+    mWriteError(false)
+{
+    memset(&mFormat, 0, sizeof(mFormat));
+}
+
+FrameTraceRecorder::~FrameTraceRecorder()
+{
+    if (mFile != NULL) fclose(mFile);
+    free(mBuffer);
+}
+
+void FrameTraceRecorder::format(const char* subFormat, int width, int height,
+                                int displayWidth, int displayHeight, int framesToHold)
+{
+    if ((subFormat == NULL) || (subFormat[0] == '\0')) subFormat = "-";
+    if (!strncmp(mFormat.subFormat, subFormat, sizeof(mFormat.subFormat) - 1) &&
+        (mFormat.width == width) && (mFormat.height == height) &&
+        (mFormat.displayWidth == displayWidth) && (mFormat.displayHeight == displayHeight) &&
+        (mFormat.framesToHold == framesToHold)) return;
+
+    strncpy(mFormat.subFormat, subFormat, sizeof(mFormat.subFormat) - 1);
+    mFormat.width = width;
+    mFormat.height = height;
+    mFormat.displayWidth = displayWidth;
+    mFormat.displayHeight = displayHeight;
+    mFormat.framesToHold = framesToHold;
+    if (fprintf(mFile, "C %s %d %d %d %d %d\n", mFormat.subFormat, width, height,
+                displayWidth, displayHeight, framesToHold) < 0) mWriteError = true;
+}
+
+void FrameTraceRecorder::frame(int64_t timestampMs, uint32_t length, const void* privateData)
+{
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (mFrames++ == 0) mStart = now;
+
+    const PLATFORM_PRIVATE_LIST* list = (const PLATFORM_PRIVATE_LIST*) privateData;
+    int entries = ((list == NULL) || (list->entryList == NULL)) ? -1 : (int) list->nEntries;
+    int n = fprintf(mFile, "F %lld %lld %u %d", (long long) ns2us(now - mStart),
+                    (long long) timestampMs, (unsigned) length, entries);
+    for (int i = 0; i < entries; i++) {
+        const PLATFORM_PRIVATE_ENTRY* entry = &list->entryList[i];
+        uint32 key = 0, offset = 0;
+        if ((entry->type == PLATFORM_PRIVATE_PMEM) && (entry->entry != NULL)) {
+            const PLATFORM_PRIVATE_PMEM_INFO* pmem = (const PLATFORM_PRIVATE_PMEM_INFO*) entry->entry;
+            key = pmem->pmem_fd;
+            offset = pmem->offset;
+        }
+        if (fprintf(mFile, " %u:%x:%u", (unsigned) entry->type, (unsigned) key, (unsigned) offset) < 0) n = -1;
+    }
+    if ((n < 0) || (fputc('\n', mFile) == EOF)) mWriteError = true;
+}
+
+void FrameTraceRecorder::print(const char* name) const
+{
+    LOGE("%s: traced %lu frames%s", name, mFrames, mWriteError ? ", write errors" : "");
+}
+
+FrameTraceReader::FrameTraceReader() :
+    mFile(NULL),
+    mLine(0)
+{
+    memset(&mFormat, 0, sizeof(mFormat));
+    memset(&mFrame, 0, sizeof(mFrame));
+}
+
+FrameTraceReader::~FrameTraceReader()
+{
+    if (mFile != NULL) fclose(mFile);
+}
+
+bool FrameTraceReader::open(const char* path)
+{
+    mFile = fopen(path, "r");
+    mLine = 0;
+    return mFile != NULL;
+}
+
+int FrameTraceReader::next()
+{
+    char text[512];
+    while (fgets(text, sizeof(text), mFile) != NULL) {
+        mLine++;
+        if ((text[0] == '#') || (text[0] == '\n')) continue;
+
+        if (text[0] == 'C') {
+            FrameTraceFormat f;
+            memset(&f, 0, sizeof(f));
+            if (sscanf(text, "C %63s %d %d %d %d %d", f.subFormat, &f.width, &f.height,
+                       &f.displayWidth, &f.displayHeight, &f.framesToHold) != 6) return TRACE_ERROR;
+            mFormat = f;
+            return TRACE_FORMAT;
+        }
+
+        if (text[0] == 'F') {
+            FrameTraceFrame f;
+            memset(&f, 0, sizeof(f));
+            long long arrival, timestamp;
+            unsigned length;
+            int used;
+            if (sscanf(text, "F %lld %lld %u %d%n", &arrival, &timestamp, &length,
+                       &f.entries, &used) != 4) return TRACE_ERROR;
+            f.arrivalUs = arrival;
+            f.timestampMs = timestamp;
+            f.length = length;
+            // entries beyond kMaxEntries are counted but not kept
+            const char* p = text + used;
+            for (int i = 0; i < f.entries; i++) {
+                unsigned type, key, offset;
+                if (sscanf(p, " %u:%x:%u%n", &type, &key, &offset, &used) != 3) return TRACE_ERROR;
+                p += used;
+                if (i >= FrameTraceFrame::kMaxEntries) continue;
+                f.entry[i].type = type;
+                f.entry[i].heapKey = key;
+                f.entry[i].offset = offset;
+            }
+            mFrame = f;
+            return TRACE_FRAME;
+        }
+        return TRACE_ERROR;
+    }
+    return TRACE_END;
+}
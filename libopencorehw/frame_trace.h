@@ -0,0 +1,124 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef FRAME_TRACE_H_INCLUDED
+#define FRAME_TRACE_H_INCLUDED
+
+#include <stdint.h>
+#include <stdio.h>
+#include <utils/Timers.h>
+
+/*
+ * Record of the frames that reach writeFrameBuf, so the timing of a real
+ * decode can be replayed into either MIO on a host, see
+ * tools/trace_replay/trace_replay.cpp.
+ *
+ * When persist.pv.trace names a file, a video output writes one line per
+ * writeFrameBuf call, before it decides anything about the frame.  A line
+ * with the output format comes first and again whenever it changes.
+ * Later streams of the process get a numbered file, as with
+ * persist.pv.capture.
+ *
+ *   # pv frame trace 1
+ *   C <sub-format MIME> <width> <height> <display width> <display height> <frames to hold>
+ *   F <arrival us> <timestamp ms> <length> <entries> [<type>:<heap key>:<offset> ...]
+ *
+ * Arrival is counted from the first line.  entries is -1 when the frame
+ * had no platform private list; heap key and offset are 0 for entries
+ * that are not pmem.  Heap keys are only compared: the same key is the
+ * same decoder heap.  Lines go through a stdio buffer, so the frame
+ * thread only writes to the file when that fills.
+ */
+
+struct FrameTraceFormat {
+    char        subFormat[64];
+    int         width;
+    int         height;
+    int         displayWidth;
+    int         displayHeight;
+    int         framesToHold;
+};
+
+struct FrameTraceEntry {
+    uint32_t    type;
+    uint32_t    heapKey;
+    uint32_t    offset;
+};
+
+struct FrameTraceFrame {
+    enum { kMaxEntries = 4 };
+
+    int64_t         arrivalUs;
+    int64_t         timestampMs;
+    uint32_t        length;
+    int             entries;
+    FrameTraceEntry entry[kMaxEntries];
+};
+
+class FrameTraceRecorder
+{
+public:
+    // NULL unless persist.pv.trace names a file that can be opened
+    static FrameTraceRecorder* create();
+    ~FrameTraceRecorder();
+
+    // written only when it differs from the last one
+    void format(const char* subFormat, int width, int height,
+                int displayWidth, int displayHeight, int framesToHold);
+    // privateData is the PLATFORM_PRIVATE_LIST of the frame, or NULL
+    void frame(int64_t timestampMs, uint32_t length, const void* privateData);
+
+    void print(const char* name) const;
+
+private:
+    FrameTraceRecorder();
+
+    static const size_t kBufferSize = 64 * 1024;
+
+    FILE*                       mFile;
+    char*                       mBuffer;
+    FrameTraceFormat            mFormat;
+    nsecs_t                     mStart;
+    unsigned long               mFrames;
+    bool                        mWriteError;
+};
+
+class FrameTraceReader
+{
+public:
+    enum { TRACE_END = 0, TRACE_FORMAT, TRACE_FRAME, TRACE_ERROR };
+
+    FrameTraceReader();
+    ~FrameTraceReader();
+
+    bool open(const char* path);
+    // the kind of the next line, which format() or frame() then hold
+    int next();
+
+    const FrameTraceFormat& format() const { return mFormat; }
+    const FrameTraceFrame& frame() const { return mFrame; }
+    int line() const { return mLine; }
+
+private:
+    FILE*                       mFile;
+    FrameTraceFormat            mFormat;
+    FrameTraceFrame             mFrame;
+    int                         mLine;
+};
+
+#endif // FRAME_TRACE_H_INCLUDED
@@ -0,0 +1,846 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef MSM_SURFACE_OUTPUT_H_INCLUDED
+#define MSM_SURFACE_OUTPUT_H_INCLUDED
+
+#include <stdio.h>
+#include <utils/Log.h>
+#include <cutils/properties.h>
+
+#include "android_surface_output.h"
+
+// support for shared contiguous physical memory
+#include <binder/MemoryHeapPmem.h>
+
+#include "pmem_heap_registry.h"
+#include "omx_display_sink.h"
+#include "video_post_stats.h"
+#include "duplicate_frame_filter.h"
+#include "pmem_frame_writer.h"
+#include "row_band_pipeline.h"
+#include "frame_capture.h"
+#include "frame_trace.h"
+#include "quality_ladder.h"
+#include "video_output_manager.h"
+#include "frame_slot_heap.h"
+#include "frame_deinterlacer.h"
+#include "yuv_rgb_convert.h"
+#include "published_state.h"
+
+/*
+ * What the MSM video outputs have in common: statistics, the software
+ * frame slots and their trimming, row bands, capture and the frame paths
+ * that only differ in where a frame is posted.
+ *
+ * Platform is the MIO deriving from this (AndroidSurfaceOutputMsm72xx,
+ * AndroidSurfaceOutputMsm7x30).  It provides
+ *
+ *   static const char* const kName;      prefix of the statistics
+ *   typedef ... SlotSink;                where the software slots go
+ *   struct Display;                      its part of an OutputState
+ *   bool buildState(OutputState&, const OutputState* current);
+ *   bool attachState(OutputState&);      whatever the display needs first
+ *   FrameHandler selectFrameHandler(const OutputState&);
+ *   void registerSlots();                hands a new slot heap to the display
+ *   void applyQualityLevel(int level);
+ *
+ * and makes this class a friend.  It may also hide the hooks below that
+ * do nothing here.
+ *
+ * A configuration of the output is an OutputState, built by initCheck on
+ * the caller's thread while frames still go to the one before, and
+ * published whole.  Nothing in it changes once published.  writeFrameBuf
+ * moves to the one published last at the start of a frame and calls the
+ * handler picked for it, instantiated for the sink and pixel format; it
+ * does not look at iVideo* or the display path itself.  Only when the
+ * new configuration has to attach something the old one holds (the one
+ * overlay pipe, the SurfaceFlinger buffers of a surface) is nothing
+ * published in between, for as long as the swap takes; the platform may
+ * leave the frame on screen showing until the new display takes over.
+ */
+template <class Platform>
+class MsmSurfaceOutput : public AndroidSurfaceOutput, public RowBandPipeline::Sink,
+        public VideoOutputManager::Trimmer
+{
+public:
+    // frame buffer interface
+    virtual bool initCheck();
+    virtual void closeFrameBuf();
+    virtual PVMFStatus writeFrameBuf(uint8* aData, uint32 aDataLen, const PvmiMediaXferHeader& data_header_info);
+
+    // skipping of software frames identical to the one on screen
+    void setDuplicateFrameSkip(bool enable) { mDuplicateFilter.setEnabled(enable); }
+    unsigned long getSkippedFrames() const { return mDuplicateFilter.skipped(); }
+
+    // row-band delivery for low latency software decoders
+    bool beginBandFrame(const uint8* frame);
+    void bandRowsDecoded(int rows);
+
+protected:
+    MsmSurfaceOutput();
+
+    // frames are posted to SurfaceFlinger or queued to the overlay; the
+    // decoder heaps of each are mapped with the caching the display needs
+    struct SurfaceSink {
+        static const uint32_t kHeapFlagsMask = MemoryHeapBase::NO_CACHING;
+        static void post(Platform* out, size_t offset) { out->mSurface->postBuffer(offset); }
+    };
+    struct OverlaySink {
+        static const uint32_t kHeapFlagsMask = 0;
+        static void post(Platform* out, size_t offset) { out->mFrameState->display.overlay->queueBuffer((void*)offset); }
+    };
+
+    // decoder output layouts: software decoders give planar I420, hardware
+    // ones semi-planar with a w x h/2 chroma plane
+    struct I420Layout {
+        static const bool kPlanar = true;
+    };
+    struct Nv21Layout {
+        static const bool kPlanar = false;
+    };
+
+    typedef PVMFStatus (Platform::*FrameHandler)(uint8* aData, const PvmiMediaXferHeader& header);
+
+    // one configuration; the frame path keeps its running state (slot
+    // index, registered heap, ladder level) next to it, not in it
+    struct OutputState : public LightRefBase<OutputState> {
+        OutputState();
+        ~OutputState();
+
+        // software slots, when slotsWanted is not 0
+        void configureSlots(const char* device, size_t size, uint32_t flags, int wanted);
+        size_t frameBytes() const { return (width * height * 3) / 2; }
+
+        FrameHandler                handler;
+        PVMFFormatType              subFormat;
+        int                         width;
+        int                         height;
+        int                         displayWidth;
+        int                         displayHeight;
+        bool                        hardwareCodec;
+        const char*                 slotDevice;
+        size_t                      slotSize;
+        uint32_t                    slotFlags;
+        int                         slotsWanted;
+        // made progressive into the slots, see persist.pv.deinterlace
+        FrameDeinterlacer*          deinterlacer;
+        // what persist.pv.capture gets
+        int                         captureFormat;
+        int                         captureWidth;
+        int                         captureHeight;
+        typename Platform::Display  display;
+    };
+    typedef typename PublishedState<OutputState>::Reader StateReader;
+
+    // software frames converted into the slots
+    template <class Sink>
+    PVMFStatus writeConvertedFrame(uint8* aData, const PvmiMediaXferHeader& header);
+    // interlaced hardware frames made progressive into the slots
+    template <class Sink>
+    PVMFStatus writeDeinterlacedFrame(uint8* aData, const PvmiMediaXferHeader& header);
+
+    // the decoder heap a hardware frame is in, NULL if there is none
+    template <class Sink>
+    sp<MemoryHeapPmem> decoderHeap(const PvmiMediaXferHeader& header, PlatformPrivateInfo* info, bool* isNew);
+    // the end of a frame that reached the display
+    PVMFStatus framePosted();
+    // true when aData went out through the row bands
+    bool bandFramePosted(const uint8* aData);
+
+    // mState is what initCheck published last, mFrameState what the frame
+    // path runs on; they differ until the next frame.  mStateLock keeps
+    // one initCheck or closeFrameBuf at a time.
+    PublishedState<OutputState> mState;
+    sp<OutputState>             mFrameState;
+    android::Mutex              mStateLock;
+
+    // the frame path's side of a swap; caller is in a StateReader
+    bool adoptState(OutputState* state);
+    // the writer's side when nothing can be published in between;
+    // replacing when a new configuration is attached right after
+    void retireState(bool replacing = false);
+    void releaseTunnelSink();
+    void closeOutput();
+    void resetFrameState();
+    void releaseReservations();
+    // the end of the destructor, which detaches before the platform goes away
+    void shutdownOutput();
+
+    // hooks a platform may hide: whether the display of current has to
+    // be let go before state is attached, and whether the frame path can
+    // move between the two without starting over
+    bool replacesDisplay(const OutputState& current, const OutputState& state) { return false; }
+    bool keepsFrameState(const OutputState& current, const OutputState& state) { return false; }
+    // caller holds mFrameLock with nothing published; the frame path may
+    // still be on an older configuration than the one published last.
+    // replacing: attachState follows, the display may keep showing the
+    // frame on screen until then.
+    void detachState(const OutputState* published, const OutputState* adopted, bool replacing) {}
+    // the frame path moves to state; caller holds mFrameLock
+    void adoptDisplay(const OutputState& state) {}
+
+    // hardware frame buffer support; mHeapKey is the decoder heap the
+    // display is pointed at
+    uint32                      mOffset;
+    PmemHeapRegistry            mHeaps;
+    uint32                      mHeapKey;
+
+    // display sink a hardware decoder can be tunneled to, through
+    // getVideoMioTunnelSink
+    bool                        mTunnelEnabled;
+    OmxDisplaySink*             mTunnelSink;
+
+    //Average FPS profiling
+    virtual void AverageFPSProfiling();
+    virtual void AverageFPSPrint();
+    bool                        mStatistics;
+    int                         mLastFrame;
+    float                       mFpsSum;
+    unsigned long               iFrameNumber;
+    unsigned long               mNumFpsSamples;
+    nsecs_t                     mLastFpsTime;
+    VideoPostStats              mPostStats;
+    DuplicateFrameFilter        mDuplicateFilter;
+    // software frames go through a kernel matched to the heap's cache mode
+    PmemFrameWriter             mFrameWriter;
+
+    // started by the first beginBandFrame, mFrameLock guards the slot index
+    // against the decoder thread
+    RowBandPipeline*            mBandPipeline;
+    android::Mutex              mFrameLock;
+    // band frames the duplicate filter has been told about
+    unsigned long               mBandFrames;
+
+    // software frames are converted at the level the ladder picks;
+    // mOutputLevel is what the display is currently set up for
+    void writeSoftwareFrame(const uint8* aData, int index);
+    QualityLadder               mLadder;
+    int                         mOutputLevel;
+    uint32                      mSlotUses[kBufferCount];
+
+    // this output's share of the process-wide pmem and overlays; a
+    // secondary stream may run with fewer than kBufferCount frame buffers.
+    // The reservations follow the configuration being built, the pmem of
+    // the old one goes with the first frame of the new.
+    int                         mStream;
+    int                         mBufferCount;
+
+    // NV21 slots of the software path, allocated by the first frame that
+    // needs them; mBufferCount follows what is resident.  Idle streams
+    // give back all but the slot on screen when another one is short.
+    bool ensureSlots();
+    bool resizeSlots(int count);
+    bool bandsIdle();
+    virtual bool trimSlots();
+    FrameSlotHeap               mSlots;
+    int                         mSlotsWanted;
+    int                         mRegrowWait;
+    nsecs_t                     mLastFrameTime;
+
+    // copies of the posted frames, when persist.pv.capture is set; opened
+    // by the frame path for the configuration it moves to
+    void captureFrame(const void* base, size_t offset);
+    FrameCapture*               mCapture;
+    int64_t                     mCaptureTimestamp;
+
+    // what reached writeFrameBuf and when, when persist.pv.trace is set
+    FrameTraceRecorder*         mTrace;
+
+private:
+    Platform* platform() { return static_cast<Platform*>(this); }
+
+    // an output that has not had a frame for this long gives its spare
+    // slots to a stream that is short of pmem
+    static const nsecs_t kTrimIdleTime = 1000000000LL;
+    // frames between attempts to grow back after the budget said no
+    static const int kRegrowFrames = 30;
+};
+
+template <class Platform>
+MsmSurfaceOutput<Platform>::MsmSurfaceOutput() :
+    AndroidSurfaceOutput()
+{
+    mOffset = 0;
+    mHeapKey = 0;
+    mTunnelSink = NULL;
+    mBandPipeline = NULL;
+    mBandFrames = 0;
+    mCapture = NULL;
+    mCaptureTimestamp = 0;
+    mTrace = FrameTraceRecorder::create();
+    mOutputLevel = QualityLadder::LEVEL_FULL;
+    mStream = VideoOutputManager::instance()->attach(this);
+    mBufferCount = kBufferCount;
+    mSlotsWanted = 0;
+    mRegrowWait = 0;
+    mLastFrameTime = 0;
+
+    //Statistics profiling
+    char value[PROPERTY_VALUE_MAX];
+    mStatistics = false;
+    mLastFrame = 0;
+    mLastFpsTime = 0;
+    mFpsSum = 0;
+    iFrameNumber = 0;
+    mNumFpsSamples = 0;
+    property_get("persist.debug.pv.statistics", value, "0");
+    if(atoi(value)) mStatistics = true;
+
+    // let a hardware decoder feed the display directly
+    property_get("persist.pv.tunnel", value, "0");
+    mTunnelEnabled = atoi(value) ? true : false;
+}
+
+template <class Platform>
+PVMFStatus MsmSurfaceOutput<Platform>::writeFrameBuf(uint8* aData, uint32 aDataLen, const PvmiMediaXferHeader& data_header_info)
+{
+    // as the decoder delivered it, before anything is decided
+    if (mTrace != NULL) {
+        mTrace->format(iVideoSubFormat.getMIMEStrPtr(), iVideoWidth, iVideoHeight,
+                       iVideoDisplayWidth, iVideoDisplayHeight, mNumberOfFramesToHold);
+        mTrace->frame(data_header_info.timestamp, aDataLen, data_header_info.private_data_ptr);
+    }
+
+    // OK to drop frames if no surface, or while nothing is published; a
+    // configuration being built does not hold them up, they go to the one
+    // before until it is published
+    StateReader reader(mState);
+    if ((mSurface == 0) || !adoptState(reader.get())) return PVMFSuccess;
+    // a software frame from a decoder already at a larger size than the
+    // output is configured for has to wait for initCheck
+    if (!mFrameState->hardwareCodec && (aDataLen < mFrameState->frameBytes())) return PVMFSuccess;
+
+    if(mStatistics) mPostStats.begin();
+    mCaptureTimestamp = data_header_info.timestamp;
+    return (platform()->*mFrameState->handler)(aData, data_header_info);
+}
+
+template <class Platform>
+MsmSurfaceOutput<Platform>::OutputState::OutputState() :
+    handler(NULL),
+    width(0),
+    height(0),
+    displayWidth(0),
+    displayHeight(0),
+    hardwareCodec(false),
+    slotDevice(NULL),
+    slotSize(0),
+    slotFlags(0),
+    slotsWanted(0),
+    deinterlacer(NULL),
+    captureFormat(CAPTURE_FORMAT_NV21),
+    captureWidth(0),
+    captureHeight(0)
+{
+}
+
+// the last holder of a configuration may be either thread
+template <class Platform>
+MsmSurfaceOutput<Platform>::OutputState::~OutputState()
+{
+    delete deinterlacer;
+}
+
+template <class Platform>
+void MsmSurfaceOutput<Platform>::OutputState::configureSlots(const char* device, size_t size,
+        uint32_t flags, int wanted)
+{
+    slotDevice = device;
+    slotSize = size;
+    slotFlags = flags;
+    slotsWanted = wanted;
+}
+
+// builds the configuration iVideo* describe, see OutputState
+template <class Platform>
+bool MsmSurfaceOutput<Platform>::initCheck()
+{
+    // initialize only when we have all the required parameters
+    if (((iVideoParameterFlags & VIDEO_SUBFORMAT_VALID) == 0) || !checkVideoParameterFlags())
+        return mInitialized;
+
+    // reset flags in case display format changes in the middle of a stream
+    resetVideoParameterFlags();
+
+    Mutex::Autolock stateLock(mStateLock);
+    sp<OutputState> current = mState.current();
+    sp<OutputState> state = new OutputState();
+    state->subFormat = iVideoSubFormat;
+    state->width = iVideoWidth;
+    state->height = iVideoHeight;
+    state->displayWidth = iVideoDisplayWidth;
+    state->displayHeight = iVideoDisplayHeight;
+    state->captureWidth = iVideoWidth;
+    state->captureHeight = iVideoHeight;
+    LOGV("building %d x %d (display %d x %d)", iVideoWidth, iVideoHeight, iVideoDisplayWidth, iVideoDisplayHeight);
+    bool built = platform()->buildState(*state, current.get());
+
+    // the tunnel sink programs the display itself
+    bool tunneled;
+    {
+        Mutex::Autolock lock(mFrameLock);
+        tunneled = (mTunnelSink != NULL);
+    }
+    // the tunnel sink's frames go with it, there is nothing to keep on screen
+    if ((current != 0) && (!built || tunneled || platform()->replacesDisplay(*current, *state)))
+        retireState(built && !tunneled);
+    if (built) built = platform()->attachState(*state);
+    if (!built) {
+        retireState();
+        releaseReservations();
+        mInitialized = false;
+        return false;
+    }
+    state->handler = platform()->selectFrameHandler(*state);
+
+    mState.publish(state);
+    mInitialized = true;
+    LOGV("sendEvent(MEDIA_SET_VIDEO_SIZE, %d, %d)", state->displayWidth, state->displayHeight);
+    mPvPlayer->sendEvent(MEDIA_SET_VIDEO_SIZE, state->displayWidth, state->displayHeight);
+    return true;
+}
+
+template <class Platform>
+void MsmSurfaceOutput<Platform>::closeFrameBuf()
+{
+    LOGV("closeFrameBuf");
+    Mutex::Autolock stateLock(mStateLock);
+    retireState();
+    releaseReservations();
+    mInitialized = false;
+}
+
+// caller is in a StateReader of mState; false when nothing is published
+template <class Platform>
+bool MsmSurfaceOutput<Platform>::adoptState(OutputState* state)
+{
+    if (state == NULL) return false;
+    // unlocked: retireState clears mFrameState only with nothing published
+    if (state == mFrameState.get()) return true;
+
+    Mutex::Autolock lock(mFrameLock);
+    bool keep = (mFrameState != 0) && platform()->keepsFrameState(*mFrameState, *state);
+    if (!keep) closeOutput();
+    mFrameState = state;
+    if (keep) return true;
+
+    resetFrameState();
+    mSlotsWanted = state->slotsWanted;
+    if (mSlotsWanted > 0) mSlots.configure(state->slotDevice, state->slotSize, state->slotFlags);
+    mBufferCount = kBufferCount;
+    mFrameBufferIndex = 0;
+    mRegrowWait = 0;
+    mLastFrameTime = 0;
+    mOffset = 0;
+    mCapture = FrameCapture::create(state->captureFormat, state->captureWidth, state->captureHeight);
+    platform()->adoptDisplay(*state);
+    LOGV("frames go to the %d x %d configuration", state->width, state->height);
+    return true;
+}
+
+// unpublishes the configuration and stops the frame paths ahead of the
+// display they post to; caller holds mStateLock
+template <class Platform>
+void MsmSurfaceOutput<Platform>::retireState(bool replacing)
+{
+    sp<OutputState> published = mState.current();
+    // returns once the frames in flight are done with it
+    mState.publish(NULL);
+
+    if (mStatistics) {
+        Mutex::Autolock lock(mFrameLock);
+        if (mTunnelSink != NULL) {
+            char name[64];
+            snprintf(name, sizeof(name), "%s (tunneled)", Platform::kName);
+            mTunnelSink->printStatistics(name);
+        }
+    }
+    releaseTunnelSink();
+
+    Mutex::Autolock lock(mFrameLock);
+    closeOutput();
+    platform()->detachState(published.get(), mFrameState.get(), replacing);
+    mFrameState.clear();
+}
+
+// the tunnel comes down before the display the sink posts to; it waits
+// for the decoder, so not under mFrameLock
+template <class Platform>
+void MsmSurfaceOutput<Platform>::releaseTunnelSink()
+{
+    OmxDisplaySink* sink;
+    {
+        Mutex::Autolock lock(mFrameLock);
+        sink = mTunnelSink;
+        mTunnelSink = NULL;
+    }
+    if ((sink != NULL) && !sink->release())
+        LOGE("%s: tunnel sink left allocated, the decoder still holds its buffers", Platform::kName);
+}
+
+template <class Platform>
+PVMFStatus MsmSurfaceOutput<Platform>::framePosted()
+{
+    //Average FPS profiling
+    if(mStatistics) {
+        mPostStats.end();
+        AverageFPSProfiling();
+    }
+    return PVMFSuccess;
+}
+
+// a band frame is posted by the band thread, and one the player dropped
+// never reaches writeFrameBuf at all; either way the duplicate filter no
+// longer knows what is on screen
+template <class Platform>
+bool MsmSurfaceOutput<Platform>::bandFramePosted(const uint8* aData)
+{
+    if (mBandPipeline == NULL) return false;
+    bool banded = mBandPipeline->finishFrame(aData);
+    if (mBandPipeline->frames() != mBandFrames) {
+        mBandFrames = mBandPipeline->frames();
+        mDuplicateFilter.reset();
+    }
+    return banded;
+}
+
+template <class Platform> template <class Sink>
+PVMFStatus MsmSurfaceOutput<Platform>::writeConvertedFrame(uint8* aData, const PvmiMediaXferHeader& header)
+{
+    // converted and posted band by band while it was being decoded
+    if (bandFramePosted(aData))
+        return framePosted();
+
+    // decimated by the quality ladder
+    if (!mLadder.beginFrame(header.timestamp))
+        return PVMFSuccess;
+    // a frame identical to the one on screen is neither converted nor
+    // posted (U and V planes are h/2 rows of w/2 each); the check is what
+    // the frame cost the ladder
+    const OutputState& state = *mFrameState;
+    if (mDuplicateFilter.isDuplicate(aData, state.width, state.height, state.width / 2, state.height)) {
+        mLadder.endFrame();
+        return PVMFSuccess;
+    }
+    {
+        Mutex::Autolock lock(mFrameLock);
+        if (!ensureSlots()) return PVMFFailure;
+        if (++mFrameBufferIndex == mBufferCount) mFrameBufferIndex = 0;
+        writeSoftwareFrame(aData, mFrameBufferIndex);
+        mLadder.endFrame();
+        Sink::post(platform(), mFrameBuffers[mFrameBufferIndex]);
+        mDuplicateFilter.posted();
+        mLastFrameTime = systemTime();
+        captureFrame(mBufferHeap.heap->base(), mFrameBuffers[mFrameBufferIndex]);
+    }
+    return framePosted();
+}
+
+template <class Platform> template <class Sink>
+PVMFStatus MsmSurfaceOutput<Platform>::writeDeinterlacedFrame(uint8* aData, const PvmiMediaXferHeader& header)
+{
+    PlatformPrivateInfo info;
+    bool isNew;
+    sp<MemoryHeapPmem> heap = decoderHeap<Sink>(header, &info, &isNew);
+    if (heap == 0) return PVMFFailure;
+    {
+        // a progressive copy in the slots is posted, not the decoder buffer
+        Mutex::Autolock lock(mFrameLock);
+        if (!ensureSlots()) return PVMFFailure;
+        mOffset = info.offset;
+        if (++mFrameBufferIndex == mBufferCount) mFrameBufferIndex = 0;
+        size_t offset = mFrameBuffers[mFrameBufferIndex];
+        mFrameState->deinterlacer->process(static_cast<const uint8*>(heap->base()) + info.offset,
+                               static_cast<uint8*>(mSlots.base()) + offset);
+        mFrameWriter.finishWrite(offset, mSlots.frameSize());
+        Sink::post(platform(), offset);
+        mLastFrameTime = systemTime();
+        captureFrame(mBufferHeap.heap->base(), offset);
+    }
+    return framePosted();
+}
+
+template <class Platform> template <class Sink>
+sp<MemoryHeapPmem> MsmSurfaceOutput<Platform>::decoderHeap(const PvmiMediaXferHeader& header,
+        PlatformPrivateInfo* info, bool* isNew)
+{
+    if (!decodePlatformPrivate(header.private_data_ptr, info)) {
+        LOGE("Error getting pmem heap from private_data_ptr");
+        return NULL;
+    }
+    sp<MemoryHeapPmem> heap = mHeaps.lookup(info->heapKey, Sink::kHeapFlagsMask, isNew);
+    if (heap == 0) LOGE("No pmem heap in private_data_ptr");
+    return heap;
+}
+
+// the frame path lets go of the configuration it was on; the display
+// keeps what it was last given until the next one is attached.  Caller
+// holds mFrameLock.
+template <class Platform>
+void MsmSurfaceOutput<Platform>::closeOutput()
+{
+    // finishes the band thread before its slots go away
+    delete mBandPipeline;
+    mBandPipeline = NULL;
+    mBandFrames = 0;
+    if (mStatistics && (mCapture != NULL)) mCapture->print(Platform::kName);
+    delete mCapture;
+    mCapture = NULL;
+    if (mStatistics && (mFrameState != 0) && (mFrameState->deinterlacer != NULL))
+        mFrameState->deinterlacer->print(Platform::kName);
+    mSlots.release();
+    mHeaps.clear();
+    mHeapKey = 0;
+}
+
+// reset in case display format changes in the middle of a stream
+template <class Platform>
+void MsmSurfaceOutput<Platform>::resetFrameState()
+{
+    mDuplicateFilter.reset();
+    mLadder.reset(QualityLadder::LEVEL_DECIMATE);
+    mOutputLevel = QualityLadder::LEVEL_FULL;
+    mSlotsWanted = 0;
+}
+
+// once nothing is published
+template <class Platform>
+void MsmSurfaceOutput<Platform>::releaseReservations()
+{
+    VideoOutputManager::instance()->releaseBuffers(mStream);
+    VideoOutputManager::instance()->releaseOverlay(mStream);
+}
+
+template <class Platform>
+void MsmSurfaceOutput<Platform>::shutdownOutput()
+{
+    if(mStatistics) AverageFPSPrint();
+    // no trimSlots() from other streams after this
+    VideoOutputManager::instance()->detach(mStream);
+    releaseTunnelSink();
+    delete mBandPipeline;
+    mBandPipeline = NULL;
+    delete mCapture;
+    mCapture = NULL;
+    // nothing reads the configurations after this
+    mState.publish(NULL);
+    mFrameState.clear();
+    delete mTrace;
+    mTrace = NULL;
+}
+
+// the decoder is about to produce frame; pick its slot and start converting
+// bands as they are reported.  Only for software decoders.
+template <class Platform>
+bool MsmSurfaceOutput<Platform>::beginBandFrame(const uint8* frame)
+{
+    StateReader reader(mState);
+    if ((reader.get() == NULL) || reader.get()->hardwareCodec || (mSurface == 0)) return false;
+
+    Mutex::Autolock lock(mFrameLock);
+    // the first frame of a new configuration goes through writeFrameBuf
+    if (reader.get() != mFrameState.get()) return false;
+    if (mBandPipeline == NULL) {
+        mBandPipeline = new RowBandPipeline(this);
+        if (!mBandPipeline->start()) {
+            delete mBandPipeline;
+            mBandPipeline = NULL;
+            return false;
+        }
+    }
+
+    // bands are always full size, a degraded stream takes the whole-frame path
+    if (mOutputLevel != QualityLadder::LEVEL_FULL) return false;
+    if (!ensureSlots()) return false;
+    if (++mFrameBufferIndex == mBufferCount) mFrameBufferIndex = 0;
+    mBandPipeline->beginFrame(frame, mFrameBuffers[mFrameBufferIndex], mFrameState->height);
+    mLastFrameTime = systemTime();
+    return true;
+}
+
+template <class Platform>
+void MsmSurfaceOutput<Platform>::bandRowsDecoded(int rows)
+{
+    // closeOutput deletes the pipeline under mFrameLock; rowsDecoded only
+    // signals the band thread, which converts without mFrameLock
+    Mutex::Autolock lock(mFrameLock);
+    if (mBandPipeline != NULL) mBandPipeline->rowsDecoded(rows);
+}
+
+// caller holds mFrameLock
+template <class Platform>
+void MsmSurfaceOutput<Platform>::writeSoftwareFrame(const uint8* aData, int index)
+{
+    int level = mLadder.level();
+    if (level != mOutputLevel) platform()->applyQualityLevel(level);
+
+    size_t offset = mFrameBuffers[index];
+    int width = mFrameState->width;
+    int height = mFrameState->height;
+    if (level >= QualityLadder::LEVEL_HALF_SIZE) {
+        mFrameWriter.writeI420AsNv21Half(aData, offset, width, height);
+    } else if ((level == QualityLadder::LEVEL_CHROMA_REUSE) && (mSlotUses[index]++ & 1)) {
+        // every other use of a slot keeps the chroma it was last given
+        mFrameWriter.writeI420Luma(aData, offset, width, height);
+    } else {
+        mFrameWriter.writeI420AsNv21(aData, offset, width, height);
+    }
+}
+
+// allocates the slots for the first frame and grows them back after a
+// trim; caller holds mFrameLock
+template <class Platform>
+bool MsmSurfaceOutput<Platform>::ensureSlots()
+{
+    int have = mSlots.count();
+    if (have >= mSlotsWanted) return true;
+    // the band thread may still write into the current heap, and a grow
+    // the budget refused is not asked for again on every frame
+    if ((have > 0) && (!bandsIdle() || (++mRegrowWait < kRegrowFrames))) return true;
+    mRegrowWait = 0;
+
+    int count = VideoOutputManager::instance()->reserveBuffers(mStream, mSlots.frameSize(),
+            mSlotsWanted, (have > 0) ? have : 1);
+    if (count == 0) {
+        LOGE("No pmem left for the frame buffer heap");
+        return false;
+    }
+    if (count == have) return true;
+    return resizeSlots(count);
+}
+
+// caller holds mFrameLock and has reserved count slots
+template <class Platform>
+bool MsmSurfaceOutput<Platform>::resizeSlots(int count)
+{
+    // the display keeps the old heap until it is given the new one and
+    // the frame on screen is posted again from there
+    sp<MemoryHeapPmem> old = mSlots.heap();
+    int have = mSlots.count();
+    int slot = mSlots.resize(count, (old != 0) ? mFrameBufferIndex : -1);
+    if (slot < 0) {
+        if (have > 0) {
+            VideoOutputManager::instance()->reserveBuffers(mStream, mSlots.frameSize(), have, have);
+        } else {
+            VideoOutputManager::instance()->releaseBuffers(mStream);
+        }
+        return have > 0;
+    }
+
+    mFrameWriter.init(mSlots.masterFlags(), mSlots.masterFd(), mSlots.base());
+    for (int i = 0; i < count; i++) {
+        mFrameBuffers[i] = mSlots.offset(i);
+    }
+    mBufferCount = count;
+    mFrameBufferIndex = slot;
+    for (int i = 0; i < kBufferCount; i++) mSlotUses[i] = 0;
+
+    platform()->registerSlots();
+    if (old != 0) {
+        mFrameWriter.finishWrite(mFrameBuffers[slot], mSlots.frameSize());
+        Platform::SlotSink::post(platform(), mFrameBuffers[slot]);
+    }
+    VideoOutputManager::instance()->setResident(mStream, mSlots.residentBytes());
+    LOGV("%d frame buffer slot(s) resident", count);
+    return true;
+}
+
+template <class Platform>
+bool MsmSurfaceOutput<Platform>::bandsIdle()
+{
+    return (mBandPipeline == NULL) || mBandPipeline->idle();
+}
+
+// another stream is short of pmem
+template <class Platform>
+bool MsmSurfaceOutput<Platform>::trimSlots()
+{
+    // a stream in the middle of a frame is not idle
+    if (mFrameLock.tryLock() != NO_ERROR) return false;
+
+    bool trimmed = false;
+    if ((mFrameState != 0) && (mSlotsWanted > 0) && bandsIdle() &&
+        (systemTime() - mLastFrameTime > kTrimIdleTime)) {
+        if (mSlots.count() == 0) {
+            // configured but never played, the first frame reserves again
+            VideoOutputManager::instance()->releaseBuffers(mStream);
+            trimmed = true;
+        } else if ((mSlots.count() > 1) && resizeSlots(1)) {
+            VideoOutputManager::instance()->reserveBuffers(mStream, mSlots.frameSize(), 1, 1);
+            mRegrowWait = kRegrowFrames;
+            trimmed = true;
+        }
+    }
+    mFrameLock.unlock();
+    return trimmed;
+}
+
+template <class Platform>
+void MsmSurfaceOutput<Platform>::captureFrame(const void* base, size_t offset)
+{
+    if ((mCapture != NULL) && (base != NULL))
+        mCapture->capture(static_cast<const uint8*>(base) + offset, mCaptureTimestamp);
+}
+
+template <class Platform>
+void MsmSurfaceOutput<Platform>::AverageFPSProfiling()
+{
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t diff = now - mLastFpsTime;
+    iFrameNumber++;
+
+    if (diff > ms2ns(250)) {
+        float mFps =  ((iFrameNumber - mLastFrame) * float(s2ns(1))) / diff;
+        LOGE("%s: Frames Per Second: %.4f", Platform::kName, mFps);
+        mFpsSum += mFps;
+        mNumFpsSamples++;
+        mLastFpsTime = now;
+        mLastFrame = iFrameNumber;
+    }
+}
+
+template <class Platform>
+void MsmSurfaceOutput<Platform>::AverageFPSPrint()
+{
+    const char* name = Platform::kName;
+    LOGE("==========================================================");
+    LOGE("%s: Average Frames Per Second: %.4f", name, mFpsSum / mNumFpsSamples);
+    mPostStats.print(name);
+    mDuplicateFilter.print(name);
+    mLadder.print(name);
+    VideoOutputManager::instance()->print(name);
+    if (mHeaps.heapsSeen() > 0)
+        LOGE("%s: frames came from %lu decoder heap(s)", name, mHeaps.heapsSeen());
+    if (mSlots.resizes() > 0)
+        LOGE("%s: %d of %d frame buffer slot(s) resident (%u bytes), %lu resizes",
+             name, mSlots.count(), mSlotsWanted, (unsigned)mSlots.residentBytes(), mSlots.resizes());
+    if (mBandPipeline != NULL)
+        LOGE("%s: %lu frames posted from %lu bands", name, mBandPipeline->frames(), mBandPipeline->bands());
+    if (mTunnelSink != NULL) {
+        char tunneled[64];
+        snprintf(tunneled, sizeof(tunneled), "%s (tunneled)", name);
+        mTunnelSink->printStatistics(tunneled);
+    }
+    if (mCapture != NULL) mCapture->print(name);
+    if ((mFrameState != 0) && (mFrameState->deinterlacer != NULL)) mFrameState->deinterlacer->print(name);
+    if (mTrace != NULL) mTrace->print(name);
+    LOGE("==========================================================");
+}
+
+#endif // MSM_SURFACE_OUTPUT_H_INCLUDED
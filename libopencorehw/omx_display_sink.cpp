@@ -0,0 +1,667 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "OmxDisplaySink"
+#include <utils/Log.h>
+
+#include "omx_display_sink.h"
+
+#include <string.h>
+
+using namespace android;
+
+#define OMX_DISPLAY_SINK_NAME       "OMX.qcom.display.sink"
+#define OMX_DISPLAY_SINK_ROLE       "iv_renderer.yuv.overlay"
+#define OMX_DISPLAY_SINK_VERSION    0x00000101
+
+// pmem allocations are page granular
+#define PMEM_ALIGN(x)               (((x) + 4095) & ~4095)
+
+static const char* pmem_adsp = "/dev/pmem_adsp";
+static const char* pmem = "/dev/pmem";
+
+template<class T>
+static inline void initOmxStruct(T* s)
+{
+    memset(s, 0, sizeof(T));
+    s->nSize = sizeof(T);
+    s->nVersion.nVersion = OMX_DISPLAY_SINK_VERSION;
+}
+
+OmxDisplaySink::OmxDisplaySink(const sp<ISurface>& surface, const sp<Overlay>& overlay,
+                               int displayWidth, int displayHeight, int frameWidth, int frameHeight,
+                               int halFormat, int framesToHold) :
+    mAppData(NULL),
+    mState(OMX_StateLoaded),
+    mPeer(NULL),
+    mPeerPort(0),
+    mSurface(surface),
+    mOverlay(overlay),
+    mDisplayWidth(displayWidth),
+    mDisplayHeight(displayHeight),
+    mHalFormat(halFormat),
+    mHeapBase(NULL),
+    mNumBuffers(0),
+    mNumHeld(0),
+    mFramesToHold(framesToHold > 0 ? framesToHold : 1),
+    mBuffersWithPeer(0),
+    mLastOffset(-1),
+    mPendingIdle(false),
+    mRefilling(0),
+    mReleasing(false)
+{
+    memset(&mCallbacks, 0, sizeof(mCallbacks));
+
+    initOmxStruct(&mPort);
+    mPort.nPortIndex = kInputPort;
+    mPort.eDir = OMX_DirInput;
+    mPort.nBufferCountMin = mFramesToHold + 1;
+    mPort.nBufferCountActual = mPort.nBufferCountMin;
+    mPort.nBufferSize = (frameWidth * frameHeight * 3) / 2;
+    mPort.bEnabled = OMX_TRUE;
+    mPort.bPopulated = OMX_FALSE;
+    mPort.eDomain = OMX_PortDomainVideo;
+    mPort.format.video.nFrameWidth = frameWidth;
+    mPort.format.video.nFrameHeight = frameHeight;
+    mPort.format.video.nStride = frameWidth;
+    mPort.format.video.nSliceHeight = frameHeight;
+    mPort.format.video.eCompressionFormat = OMX_VIDEO_CodingUnused;
+    mPort.format.video.eColorFormat = OMX_COLOR_FormatYUV420SemiPlanar;
+    mPort.bBuffersContiguous = OMX_TRUE;
+    mPort.nBufferAlignment = 4096;
+
+    initOmxStruct(&mComponent);
+    mComponent.pComponentPrivate = this;
+    mComponent.GetComponentVersion = GetComponentVersion;
+    mComponent.SendCommand = SendCommand;
+    mComponent.GetParameter = GetParameter;
+    mComponent.SetParameter = SetParameter;
+    mComponent.GetConfig = GetConfig;
+    mComponent.SetConfig = SetConfig;
+    mComponent.GetExtensionIndex = GetExtensionIndex;
+    mComponent.GetState = GetState;
+    mComponent.ComponentTunnelRequest = ComponentTunnelRequest;
+    mComponent.UseBuffer = UseBuffer;
+    mComponent.AllocateBuffer = AllocateBuffer;
+    mComponent.FreeBuffer = FreeBuffer;
+    mComponent.EmptyThisBuffer = EmptyThisBuffer;
+    mComponent.FillThisBuffer = FillThisBuffer;
+    mComponent.SetCallbacks = SetCallbacks;
+    mComponent.ComponentDeInit = ComponentDeInit;
+    mComponent.UseEGLImage = UseEGLImage;
+    mComponent.ComponentRoleEnum = ComponentRoleEnum;
+}
+
+// only from release(), with the buffers freed and the tunnel down
+OmxDisplaySink::~OmxDisplaySink()
+{
+}
+
+bool OmxDisplaySink::release()
+{
+    OMX_HANDLETYPE peer;
+    OMX_U32 peerPort;
+    bool flush;
+    {
+        Mutex::Autolock l(mLock);
+        // nothing reaches the display or goes back to the decoder from now
+        mReleasing = true;
+        if ((mState == OMX_StateExecuting) || (mState == OMX_StatePause)) {
+            mNumHeld = 0;
+            mState = OMX_StateIdle;
+        }
+        while (mRefilling) mReturned.wait(mLock);
+        peer = mPeer;
+        peerPort = mPeerPort;
+        flush = (mBuffersWithPeer != 0);
+    }
+
+    // what the decoder has not filled comes back through EmptyThisBuffer
+    if (flush) OMX_SendCommand(peer, OMX_CommandFlush, peerPort, NULL);
+
+    {
+        Mutex::Autolock l(mLock);
+        nsecs_t deadline = systemTime() + kReleaseTimeout;
+        while (mBuffersWithPeer) {
+            nsecs_t left = deadline - systemTime();
+            if (left <= 0) {
+                LOGE("decoder kept %lu tunnel buffers, sink not released", mBuffersWithPeer);
+                return false;
+            }
+            mReturned.waitRelative(mLock, left);
+        }
+        mPendingIdle = false;
+        freeTunnelBuffers();
+        mState = OMX_StateLoaded;
+        mPeer = NULL;
+    }
+
+    // what OMX_SetupTunnel(peer, peerPort, NULL, 0) does, without linking
+    // the OMX core into the MIO
+    if (peer != NULL) {
+        OMX_TUNNELSETUPTYPE setup;
+        setup.nTunnelFlags = 0;
+        setup.eSupplier = OMX_BufferSupplyUnspecified;
+        OMX_ERRORTYPE err = static_cast<OMX_COMPONENTTYPE*>(peer)->ComponentTunnelRequest(peer, peerPort,
+                NULL, 0, &setup);
+        if (err != OMX_ErrorNone) LOGW("decoder did not clear its end of the tunnel: 0x%x", err);
+    }
+    delete this;
+    return true;
+}
+
+OmxDisplaySink* OmxDisplaySink::self(OMX_HANDLETYPE hComponent)
+{
+    return static_cast<OmxDisplaySink*>(static_cast<OMX_COMPONENTTYPE*>(hComponent)->pComponentPrivate);
+}
+
+bool OmxDisplaySink::isActive()
+{
+    Mutex::Autolock l(mLock);
+    return (mState == OMX_StateExecuting) || (mState == OMX_StatePause);
+}
+
+void OmxDisplaySink::postLastFrame()
+{
+    Mutex::Autolock l(mLock);
+    if (mLastOffset < 0) return;
+    if (mOverlay != 0) {
+        mOverlay->queueBuffer((void*) mLastOffset);
+    } else if (mBufferHeap.heap != 0) {
+        mSurface->postBuffer(mLastOffset);
+    }
+}
+
+void OmxDisplaySink::printStatistics(const char* name)
+{
+    Mutex::Autolock l(mLock);
+    mPostStats.print(name);
+}
+
+void OmxDisplaySink::notify(OMX_EVENTTYPE event, OMX_U32 data1, OMX_U32 data2)
+{
+    if (mCallbacks.EventHandler) {
+        mCallbacks.EventHandler(&mComponent, mAppData, event, data1, data2, NULL);
+    }
+}
+
+// allocate one pmem slot per tunnel buffer and hand them to the decoder
+OMX_ERRORTYPE OmxDisplaySink::allocateTunnelBuffers()
+{
+    if (mPeer == NULL) {
+        LOGE("no tunnel peer, cannot leave Loaded");
+        return OMX_ErrorIncorrectStateTransition;
+    }
+
+    OMX_PARAM_PORTDEFINITIONTYPE peerPort;
+    initOmxStruct(&peerPort);
+    peerPort.nPortIndex = mPeerPort;
+    OMX_ERRORTYPE err = OMX_GetParameter(mPeer, OMX_IndexParamPortDefinition, &peerPort);
+    if (err != OMX_ErrorNone) return err;
+
+    mNumBuffers = peerPort.nBufferCountActual > mPort.nBufferCountActual ?
+                  peerPort.nBufferCountActual : mPort.nBufferCountActual;
+    if (mNumBuffers > kMaxBuffers) mNumBuffers = kMaxBuffers;
+    OMX_U32 size = peerPort.nBufferSize > mPort.nBufferSize ? peerPort.nBufferSize : mPort.nBufferSize;
+    size = PMEM_ALIGN(size);
+
+    sp<MemoryHeapBase> master = new MemoryHeapBase(pmem_adsp, size * mNumBuffers);
+    if (master->heapID() < 0) {
+        LOGE("Error creating tunnel buffer heap");
+        mNumBuffers = 0;
+        return OMX_ErrorInsufficientResources;
+    }
+    master->setDevice(pmem);
+    mHeapPmem = new MemoryHeapPmem(master, 0);
+    mHeapPmem->slap();
+    master.clear();
+    mHeapBase = static_cast<uint8*>(mHeapPmem->base());
+
+    for (OMX_U32 i = 0; i < mNumBuffers; i++) {
+        mPmemInfo[i].pmem_fd = mHeapPmem->heapID();
+        mPmemInfo[i].offset = i * size;
+        err = OMX_UseBuffer(mPeer, &mBuffers[i], mPeerPort, &mPmemInfo[i], size, mHeapBase + i * size);
+        if (err != OMX_ErrorNone) {
+            LOGE("decoder rejected tunnel buffer %lu: 0x%x", i, err);
+            mNumBuffers = i;
+            freeTunnelBuffers();
+            return err;
+        }
+        mBuffers[i]->nInputPortIndex = kInputPort;
+    }
+    mPort.nBufferCountActual = mNumBuffers;
+    mPort.nBufferSize = size;
+    mPort.bPopulated = OMX_TRUE;
+
+    // register the slots with whichever display path is in use
+    if (mOverlay != 0) {
+        mOverlay->setFd(mHeapPmem->heapID());
+        mOverlay->setCrop(0, 0, mDisplayWidth, mDisplayHeight);
+    } else {
+        mBufferHeap = ISurface::BufferHeap(mDisplayWidth, mDisplayHeight,
+                mPort.format.video.nFrameWidth, mPort.format.video.nFrameHeight, mHalFormat, mHeapPmem);
+        if (mSurface->registerBuffers(mBufferHeap) != OK) {
+            LOGE("Register Buffer Failed");
+            freeTunnelBuffers();
+            return OMX_ErrorInsufficientResources;
+        }
+    }
+
+    LOGV("supplied %lu tunnel buffers of %lu bytes", mNumBuffers, size);
+    return OMX_ErrorNone;
+}
+
+void OmxDisplaySink::freeTunnelBuffers()
+{
+    for (OMX_U32 i = 0; i < mNumBuffers; i++) {
+        OMX_FreeBuffer(mPeer, mPeerPort, mBuffers[i]);
+        mBuffers[i] = NULL;
+    }
+    mNumBuffers = 0;
+    mNumHeld = 0;
+    mLastOffset = -1;
+    mPort.bPopulated = OMX_FALSE;
+
+    if (mBufferHeap.heap != 0) {
+        mSurface->unregisterBuffers();
+        mBufferHeap.heap.clear();
+    }
+    mHeapBase = NULL;
+    mHeapPmem.clear();
+}
+
+// give frames beyond the hold count back to the decoder, oldest first
+void OmxDisplaySink::trimHeldBuffers(OMX_U32 keep, Refill& refill)
+{
+    while (mNumHeld > keep) {
+        OMX_BUFFERHEADERTYPE* oldest = mHeld[0];
+        memmove(mHeld, mHeld + 1, --mNumHeld * sizeof(oldest));
+        oldest->nFilledLen = 0;
+        returnToPeer(oldest, refill);
+    }
+}
+
+// the decoder owns the buffer from here, though it only gets it in fillPeer
+void OmxDisplaySink::returnToPeer(OMX_BUFFERHEADERTYPE* pBuffer, Refill& refill)
+{
+    refill.peer = mPeer;
+    refill.buffers[refill.count++] = pBuffer;
+    mBuffersWithPeer++;
+    mRefilling++;
+}
+
+void OmxDisplaySink::fillPeer(const Refill& refill)
+{
+    if (refill.count == 0) return;
+    for (OMX_U32 i = 0; i < refill.count; i++) {
+        OMX_FillThisBuffer(refill.peer, refill.buffers[i]);
+    }
+    Mutex::Autolock l(mLock);
+    mRefilling -= refill.count;
+    if (mRefilling == 0) mReturned.broadcast();
+}
+
+// caller started mPostStats when the frame arrived
+OMX_ERRORTYPE OmxDisplaySink::queueFrame(OMX_BUFFERHEADERTYPE* pBuffer, Refill& refill)
+{
+    // the slot's offset in our own heap, no private data lookup needed
+    int32 offset = pBuffer->pBuffer - mHeapBase;
+    if (mOverlay != 0) {
+        mOverlay->queueBuffer((void*) offset);
+    } else {
+        mSurface->postBuffer(offset);
+    }
+    mLastOffset = offset;
+    mPostStats.end();
+
+    mHeld[mNumHeld++] = pBuffer;
+    trimHeldBuffers(mFramesToHold, refill);
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OmxDisplaySink::setState(OMX_STATETYPE state, Refill& refill)
+{
+    if (mReleasing) return OMX_ErrorInvalidState;
+    if (state == mState) return OMX_ErrorSameState;
+
+    switch (state) {
+    case OMX_StateIdle:
+        if (mState == OMX_StateLoaded) {
+            OMX_ERRORTYPE err = allocateTunnelBuffers();
+            if (err != OMX_ErrorNone) return err;
+        } else if (mState == OMX_StateExecuting || mState == OMX_StatePause) {
+            // buffers held for display are ours again; the rest come back
+            // from the decoder through EmptyThisBuffer as it flushes
+            mNumHeld = 0;
+            if (mBuffersWithPeer) {
+                mState = OMX_StateIdle;
+                mPendingIdle = true;
+                return OMX_ErrorNotReady;
+            }
+        } else {
+            return OMX_ErrorIncorrectStateTransition;
+        }
+        break;
+    case OMX_StateExecuting:
+        if (mState == OMX_StateIdle) {
+            // the supplier primes the tunnel with every buffer
+            for (OMX_U32 i = 0; i < mNumBuffers; i++) {
+                returnToPeer(mBuffers[i], refill);
+            }
+        } else if (mState == OMX_StatePause) {
+            trimHeldBuffers(mFramesToHold, refill);
+        } else {
+            return OMX_ErrorIncorrectStateTransition;
+        }
+        break;
+    case OMX_StatePause:
+        if (mState != OMX_StateExecuting && mState != OMX_StateIdle)
+            return OMX_ErrorIncorrectStateTransition;
+        break;
+    case OMX_StateLoaded:
+        if (mState != OMX_StateIdle || mPendingIdle) return OMX_ErrorIncorrectStateTransition;
+        freeTunnelBuffers();
+        break;
+    default:
+        return OMX_ErrorIncorrectStateTransition;
+    }
+
+    mState = state;
+    return OMX_ErrorNone;
+}
+
+/* ======================================================================
+ * component entry points
+ * ====================================================================== */
+
+OMX_ERRORTYPE OmxDisplaySink::GetComponentVersion(OMX_HANDLETYPE hComponent, OMX_STRING pComponentName,
+        OMX_VERSIONTYPE* pComponentVersion, OMX_VERSIONTYPE* pSpecVersion, OMX_UUIDTYPE* pComponentUUID)
+{
+    strncpy(pComponentName, OMX_DISPLAY_SINK_NAME, OMX_MAX_STRINGNAME_SIZE);
+    pComponentVersion->nVersion = OMX_DISPLAY_SINK_VERSION;
+    pSpecVersion->nVersion = OMX_DISPLAY_SINK_VERSION;
+    if (pComponentUUID) memset(pComponentUUID, 0, sizeof(*pComponentUUID));
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OmxDisplaySink::SendCommand(OMX_HANDLETYPE hComponent, OMX_COMMANDTYPE Cmd,
+        OMX_U32 nParam1, OMX_PTR pCmdData)
+{
+    OmxDisplaySink* sink = self(hComponent);
+    OMX_ERRORTYPE err;
+    Refill refill;
+
+    switch (Cmd) {
+    case OMX_CommandStateSet: {
+        {
+            Mutex::Autolock l(sink->mLock);
+            err = sink->setState((OMX_STATETYPE) nParam1, refill);
+        }
+        sink->fillPeer(refill);
+        if (err == OMX_ErrorNone) {
+            sink->notify(OMX_EventCmdComplete, OMX_CommandStateSet, nParam1);
+        } else if (err != OMX_ErrorNotReady) {
+            sink->notify(OMX_EventError, (OMX_U32) err, 0);
+        }
+        return OMX_ErrorNone;
+    }
+    case OMX_CommandFlush: {
+        if (nParam1 != kInputPort && nParam1 != OMX_ALL) return OMX_ErrorBadPortIndex;
+        {
+            // keep only what is on screen; everything else goes back upstream
+            Mutex::Autolock l(sink->mLock);
+            if (sink->mState == OMX_StateExecuting || sink->mState == OMX_StatePause) {
+                sink->trimHeldBuffers(sink->mFramesToHold, refill);
+            }
+        }
+        sink->fillPeer(refill);
+        sink->notify(OMX_EventCmdComplete, OMX_CommandFlush, kInputPort);
+        return OMX_ErrorNone;
+    }
+    default:
+        return OMX_ErrorNotImplemented;
+    }
+}
+
+OMX_ERRORTYPE OmxDisplaySink::GetParameter(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nParamIndex, OMX_PTR pParam)
+{
+    OmxDisplaySink* sink = self(hComponent);
+    if (pParam == NULL) return OMX_ErrorBadParameter;
+    Mutex::Autolock l(sink->mLock);
+
+    switch (nParamIndex) {
+    case OMX_IndexParamPortDefinition: {
+        OMX_PARAM_PORTDEFINITIONTYPE* def = (OMX_PARAM_PORTDEFINITIONTYPE*) pParam;
+        if (def->nPortIndex != kInputPort) return OMX_ErrorBadPortIndex;
+        *def = sink->mPort;
+        return OMX_ErrorNone;
+    }
+    case OMX_IndexParamVideoInit: {
+        OMX_PORT_PARAM_TYPE* ports = (OMX_PORT_PARAM_TYPE*) pParam;
+        ports->nPorts = 1;
+        ports->nStartPortNumber = kInputPort;
+        return OMX_ErrorNone;
+    }
+    case OMX_IndexParamCompBufferSupplier: {
+        OMX_PARAM_BUFFERSUPPLIERTYPE* supplier = (OMX_PARAM_BUFFERSUPPLIERTYPE*) pParam;
+        if (supplier->nPortIndex != kInputPort) return OMX_ErrorBadPortIndex;
+        supplier->eBufferSupplier = OMX_BufferSupplyInput;
+        return OMX_ErrorNone;
+    }
+    case OMX_IndexParamStandardComponentRole: {
+        OMX_PARAM_COMPONENTROLETYPE* role = (OMX_PARAM_COMPONENTROLETYPE*) pParam;
+        strncpy((char*) role->cRole, OMX_DISPLAY_SINK_ROLE, OMX_MAX_STRINGNAME_SIZE);
+        return OMX_ErrorNone;
+    }
+    default:
+        return OMX_ErrorUnsupportedIndex;
+    }
+}
+
+OMX_ERRORTYPE OmxDisplaySink::SetParameter(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nIndex, OMX_PTR pParam)
+{
+    OmxDisplaySink* sink = self(hComponent);
+    if (pParam == NULL) return OMX_ErrorBadParameter;
+    Mutex::Autolock l(sink->mLock);
+
+    switch (nIndex) {
+    case OMX_IndexParamPortDefinition: {
+        const OMX_PARAM_PORTDEFINITIONTYPE* def = (const OMX_PARAM_PORTDEFINITIONTYPE*) pParam;
+        if (def->nPortIndex != kInputPort) return OMX_ErrorBadPortIndex;
+        if (sink->mState != OMX_StateLoaded) return OMX_ErrorIncorrectStateOperation;
+        if (def->nBufferCountActual < sink->mPort.nBufferCountMin ||
+            def->nBufferCountActual > kMaxBuffers)
+            return OMX_ErrorBadParameter;
+        sink->mPort.nBufferCountActual = def->nBufferCountActual;
+        if (def->nBufferSize > sink->mPort.nBufferSize) sink->mPort.nBufferSize = def->nBufferSize;
+        return OMX_ErrorNone;
+    }
+    case OMX_IndexParamCompBufferSupplier: {
+        // only pmem we allocated ourselves can be registered with the display
+        const OMX_PARAM_BUFFERSUPPLIERTYPE* supplier = (const OMX_PARAM_BUFFERSUPPLIERTYPE*) pParam;
+        if (supplier->nPortIndex != kInputPort) return OMX_ErrorBadPortIndex;
+        return supplier->eBufferSupplier == OMX_BufferSupplyInput ?
+               OMX_ErrorNone : OMX_ErrorUnsupportedSetting;
+    }
+    case OMX_IndexParamStandardComponentRole:
+        return OMX_ErrorNone;
+    default:
+        return OMX_ErrorUnsupportedIndex;
+    }
+}
+
+OMX_ERRORTYPE OmxDisplaySink::GetConfig(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nIndex, OMX_PTR pConfig)
+{
+    return OMX_ErrorUnsupportedIndex;
+}
+
+OMX_ERRORTYPE OmxDisplaySink::SetConfig(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nIndex, OMX_PTR pConfig)
+{
+    return OMX_ErrorUnsupportedIndex;
+}
+
+OMX_ERRORTYPE OmxDisplaySink::GetExtensionIndex(OMX_HANDLETYPE hComponent, OMX_STRING cParameterName,
+        OMX_INDEXTYPE* pIndexType)
+{
+    return OMX_ErrorUnsupportedIndex;
+}
+
+OMX_ERRORTYPE OmxDisplaySink::GetState(OMX_HANDLETYPE hComponent, OMX_STATETYPE* pState)
+{
+    OmxDisplaySink* sink = self(hComponent);
+    Mutex::Autolock l(sink->mLock);
+    *pState = sink->mState;
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OmxDisplaySink::ComponentTunnelRequest(OMX_HANDLETYPE hComp, OMX_U32 nPort,
+        OMX_HANDLETYPE hTunneledComp, OMX_U32 nTunneledPort, OMX_TUNNELSETUPTYPE* pTunnelSetup)
+{
+    OmxDisplaySink* sink = self(hComp);
+    if (nPort != kInputPort) return OMX_ErrorBadPortIndex;
+    Mutex::Autolock l(sink->mLock);
+    if (sink->mState != OMX_StateLoaded) return OMX_ErrorIncorrectStateOperation;
+
+    // a NULL peer tears the tunnel down
+    if (hTunneledComp == NULL) {
+        sink->mPeer = NULL;
+        return OMX_ErrorNone;
+    }
+    if (pTunnelSetup == NULL) return OMX_ErrorBadParameter;
+
+    OMX_PARAM_PORTDEFINITIONTYPE peerPort;
+    initOmxStruct(&peerPort);
+    peerPort.nPortIndex = nTunneledPort;
+    if (OMX_GetParameter(hTunneledComp, OMX_IndexParamPortDefinition, &peerPort) != OMX_ErrorNone ||
+        peerPort.eDir != OMX_DirOutput || peerPort.eDomain != OMX_PortDomainVideo) {
+        LOGE("tunnel peer port %lu is not a video output port", nTunneledPort);
+        return OMX_ErrorPortsNotCompatible;
+    }
+
+    sink->mPort.format.video.nFrameWidth = peerPort.format.video.nFrameWidth;
+    sink->mPort.format.video.nFrameHeight = peerPort.format.video.nFrameHeight;
+    sink->mPort.format.video.nStride = peerPort.format.video.nStride;
+    sink->mPort.format.video.nSliceHeight = peerPort.format.video.nSliceHeight;
+    sink->mPort.format.video.eColorFormat = peerPort.format.video.eColorFormat;
+    if (peerPort.nBufferCountActual > sink->mPort.nBufferCountActual) {
+        sink->mPort.nBufferCountActual = peerPort.nBufferCountActual;
+    }
+    if (peerPort.nBufferSize > sink->mPort.nBufferSize) {
+        sink->mPort.nBufferSize = peerPort.nBufferSize;
+    }
+
+    pTunnelSetup->eSupplier = OMX_BufferSupplyInput;
+    sink->mPeer = hTunneledComp;
+    sink->mPeerPort = nTunneledPort;
+    LOGV("tunneled to port %lu, %lux%lu", nTunneledPort,
+         peerPort.format.video.nFrameWidth, peerPort.format.video.nFrameHeight);
+    return OMX_ErrorNone;
+}
+
+// the sink supplies its own buffers, so the peer never offers any
+OMX_ERRORTYPE OmxDisplaySink::UseBuffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE** ppBufferHdr,
+        OMX_U32 nPortIndex, OMX_PTR pAppPrivate, OMX_U32 nSizeBytes, OMX_U8* pBuffer)
+{
+    return OMX_ErrorNotImplemented;
+}
+
+OMX_ERRORTYPE OmxDisplaySink::AllocateBuffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE** ppBuffer,
+        OMX_U32 nPortIndex, OMX_PTR pAppPrivate, OMX_U32 nSizeBytes)
+{
+    return OMX_ErrorNotImplemented;
+}
+
+OMX_ERRORTYPE OmxDisplaySink::FreeBuffer(OMX_HANDLETYPE hComponent, OMX_U32 nPortIndex, OMX_BUFFERHEADERTYPE* pBuffer)
+{
+    return OMX_ErrorNotImplemented;
+}
+
+// decoded frame from the tunnel peer
+OMX_ERRORTYPE OmxDisplaySink::EmptyThisBuffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE* pBuffer)
+{
+    OmxDisplaySink* sink = self(hComponent);
+    bool idleComplete = false;
+    bool eos = false;
+    Refill refill;
+    {
+        Mutex::Autolock l(sink->mLock);
+        if (sink->mBuffersWithPeer) sink->mBuffersWithPeer--;
+        eos = (pBuffer->nFlags & OMX_BUFFERFLAG_EOS) != 0;
+
+        if (sink->mState == OMX_StateExecuting) {
+            if (pBuffer->nFilledLen) {
+                // from the decoder handing the frame over, as writeFrameBuf
+                // times it from the frame reaching the MIO
+                sink->mPostStats.begin();
+                sink->queueFrame(pBuffer, refill);
+            } else {
+                sink->returnToPeer(pBuffer, refill);
+            }
+        } else if (sink->mState == OMX_StatePause) {
+            // keep it until we resume, like any other held frame
+            sink->mHeld[sink->mNumHeld++] = pBuffer;
+        } else {
+            if (sink->mPendingIdle && sink->mBuffersWithPeer == 0) {
+                sink->mPendingIdle = false;
+                idleComplete = true;
+            }
+            if (sink->mReleasing) sink->mReturned.broadcast();
+        }
+    }
+    sink->fillPeer(refill);
+
+    if (eos) sink->notify(OMX_EventBufferFlag, kInputPort, pBuffer->nFlags);
+    if (idleComplete) sink->notify(OMX_EventCmdComplete, OMX_CommandStateSet, OMX_StateIdle);
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OmxDisplaySink::FillThisBuffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE* pBuffer)
+{
+    // no output port
+    return OMX_ErrorBadPortIndex;
+}
+
+OMX_ERRORTYPE OmxDisplaySink::SetCallbacks(OMX_HANDLETYPE hComponent, OMX_CALLBACKTYPE* pCallbacks, OMX_PTR pAppData)
+{
+    OmxDisplaySink* sink = self(hComponent);
+    if (pCallbacks == NULL) return OMX_ErrorBadParameter;
+    Mutex::Autolock l(sink->mLock);
+    sink->mCallbacks = *pCallbacks;
+    sink->mAppData = pAppData;
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OmxDisplaySink::ComponentDeInit(OMX_HANDLETYPE hComponent)
+{
+    // lifetime is owned by the MIO, through release()
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OmxDisplaySink::UseEGLImage(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE** ppBufferHdr,
+        OMX_U32 nPortIndex, OMX_PTR pAppPrivate, void* eglImage)
+{
+    return OMX_ErrorNotImplemented;
+}
+
+OMX_ERRORTYPE OmxDisplaySink::ComponentRoleEnum(OMX_HANDLETYPE hComponent, OMX_U8* cRole, OMX_U32 nIndex)
+{
+    if (nIndex > 0) return OMX_ErrorNoMore;
+    strncpy((char*) cRole, OMX_DISPLAY_SINK_ROLE, OMX_MAX_STRINGNAME_SIZE);
+    return OMX_ErrorNone;
+}
@@ -0,0 +1,181 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef OMX_DISPLAY_SINK_H_INCLUDED
+#define OMX_DISPLAY_SINK_H_INCLUDED
+
+#include <utils/threads.h>
+#include <binder/MemoryHeapPmem.h>
+#include <surfaceflinger/ISurface.h>
+#include <ui/Overlay.h>
+
+#include "OMX_Core.h"
+#include "OMX_Component.h"
+
+#include "qcom_platform_private.h"
+#include "video_post_stats.h"
+
+namespace android {
+
+/*
+ * OMX IL display sink with a single video input port.
+ *
+ * Meant to be tunneled to a hardware decoder's output port with
+ * OMX_SetupTunnel, so decoded frames go straight from the decoder to the
+ * overlay (or to ISurface when there is no overlay) instead of travelling
+ * through the PV graph and AndroidSurfaceOutput::writeFrameBuf.
+ *
+ * The sink is the buffer supplier for the tunnel: it allocates a pmem heap
+ * the same way the MIO software path does, hands each slot to the decoder
+ * with OMX_UseBuffer (passing the pmem fd and offset as app data, which is
+ * how the Qualcomm decoders expect pmem output buffers), and therefore
+ * never needs to decode platform private data per frame.
+ *
+ * The decoder writes into that heap for as long as the tunnel is up, so
+ * the sink is not deleted but released: release() takes the tunnel down
+ * from its end first.  Buffers go back to the decoder only with mLock
+ * released, as a decoder may fill one synchronously and call straight
+ * back into EmptyThisBuffer.
+ */
+class OmxDisplaySink
+{
+public:
+    OmxDisplaySink(const sp<ISurface>& surface, const sp<Overlay>& overlay,
+                   int displayWidth, int displayHeight, int frameWidth, int frameHeight,
+                   int halFormat, int framesToHold);
+
+    // handle to pass to OMX_SetupTunnel as the input component
+    OMX_HANDLETYPE handle() { return &mComponent; }
+
+    // true once the tunnel is established and frames are flowing
+    bool isActive();
+
+    // re-post the frame currently on screen, e.g. after a pause
+    void postLastFrame();
+
+    void printStatistics(const char* name);
+
+    // stops posting, takes back every buffer (flushing the decoder's
+    // output port for the ones it has not filled), frees them, clears the
+    // tunnel on both ends and deletes the sink.  False if the decoder
+    // keeps some beyond kReleaseTimeout; the sink then stays allocated,
+    // off the display, since the decoder may still write into its heap.
+    bool release();
+
+private:
+    enum {
+        kMaxBuffers = 32,
+        kInputPort = 0
+    };
+    static const nsecs_t kReleaseTimeout = 1000000000LL;
+
+    // buffers going back to the decoder, collected under mLock
+    struct Refill {
+        Refill() : peer(NULL), count(0) {}
+        OMX_HANDLETYPE          peer;
+        OMX_BUFFERHEADERTYPE*   buffers[kMaxBuffers];
+        OMX_U32                 count;
+    };
+
+    ~OmxDisplaySink();
+
+    // OMX component entry points
+    static OMX_ERRORTYPE GetComponentVersion(OMX_HANDLETYPE hComponent, OMX_STRING pComponentName,
+            OMX_VERSIONTYPE* pComponentVersion, OMX_VERSIONTYPE* pSpecVersion, OMX_UUIDTYPE* pComponentUUID);
+    static OMX_ERRORTYPE SendCommand(OMX_HANDLETYPE hComponent, OMX_COMMANDTYPE Cmd, OMX_U32 nParam1, OMX_PTR pCmdData);
+    static OMX_ERRORTYPE GetParameter(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nParamIndex, OMX_PTR pParam);
+    static OMX_ERRORTYPE SetParameter(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nIndex, OMX_PTR pParam);
+    static OMX_ERRORTYPE GetConfig(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nIndex, OMX_PTR pConfig);
+    static OMX_ERRORTYPE SetConfig(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nIndex, OMX_PTR pConfig);
+    static OMX_ERRORTYPE GetExtensionIndex(OMX_HANDLETYPE hComponent, OMX_STRING cParameterName, OMX_INDEXTYPE* pIndexType);
+    static OMX_ERRORTYPE GetState(OMX_HANDLETYPE hComponent, OMX_STATETYPE* pState);
+    static OMX_ERRORTYPE ComponentTunnelRequest(OMX_HANDLETYPE hComp, OMX_U32 nPort,
+            OMX_HANDLETYPE hTunneledComp, OMX_U32 nTunneledPort, OMX_TUNNELSETUPTYPE* pTunnelSetup);
+    static OMX_ERRORTYPE UseBuffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE** ppBufferHdr,
+            OMX_U32 nPortIndex, OMX_PTR pAppPrivate, OMX_U32 nSizeBytes, OMX_U8* pBuffer);
+    static OMX_ERRORTYPE AllocateBuffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE** ppBuffer,
+            OMX_U32 nPortIndex, OMX_PTR pAppPrivate, OMX_U32 nSizeBytes);
+    static OMX_ERRORTYPE FreeBuffer(OMX_HANDLETYPE hComponent, OMX_U32 nPortIndex, OMX_BUFFERHEADERTYPE* pBuffer);
+    static OMX_ERRORTYPE EmptyThisBuffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE* pBuffer);
+    static OMX_ERRORTYPE FillThisBuffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE* pBuffer);
+    static OMX_ERRORTYPE SetCallbacks(OMX_HANDLETYPE hComponent, OMX_CALLBACKTYPE* pCallbacks, OMX_PTR pAppData);
+    static OMX_ERRORTYPE ComponentDeInit(OMX_HANDLETYPE hComponent);
+    static OMX_ERRORTYPE UseEGLImage(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE** ppBufferHdr,
+            OMX_U32 nPortIndex, OMX_PTR pAppPrivate, void* eglImage);
+    static OMX_ERRORTYPE ComponentRoleEnum(OMX_HANDLETYPE hComponent, OMX_U8* cRole, OMX_U32 nIndex);
+
+    static OmxDisplaySink* self(OMX_HANDLETYPE hComponent);
+
+    OMX_ERRORTYPE setState(OMX_STATETYPE state, Refill& refill);
+    OMX_ERRORTYPE allocateTunnelBuffers();
+    void freeTunnelBuffers();
+    OMX_ERRORTYPE queueFrame(OMX_BUFFERHEADERTYPE* pBuffer, Refill& refill);
+    void trimHeldBuffers(OMX_U32 keep, Refill& refill);
+    void returnToPeer(OMX_BUFFERHEADERTYPE* pBuffer, Refill& refill);
+    // caller does not hold mLock
+    void fillPeer(const Refill& refill);
+    void notify(OMX_EVENTTYPE event, OMX_U32 data1, OMX_U32 data2);
+
+    OMX_COMPONENTTYPE               mComponent;
+    OMX_CALLBACKTYPE                mCallbacks;
+    OMX_PTR                         mAppData;
+    OMX_STATETYPE                   mState;
+    OMX_PARAM_PORTDEFINITIONTYPE    mPort;
+
+    // tunnel peer (the decoder output port)
+    OMX_HANDLETYPE                  mPeer;
+    OMX_U32                         mPeerPort;
+
+    // display targets
+    sp<ISurface>                    mSurface;
+    sp<Overlay>                     mOverlay;
+    ISurface::BufferHeap            mBufferHeap;
+    int                             mDisplayWidth;
+    int                             mDisplayHeight;
+    int                             mHalFormat;
+
+    // pmem slots supplied to the decoder
+    sp<MemoryHeapPmem>              mHeapPmem;
+    uint8*                          mHeapBase;
+    OMX_U32                         mNumBuffers;
+    OMX_BUFFERHEADERTYPE*           mBuffers[kMaxBuffers];
+    PLATFORM_PRIVATE_PMEM_INFO      mPmemInfo[kMaxBuffers];
+
+    // frames still being scanned out, oldest first
+    OMX_BUFFERHEADERTYPE*           mHeld[kMaxBuffers];
+    OMX_U32                         mNumHeld;
+    OMX_U32                         mFramesToHold;
+    OMX_U32                         mBuffersWithPeer;
+    int32                           mLastOffset;
+
+    // Executing->Idle completes once the decoder has handed every buffer back
+    bool                            mPendingIdle;
+
+    // collected refills not yet handed to the decoder; release() waits for
+    // them and for mBuffersWithPeer to drain
+    OMX_U32                         mRefilling;
+    bool                            mReleasing;
+
+    Mutex                           mLock;
+    Condition                       mReturned;
+    VideoPostStats                  mPostStats;
+};
+
+}; // namespace android
+
+#endif // OMX_DISPLAY_SINK_H_INCLUDED
@@ -0,0 +1,283 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "PmemFrameWriter"
+#include <utils/Log.h>
+
+#include <string.h>
+#include <sys/ioctl.h>
+#include <cutils/properties.h>
+#include <binder/MemoryHeapBase.h>
+
+#if HAVE_ANDROID_OS
+#include <linux/android_pmem.h>
+#endif
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "pmem_frame_writer.h"
+
+using namespace android;
+
+// ordinary stores, the cache absorbs the partial writes
+static void copyCached(const uint8_t* src, uint8_t* dst, size_t bytes)
+{
+    memcpy(dst, src, bytes);
+}
+
+static void interleaveVuCached(const uint8_t* pu, const uint8_t* pv, uint8_t* p, size_t count)
+{
+    size_t i = 0;
+#if defined(__ARM_NEON__)
+    for (; i + 8 <= count; i += 8) {
+        uint8x8x2_t vu;
+        vu.val[0] = vld1_u8(pv + i);
+        vu.val[1] = vld1_u8(pu + i);
+        vst2_u8(p + 2 * i, vu);
+    }
+#endif
+    for (; i < count; i++) {
+        p[2 * i] = pv[i];
+        p[2 * i + 1] = pu[i];
+    }
+}
+
+// whole 64 byte lines per store burst for write-combined mappings
+static void copyStreaming(const uint8_t* src, uint8_t* dst, size_t bytes)
+{
+    size_t i = 0;
+#if defined(__ARM_NEON__)
+    for (; i + 64 <= bytes; i += 64) {
+        __builtin_prefetch(src + i + 256);
+        uint8x16_t a = vld1q_u8(src + i);
+        uint8x16_t b = vld1q_u8(src + i + 16);
+        uint8x16_t c = vld1q_u8(src + i + 32);
+        uint8x16_t d = vld1q_u8(src + i + 48);
+        vst1q_u8(dst + i, a);
+        vst1q_u8(dst + i + 16, b);
+        vst1q_u8(dst + i + 32, c);
+        vst1q_u8(dst + i + 48, d);
+    }
+#else
+    // eight words in registers, then one stm-sized burst
+    for (; i + 32 <= bytes; i += 32) {
+        uint32_t w[8];
+        __builtin_prefetch(src + i + 256);
+        memcpy(w, src + i, sizeof(w));
+        memcpy(dst + i, w, sizeof(w));
+    }
+#endif
+    if (i < bytes) memcpy(dst + i, src + i, bytes - i);
+}
+
+static void interleaveVuStreaming(const uint8_t* pu, const uint8_t* pv, uint8_t* p, size_t count)
+{
+    size_t i = 0;
+#if defined(__ARM_NEON__)
+    for (; i + 32 <= count; i += 32) {
+        __builtin_prefetch(pu + i + 128);
+        __builtin_prefetch(pv + i + 128);
+        uint8x16x2_t lo, hi;
+        lo.val[0] = vld1q_u8(pv + i);
+        lo.val[1] = vld1q_u8(pu + i);
+        hi.val[0] = vld1q_u8(pv + i + 16);
+        hi.val[1] = vld1q_u8(pu + i + 16);
+        vst2q_u8(p + 2 * i, lo);
+        vst2q_u8(p + 2 * i + 32, hi);
+    }
+#else
+    for (; i + 16 <= count; i += 16) {
+        uint32_t w[8];
+        for (int k = 0; k < 8; k++) {
+            const uint8_t* u = pu + i + 2 * k;
+            const uint8_t* v = pv + i + 2 * k;
+            w[k] = v[0] | (u[0] << 8) | (v[1] << 16) | (u[1] << 24);
+        }
+        memcpy(p + 2 * i, w, sizeof(w));
+    }
+#endif
+    for (; i < count; i++) {
+        p[2 * i] = pv[i];
+        p[2 * i + 1] = pu[i];
+    }
+}
+
+// out[i] = average of the 2x2 block at column 2i of rows r0 and r1
+static void halveRow(const uint8_t* r0, const uint8_t* r1, uint8_t* out, int count)
+{
+    int i = 0;
+#if defined(__ARM_NEON__)
+    for (; i + 8 <= count; i += 8) {
+        uint16x8_t sum = vaddq_u16(vpaddlq_u8(vld1q_u8(r0 + 2 * i)), vpaddlq_u8(vld1q_u8(r1 + 2 * i)));
+        vst1_u8(out + i, vrshrn_n_u16(sum, 2));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = (r0[2 * i] + r0[2 * i + 1] + r1[2 * i] + r1[2 * i + 1] + 2) >> 2;
+    }
+}
+
+void i420ToNv21Cached(const uint8_t* src, uint8_t* dst, int width, int height)
+{
+    size_t ySize = width * height;
+    copyCached(src, dst, ySize);
+    interleaveVuCached(src + ySize, src + ySize + ySize / 4, dst + ySize, ySize / 4);
+}
+
+void i420ToNv21Streaming(const uint8_t* src, uint8_t* dst, int width, int height)
+{
+    size_t ySize = width * height;
+    copyStreaming(src, dst, ySize);
+    interleaveVuStreaming(src + ySize, src + ySize + ySize / 4, dst + ySize, ySize / 4);
+}
+
+PmemFrameWriter::PmemFrameWriter() :
+    mCacheMode(PMEM_CACHE_CACHED),
+    mStreaming(false),
+    mFd(-1),
+    mBase(NULL)
+{
+}
+
+void PmemFrameWriter::init(uint32_t heapFlags, int pmemFd, void* base)
+{
+    mCacheMode = (heapFlags & MemoryHeapBase::NO_CACHING) ? PMEM_CACHE_WRITE_COMBINED : PMEM_CACHE_CACHED;
+    mFd = pmemFd;
+    mBase = base;
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get("persist.pv.convert.kernel", value, "auto");
+    if (!strcmp(value, "stream")) {
+        mStreaming = true;
+    } else if (!strcmp(value, "cached")) {
+        mStreaming = false;
+    } else {
+        mStreaming = (mCacheMode == PMEM_CACHE_WRITE_COMBINED);
+    }
+    LOGV("heap is %s, using the %s kernel", mCacheMode == PMEM_CACHE_CACHED ? "cached" : "write-combined",
+         mStreaming ? "streaming" : "cached");
+}
+
+void PmemFrameWriter::writeI420AsNv21(const void* src, size_t offset, int width, int height)
+{
+    uint8_t* dst = static_cast<uint8_t*>(mBase) + offset;
+    if (mStreaming) {
+        i420ToNv21Streaming(static_cast<const uint8_t*>(src), dst, width, height);
+    } else {
+        i420ToNv21Cached(static_cast<const uint8_t*>(src), dst, width, height);
+    }
+    finishWrite(offset, (width * height * 3) / 2);
+}
+
+void PmemFrameWriter::writeI420AsNv21Rows(const void* src, size_t offset, int width, int height,
+                                          int firstRow, int rows)
+{
+    const uint8_t* in = static_cast<const uint8_t*>(src);
+    uint8_t* out = static_cast<uint8_t*>(mBase) + offset;
+    size_t ySize = width * height;
+
+    // luma rows, then the chroma rows they share
+    size_t yStart = firstRow * width;
+    size_t yBytes = rows * width;
+    size_t cStart = (firstRow / 2) * (width / 2);
+    size_t cCount = ((firstRow + rows + 1) / 2 - firstRow / 2) * (width / 2);
+    const uint8_t* pu = in + ySize + cStart;
+    const uint8_t* pv = in + ySize + ySize / 4 + cStart;
+
+    if (mStreaming) {
+        copyStreaming(in + yStart, out + yStart, yBytes);
+        interleaveVuStreaming(pu, pv, out + ySize + 2 * cStart, cCount);
+    } else {
+        copyCached(in + yStart, out + yStart, yBytes);
+        interleaveVuCached(pu, pv, out + ySize + 2 * cStart, cCount);
+    }
+    finishWrite(offset + yStart, yBytes);
+    finishWrite(offset + ySize + 2 * cStart, 2 * cCount);
+}
+
+void PmemFrameWriter::writeI420Luma(const void* src, size_t offset, int width, int height)
+{
+    uint8_t* dst = static_cast<uint8_t*>(mBase) + offset;
+    if (mStreaming) {
+        copyStreaming(static_cast<const uint8_t*>(src), dst, width * height);
+    } else {
+        copyCached(static_cast<const uint8_t*>(src), dst, width * height);
+    }
+    finishWrite(offset, width * height);
+}
+
+void PmemFrameWriter::writeI420AsNv21Half(const void* src, size_t offset, int width, int height)
+{
+    const uint8_t* in = static_cast<const uint8_t*>(src);
+    uint8_t* out = static_cast<uint8_t*>(mBase) + offset;
+    size_t ySize = width * height;
+    int halfWidth = width / 2;
+    int halfHeight = height / 2;
+
+    for (int row = 0; row < halfHeight; row++) {
+        const uint8_t* r0 = in + 2 * row * width;
+        halveRow(r0, r0 + width, out + row * width, halfWidth);
+    }
+
+    // chroma planes are width/2 wide; halve them a chunk at a time and
+    // interleave the result into the NV21 row
+    const uint8_t* pu = in + ySize;
+    const uint8_t* pv = pu + ySize / 4;
+    int chromaStride = width / 2;
+    int chromaCount = halfWidth / 2;
+    uint8_t u[256];
+    uint8_t v[256];
+    for (int row = 0; row < halfHeight / 2; row++) {
+        const uint8_t* u0 = pu + 2 * row * chromaStride;
+        const uint8_t* v0 = pv + 2 * row * chromaStride;
+        uint8_t* p = out + ySize + row * width;
+        for (int x = 0; x < chromaCount; x += sizeof(u)) {
+            int n = chromaCount - x;
+            if (n > (int)sizeof(u)) n = sizeof(u);
+            halveRow(u0 + 2 * x, u0 + chromaStride + 2 * x, u, n);
+            halveRow(v0 + 2 * x, v0 + chromaStride + 2 * x, v, n);
+            if (mStreaming) {
+                interleaveVuStreaming(u, v, p + 2 * x, n);
+            } else {
+                interleaveVuCached(u, v, p + 2 * x, n);
+            }
+        }
+    }
+
+    finishWrite(offset, halfHeight * width);
+    finishWrite(offset + ySize, (halfHeight / 2) * width);
+}
+
+void PmemFrameWriter::finishWrite(size_t offset, size_t length)
+{
+    if (mCacheMode != PMEM_CACHE_CACHED) return;
+
+#if defined(PMEM_CLEAN_CACHES)
+    // one clean for the whole frame rather than per line
+    struct pmem_addr addr;
+    addr.vaddr = (unsigned long)mBase;
+    addr.offset = offset;
+    addr.length = length;
+    if (ioctl(mFd, PMEM_CLEAN_CACHES, &addr) < 0) {
+        LOGE("PMEM_CLEAN_CACHES failed on fd %d", mFd);
+    }
+#endif
+}
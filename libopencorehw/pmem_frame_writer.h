@@ -0,0 +1,86 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef PMEM_FRAME_WRITER_H_INCLUDED
+#define PMEM_FRAME_WRITER_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Writes software decoded frames into a pmem frame buffer heap with the
+ * kernel that suits how the heap is mapped.
+ *
+ *  - MemoryHeapBase::NO_CACHING heaps are mapped write-combined.  Every
+ *    partial line costs a bus transaction, so the streaming kernel reads
+ *    ahead and writes whole 64 byte lines at a time.
+ *  - Cached heaps take ordinary stores, and the written range is cleaned
+ *    to memory with a single PMEM_CLEAN_CACHES once the frame is complete,
+ *    before the overlay or MDP reads it.
+ *
+ * persist.pv.convert.kernel (auto, cached, stream) overrides the choice.
+ */
+
+enum {
+    PMEM_CACHE_CACHED = 0,
+    PMEM_CACHE_WRITE_COMBINED
+};
+
+// I420 to NV21 (Y plane, then interleaved V/U) over planes with stride == width
+void i420ToNv21Cached(const uint8_t* src, uint8_t* dst, int width, int height);
+void i420ToNv21Streaming(const uint8_t* src, uint8_t* dst, int width, int height);
+
+class PmemFrameWriter
+{
+public:
+    PmemFrameWriter();
+
+    // heapFlags as passed to the master MemoryHeapBase; fd and base are
+    // the master heap's, cache maintenance is done through them
+    void init(uint32_t heapFlags, int pmemFd, void* base);
+
+    // converts an I420 frame into the heap at offset, ready for display
+    void writeI420AsNv21(const void* src, size_t offset, int width, int height);
+
+    // same for rows [firstRow, firstRow + rows) and the chroma rows they
+    // use; firstRow must be even
+    void writeI420AsNv21Rows(const void* src, size_t offset, int width, int height,
+                             int firstRow, int rows);
+
+    // only the luma plane, the slot keeps the chroma it has
+    void writeI420Luma(const void* src, size_t offset, int width, int height);
+
+    // 2:1 downscaled (2x2 average) into the top-left quarter of the slot,
+    // keeping the full size strides and chroma plane position so the
+    // display only needs its crop halved
+    void writeI420AsNv21Half(const void* src, size_t offset, int width, int height);
+
+    // for frames written by someone else (e.g. the RGB converter)
+    void finishWrite(size_t offset, size_t length);
+
+    int cacheMode() const { return mCacheMode; }
+    bool streaming() const { return mStreaming; }
+
+private:
+    int                         mCacheMode;
+    bool                        mStreaming;
+    int                         mFd;
+    void*                       mBase;
+};
+
+#endif // PMEM_FRAME_WRITER_H_INCLUDED
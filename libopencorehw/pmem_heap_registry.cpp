@@ -0,0 +1,163 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "PmemHeapRegistry"
+#include <utils/Log.h>
+
+#include "pmem_heap_registry.h"
+
+using namespace android;
+
+static const char* pmem = "/dev/pmem";
+
+bool decodePlatformPrivate(OsclAny* private_data_ptr, PlatformPrivateInfo* info)
+{
+    PLATFORM_PRIVATE_LIST* listPtr = (PLATFORM_PRIVATE_LIST*) private_data_ptr;
+    if ((listPtr == NULL) || (listPtr->entryList == NULL)) return false;
+
+    for (uint32 i = 0; i < listPtr->nEntries; i++) {
+        PLATFORM_PRIVATE_ENTRY* entry = &listPtr->entryList[i];
+        if (entry->type != PLATFORM_PRIVATE_PMEM) continue;
+        PLATFORM_PRIVATE_PMEM_INFO* pmemInfoPtr = (PLATFORM_PRIVATE_PMEM_INFO*) entry->entry;
+        if (pmemInfoPtr == NULL) return false;
+        info->heapKey = pmemInfoPtr->pmem_fd;
+        info->offset = pmemInfoPtr->offset;
+        LOGV("private data %p: heap 0x%x offset %u", private_data_ptr, info->heapKey, info->offset);
+        return true;
+    }
+    return false;
+}
+
+PmemHeapRegistry::PmemHeapRegistry() :
+    mEntries(new Entry[kInitialHeaps]),
+    mCapacity(kInitialHeaps),
+    mCount(0),
+    mFrames(0),
+    mHeapsSeen(0),
+    mChangeFrame(0),
+    mLastWasNew(false)
+{
+}
+
+PmemHeapRegistry::~PmemHeapRegistry()
+{
+    delete[] mEntries;
+}
+
+sp<MemoryHeapPmem> PmemHeapRegistry::lookup(uint32 key, uint32_t flagsMask, bool* isNew)
+{
+    *isNew = false;
+    if (key == 0) return NULL;
+    mFrames++;
+
+    Entry* found = NULL;
+    for (int i = 0; i < mCount; i++) {
+        if (mEntries[i].key == key) {
+            found = &mEntries[i];
+            break;
+        }
+    }
+
+    if (found == NULL) {
+        // ugly hack to pass an sp<MemoryHeapBase> as an int
+        sp<MemoryHeapBase> master = (MemoryHeapBase *) key;
+        master->setDevice(pmem);
+        sp<MemoryHeapPmem> heap = new MemoryHeapPmem(master, master->getFlags() & flagsMask);
+        heap->slap();
+        master.clear();
+
+        // a run of new heaps is one change of the decoder's set
+        if (!mLastWasNew && (mCount > 0)) mChangeFrame = mFrames;
+        found = add(key, heap);
+        mHeapsSeen++;
+        *isNew = true;
+        LOGV("new decoder heap 0x%x (%lu so far, %d held)", key, mHeapsSeen, mCount);
+    }
+    mLastWasNew = *isNew;
+    found->lastUse = mFrames;
+    sp<MemoryHeapPmem> heap = found->heap;
+
+    // moves the entries around, found among them
+    if (mChangeFrame != 0) releaseReplaced();
+    return heap;
+}
+
+PmemHeapRegistry::Entry* PmemHeapRegistry::add(uint32 key, const sp<MemoryHeapPmem>& heap)
+{
+    if ((mCount == mCapacity) && (mCapacity < kMaxHeaps)) {
+        int capacity = (mCapacity * 2 < kMaxHeaps) ? mCapacity * 2 : kMaxHeaps;
+        Entry* entries = new Entry[capacity];
+        for (int i = 0; i < mCount; i++) entries[i] = mEntries[i];
+        delete[] mEntries;
+        mEntries = entries;
+        mCapacity = capacity;
+    }
+
+    Entry* e;
+    if (mCount < mCapacity) {
+        e = &mEntries[mCount++];
+    } else {
+        // a decoder with more heaps than that: the least recently used goes
+        e = &mEntries[0];
+        for (int i = 1; i < mCount; i++) {
+            if (mEntries[i].lastUse < e->lastUse) e = &mEntries[i];
+        }
+        LOGV("registry full, releasing heap 0x%x", e->key);
+    }
+    e->key = key;
+    e->heap = heap;
+    return e;
+}
+
+// heaps the decoder has not handed out since its set changed are gone once
+// every heap still in use has come round
+void PmemHeapRegistry::releaseReplaced()
+{
+    int inUse = 0, replaced = 0;
+    for (int i = 0; i < mCount; i++) {
+        if (mEntries[i].lastUse >= mChangeFrame) inUse++;
+        else replaced++;
+    }
+    if (replaced == 0) {
+        mChangeFrame = 0;
+        return;
+    }
+    if (mFrames - mChangeFrame < (unsigned long) inUse + kStaleSlack) return;
+
+    int n = 0;
+    for (int i = 0; i < mCount; i++) {
+        if (mEntries[i].lastUse < mChangeFrame) {
+            LOGV("heap 0x%x replaced, releasing", mEntries[i].key);
+            continue;
+        }
+        if (n != i) mEntries[n] = mEntries[i];
+        n++;
+    }
+    for (int i = n; i < mCount; i++) mEntries[i].heap.clear();
+    mCount = n;
+    mChangeFrame = 0;
+}
+
+void PmemHeapRegistry::clear()
+{
+    for (int i = 0; i < mCount; i++) mEntries[i].heap.clear();
+    mCount = 0;
+    mChangeFrame = 0;
+    mLastWasNew = false;
+}
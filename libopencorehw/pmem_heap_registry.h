@@ -0,0 +1,96 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef PMEM_HEAP_REGISTRY_H_INCLUDED
+#define PMEM_HEAP_REGISTRY_H_INCLUDED
+
+#include <binder/MemoryHeapPmem.h>
+
+#include "qcom_platform_private.h"
+
+// what a hardware decoder tells about one output frame
+struct PlatformPrivateInfo {
+    // the decoder's sp<MemoryHeapBase> passed as an int in pmem_fd; only
+    // compared and handed to PmemHeapRegistry
+    uint32      heapKey;
+    uint32      offset;
+};
+
+// one walk over the PLATFORM_PRIVATE_LIST of a frame, false without a
+// pmem entry
+bool decodePlatformPrivate(OsclAny* private_data_ptr, PlatformPrivateInfo* info);
+
+/*
+ * The pmem heaps a hardware decoder has handed out frames from.
+ *
+ * A decoder may allocate each output buffer from its own heap, or drop its
+ * heap and allocate another one after a port settings change.  Each heap
+ * is wrapped in a MemoryHeapPmem the first time a frame from it arrives
+ * and kept for the frames after it, so the output only has to re-point
+ * the overlay (setFd) or re-register the BufferHeap when the heap of the
+ * frame changes, instead of being torn down.
+ *
+ * The registry grows to hold every heap the decoder cycles through, up to
+ * kMaxHeaps, so one heap per output buffer does not evict and re-wrap a
+ * heap on every frame.  Nothing is let go while the decoder keeps handing
+ * out the same heaps.  Once a new heap turns up, the ones no frame came
+ * from since are released after one pass over the heaps still in use
+ * plus kStaleSlack frames, so the pmem of a decoder that reallocated is
+ * returned as soon as it is off the screen.
+ */
+class PmemHeapRegistry
+{
+public:
+    PmemHeapRegistry();
+    ~PmemHeapRegistry();
+
+    // the wrapped heap for key; flagsMask picks which of the decoder
+    // heap's flags the wrapper keeps.  isNew is set the first time key is
+    // seen.  NULL only if key is 0.
+    android::sp<android::MemoryHeapPmem> lookup(uint32 key, uint32_t flagsMask, bool* isNew);
+    void clear();
+
+    unsigned long heapsSeen() const { return mHeapsSeen; }
+
+private:
+    static const int kInitialHeaps = 8;
+    static const int kMaxHeaps = 64;
+    // frames the player holds back or reorders on top of one pass
+    static const unsigned long kStaleSlack = 4;
+
+    struct Entry {
+        uint32                                  key;
+        android::sp<android::MemoryHeapPmem>    heap;
+        unsigned long                           lastUse;
+    };
+
+    Entry* add(uint32 key, const android::sp<android::MemoryHeapPmem>& heap);
+    void releaseReplaced();
+
+    Entry*                      mEntries;
+    int                         mCapacity;
+    int                         mCount;
+    unsigned long               mFrames;
+    unsigned long               mHeapsSeen;
+    // the first frame of the latest run of new heaps, 0 when no heap from
+    // before it is left
+    unsigned long               mChangeFrame;
+    bool                        mLastWasNew;
+};
+
+#endif // PMEM_HEAP_REGISTRY_H_INCLUDED
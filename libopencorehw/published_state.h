@@ -0,0 +1,119 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef PUBLISHED_STATE_H_INCLUDED
+#define PUBLISHED_STATE_H_INCLUDED
+
+#include <stdint.h>
+#include <unistd.h>
+#include <utils/RefBase.h>
+
+/*
+ * A reference counted object readers pick up without locking while a
+ * writer replaces it, read-copy-update style: the writer builds the next
+ * one off to the side and publish() swaps it in.  Readers never wait.
+ *
+ *   PublishedState<T>::Reader reader(state);
+ *   if (reader.get() != NULL) ... use *reader.get() ...
+ *
+ * What get() returns stays valid until the Reader goes out of scope;
+ * holding it longer takes an sp<T>.  publish() returns once no Reader
+ * can still see the object it replaced and drops the reference it had
+ * on it, so the last holder frees it.  Readers count themselves into one
+ * of two epochs; publish() flips the epoch and waits for the old one to
+ * empty, which only takes as long as the Readers already open.
+ *
+ * One writer at a time, serialized by the owner, and never from inside a
+ * Reader of the same state.
+ */
+template <class T>
+class PublishedState
+{
+public:
+    PublishedState() : mState(NULL), mEpoch(0)
+    {
+        mReaders[0] = 0;
+        mReaders[1] = 0;
+    }
+    ~PublishedState()
+    {
+        if (mState != NULL) mState->decStrong(this);
+    }
+
+    class Reader
+    {
+    public:
+        explicit Reader(const PublishedState& owner) : mOwner(owner)
+        {
+            mEpoch = owner.enter();
+            mState = owner.mState;
+        }
+        ~Reader() { mOwner.leave(mEpoch); }
+        T* get() const { return mState; }
+
+    private:
+        const PublishedState&   mOwner;
+        int32_t                 mEpoch;
+        T*                      mState;
+    };
+
+    void publish(const android::sp<T>& next)
+    {
+        T* state = next.get();
+        if (state != NULL) state->incStrong(this);
+        T* old = __sync_lock_test_and_set(&mState, state);
+
+        // readers that entered after the flip see state
+        int32_t epoch = mEpoch & 1;
+        __sync_fetch_and_add(&mEpoch, 1);
+        while (__sync_fetch_and_add(&mReaders[epoch], 0) != 0) usleep(kGraceWaitUs);
+
+        if (old != NULL) old->decStrong(this);
+    }
+
+    // for the writer: what readers see now
+    android::sp<T> current() const { return mState; }
+
+private:
+    PublishedState(const PublishedState&);
+    PublishedState& operator=(const PublishedState&);
+
+    int32_t enter() const
+    {
+        for (;;) {
+            int32_t epoch = mEpoch & 1;
+            __sync_fetch_and_add(&mReaders[epoch], 1);
+            // counted into the epoch publish() waits for, or retried
+            if ((__sync_fetch_and_add(&mEpoch, 0) & 1) == epoch) return epoch;
+            __sync_fetch_and_sub(&mReaders[epoch], 1);
+        }
+    }
+    void leave(int32_t epoch) const
+    {
+        __sync_fetch_and_sub(&mReaders[epoch], 1);
+    }
+
+    // readers hold a frame at most, so the writer polls
+    static const useconds_t kGraceWaitUs = 500;
+
+    T* volatile                 mState;
+    mutable volatile int32_t    mEpoch;
+    mutable volatile int32_t    mReaders[2];
+};
+
+#endif // PUBLISHED_STATE_H_INCLUDED
@@ -0,0 +1,54 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 2009 Android Open Source Project
+ * Copyright (c) 2009, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef QCOM_PLATFORM_PRIVATE_H_INCLUDED
+#define QCOM_PLATFORM_PRIVATE_H_INCLUDED
+
+#include "oscl_types.h"
+
+#define PLATFORM_PRIVATE_PMEM 1
+
+// data structures for tunneling buffers
+typedef struct PLATFORM_PRIVATE_PMEM_INFO
+{
+    /* pmem file descriptor */
+    uint32 pmem_fd;
+    uint32 offset;
+} PLATFORM_PRIVATE_PMEM_INFO;
+
+typedef struct PLATFORM_PRIVATE_ENTRY
+{
+    /* Entry type */
+    uint32 type;
+
+    /* Pointer to platform specific entry */
+    OsclAny* entry;
+} PLATFORM_PRIVATE_ENTRY;
+
+typedef struct PLATFORM_PRIVATE_LIST
+{
+    /* Number of entries */
+    uint32 nEntries;
+
+    /* Pointer to array of platform specific entries *
+     * Contiguous block of PLATFORM_PRIVATE_ENTRY elements */
+    PLATFORM_PRIVATE_ENTRY* entryList;
+} PLATFORM_PRIVATE_LIST;
+
+#endif // QCOM_PLATFORM_PRIVATE_H_INCLUDED
@@ -0,0 +1,169 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "QualityLadder"
+#include <utils/Log.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/properties.h>
+
+#include "quality_ladder.h"
+
+// rough cost of each level per frame interval, relative to full; only
+// used to predict whether the level above would fit again
+static const int kLevelCost[QualityLadder::LEVEL_COUNT] = { 100, 80, 35, 18 };
+
+// until the timestamps say otherwise
+static const nsecs_t kDefaultInterval = 33333333;
+
+QualityLadder::QualityLadder() :
+    mEnabled(false),
+    mBudgetPercent(40),
+    mMaxLevel(LEVEL_FULL),
+    mLevel(LEVEL_FULL),
+    mFrames(0),
+    mDropped(0),
+    mTransitions(0)
+{
+    memset(mLevelFrames, 0, sizeof(mLevelFrames));
+    reset(LEVEL_FULL);
+}
+
+void QualityLadder::reset(int maxLevel)
+{
+    char value[PROPERTY_VALUE_MAX];
+    property_get("persist.pv.ladder", value, "0");
+    mEnabled = atoi(value) ? true : false;
+    property_get("persist.pv.ladder.budget", value, "40");
+    mBudgetPercent = atoi(value);
+    if (mBudgetPercent <= 0) mBudgetPercent = 40;
+
+    mMaxLevel = (maxLevel < LEVEL_COUNT) ? maxLevel : LEVEL_COUNT - 1;
+    mLevel = LEVEL_FULL;
+    mLastTimestamp = -1;
+    mInterval = kDefaultInterval;
+    mCost = 0;
+    mStart = 0;
+    mDownCount = 0;
+    mUpCount = 0;
+    mDropNext = false;
+}
+
+bool QualityLadder::beginFrame(int64_t timestampMs)
+{
+    if (!mEnabled) return true;
+
+    // ignore seeks and timestamp resets
+    if (mLastTimestamp >= 0) {
+        int64_t delta = timestampMs - mLastTimestamp;
+        if ((delta > 0) && (delta < 1000)) {
+            mInterval += (ms2ns(delta) - mInterval) / 8;
+        }
+    }
+    mLastTimestamp = timestampMs;
+    mFrames++;
+
+    if (mLevel == LEVEL_DECIMATE) {
+        mDropNext = !mDropNext;
+        if (mDropNext) {
+            mDropped++;
+            mLevelFrames[mLevel]++;
+            update(0);
+            return false;
+        }
+    }
+
+    mStart = systemTime(SYSTEM_TIME_MONOTONIC);
+    return true;
+}
+
+void QualityLadder::endFrame()
+{
+    if (!mEnabled) return;
+    mLevelFrames[mLevel]++;
+    update(systemTime(SYSTEM_TIME_MONOTONIC) - mStart);
+}
+
+void QualityLadder::update(nsecs_t cost)
+{
+    mCost += (cost - mCost) / 8;
+    nsecs_t budget = (mInterval * mBudgetPercent) / 100;
+
+    if (mCost > budget) {
+        mUpCount = 0;
+        if ((++mDownCount >= kDownFrames) && (mLevel < mMaxLevel)) step(mLevel + 1);
+        return;
+    }
+
+    mDownCount = 0;
+    if (mLevel == LEVEL_FULL) return;
+    nsecs_t predicted = (mCost * kLevelCost[mLevel - 1]) / kLevelCost[mLevel];
+    if (predicted < (budget * 3) / 4) {
+        if (++mUpCount >= kUpFrames) step(mLevel - 1);
+    } else {
+        mUpCount = 0;
+    }
+}
+
+void QualityLadder::step(int level)
+{
+    Transition& t = mHistory[mTransitions % kHistory];
+    t.frame = mFrames;
+    t.from = mLevel;
+    t.to = level;
+    t.cost = mCost;
+    t.budget = (mInterval * mBudgetPercent) / 100;
+    mTransitions++;
+    LOGV("frame %lu: %s -> %s (cost %lld us, budget %lld us)", t.frame, levelName(t.from),
+         levelName(t.to), (long long)(t.cost / 1000), (long long)(t.budget / 1000));
+
+    // carry the average over as an estimate for the new level
+    mCost = (mCost * kLevelCost[level]) / kLevelCost[mLevel];
+    mLevel = level;
+    mDownCount = 0;
+    mUpCount = 0;
+    mDropNext = false;
+}
+
+const char* QualityLadder::levelName(int level)
+{
+    switch (level) {
+    case LEVEL_FULL:            return "full";
+    case LEVEL_CHROMA_REUSE:    return "chroma-reuse";
+    case LEVEL_HALF_SIZE:       return "half-size";
+    case LEVEL_DECIMATE:        return "decimate";
+    default:                    return "?";
+    }
+}
+
+void QualityLadder::print(const char* name) const
+{
+    if (mFrames == 0) return;
+    LOGE("%s: quality ladder at %s, frames full %lu, chroma-reuse %lu, half-size %lu, decimate %lu (%lu dropped)",
+         name, levelName(mLevel), mLevelFrames[LEVEL_FULL], mLevelFrames[LEVEL_CHROMA_REUSE],
+         mLevelFrames[LEVEL_HALF_SIZE], mLevelFrames[LEVEL_DECIMATE], mDropped);
+
+    unsigned long first = (mTransitions > kHistory) ? mTransitions - kHistory : 0;
+    for (unsigned long i = first; i < mTransitions; i++) {
+        const Transition& t = mHistory[i % kHistory];
+        LOGE("%s:   frame %lu: %s -> %s (cost %lld us, budget %lld us)", name, t.frame,
+             levelName(t.from), levelName(t.to), (long long)(t.cost / 1000), (long long)(t.budget / 1000));
+    }
+}
@@ -0,0 +1,105 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef QUALITY_LADDER_H_INCLUDED
+#define QUALITY_LADDER_H_INCLUDED
+
+#include <stdint.h>
+#include <utils/Timers.h>
+
+/*
+ * Picks how much work the software frame path does per frame, so a stream
+ * too heavy for the cpu degrades predictably instead of the player
+ * dropping whole frames at random.
+ *
+ * The conversion cost of each frame is averaged and compared with a share
+ * of the frame interval taken from the timestamps (persist.pv.ladder.budget,
+ * percent, default 40).  Eight frames in a row over budget step one level
+ * down.  Stepping back up needs the cost the level above is expected to
+ * have to stay under three quarters of the budget for kUpFrames frames,
+ * so the ladder does not flap around the limit.
+ *
+ * persist.pv.ladder turns it on (default 0); each transition is kept for
+ * the statistics printout.
+ */
+class QualityLadder
+{
+public:
+    enum {
+        LEVEL_FULL = 0,         // every frame converted at full size
+        LEVEL_CHROMA_REUSE,     // chroma refreshed on every other use of a slot
+        LEVEL_HALF_SIZE,        // 2:1 downscaled, the display scales it back up
+        LEVEL_DECIMATE,         // half size and every other frame dropped
+        LEVEL_COUNT
+    };
+
+    QualityLadder();
+
+    // back to full quality for a new stream; maxLevel is the lowest level
+    // the output can do
+    void reset(int maxLevel);
+    bool enabled() const { return mEnabled; }
+
+    // before converting a frame; false when the frame is to be dropped
+    bool beginFrame(int64_t timestampMs);
+    // after converting it; may change level() for the next frame
+    void endFrame();
+
+    int level() const { return mLevel; }
+
+    void print(const char* name) const;
+
+    static const char* levelName(int level);
+
+private:
+    void update(nsecs_t cost);
+    void step(int level);
+
+    static const int kDownFrames = 8;
+    static const int kUpFrames = 90;
+    static const int kHistory = 16;
+
+    struct Transition {
+        unsigned long   frame;
+        int             from;
+        int             to;
+        nsecs_t         cost;
+        nsecs_t         budget;
+    };
+
+    bool                        mEnabled;
+    int                         mBudgetPercent;
+    int                         mMaxLevel;
+    int                         mLevel;
+
+    int64_t                     mLastTimestamp;
+    nsecs_t                     mInterval;      // averaged frame interval
+    nsecs_t                     mCost;          // averaged cost per frame interval
+    nsecs_t                     mStart;
+    int                         mDownCount;
+    int                         mUpCount;
+    bool                        mDropNext;
+
+    unsigned long               mFrames;
+    unsigned long               mDropped;
+    unsigned long               mLevelFrames[LEVEL_COUNT];
+    unsigned long               mTransitions;
+    Transition                  mHistory[kHistory];
+};
+
+#endif // QUALITY_LADDER_H_INCLUDED
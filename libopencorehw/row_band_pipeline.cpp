@@ -0,0 +1,184 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "RowBandPipeline"
+#include <utils/Log.h>
+
+#include "row_band_pipeline.h"
+
+using namespace android;
+
+RowBandPipeline::RowBandPipeline(Sink* sink) :
+    mSink(sink),
+    mRunning(false),
+    mExit(false),
+    mHead(0),
+    mCount(0),
+    mFramesPosted(0),
+    mBands(0)
+{
+}
+
+RowBandPipeline::~RowBandPipeline()
+{
+    if (!mRunning) return;
+    mLock.lock();
+    mExit = true;
+    mWork.signal();
+    mLock.unlock();
+    pthread_join(mThread, NULL);
+}
+
+bool RowBandPipeline::start()
+{
+    if (mRunning) return true;
+    if (pthread_create(&mThread, NULL, workerThread, this) != 0) {
+        LOGE("failed to start the band conversion thread");
+        return false;
+    }
+    mRunning = true;
+    return true;
+}
+
+void* RowBandPipeline::workerThread(void* arg)
+{
+    static_cast<RowBandPipeline*>(arg)->workerLoop();
+    return NULL;
+}
+
+void RowBandPipeline::workerLoop()
+{
+    Mutex::Autolock lock(mLock);
+    while (!mExit) {
+        // oldest frame with a whole band to convert; chroma rows are shared
+        // by row pairs, so bands end on an even row until the last one
+        Frame* frame = NULL;
+        int last = 0;
+        for (int i = 0; i < mCount; i++) {
+            Frame& f = mFrames[(mHead + i) % kMaxPending];
+            if (f.posted) continue;
+            last = (f.ready >= f.height) ? f.height : (f.ready & ~1);
+            if (last > f.converted) {
+                frame = &f;
+                break;
+            }
+        }
+        if (frame == NULL) {
+            mWork.wait(mLock);
+            continue;
+        }
+
+        int first = frame->converted;
+        mLock.unlock();
+        mSink->convertRows(frame->src, frame->offset, first, last - first);
+        mLock.lock();
+        frame->converted = last;
+        mBands++;
+
+        if (last == frame->height) {
+            mLock.unlock();
+            mSink->postRows(frame->offset);
+            mLock.lock();
+            frame->posted = true;
+            mFramesPosted++;
+            mDone.broadcast();
+        }
+    }
+}
+
+// caller holds mLock; the frame is fully decoded, wait for it to be posted
+void RowBandPipeline::completeLocked(Frame& frame)
+{
+    frame.ready = frame.height;
+    mWork.signal();
+    while (!frame.posted && !mExit) {
+        mDone.wait(mLock);
+    }
+}
+
+void RowBandPipeline::beginFrame(const uint8_t* src, size_t offset, int height)
+{
+    Mutex::Autolock lock(mLock);
+
+    // the decoder has moved on, so whatever it had not reported is done
+    if (mCount > 0) {
+        Frame& previous = mFrames[(mHead + mCount - 1) % kMaxPending];
+        if (previous.ready < previous.height) {
+            previous.ready = previous.height;
+            mWork.signal();
+        }
+    }
+
+    // a frame writeFrameBuf never asked for (dropped by the player)
+    if (mCount == kMaxPending) {
+        completeLocked(mFrames[mHead]);
+        mHead = (mHead + 1) % kMaxPending;
+        mCount--;
+    }
+
+    Frame& f = mFrames[(mHead + mCount) % kMaxPending];
+    f.src = src;
+    f.offset = offset;
+    f.height = height;
+    f.ready = 0;
+    f.converted = 0;
+    f.posted = false;
+    mCount++;
+}
+
+void RowBandPipeline::rowsDecoded(int rows)
+{
+    Mutex::Autolock lock(mLock);
+    if (mCount == 0) return;
+
+    Frame& f = mFrames[(mHead + mCount - 1) % kMaxPending];
+    if (rows > f.height) rows = f.height;
+    if (rows > f.ready) {
+        f.ready = rows;
+        mWork.signal();
+    }
+}
+
+bool RowBandPipeline::finishFrame(const uint8_t* src)
+{
+    Mutex::Autolock lock(mLock);
+
+    int match = -1;
+    for (int i = 0; i < mCount; i++) {
+        if (mFrames[(mHead + i) % kMaxPending].src == src) {
+            match = i;
+            break;
+        }
+    }
+    if (match < 0) return false;
+
+    // older entries were dropped on the way to writeFrameBuf
+    for (int i = 0; i <= match; i++) {
+        completeLocked(mFrames[mHead]);
+        mHead = (mHead + 1) % kMaxPending;
+        mCount--;
+    }
+    return true;
+}
+
+bool RowBandPipeline::idle()
+{
+    Mutex::Autolock lock(mLock);
+    return mCount == 0;
+}
@@ -0,0 +1,108 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef ROW_BAND_PIPELINE_H_INCLUDED
+#define ROW_BAND_PIPELINE_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <utils/threads.h>
+
+/*
+ * Converts a software decoded frame band by band while the decoder is
+ * still working on the rows below, for low latency (video call) streams.
+ *
+ * The decoder announces a frame with beginFrame() and reports progress
+ * with rowsDecoded() after each macroblock row.  A worker thread converts
+ * every newly completed band into the frame buffer slot the MIO picked and
+ * posts the slot the moment the last band is written.  When the same frame
+ * later reaches writeFrameBuf, finishFrame() recognises it and the MIO has
+ * nothing left to do.
+ *
+ * Frames the decoder never announces take the normal whole-frame path.
+ */
+class RowBandPipeline
+{
+public:
+    // implemented by the MIO
+    class Sink {
+    public:
+        virtual ~Sink() {}
+        // convert rows [firstRow, firstRow + rows) of src into the slot at offset
+        virtual void convertRows(const uint8_t* src, size_t offset, int firstRow, int rows) = 0;
+        // all rows are in, display the slot
+        virtual void postRows(size_t offset) = 0;
+    };
+
+    RowBandPipeline(Sink* sink);
+    ~RowBandPipeline();
+
+    bool start();
+
+    // decoder side; height is the number of rows the frame will report
+    void beginFrame(const uint8_t* src, size_t offset, int height);
+    // rows counts all rows of the current frame that are complete so far
+    void rowsDecoded(int rows);
+
+    // MIO side, from writeFrameBuf: true if src went through the pipeline,
+    // in which case it has been (or, after waiting here, is) posted
+    bool finishFrame(const uint8_t* src);
+
+    // no frame announced that writeFrameBuf has not seen yet, so nothing
+    // is or will be written into the slots without a new beginFrame()
+    bool idle();
+
+    unsigned long frames() const { return mFramesPosted; }
+    unsigned long bands() const { return mBands; }
+
+private:
+    // frames that went through the bands but have not been matched by
+    // finishFrame yet; the decoder may run a couple of frames ahead
+    static const int kMaxPending = 4;
+
+    struct Frame {
+        const uint8_t*  src;
+        size_t          offset;
+        int             height;
+        int             ready;      // rows decoded
+        int             converted;  // rows converted, always even or height
+        bool            posted;
+    };
+
+    static void* workerThread(void* arg);
+    void workerLoop();
+    void completeLocked(Frame& frame);
+
+    Sink*                       mSink;
+    android::Mutex              mLock;
+    android::Condition          mWork;
+    android::Condition          mDone;
+    pthread_t                   mThread;
+    bool                        mRunning;
+    bool                        mExit;
+
+    Frame                       mFrames[kMaxPending];
+    int                         mHead;      // oldest frame not yet matched
+    int                         mCount;
+
+    unsigned long               mFramesPosted;
+    unsigned long               mBands;
+};
+
+#endif // ROW_BAND_PIPELINE_H_INCLUDED
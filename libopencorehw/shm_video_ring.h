@@ -0,0 +1,190 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef SHM_VIDEO_RING_H_INCLUDED
+#define SHM_VIDEO_RING_H_INCLUDED
+
+/*
+ * Shared memory frame ring published by AndroidSurfaceOutputShm.
+ *
+ * The video MIO keeps the ring in a memfd (ashmem on kernels without
+ * memfd_create) and hands the descriptor to whoever connects to the
+ * abstract unix socket named by persist.pv.shm.socket.  The first video
+ * output of the process listens on that name; one playing alongside it
+ * listens on <name>-1, the next on <name>-2.  The consumer maps the ring
+ * read/write and reads frames straight out of the slots.
+ *
+ * Protocol, single producer and a single consuming reader:
+ *
+ *   - writeSeq counts published frames.  The frame with sequence s lives
+ *     in slot s % slotCount.  The producer fills the slot, then bumps
+ *     writeSeq and FUTEX_WAKEs it.
+ *   - readSeq counts frames the consumer is done with.  The consumer
+ *     FUTEX_WAITs on writeSeq while writeSeq == readSeq, reads the slot,
+ *     then bumps readSeq and FUTEX_WAKEs it.
+ *   - While a consumer is attached (consumerPid != 0) the producer never
+ *     overwrites an unreleased slot; it waits on readSeq for a bounded
+ *     time and drops the frame if the consumer stays behind.  With no
+ *     consumer it overwrites freely and keeps readSeq in step itself.
+ *   - When the stream ends or changes format the producer sets state to
+ *     SHM_VIDEO_RING_CLOSED and wakes both words.  A new ring, with a new
+ *     descriptor, is served to the next connection.
+ *
+ * The consumer only writes the words in ShmVideoRingConsumer.  The
+ * producer keeps its own copy of everything else and never reads it back,
+ * so a consumer scribbling over the layout cannot move where it writes.
+ *
+ * The futexes are process-shared, so no FUTEX_PRIVATE_FLAG.
+ */
+
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define SHM_VIDEO_RING_MAGIC        0x47525650  /* "PVRG" */
+#define SHM_VIDEO_RING_VERSION      2
+#define SHM_VIDEO_RING_MAX_SLOTS    16
+
+// default abstract socket name, without the leading NUL
+#define SHM_VIDEO_RING_SOCKET       "pv_video_ring"
+
+enum {
+    SHM_VIDEO_RING_ACTIVE = 1,
+    SHM_VIDEO_RING_CLOSED = 2
+};
+
+enum {
+    SHM_VIDEO_FORMAT_I420 = 1,  // planar Y, U, V
+    SHM_VIDEO_FORMAT_NV21 = 2,  // Y then interleaved V/U
+    SHM_VIDEO_FORMAT_NV12 = 3   // Y then interleaved U/V
+};
+
+typedef struct ShmVideoSlot {
+    uint32_t            seq;            // sequence of the frame in the slot
+    uint32_t            size;           // bytes of frame data
+    int64_t             timestampUs;    // presentation time
+} ShmVideoSlot;
+
+typedef struct ShmVideoRingConsumer {
+    volatile uint32_t   readSeq;        // futex word
+    volatile int32_t    consumerPid;    // set while attached
+} ShmVideoRingConsumer;
+
+typedef struct ShmVideoRingHeader {
+    uint32_t            magic;
+    uint32_t            version;
+    uint32_t            totalSize;      // of the whole mapping
+    volatile int32_t    state;
+
+    uint32_t            format;
+    uint32_t            width;          // decoded frame size
+    uint32_t            height;
+    uint32_t            displayWidth;   // visible area
+    uint32_t            displayHeight;
+
+    uint32_t            slotCount;
+    uint32_t            slotSize;
+    uint32_t            slotOffset;     // page aligned offset of slot 0
+
+    volatile uint32_t   writeSeq;       // futex word
+    volatile uint32_t   dropped;        // frames dropped waiting for the consumer
+
+    ShmVideoSlot        slots[SHM_VIDEO_RING_MAX_SLOTS];
+
+    ShmVideoRingConsumer consumer;
+} ShmVideoRingHeader;
+
+// for the consumer; the producer uses its own slot layout
+static inline uint8_t* shmVideoSlotData(ShmVideoRingHeader* ring, uint32_t seq)
+{
+    return (uint8_t*)ring + ring->slotOffset + (seq % ring->slotCount) * ring->slotSize;
+}
+
+static inline int shmVideoFutexWait(volatile uint32_t* addr, uint32_t value, int timeoutMs)
+{
+    struct timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+    return syscall(__NR_futex, addr, FUTEX_WAIT, value, timeoutMs < 0 ? NULL : &ts, NULL, 0);
+}
+
+static inline void shmVideoFutexWake(volatile uint32_t* addr)
+{
+    syscall(__NR_futex, addr, FUTEX_WAKE, 0x7fffffff, NULL, NULL, 0);
+}
+
+/*
+ * Consumer side helpers.  A consumer loop looks like:
+ *
+ *   uint32_t seq;
+ *   shmVideoRingAttach(ring);
+ *   while (shmVideoRingAcquire(ring, &seq, 100) == 0) {
+ *       process(shmVideoSlotData(ring, seq), ring->slots[seq % ring->slotCount].size);
+ *       shmVideoRingRelease(ring, seq);
+ *   }
+ *   shmVideoRingDetach(ring);
+ *
+ * Acquire returns 0 with the next frame, -EAGAIN on timeout and -EPIPE
+ * once the ring is closed.
+ */
+static inline void shmVideoRingAttach(ShmVideoRingHeader* ring)
+{
+    ring->consumer.consumerPid = getpid();
+    __sync_synchronize();
+}
+
+static inline void shmVideoRingDetach(ShmVideoRingHeader* ring)
+{
+    ring->consumer.consumerPid = 0;
+    __sync_synchronize();
+    shmVideoFutexWake(&ring->consumer.readSeq);
+}
+
+static inline int shmVideoRingAcquire(ShmVideoRingHeader* ring, uint32_t* seq, int timeoutMs)
+{
+    for (;;) {
+        uint32_t read = ring->consumer.readSeq;
+        uint32_t write = ring->writeSeq;
+        if (write != read) {
+            // the producer overwrote slots while nobody was attached
+            if (write - read > ring->slotCount) {
+                read = write - ring->slotCount;
+                ring->consumer.readSeq = read;
+            }
+            __sync_synchronize();
+            *seq = read;
+            return 0;
+        }
+        if (ring->state != SHM_VIDEO_RING_ACTIVE) return -EPIPE;
+        if (shmVideoFutexWait(&ring->writeSeq, write, timeoutMs) < 0 && errno == ETIMEDOUT) {
+            return -EAGAIN;
+        }
+    }
+}
+
+static inline void shmVideoRingRelease(ShmVideoRingHeader* ring, uint32_t seq)
+{
+    __sync_synchronize();
+    ring->consumer.readSeq = seq + 1;
+    shmVideoFutexWake(&ring->consumer.readSeq);
+}
+
+#endif // SHM_VIDEO_RING_H_INCLUDED
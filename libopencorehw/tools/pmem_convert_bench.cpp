@@ -0,0 +1,207 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+/*
+ * Compares the software frame kernels of PmemFrameWriter per resolution.
+ *
+ * A frame buffer is mapped from /dev/pmem_adsp twice, once cached and once
+ * write-combined (O_SYNC), and every kernel writes I420 frames into both:
+ *
+ *   cached mapping          ordinary stores + PMEM_CLEAN_CACHES per frame
+ *   cached mapping          streaming stores + PMEM_CLEAN_CACHES per frame
+ *   write-combined mapping  ordinary stores
+ *   write-combined mapping  streaming stores
+ *
+ * The fastest row per resolution is what the MIO heap for that size should
+ * be allocated as.  Without pmem (e.g. on a host) both mappings are plain
+ * memory and only the kernels are compared.
+ *
+ *   pmem_convert_bench [-n frames] [-d device]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <binder/MemoryHeapBase.h>
+
+#include "pmem_frame_writer.h"
+
+using namespace android;
+
+#define DEFAULT_DEVICE  "/dev/pmem_adsp"
+#define DEFAULT_FRAMES  100
+
+struct Resolution {
+    const char* name;
+    int         width;
+    int         height;
+};
+
+static const Resolution kResolutions[] = {
+    { "QCIF",  176,  144 },
+    { "QVGA",  320,  240 },
+    { "VGA",   640,  480 },
+    { "WVGA",  800,  480 },
+    { "720p", 1280,  720 },
+    { "1080p", 1920, 1088 },
+};
+
+struct Mapping {
+    const char* name;
+    uint32_t    heapFlags;
+    int         fd;
+    uint8_t*    base;
+    size_t      size;
+};
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static bool mapBuffer(Mapping* m, const char* device, size_t size, bool uncached)
+{
+    m->size = size;
+    m->fd = open(device, O_RDWR | (uncached ? O_SYNC : 0));
+    if (m->fd >= 0) {
+        void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, m->fd, 0);
+        if (base != MAP_FAILED) {
+            m->base = static_cast<uint8_t*>(base);
+            return true;
+        }
+        fprintf(stderr, "cannot map %zu bytes of %s: %s\n", size, device, strerror(errno));
+        close(m->fd);
+    }
+    // no pmem: compare the kernels on ordinary memory
+    m->fd = -1;
+    m->base = static_cast<uint8_t*>(malloc(size));
+    return m->base != NULL;
+}
+
+static void unmapBuffer(Mapping* m)
+{
+    if (m->fd >= 0) {
+        munmap(m->base, m->size);
+        close(m->fd);
+    } else {
+        free(m->base);
+    }
+}
+
+static double runKernel(const Mapping& m, bool streaming, const uint8_t* src,
+                        int width, int height, int frames)
+{
+    PmemFrameWriter writer;
+    writer.init(m.heapFlags, m.fd, m.base);
+    size_t frameSize = (width * height * 3) / 2;
+
+    // two slots as the MIOs use, so consecutive frames do not hit the same lines
+    int64_t start = nowNs();
+    for (int i = 0; i < frames; i++) {
+        size_t offset = (i & 1) ? frameSize : 0;
+        if (streaming) {
+            i420ToNv21Streaming(src, m.base + offset, width, height);
+        } else {
+            i420ToNv21Cached(src, m.base + offset, width, height);
+        }
+        if (m.fd >= 0) writer.finishWrite(offset, frameSize);
+    }
+    return (nowNs() - start) / (1e6 * frames);
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-n frames] [-d device]\n", name);
+}
+
+int main(int argc, char** argv)
+{
+    const char* device = DEFAULT_DEVICE;
+    int frames = DEFAULT_FRAMES;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:d:h")) != -1) {
+        switch (opt) {
+        case 'n': frames = atoi(optarg); break;
+        case 'd': device = optarg; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (frames <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const Resolution& largest = kResolutions[sizeof(kResolutions) / sizeof(kResolutions[0]) - 1];
+    size_t maxFrame = (largest.width * largest.height * 3) / 2;
+    size_t mapSize = (2 * maxFrame + 4095) & ~4095;
+
+    Mapping mappings[2];
+    mappings[0].name = "cached";
+    mappings[0].heapFlags = 0;
+    mappings[1].name = "write-combined";
+    mappings[1].heapFlags = MemoryHeapBase::NO_CACHING;
+    for (int i = 0; i < 2; i++) {
+        if (!mapBuffer(&mappings[i], device, mapSize, i == 1)) {
+            fprintf(stderr, "cannot allocate frame buffers\n");
+            return 1;
+        }
+    }
+    if (mappings[0].fd < 0) {
+        printf("%s not available, both mappings are ordinary memory\n", device);
+    }
+
+    // decoder output lives in ordinary cached memory
+    uint8_t* src = static_cast<uint8_t*>(malloc(maxFrame));
+    for (size_t i = 0; i < maxFrame; i++) src[i] = (i * 7) ^ (i >> 9);
+
+    printf("%d frames per run, ms per frame\n", frames);
+    printf("%-6s %12s %12s %12s %12s   %s\n", "", "cached", "cached", "wc", "wc", "best");
+    printf("%-6s %12s %12s %12s %12s\n", "", "+clean", "stream+clean", "", "stream");
+
+    for (size_t r = 0; r < sizeof(kResolutions) / sizeof(kResolutions[0]); r++) {
+        const Resolution& res = kResolutions[r];
+        static const char* kNames[4] = { "cached+clean", "cached stream+clean", "wc", "wc stream" };
+        double ms[4];
+        ms[0] = runKernel(mappings[0], false, src, res.width, res.height, frames);
+        ms[1] = runKernel(mappings[0], true, src, res.width, res.height, frames);
+        ms[2] = runKernel(mappings[1], false, src, res.width, res.height, frames);
+        ms[3] = runKernel(mappings[1], true, src, res.width, res.height, frames);
+
+        int best = 0;
+        for (int k = 1; k < 4; k++) {
+            if (ms[k] < ms[best]) best = k;
+        }
+        printf("%-6s %12.3f %12.3f %12.3f %12.3f   %s\n", res.name, ms[0], ms[1], ms[2], ms[3], kNames[best]);
+    }
+
+    free(src);
+    unmapBuffer(&mappings[0]);
+    unmapBuffer(&mappings[1]);
+    return 0;
+}
@@ -0,0 +1,175 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef TRACE_REPLAY_ANDROID_SURFACE_OUTPUT_H_INCLUDED
+#define TRACE_REPLAY_ANDROID_SURFACE_OUTPUT_H_INCLUDED
+
+/*
+ * Host stand-in for the OpenCORE AndroidSurfaceOutput the MSM outputs
+ * derive from: only the parameters, frame buffer bookkeeping and hooks
+ * they use.  The replay harness sets the video parameters directly where
+ * the player would go through setParametersSync.
+ *
+ * writeAsync keeps the decoder buffer of each frame written until
+ * mNumberOfFramesToHold newer ones have been, as the OpenCORE write
+ * response queue does, and hands it back through writeComplete.
+ */
+
+#include <string.h>
+#include <utils/Log.h>
+#include <utils/threads.h>
+#include <surfaceflinger/ISurface.h>
+#include <media/PVPlayer.h>
+
+#include "oscl_types.h"
+
+using namespace android;
+
+typedef int32 PVMFStatus;
+#define PVMFSuccess         1
+#define PVMFFailure         (-1)
+#define PVMFErrNoMemory     (-2)
+
+#define PVMF_MIME_YUV420                            "X-YUV-420"
+#define PVMF_MIME_YUV420_SEMIPLANAR                 "X-YUV-420-SEMIPLANAR"
+#define PVMF_MIME_YUV420_SEMIPLANAR_YVU             "X-YUV-420-SEMIPLANAR-YVU"
+#define PVMF_MIME_YUV420_SEMIPLANAR_YVU_INTERLACE   "X-YUV-420-SEMIPLANAR-YVU-INTERLACE"
+#define PVMF_MIME_YUV420_PACKEDSEMIPLANAR_TILE      "X-YUV-420-PACKEDSEMIPLANAR-TILE"
+
+// compared by MIME string like the OpenCORE one; the string is not copied
+class PVMFFormatType
+{
+public:
+    PVMFFormatType(const char* mime = "") : mMime(mime) {}
+    const char* getMIMEStrPtr() const { return mMime; }
+    bool operator==(const char* mime) const { return !strcmp(mMime, mime); }
+    bool operator!=(const char* mime) const { return strcmp(mMime, mime) != 0; }
+    bool operator==(const PVMFFormatType& other) const { return !strcmp(mMime, other.mMime); }
+private:
+    const char* mMime;
+};
+
+struct PvmiMediaXferHeader {
+    uint32      seq_num;
+    uint64      timestamp;
+    uint32      flags;
+    uint32      duration;
+    uint32      stream_id;
+    OsclAny*    private_data_ptr;
+};
+
+#define VIDEO_DISPLAY_WIDTH_VALID   0x01
+#define VIDEO_DISPLAY_HEIGHT_VALID  0x02
+#define VIDEO_WIDTH_VALID           0x04
+#define VIDEO_HEIGHT_VALID          0x08
+#define VIDEO_SUBFORMAT_VALID       0x10
+
+class AndroidSurfaceOutput
+{
+public:
+    AndroidSurfaceOutput() :
+        iVideoParameterFlags(0),
+        iVideoHeight(0),
+        iVideoWidth(0),
+        iVideoDisplayHeight(0),
+        iVideoDisplayWidth(0),
+        mFrameBufferIndex(0),
+        mInitialized(false),
+        mPvPlayer(NULL),
+        mNumberOfFramesToHold(1),
+        mHeldFirst(0),
+        mHeldCount(0)
+    {
+        memset(mFrameBuffers, 0, sizeof(mFrameBuffers));
+    }
+    virtual ~AndroidSurfaceOutput() {}
+
+    // the player's side of a frame; writeFrameBuf's status is what the
+    // write response of the frame carries
+    PVMFStatus writeAsync(uint8* aData, uint32 aDataLen, const PvmiMediaXferHeader& data_header_info)
+    {
+        PVMFStatus status = writeFrameBuf(aData, aDataLen, data_header_info);
+        if (mHeldCount == kMaxHeld) releaseOldest();
+        mHeld[(mHeldFirst + mHeldCount++) % kMaxHeld] = data_header_info.seq_num;
+        while (mHeldCount > mNumberOfFramesToHold) releaseOldest();
+        return status;
+    }
+    // flush: every buffer held goes back
+    void releaseHeld()
+    {
+        while (mHeldCount > 0) releaseOldest();
+    }
+
+    virtual bool initCheck() = 0;
+    virtual PVMFStatus writeFrameBuf(uint8* aData, uint32 aDataLen, const PvmiMediaXferHeader& data_header_info) = 0;
+    virtual void postLastFrame() {}
+    virtual void closeFrameBuf()
+    {
+        if (!mInitialized) return;
+        mInitialized = false;
+        if (mSurface != 0) mSurface->unregisterBuffers();
+        mBufferHeap.heap.clear();
+    }
+
+protected:
+    // a decoder buffer goes back; seq_num of the frame it carried
+    virtual void writeComplete(uint32 seq) {}
+
+    bool checkVideoParameterFlags()
+    {
+        const uint32 all = VIDEO_DISPLAY_WIDTH_VALID | VIDEO_DISPLAY_HEIGHT_VALID |
+                           VIDEO_WIDTH_VALID | VIDEO_HEIGHT_VALID;
+        return (iVideoParameterFlags & all) == all;
+    }
+    void resetVideoParameterFlags() { iVideoParameterFlags = 0; }
+
+    uint32                  iVideoParameterFlags;
+    int                     iVideoHeight;
+    int                     iVideoWidth;
+    int                     iVideoDisplayHeight;
+    int                     iVideoDisplayWidth;
+    PVMFFormatType          iVideoFormat;
+    PVMFFormatType          iVideoSubFormat;
+
+    sp<ISurface>            mSurface;
+    ISurface::BufferHeap    mBufferHeap;
+
+    static const int kBufferCount = 2;
+    int                     mFrameBufferIndex;
+    uint32                  mFrameBuffers[kBufferCount];
+
+    bool                    mInitialized;
+    PVPlayer*               mPvPlayer;
+    int                     mNumberOfFramesToHold;
+
+private:
+    void releaseOldest()
+    {
+        uint32 seq = mHeld[mHeldFirst];
+        mHeldFirst = (mHeldFirst + 1) % kMaxHeld;
+        mHeldCount--;
+        writeComplete(seq);
+    }
+
+    static const int kMaxHeld = 16;
+    uint32                  mHeld[kMaxHeld];
+    int                     mHeldFirst;
+    int                     mHeldCount;
+};
+
+#endif // TRACE_REPLAY_ANDROID_SURFACE_OUTPUT_H_INCLUDED
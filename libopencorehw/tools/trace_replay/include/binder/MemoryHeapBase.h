@@ -0,0 +1,114 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef TRACE_REPLAY_MEMORY_HEAP_BASE_H_INCLUDED
+#define TRACE_REPLAY_MEMORY_HEAP_BASE_H_INCLUDED
+
+/*
+ * Host stand-in for the binder heaps.  Heaps opened on a device come out
+ * of a pmem pool of fixed size and fail like the kernel would once it is
+ * spent; the others are plain memory.  Every heap gets a made-up fd.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <utils/RefBase.h>
+#include <utils/Errors.h>
+
+namespace android {
+
+class IMemoryHeap : public virtual RefBase
+{
+public:
+    virtual int getHeapID() const = 0;
+    virtual void* getBase() const = 0;
+    virtual size_t getSize() const = 0;
+    virtual uint32_t getFlags() const = 0;
+
+    int heapID() const { return getHeapID(); }
+    void* base() const { return getBase(); }
+    size_t virtualSize() const { return getSize(); }
+};
+
+class MemoryHeapBase : public virtual IMemoryHeap
+{
+public:
+    enum {
+        READ_ONLY = 0x00000001,
+        DONT_MAP_LOCALLY = 0x00000100,
+        NO_CACHING = 0x00000200
+    };
+
+    MemoryHeapBase(const char* device, size_t size = 0, uint32_t flags = 0) :
+        mBase(NULL), mSize(size), mFlags(flags), mFd(-1), mDevice(true)
+    {
+        Pool& p = pool();
+        if ((p.limit != 0) && (p.used + size > p.limit)) return;
+        mBase = calloc(1, size ? size : 1);
+        if (mBase == NULL) return;
+        mFd = p.nextFd++;
+        p.used += size;
+        if (p.used > p.peak) p.peak = p.used;
+    }
+    MemoryHeapBase(size_t size, uint32_t flags = 0, const char* name = NULL) :
+        mBase(calloc(1, size ? size : 1)), mSize(size), mFlags(flags), mFd(pool().nextFd++), mDevice(false) {}
+    virtual ~MemoryHeapBase()
+    {
+        if (mDevice && (mFd >= 0)) pool().used -= mSize;
+        free(mBase);
+    }
+
+    virtual int getHeapID() const { return mFd; }
+    virtual void* getBase() const { return mBase; }
+    virtual size_t getSize() const { return mSize; }
+    virtual uint32_t getFlags() const { return mFlags; }
+    status_t setDevice(const char* device) { return NO_ERROR; }
+
+    // the pmem pool of device heaps, 0 for no limit
+    static void setPmemLimit(size_t bytes) { pool().limit = bytes; }
+    static size_t pmemUsed() { return pool().used; }
+    static size_t pmemPeak() { return pool().peak; }
+
+protected:
+    // a second mapping of parent's memory
+    MemoryHeapBase(const MemoryHeapBase* parent, uint32_t flags) :
+        mBase(NULL), mSize(0), mFlags(flags), mFd(parent->mFd), mDevice(false) {}
+
+private:
+    struct Pool {
+        size_t  limit;
+        size_t  used;
+        size_t  peak;
+        int     nextFd;
+    };
+    static Pool& pool()
+    {
+        static Pool p = { 0, 0, 0, 100 };
+        return p;
+    }
+
+    void*       mBase;
+    size_t      mSize;
+    uint32_t    mFlags;
+    int         mFd;
+    bool        mDevice;
+};
+
+}; // namespace android
+
+#endif // TRACE_REPLAY_MEMORY_HEAP_BASE_H_INCLUDED
@@ -0,0 +1,46 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef TRACE_REPLAY_MEMORY_HEAP_PMEM_H_INCLUDED
+#define TRACE_REPLAY_MEMORY_HEAP_PMEM_H_INCLUDED
+
+// host stand-in: the client heap shares the master's memory and fd
+
+#include <binder/MemoryHeapBase.h>
+
+namespace android {
+
+class MemoryHeapPmem : public MemoryHeapBase
+{
+public:
+    MemoryHeapPmem(const sp<MemoryHeapBase>& pmemHeap, uint32_t flags = 0) :
+        MemoryHeapBase(pmemHeap.get(), flags), mParent(pmemHeap) {}
+
+    virtual void* getBase() const { return mParent->getBase(); }
+    virtual size_t getSize() const { return mParent->getSize(); }
+
+    status_t slap() { return NO_ERROR; }
+    status_t unslap() { return NO_ERROR; }
+
+private:
+    sp<MemoryHeapBase> mParent;
+};
+
+}; // namespace android
+
+#endif // TRACE_REPLAY_MEMORY_HEAP_PMEM_H_INCLUDED
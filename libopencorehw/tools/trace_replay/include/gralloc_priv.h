@@ -0,0 +1,36 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef TRACE_REPLAY_GRALLOC_PRIV_H_INCLUDED
+#define TRACE_REPLAY_GRALLOC_PRIV_H_INCLUDED
+
+// host stand-in: the HAL pixel formats of libgralloc-qsd8k
+
+enum {
+    HAL_PIXEL_FORMAT_RGBA_8888          = 1,
+    HAL_PIXEL_FORMAT_RGBX_8888          = 2,
+    HAL_PIXEL_FORMAT_RGB_565            = 4,
+    HAL_PIXEL_FORMAT_YCbCr_422_SP       = 0x10,
+    HAL_PIXEL_FORMAT_YCrCb_420_SP       = 0x11,
+    HAL_PIXEL_FORMAT_YCbCr_420_SP       = 0x109,
+    HAL_PIXEL_FORMAT_YCrCb_422_SP       = 0x10B,
+    HAL_PIXEL_FORMAT_YCbCr_420_SP_TILED = 0x7FA30C03,
+    HAL_PIXEL_FORMAT_INTERLACE          = 0x180
+};
+
+#endif // TRACE_REPLAY_GRALLOC_PRIV_H_INCLUDED
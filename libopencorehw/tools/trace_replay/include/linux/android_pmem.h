@@ -0,0 +1,24 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef TRACE_REPLAY_ANDROID_PMEM_H_INCLUDED
+#define TRACE_REPLAY_ANDROID_PMEM_H_INCLUDED
+
+// host stand-in: no PMEM_CLEAN_CACHES, the stand-in heaps are not pmem
+
+#endif // TRACE_REPLAY_ANDROID_PMEM_H_INCLUDED
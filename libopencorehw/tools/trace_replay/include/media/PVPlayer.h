@@ -0,0 +1,37 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef TRACE_REPLAY_PVPLAYER_H_INCLUDED
+#define TRACE_REPLAY_PVPLAYER_H_INCLUDED
+
+// host stand-in: the video outputs only send the video size
+
+namespace android {
+
+enum { MEDIA_SET_VIDEO_SIZE = 5 };
+
+class PVPlayer
+{
+public:
+    virtual ~PVPlayer() {}
+    virtual void sendEvent(int msg, int ext1 = 0, int ext2 = 0) {}
+};
+
+}; // namespace android
+
+#endif // TRACE_REPLAY_PVPLAYER_H_INCLUDED
@@ -0,0 +1,40 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef TRACE_REPLAY_OSCL_TYPES_H_INCLUDED
+#define TRACE_REPLAY_OSCL_TYPES_H_INCLUDED
+
+// host stand-in for the OpenCORE basic types the video outputs use
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint8_t     uint8;
+typedef int8_t      int8;
+typedef uint16_t    uint16;
+typedef int16_t     int16;
+typedef uint32_t    uint32;
+typedef int32_t     int32;
+typedef uint64_t    uint64;
+typedef int64_t     int64;
+typedef void        OsclAny;
+
+#define OSCL_EXPORT_REF
+#define OSCL_IMPORT_REF
+
+#endif // TRACE_REPLAY_OSCL_TYPES_H_INCLUDED
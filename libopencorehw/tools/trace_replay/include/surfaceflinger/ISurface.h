@@ -0,0 +1,72 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef TRACE_REPLAY_ISURFACE_H_INCLUDED
+#define TRACE_REPLAY_ISURFACE_H_INCLUDED
+
+// host stand-in for the push buffer surface; the replay harness implements it
+
+#include <sys/types.h>
+#include <utils/RefBase.h>
+#include <utils/Errors.h>
+#include <binder/MemoryHeapBase.h>
+#include <ui/Overlay.h>
+
+namespace android {
+
+class ISurface : public virtual RefBase
+{
+public:
+    class BufferHeap
+    {
+    public:
+        enum {
+            ROT_0 = 0,
+            ROT_90 = 4,
+            ROT_180 = 3,
+            ROT_270 = 7
+        };
+        BufferHeap() : w(0), h(0), hor_stride(0), ver_stride(0), format(0), transform(0), flags(0) {}
+        BufferHeap(uint32_t w, uint32_t h, int32_t hor_stride, int32_t ver_stride,
+                   int format, const sp<IMemoryHeap>& heap) :
+            w(w), h(h), hor_stride(hor_stride), ver_stride(ver_stride),
+            format(format), transform(0), flags(0), heap(heap) {}
+        BufferHeap(uint32_t w, uint32_t h, int32_t hor_stride, int32_t ver_stride,
+                   int format, uint32_t transform, uint32_t flags, const sp<IMemoryHeap>& heap) :
+            w(w), h(h), hor_stride(hor_stride), ver_stride(ver_stride),
+            format(format), transform(transform), flags(flags), heap(heap) {}
+
+        uint32_t w;
+        uint32_t h;
+        int32_t hor_stride;
+        int32_t ver_stride;
+        int format;
+        uint32_t transform;
+        uint32_t flags;
+        sp<IMemoryHeap> heap;
+    };
+
+    virtual status_t registerBuffers(const BufferHeap& buffers) = 0;
+    virtual void postBuffer(ssize_t offset) = 0;
+    virtual void unregisterBuffers() = 0;
+    virtual sp<OverlayRef> createOverlay(uint32_t w, uint32_t h, int32_t format, int32_t orientation) = 0;
+};
+
+}; // namespace android
+
+#endif // TRACE_REPLAY_ISURFACE_H_INCLUDED
@@ -0,0 +1,83 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef TRACE_REPLAY_OVERLAY_H_INCLUDED
+#define TRACE_REPLAY_OVERLAY_H_INCLUDED
+
+/*
+ * Host stand-in for the overlay client.  The OverlayRef a surface hands
+ * out carries the listener the overlay reports to, so the replay harness
+ * sees what is queued to it.
+ */
+
+#include <utils/RefBase.h>
+#include <utils/Errors.h>
+
+namespace android {
+
+typedef void* overlay_buffer_t;
+
+class OverlayListener
+{
+public:
+    virtual ~OverlayListener() {}
+    virtual void overlayQueued(overlay_buffer_t buffer) = 0;
+    virtual void overlaySetFd(int fd) {}
+};
+
+class OverlayRef : public RefBase
+{
+public:
+    explicit OverlayRef(OverlayListener* listener = NULL) : mListener(listener) {}
+    OverlayListener* listener() const { return mListener; }
+private:
+    OverlayListener* mListener;
+};
+
+class Overlay : public virtual RefBase
+{
+public:
+    Overlay(const sp<OverlayRef>& ref) : mRef(ref) {}
+
+    void destroy() { mRef.clear(); }
+    status_t getStatus() const { return (mRef == 0) ? NO_INIT : NO_ERROR; }
+
+    status_t queueBuffer(overlay_buffer_t buffer)
+    {
+        if (mRef == 0) return NO_INIT;
+        if (mRef->listener() != NULL) mRef->listener()->overlayQueued(buffer);
+        return NO_ERROR;
+    }
+    status_t setFd(int fd)
+    {
+        if (mRef == 0) return NO_INIT;
+        if (mRef->listener() != NULL) mRef->listener()->overlaySetFd(fd);
+        return NO_ERROR;
+    }
+    status_t setCrop(uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+    {
+        return (mRef == 0) ? NO_INIT : NO_ERROR;
+    }
+
+private:
+    sp<OverlayRef> mRef;
+};
+
+}; // namespace android
+
+#endif // TRACE_REPLAY_OVERLAY_H_INCLUDED
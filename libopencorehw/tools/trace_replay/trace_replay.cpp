@@ -0,0 +1,489 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+/*
+ * Replays frame traces recorded with persist.pv.trace (see frame_trace.h)
+ * into a video output on the host, so two builds can be compared on the
+ * same decode without a device.
+ *
+ * The MIO is the real one, built against the stand-ins in include/: a
+ * surface that notes when frames are posted, overlays up to a fixed count
+ * and a pmem pool of fixed size.  Every trace gets a fresh output.  Frames
+ * are written when they arrived in the trace, scaled by -x, with the
+ * format of the last C line; hardware frames point at stand-in decoder
+ * heaps, one per heap key of the trace.  Frame contents are not recorded,
+ * every software frame differs from the last one.
+ *
+ * For each trace it reports:
+ *
+ *   deadline misses  frames posted later than one refresh after both their
+ *                    timestamp and their arrival; the timestamps count from
+ *                    the first frame after a format change or a seek back
+ *   arrived late     frames that arrived more than one refresh after their
+ *                    timestamp
+ *   hold queue       decoder buffers the output has not handed back after a
+ *                    frame is written, counted from the write completions
+ *                    of the stand-in (see include/android_surface_output.h),
+ *                    so it follows the mNumberOfFramesToHold the output
+ *                    picks for each format
+ *   cpu              thread time and wall time of each writeFrameBuf, and
+ *                    the process time of the whole trace, which includes
+ *                    helper threads
+ *
+ * and ends with a summary line of key=value pairs to diff between builds.
+ * Properties are read as on the host, which gives the defaults.
+ *
+ *   trace_replay_msm7x30 [-x speed] [-r refresh ms] [-o overlays] [-p pmem MiB] trace...
+ *
+ * Exits non-zero if a trace could not be read.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <utils/Timers.h>
+
+#if defined(REPLAY_MSM7X30)
+#include "android_surface_output_msm7x30.h"
+typedef AndroidSurfaceOutputMsm7x30 ReplayMio;
+#define REPLAY_NAME         "msm7x30"
+#else
+#include "android_surface_output_msm72xx.h"
+typedef AndroidSurfaceOutputMsm72xx ReplayMio;
+#define REPLAY_NAME         "msm72xx"
+#endif
+
+#define DEFAULT_PMEM_MB     24
+#define DEFAULT_OVERLAYS    1
+#define DEFAULT_REFRESH_MS  16.7
+#define MAX_DECODER_HEAPS   16
+
+// stand-in for SurfaceFlinger and the overlay pipes
+class ReplaySurface : public ISurface, public OverlayListener
+{
+public:
+    ReplaySurface(int overlays) : mOverlaysLeft(overlays), mPosts(0), mLastPost(0) {}
+
+    virtual status_t registerBuffers(const BufferHeap& buffers) { return NO_ERROR; }
+    virtual void postBuffer(ssize_t offset) { posted(); }
+    virtual void unregisterBuffers() {}
+    virtual sp<OverlayRef> createOverlay(uint32_t w, uint32_t h, int32_t format, int32_t orientation)
+    {
+        if (mOverlaysLeft == 0) return NULL;
+        mOverlaysLeft--;
+        return new Ref(this);
+    }
+
+    virtual void overlayQueued(overlay_buffer_t buffer) { posted(); }
+
+    // frames posted or queued so far, and when the last one was
+    unsigned long posts() const { return mPosts; }
+    nsecs_t lastPost() const { return mLastPost; }
+
+private:
+    // gives its pipe back when the last Overlay on it is gone
+    class Ref : public OverlayRef
+    {
+    public:
+        Ref(ReplaySurface* surface) : OverlayRef(surface), mSurface(surface) {}
+        virtual ~Ref() { mSurface->mOverlaysLeft++; }
+    private:
+        sp<ReplaySurface> mSurface;
+    };
+
+    void posted()
+    {
+        mPosts++;
+        mLastPost = systemTime(SYSTEM_TIME_MONOTONIC);
+    }
+
+    int             mOverlaysLeft;
+    unsigned long   mPosts;
+    nsecs_t         mLastPost;
+};
+
+// the MIOs take the decoder heap from the 32 bit key in the private data,
+// so on a 64 bit host the heap object has to be below 4G
+class DecoderHeap : public MemoryHeapBase
+{
+public:
+    DecoderHeap(size_t size) : MemoryHeapBase(size) {}
+
+    static void* operator new(size_t size)
+    {
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_32BIT)
+        if (sizeof(void*) > sizeof(uint32)) flags |= MAP_32BIT;
+#endif
+        void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (p == MAP_FAILED) {
+            fprintf(stderr, "cannot map a decoder heap\n");
+            abort();
+        }
+        return p;
+    }
+    static void operator delete(void* p, size_t size) { munmap(p, size); }
+
+    uint32 key() const { return (uint32)(uintptr_t) this; }
+};
+
+// the player side of the output: parameters are set directly instead of
+// through setParametersSync
+class ReplayOutput : public ReplayMio
+{
+public:
+    ReplayOutput(const sp<ISurface>& surface, PVPlayer* player) :
+        mWritten(0),
+        mCompleted(0)
+    {
+        mSurface = surface;
+        mPvPlayer = player;
+    }
+
+    PVMFStatus write(uint8* data, uint32 length, const PvmiMediaXferHeader& header)
+    {
+        mWritten++;
+        return writeAsync(data, length, header);
+    }
+
+    // decoder buffers written and not handed back yet
+    int held() const { return (int)(mWritten - mCompleted); }
+
+    bool configure(const FrameTraceFormat& format)
+    {
+        iVideoSubFormat = PVMFFormatType(strcmp(format.subFormat, "-") ? format.subFormat : "");
+        iVideoFormat = iVideoSubFormat;
+        iVideoWidth = format.width;
+        iVideoHeight = format.height;
+        iVideoDisplayWidth = format.displayWidth;
+        iVideoDisplayHeight = format.displayHeight;
+        iVideoParameterFlags |= VIDEO_SUBFORMAT_VALID | VIDEO_WIDTH_VALID | VIDEO_HEIGHT_VALID |
+                                VIDEO_DISPLAY_WIDTH_VALID | VIDEO_DISPLAY_HEIGHT_VALID;
+        mNumberOfFramesToHold = format.framesToHold;
+        return initCheck();
+    }
+
+protected:
+    virtual void writeComplete(uint32 seq) { mCompleted++; }
+
+private:
+    unsigned long   mWritten;
+    unsigned long   mCompleted;
+};
+
+// a trace read into memory, so arrivals ahead of the frame being written
+// are known
+struct Trace {
+    FrameTraceFormat*   formats;
+    int                 formatCount;
+    FrameTraceFrame*    frames;
+    int*                frameFormat;    // index into formats, -1 before the first
+    int                 frameCount;
+    uint32              maxLength;
+};
+
+static bool loadTrace(const char* path, Trace* trace)
+{
+    memset(trace, 0, sizeof(*trace));
+    FrameTraceReader reader;
+    if (!reader.open(path)) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+    int formatSpace = 0, frameSpace = 0;
+    for (;;) {
+        int kind = reader.next();
+        if (kind == FrameTraceReader::TRACE_END) return true;
+        if (kind == FrameTraceReader::TRACE_ERROR) {
+            fprintf(stderr, "%s:%d: not a trace line\n", path, reader.line());
+            return false;
+        }
+        if (kind == FrameTraceReader::TRACE_FORMAT) {
+            if (trace->formatCount == formatSpace) {
+                formatSpace = formatSpace ? formatSpace * 2 : 8;
+                trace->formats = (FrameTraceFormat*) realloc(trace->formats, formatSpace * sizeof(FrameTraceFormat));
+            }
+            trace->formats[trace->formatCount++] = reader.format();
+            continue;
+        }
+        if (trace->frameCount == frameSpace) {
+            frameSpace = frameSpace ? frameSpace * 2 : 1024;
+            trace->frames = (FrameTraceFrame*) realloc(trace->frames, frameSpace * sizeof(FrameTraceFrame));
+            trace->frameFormat = (int*) realloc(trace->frameFormat, frameSpace * sizeof(int));
+        }
+        trace->frames[trace->frameCount] = reader.frame();
+        trace->frameFormat[trace->frameCount] = trace->formatCount - 1;
+        trace->frameCount++;
+        if (reader.frame().length > trace->maxLength) trace->maxLength = reader.frame().length;
+    }
+}
+
+static void freeTrace(Trace* trace)
+{
+    free(trace->formats);
+    free(trace->frames);
+    free(trace->frameFormat);
+}
+
+// stand-ins for the decoder heaps of a trace, found by the recorded key
+struct DecoderHeaps {
+    uint32          traceKey[MAX_DECODER_HEAPS];
+    size_t          size[MAX_DECODER_HEAPS];
+    sp<DecoderHeap> heap[MAX_DECODER_HEAPS];
+    int             count;
+
+    int find(uint32 key) const
+    {
+        for (int i = 0; i < count; i++) {
+            if (traceKey[i] == key) return i;
+        }
+        return -1;
+    }
+};
+
+static bool createDecoderHeaps(const Trace& trace, DecoderHeaps* heaps)
+{
+    heaps->count = 0;
+    for (int i = 0; i < trace.frameCount; i++) {
+        const FrameTraceFrame& frame = trace.frames[i];
+        int f = trace.frameFormat[i];
+        // large enough for a frame of the format, even if length says less
+        size_t frameSize = (f < 0) ? 0 : (size_t) trace.formats[f].width * trace.formats[f].height * 3 / 2;
+        if (frame.length > frameSize) frameSize = frame.length;
+        for (int e = 0; (e < frame.entries) && (e < FrameTraceFrame::kMaxEntries); e++) {
+            const FrameTraceEntry& entry = frame.entry[e];
+            if ((entry.type != PLATFORM_PRIVATE_PMEM) || (entry.heapKey == 0)) continue;
+            int h = heaps->find(entry.heapKey);
+            if (h < 0) {
+                if (heaps->count == MAX_DECODER_HEAPS) {
+                    fprintf(stderr, "more than %d decoder heaps\n", MAX_DECODER_HEAPS);
+                    return false;
+                }
+                h = heaps->count++;
+                heaps->traceKey[h] = entry.heapKey;
+                heaps->size[h] = 0;
+            }
+            if (entry.offset + frameSize > heaps->size[h]) heaps->size[h] = entry.offset + frameSize;
+        }
+    }
+    for (int h = 0; h < heaps->count; h++) {
+        heaps->heap[h] = new DecoderHeap((heaps->size[h] + 4095) & ~4095);
+        if (heaps->heap[h]->getBase() == NULL) {
+            fprintf(stderr, "cannot allocate a %u byte decoder heap\n", (unsigned) heaps->size[h]);
+            return false;
+        }
+    }
+    return true;
+}
+
+struct ReplayStats {
+    int             frames;
+    int             skipped;            // before the first format or while it failed
+    int             configFailures;
+    unsigned long   posted;
+    int             misses;
+    int             lateArrivals;
+    double          queueSum;
+    int             queueMax;
+    nsecs_t         cpuSum;
+    nsecs_t         cpuMax;
+    nsecs_t         wallSum;
+    nsecs_t         wallMax;
+    nsecs_t         processCpu;
+    nsecs_t         duration;
+};
+
+static void sleepUntil(nsecs_t when)
+{
+    struct timespec ts;
+    ts.tv_sec = when / 1000000000LL;
+    ts.tv_nsec = when % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {}
+}
+
+static void replay(const Trace& trace, const DecoderHeaps& heaps, double speed, nsecs_t refresh,
+                   int overlays, ReplayStats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    sp<ReplaySurface> surface = new ReplaySurface(overlays);
+    PVPlayer player;
+    ReplayOutput* output = new ReplayOutput(surface, &player);
+
+    uint8* software = (uint8*) malloc(trace.maxLength ? trace.maxLength : 1);
+    PLATFORM_PRIVATE_PMEM_INFO pmem[FrameTraceFrame::kMaxEntries];
+    PLATFORM_PRIVATE_ENTRY entries[FrameTraceFrame::kMaxEntries];
+    PLATFORM_PRIVATE_LIST list;
+
+    int format = -1;
+    bool configured = false;
+    nsecs_t anchorDue = 0;
+    int64_t anchorTs = 0, lastTs = 0;
+
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t processStart = systemTime(SYSTEM_TIME_PROCESS);
+    for (int i = 0; i < trace.frameCount; i++) {
+        const FrameTraceFrame& frame = trace.frames[i];
+        nsecs_t arrival = start + (nsecs_t)(us2ns(frame.arrivalUs) / speed);
+        sleepUntil(arrival);
+
+        if (trace.frameFormat[i] != format) {
+            format = trace.frameFormat[i];
+            configured = (format >= 0) && output->configure(trace.formats[format]);
+            if ((format >= 0) && !configured) stats->configFailures++;
+            anchorDue = arrival;
+            anchorTs = frame.timestampMs;
+        } else if (frame.timestampMs < lastTs) {
+            anchorDue = arrival;
+            anchorTs = frame.timestampMs;
+        }
+        lastTs = frame.timestampMs;
+        if (!configured) {
+            stats->skipped++;
+            continue;
+        }
+
+        PvmiMediaXferHeader header;
+        memset(&header, 0, sizeof(header));
+        header.seq_num = i;
+        header.timestamp = frame.timestampMs;
+        uint8* data = software;
+        if (frame.entries >= 0) {
+            int n = (frame.entries < FrameTraceFrame::kMaxEntries) ? frame.entries : FrameTraceFrame::kMaxEntries;
+            for (int e = 0; e < n; e++) {
+                entries[e].type = frame.entry[e].type;
+                entries[e].entry = NULL;
+                int h = heaps.find(frame.entry[e].heapKey);
+                if ((frame.entry[e].type != PLATFORM_PRIVATE_PMEM) || (h < 0)) continue;
+                pmem[e].pmem_fd = heaps.heap[h]->key();
+                pmem[e].offset = frame.entry[e].offset;
+                entries[e].entry = &pmem[e];
+                data = (uint8*) heaps.heap[h]->getBase() + frame.entry[e].offset;
+            }
+            list.nEntries = n;
+            list.entryList = entries;
+            header.private_data_ptr = &list;
+        } else {
+            memset(software, i & 0xff, frame.length);
+        }
+
+        unsigned long posts = surface->posts();
+        nsecs_t cpu = systemTime(SYSTEM_TIME_THREAD);
+        nsecs_t wall = systemTime(SYSTEM_TIME_MONOTONIC);
+        output->write(data, frame.length, header);
+        cpu = systemTime(SYSTEM_TIME_THREAD) - cpu;
+        wall = systemTime(SYSTEM_TIME_MONOTONIC) - wall;
+
+        int queue = output->held();
+        stats->queueSum += queue;
+        if (queue > stats->queueMax) stats->queueMax = queue;
+
+        stats->frames++;
+        stats->cpuSum += cpu;
+        stats->wallSum += wall;
+        if (cpu > stats->cpuMax) stats->cpuMax = cpu;
+        if (wall > stats->wallMax) stats->wallMax = wall;
+
+        // a frame has one refresh from when it could have been shown
+        nsecs_t due = anchorDue + (nsecs_t)(ms2ns(frame.timestampMs - anchorTs) / speed);
+        if (arrival > due + refresh) stats->lateArrivals++;
+        if (arrival > due) due = arrival;
+        if (surface->posts() != posts) {
+            stats->posted++;
+            if (surface->lastPost() > due + refresh) stats->misses++;
+        }
+    }
+    stats->duration = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    output->releaseHeld();
+    output->closeFrameBuf();
+    delete output;
+    stats->processCpu = systemTime(SYSTEM_TIME_PROCESS) - processStart;
+    free(software);
+}
+
+static void report(const char* path, const Trace& trace, const DecoderHeaps& heaps,
+                   nsecs_t refresh, const ReplayStats& s)
+{
+    int n = s.frames ? s.frames : 1;
+    printf("%s: %d frames, %d format(s), %d decoder heap(s)\n", path, trace.frameCount,
+           trace.formatCount, heaps.count);
+    if (s.skipped || s.configFailures)
+        printf("  %d frame(s) not written, %d format(s) refused by initCheck\n", s.skipped, s.configFailures);
+    printf("  posted %lu, dropped %lu, arrived late %d, deadline misses %d (refresh %.1f ms)\n",
+           s.posted, s.frames - s.posted, s.lateArrivals, s.misses, refresh / 1e6);
+    printf("  hold queue avg %.2f max %d\n", s.queueSum / n, s.queueMax);
+    printf("  writeFrameBuf cpu avg %.3f max %.3f ms, wall avg %.3f max %.3f ms\n",
+           s.cpuSum / 1e6 / n, s.cpuMax / 1e6, s.wallSum / 1e6 / n, s.wallMax / 1e6);
+    printf("  process cpu %.3f s over %.3f s\n", s.processCpu / 1e9, s.duration / 1e9);
+    printf("summary trace=%s frames=%d posted=%lu dropped=%lu late=%d misses=%d"
+           " queue_avg=%.2f queue_max=%d cpu_avg_us=%lld cpu_max_us=%lld"
+           " wall_avg_us=%lld wall_max_us=%lld process_cpu_ms=%lld\n",
+           path, s.frames, s.posted, s.frames - s.posted, s.lateArrivals, s.misses,
+           s.queueSum / n, s.queueMax, (long long) ns2us(s.cpuSum / n), (long long) ns2us(s.cpuMax),
+           (long long) ns2us(s.wallSum / n), (long long) ns2us(s.wallMax),
+           (long long) ns2ms(s.processCpu));
+}
+
+int main(int argc, char** argv)
+{
+    double speed = 1.0;
+    double refreshMs = DEFAULT_REFRESH_MS;
+    int overlays = DEFAULT_OVERLAYS;
+    size_t pmem = DEFAULT_PMEM_MB;
+    int c;
+    while ((c = getopt(argc, argv, "x:r:o:p:")) != -1) {
+        switch (c) {
+        case 'x': speed = atof(optarg); break;
+        case 'r': refreshMs = atof(optarg); break;
+        case 'o': overlays = atoi(optarg); break;
+        case 'p': pmem = atoi(optarg); break;
+        default:
+            speed = 0;
+            break;
+        }
+    }
+    if ((speed <= 0) || (optind == argc)) {
+        fprintf(stderr, "usage: %s [-x speed] [-r refresh ms] [-o overlays] [-p pmem MiB] trace...\n", argv[0]);
+        return 2;
+    }
+    printf("%s, speed %.2f, %u MiB of pmem, %d overlay(s)\n", REPLAY_NAME, speed,
+           (unsigned) pmem, overlays);
+    MemoryHeapBase::setPmemLimit(pmem * 1024 * 1024);
+    nsecs_t refresh = (nsecs_t)(refreshMs * 1e6);
+
+    int failed = 0;
+    for (int i = optind; i < argc; i++) {
+        Trace trace;
+        DecoderHeaps heaps;
+        if (!loadTrace(argv[i], &trace) || !createDecoderHeaps(trace, &heaps)) {
+            freeTrace(&trace);
+            failed++;
+            continue;
+        }
+        ReplayStats stats;
+        replay(trace, heaps, speed, refresh, overlays, &stats);
+        report(argv[i], trace, heaps, refresh, stats);
+        freeTrace(&trace);
+    }
+    return failed ? 1 : 0;
+}
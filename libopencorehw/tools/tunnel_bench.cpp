@@ -0,0 +1,551 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+/*
+ * Feeds a stand-in hardware decoder of the OMX core in pvomx/omx_core_stub
+ * into a video output both ways a decoder can reach it, so the tunnel can
+ * be weighed against the PV path on the host:
+ *
+ *   mio     the decoder fills buffers of a stand-in decoder heap; each
+ *           FillBufferDone is handed to a player thread that writes it
+ *           to the MIO with writeAsync, as the PV graph would, and the
+ *           write completion gives the buffer back to the decoder
+ *   tunnel  the display sink getVideoMioTunnelSink returns is tunneled
+ *           to the decoder's output port with OMX_SetupTunnel; the
+ *           decoder fills the sink's buffers and calls its
+ *           EmptyThisBuffer, which posts the frame
+ *
+ * Both time the same span, from the decoder handing a filled buffer over
+ * (FillBufferDone, or EmptyThisBuffer through a tap on the sink's handle)
+ * to the frame being posted or queued to the stand-in display.  The MIO
+ * is the real one, built against the stand-ins in trace_replay/include,
+ * with tunneling on as persist.pv.tunnel=1 would have it.  One input frame is
+ * queued per frame period; what the decoder takes over it is set with the
+ * core's OMX_STUB_DEC_* environment.
+ *
+ *   LD_LIBRARY_PATH=$ANDROID_HOST_OUT/lib tunnel_bench_msm7x30 [-n frames] [-f fps] [-w width] [-h height]
+ *
+ * Exits non-zero if either path did not post every frame decoded.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <utils/Timers.h>
+#include <utils/threads.h>
+
+#include "OMX_Core.h"
+#include "OMX_Component.h"
+
+#if defined(BENCH_MSM7X30)
+#include "android_surface_output_msm7x30.h"
+typedef AndroidSurfaceOutputMsm7x30 BenchMio;
+#define BENCH_NAME          "msm7x30"
+#else
+#include "android_surface_output_msm72xx.h"
+typedef AndroidSurfaceOutputMsm72xx BenchMio;
+#define BENCH_NAME          "msm72xx"
+#endif
+
+extern "C" OMX_HANDLETYPE getVideoMioTunnelSink(BenchMio* mio);
+
+#define DEFAULT_COMPONENT   "OMX.qcom.stub.video.decoder.avc"
+#define DEFAULT_FRAMES      300
+#define DEFAULT_FPS         30
+#define MAX_BUFFERS         32
+#define DRAIN_TIMEOUT       5000000000LL
+
+// stand-in for SurfaceFlinger and the one overlay pipe; a path posts from
+// one thread only, the one that reads posts() around it
+class BenchSurface : public ISurface, public OverlayListener
+{
+public:
+    BenchSurface() : mOverlayFree(true), mPosts(0), mLastPost(0) {}
+
+    virtual status_t registerBuffers(const BufferHeap& buffers) { return NO_ERROR; }
+    virtual void postBuffer(ssize_t offset) { posted(); }
+    virtual void unregisterBuffers() {}
+    virtual sp<OverlayRef> createOverlay(uint32_t w, uint32_t h, int32_t format, int32_t orientation)
+    {
+        if (!mOverlayFree) return NULL;
+        mOverlayFree = false;
+        return new Ref(this);
+    }
+
+    virtual void overlayQueued(overlay_buffer_t buffer) { posted(); }
+
+    unsigned long posts() const { return mPosts; }
+    nsecs_t lastPost() const { return mLastPost; }
+
+private:
+    class Ref : public OverlayRef
+    {
+    public:
+        Ref(BenchSurface* surface) : OverlayRef(surface), mSurface(surface) {}
+        virtual ~Ref() { mSurface->mOverlayFree = true; }
+    private:
+        sp<BenchSurface> mSurface;
+    };
+
+    void posted()
+    {
+        mPosts++;
+        mLastPost = systemTime(SYSTEM_TIME_MONOTONIC);
+    }
+
+    bool            mOverlayFree;
+    unsigned long   mPosts;
+    nsecs_t         mLastPost;
+};
+
+// the MIOs take the decoder heap from the 32 bit key in the private data,
+// so on a 64 bit host the heap object has to be below 4G
+class DecoderHeap : public MemoryHeapBase
+{
+public:
+    DecoderHeap(size_t size) : MemoryHeapBase(size) {}
+
+    static void* operator new(size_t size)
+    {
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_32BIT)
+        if (sizeof(void*) > sizeof(uint32)) flags |= MAP_32BIT;
+#endif
+        void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (p == MAP_FAILED) {
+            fprintf(stderr, "cannot map a decoder heap\n");
+            abort();
+        }
+        return p;
+    }
+    static void operator delete(void* p, size_t size) { munmap(p, size); }
+
+    uint32 key() const { return (uint32)(uintptr_t) this; }
+};
+
+struct Bench;
+
+// the player side of the output, with tunneling on
+class BenchOutput : public BenchMio
+{
+public:
+    BenchOutput(const sp<ISurface>& surface, PVPlayer* player, Bench* bench) : mBench(bench)
+    {
+        mSurface = surface;
+        mPvPlayer = player;
+        mTunnelEnabled = true;
+    }
+
+    bool configure(int width, int height)
+    {
+        iVideoSubFormat = PVMF_MIME_YUV420_SEMIPLANAR_YVU;
+        iVideoFormat = iVideoSubFormat;
+        iVideoWidth = iVideoDisplayWidth = width;
+        iVideoHeight = iVideoDisplayHeight = height;
+        iVideoParameterFlags |= VIDEO_SUBFORMAT_VALID | VIDEO_WIDTH_VALID | VIDEO_HEIGHT_VALID |
+                                VIDEO_DISPLAY_WIDTH_VALID | VIDEO_DISPLAY_HEIGHT_VALID;
+        return initCheck();
+    }
+
+protected:
+    virtual void writeComplete(uint32 seq);
+
+private:
+    Bench*  mBench;
+};
+
+// one run of either path; callbacks of the decoder and of the tap come in
+// on the decoder's thread
+struct Bench {
+    OMX_HANDLETYPE              decoder;
+    sp<BenchSurface>            surface;
+    BenchOutput*                output;
+
+    Mutex                       lock;
+    Condition                   changed;
+    OMX_STATETYPE               decoderState;
+    bool                        stopping;
+
+    OMX_BUFFERHEADERTYPE*       input[MAX_BUFFERS];
+    int                         inputCount;
+    OMX_BUFFERHEADERTYPE*       freeInput[MAX_BUFFERS];
+    int                         freeInputCount;
+
+    // mio: decoder output in a heap of ours, described to the MIO the
+    // way the decoder node does
+    sp<DecoderHeap>             heap;
+    OMX_BUFFERHEADERTYPE*       output_[MAX_BUFFERS];
+    int                         outputCount;
+    PLATFORM_PRIVATE_PMEM_INFO  pmem[MAX_BUFFERS];
+    PLATFORM_PRIVATE_ENTRY      entry[MAX_BUFFERS];
+    PLATFORM_PRIVATE_LIST       list[MAX_BUFFERS];
+    // filled and not written yet, oldest first
+    OMX_BUFFERHEADERTYPE*       filled[MAX_BUFFERS];
+    nsecs_t                     filledAt[MAX_BUFFERS];
+    int                         filledCount;
+
+    // frames handed over by the decoder and done with, and the spans of
+    // those that were posted
+    int                         delivered;
+    int                         done;
+    nsecs_t*                    spans;
+    int                         spanCount;
+};
+
+static Bench sBench;
+
+void BenchOutput::writeComplete(uint32 seq)
+{
+    OMX_FillThisBuffer(mBench->decoder, mBench->output_[seq]);
+}
+
+static void frameDone(Bench* b, nsecs_t handedOver, bool posted)
+{
+    Mutex::Autolock l(b->lock);
+    if (posted) b->spans[b->spanCount++] = b->surface->lastPost() - handedOver;
+    b->done++;
+    b->changed.broadcast();
+}
+
+static OMX_ERRORTYPE onEvent(OMX_HANDLETYPE hComponent, OMX_PTR appData, OMX_EVENTTYPE event,
+                             OMX_U32 data1, OMX_U32 data2, OMX_PTR eventData)
+{
+    Bench* b = (Bench*) appData;
+    if ((event == OMX_EventCmdComplete) && (data1 == OMX_CommandStateSet)) {
+        Mutex::Autolock l(b->lock);
+        b->decoderState = (OMX_STATETYPE) data2;
+        b->changed.broadcast();
+    } else if (event == OMX_EventError) {
+        fprintf(stderr, "decoder error 0x%x\n", (unsigned) data1);
+    }
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE onEmptyBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR appData, OMX_BUFFERHEADERTYPE* buffer)
+{
+    Bench* b = (Bench*) appData;
+    Mutex::Autolock l(b->lock);
+    b->freeInput[b->freeInputCount++] = buffer;
+    b->changed.broadcast();
+    return OMX_ErrorNone;
+}
+
+// mio: the decoder node would send the frame down the graph from here
+static OMX_ERRORTYPE onFillBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR appData, OMX_BUFFERHEADERTYPE* buffer)
+{
+    Bench* b = (Bench*) appData;
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    Mutex::Autolock l(b->lock);
+    if (b->stopping || (buffer->nFilledLen == 0)) return OMX_ErrorNone;
+    b->delivered++;
+    b->filled[b->filledCount] = buffer;
+    b->filledAt[b->filledCount++] = now;
+    b->changed.broadcast();
+    return OMX_ErrorNone;
+}
+
+static OMX_CALLBACKTYPE sCallbacks = { onEvent, onEmptyBufferDone, onFillBufferDone };
+
+// tunnel: the decoder's peer is a copy of the sink's handle with this in
+// front of EmptyThisBuffer; everything else goes to the sink as it is
+static OMX_COMPONENTTYPE sTap;
+static OMX_ERRORTYPE (*sSinkEmptyThisBuffer)(OMX_HANDLETYPE, OMX_BUFFERHEADERTYPE*);
+
+static OMX_ERRORTYPE tapEmptyThisBuffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE* buffer)
+{
+    Bench* b = &sBench;
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    bool filled = (buffer->nFilledLen != 0);
+    unsigned long posts = b->surface->posts();
+    OMX_ERRORTYPE err = sSinkEmptyThisBuffer(hComponent, buffer);
+    if (filled) {
+        {
+            Mutex::Autolock l(b->lock);
+            b->delivered++;
+        }
+        frameDone(b, now, b->surface->posts() != posts);
+    }
+    return err;
+}
+
+static void* playerThread(void* arg)
+{
+    Bench* b = (Bench*) arg;
+    for (;;) {
+        OMX_BUFFERHEADERTYPE* buffer;
+        nsecs_t handedOver;
+        {
+            Mutex::Autolock l(b->lock);
+            while ((b->filledCount == 0) && !b->stopping) b->changed.wait(b->lock);
+            if (b->filledCount == 0) return NULL;
+            buffer = b->filled[0];
+            handedOver = b->filledAt[0];
+            b->filledCount--;
+            memmove(b->filled, b->filled + 1, b->filledCount * sizeof(b->filled[0]));
+            memmove(b->filledAt, b->filledAt + 1, b->filledCount * sizeof(b->filledAt[0]));
+        }
+        int i = (int)(intptr_t) buffer->pAppPrivate;
+        PvmiMediaXferHeader header;
+        memset(&header, 0, sizeof(header));
+        header.seq_num = i;
+        header.timestamp = buffer->nTimeStamp / 1000;
+        header.private_data_ptr = &b->list[i];
+        unsigned long posts = b->surface->posts();
+        b->output->writeAsync(buffer->pBuffer + buffer->nOffset, buffer->nFilledLen, header);
+        frameDone(b, handedOver, b->surface->posts() != posts);
+    }
+}
+
+static bool waitState(Bench* b, OMX_STATETYPE state)
+{
+    Mutex::Autolock l(b->lock);
+    nsecs_t deadline = systemTime(SYSTEM_TIME_MONOTONIC) + DRAIN_TIMEOUT;
+    while (b->decoderState != state) {
+        nsecs_t left = deadline - systemTime(SYSTEM_TIME_MONOTONIC);
+        if (left <= 0) return false;
+        b->changed.waitRelative(b->lock, left);
+    }
+    return true;
+}
+
+static bool setDecoderState(Bench* b, OMX_STATETYPE state)
+{
+    OMX_SendCommand(b->decoder, OMX_CommandStateSet, state, NULL);
+    if (waitState(b, state)) return true;
+    fprintf(stderr, "decoder did not reach state %d\n", state);
+    return false;
+}
+
+// mio: decoder output buffers in a decoder heap, in the platform private
+// layout the MIO decodes
+static bool useOutputBuffers(Bench* b, const OMX_PARAM_PORTDEFINITIONTYPE& port)
+{
+    size_t size = (port.nBufferSize + 4095) & ~4095;
+    b->outputCount = (port.nBufferCountActual < MAX_BUFFERS) ? port.nBufferCountActual : MAX_BUFFERS;
+    b->heap = new DecoderHeap(size * b->outputCount);
+    uint8* base = (uint8*) b->heap->getBase();
+    for (int i = 0; i < b->outputCount; i++) {
+        b->pmem[i].pmem_fd = b->heap->key();
+        b->pmem[i].offset = i * size;
+        b->entry[i].type = PLATFORM_PRIVATE_PMEM;
+        b->entry[i].entry = &b->pmem[i];
+        b->list[i].nEntries = 1;
+        b->list[i].entryList = &b->entry[i];
+        if (OMX_UseBuffer(b->decoder, &b->output_[i], port.nPortIndex, (OMX_PTR)(intptr_t) i,
+                          size, base + i * size) != OMX_ErrorNone) {
+            b->outputCount = i;
+            return false;
+        }
+    }
+    return true;
+}
+
+// the sink's handle, with the tap, for OMX_SetupTunnel
+static OMX_HANDLETYPE tapSink(OMX_HANDLETYPE sink)
+{
+    sTap = *(OMX_COMPONENTTYPE*) sink;
+    sSinkEmptyThisBuffer = sTap.EmptyThisBuffer;
+    sTap.EmptyThisBuffer = tapEmptyThisBuffer;
+    return &sTap;
+}
+
+static int compareSpans(const void* a, const void* b)
+{
+    nsecs_t x = *(const nsecs_t*) a, y = *(const nsecs_t*) b;
+    return (x < y) ? -1 : (x > y);
+}
+
+static bool run(bool tunneled, const char* component, int frames, int fps, int width, int height)
+{
+    Bench* b = &sBench;
+    b->decoder = NULL;
+    b->surface = new BenchSurface();
+    b->decoderState = OMX_StateLoaded;
+    b->stopping = false;
+    b->inputCount = b->freeInputCount = b->outputCount = b->filledCount = 0;
+    b->delivered = b->done = b->spanCount = 0;
+    b->spans = new nsecs_t[frames];
+    b->heap.clear();
+    const char* path = tunneled ? "tunnel" : "mio";
+
+    PVPlayer player;
+    b->output = new BenchOutput(b->surface, &player, b);
+    bool ok = b->output->configure(width, height);
+    OMX_HANDLETYPE sink = NULL;
+    if (ok && tunneled) {
+        sink = getVideoMioTunnelSink(b->output);
+        if (sink == NULL) fprintf(stderr, "%s: the output has no tunnel sink for this format\n", path);
+        ok = (sink != NULL);
+    }
+    if (ok) ok = (OMX_GetHandle(&b->decoder, (OMX_STRING) component, b, &sCallbacks) == OMX_ErrorNone);
+    if (!ok) {
+        fprintf(stderr, "%s: cannot set up %s\n", path, component);
+        b->output->closeFrameBuf();
+        delete b->output;
+        delete[] b->spans;
+        return false;
+    }
+
+    OMX_PARAM_PORTDEFINITIONTYPE port;
+    memset(&port, 0, sizeof(port));
+    port.nSize = sizeof(port);
+    port.nPortIndex = 1;
+    OMX_GetParameter(b->decoder, OMX_IndexParamPortDefinition, &port);
+    port.format.video.nFrameWidth = width;
+    port.format.video.nFrameHeight = height;
+    OMX_SetParameter(b->decoder, OMX_IndexParamPortDefinition, &port);
+    OMX_GetParameter(b->decoder, OMX_IndexParamPortDefinition, &port);
+
+    OMX_PARAM_PORTDEFINITIONTYPE in;
+    memset(&in, 0, sizeof(in));
+    in.nSize = sizeof(in);
+    in.nPortIndex = 0;
+    OMX_GetParameter(b->decoder, OMX_IndexParamPortDefinition, &in);
+    b->inputCount = (in.nBufferCountActual < MAX_BUFFERS) ? in.nBufferCountActual : MAX_BUFFERS;
+    for (int i = 0; i < b->inputCount; i++) {
+        OMX_AllocateBuffer(b->decoder, &b->input[i], 0, NULL, in.nBufferSize);
+        b->freeInput[b->freeInputCount++] = b->input[i];
+    }
+
+    // the sink supplies its buffers on Loaded->Idle and primes the decoder
+    // with them on Idle->Executing, so it goes last both times
+    pthread_t player_thread;
+    if (tunneled) {
+        ok = (OMX_SetupTunnel(b->decoder, port.nPortIndex, tapSink(sink), 0) == OMX_ErrorNone);
+        if (ok) OMX_SendCommand(sink, OMX_CommandStateSet, OMX_StateIdle, NULL);
+        ok = ok && setDecoderState(b, OMX_StateIdle) && setDecoderState(b, OMX_StateExecuting);
+        if (ok) OMX_SendCommand(sink, OMX_CommandStateSet, OMX_StateExecuting, NULL);
+    } else {
+        ok = useOutputBuffers(b, port) && setDecoderState(b, OMX_StateIdle) &&
+             setDecoderState(b, OMX_StateExecuting);
+        for (int i = 0; ok && (i < b->outputCount); i++) OMX_FillThisBuffer(b->decoder, b->output_[i]);
+        pthread_create(&player_thread, NULL, playerThread, b);
+    }
+
+    nsecs_t period = 1000000000LL / fps;
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t processStart = systemTime(SYSTEM_TIME_PROCESS);
+    int queued = 0;
+    for (; ok && (queued < frames); queued++) {
+        nsecs_t due = start + queued * period;
+        struct timespec ts;
+        ts.tv_sec = due / 1000000000LL;
+        ts.tv_nsec = due % 1000000000LL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {}
+
+        OMX_BUFFERHEADERTYPE* buffer;
+        {
+            Mutex::Autolock l(b->lock);
+            while (b->freeInputCount == 0) b->changed.wait(b->lock);
+            buffer = b->freeInput[--b->freeInputCount];
+        }
+        buffer->nOffset = 0;
+        buffer->nFilledLen = buffer->nAllocLen;
+        buffer->nFlags = 0;
+        buffer->nTimeStamp = ns2us(queued * period);
+        OMX_EmptyThisBuffer(b->decoder, buffer);
+    }
+
+    // every frame queued comes out and is written or posted
+    {
+        Mutex::Autolock l(b->lock);
+        nsecs_t deadline = systemTime(SYSTEM_TIME_MONOTONIC) + DRAIN_TIMEOUT;
+        while (b->done < queued) {
+            nsecs_t left = deadline - systemTime(SYSTEM_TIME_MONOTONIC);
+            if (left <= 0) break;
+            b->changed.waitRelative(b->lock, left);
+        }
+        b->stopping = true;
+        b->changed.broadcast();
+    }
+    nsecs_t duration = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    nsecs_t processCpu = systemTime(SYSTEM_TIME_PROCESS) - processStart;
+
+    // the tunnel comes down with the output's configuration
+    if (!tunneled) {
+        pthread_join(player_thread, NULL);
+        b->output->releaseHeld();
+    }
+    b->output->closeFrameBuf();
+    setDecoderState(b, OMX_StateIdle);
+    for (int i = 0; i < b->inputCount; i++) OMX_FreeBuffer(b->decoder, 0, b->input[i]);
+    for (int i = 0; i < b->outputCount; i++) OMX_FreeBuffer(b->decoder, 1, b->output_[i]);
+    setDecoderState(b, OMX_StateLoaded);
+    OMX_FreeHandle(b->decoder);
+    delete b->output;
+    b->heap.clear();
+
+    int n = b->spanCount ? b->spanCount : 1;
+    qsort(b->spans, b->spanCount, sizeof(nsecs_t), compareSpans);
+    nsecs_t sum = 0;
+    for (int i = 0; i < b->spanCount; i++) sum += b->spans[i];
+    nsecs_t p50 = b->spanCount ? b->spans[b->spanCount / 2] : 0;
+    nsecs_t p99 = b->spanCount ? b->spans[(b->spanCount * 99) / 100] : 0;
+    nsecs_t max = b->spanCount ? b->spans[b->spanCount - 1] : 0;
+    printf("%-6s queued %d, decoded %d, posted %d\n", path, queued, b->delivered, b->spanCount);
+    printf("       decoder to post avg %.3f p50 %.3f p99 %.3f max %.3f ms\n",
+           sum / 1e6 / n, p50 / 1e6, p99 / 1e6, max / 1e6);
+    printf("       process cpu %.3f ms/frame over %.3f s\n", processCpu / 1e6 / (queued ? queued : 1),
+           duration / 1e9);
+    printf("summary path=%s queued=%d decoded=%d posted=%d avg_us=%lld p50_us=%lld p99_us=%lld"
+           " max_us=%lld cpu_us_per_frame=%lld\n",
+           path, queued, b->delivered, b->spanCount, (long long) ns2us(sum / n), (long long) ns2us(p50),
+           (long long) ns2us(p99), (long long) ns2us(max), (long long) ns2us(processCpu / (queued ? queued : 1)));
+
+    ok = ok && (b->delivered == queued) && (b->spanCount == b->delivered);
+    delete[] b->spans;
+    b->surface.clear();
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    const char* component = DEFAULT_COMPONENT;
+    int frames = DEFAULT_FRAMES;
+    int fps = DEFAULT_FPS;
+    int width = 640, height = 480;
+    int c;
+    while ((c = getopt(argc, argv, "c:n:f:w:h:")) != -1) {
+        switch (c) {
+        case 'c': component = optarg; break;
+        case 'n': frames = atoi(optarg); break;
+        case 'f': fps = atoi(optarg); break;
+        case 'w': width = atoi(optarg); break;
+        case 'h': height = atoi(optarg); break;
+        default:
+            frames = 0;
+            break;
+        }
+    }
+    if ((frames <= 0) || (fps <= 0) || (width <= 0) || (height <= 0)) {
+        fprintf(stderr, "usage: %s [-c component] [-n frames] [-f fps] [-w width] [-h height]\n", argv[0]);
+        return 2;
+    }
+    printf("%s, %s, %d frames of %d x %d at %d fps\n", BENCH_NAME, component, frames, width, height, fps);
+
+    OMX_Init();
+    bool ok = run(false, component, frames, fps, width, height);
+    ok = run(true, component, frames, fps, width, height) && ok;
+    OMX_Deinit();
+    return ok ? 0 : 1;
+}
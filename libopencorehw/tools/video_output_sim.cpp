@@ -0,0 +1,281 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+/*
+ * Runs VideoOutputManager against stand-ins for the display, so the
+ * sharing policy can be checked without a device.
+ *
+ * SimDisplay has a fixed number of overlay pipes and a pmem pool of fixed
+ * size and refuses anything beyond them, like the kernel would.  SimOutput
+ * goes through the same steps as the MIO initOverlay: overlay first, then
+ * frame buffers for it, and the surface path when either is refused.
+ * Every scenario below opens and closes outputs in the order a player
+ * would (playback, picture-in-picture, camera preview next to playback,
+ * ...) and prints what each one was granted.
+ *
+ * Exits non-zero if the display was ever asked for more than it has, or
+ * an output ended up with neither an overlay nor a surface.
+ *
+ *   video_output_sim [-p pmem MiB] [-o overlays]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "video_output_manager.h"
+
+#define DEFAULT_PMEM_MB     24
+#define DEFAULT_OVERLAYS    1
+#define BUFFER_COUNT        2       // what the MIOs ask for
+
+static int sViolations = 0;
+
+static void violation(const char* what)
+{
+    printf("    VIOLATION: %s\n", what);
+    sViolations++;
+}
+
+// stand-in for the overlay pipes and the pmem_adsp pool
+class SimDisplay
+{
+public:
+    SimDisplay(size_t pmem, int pipes) : mPmem(pmem), mPmemUsed(0), mPipes(pipes), mPipesUsed(0) {}
+
+    bool allocPmem(size_t size)
+    {
+        if (mPmemUsed + size > mPmem) return false;
+        mPmemUsed += size;
+        return true;
+    }
+    void freePmem(size_t size) { mPmemUsed -= size; }
+
+    bool createOverlay()
+    {
+        if (mPipesUsed >= mPipes) return false;
+        mPipesUsed++;
+        return true;
+    }
+    void destroyOverlay() { mPipesUsed--; }
+
+    size_t pmemUsed() const { return mPmemUsed; }
+    int pipesUsed() const { return mPipesUsed; }
+
+private:
+    size_t  mPmem;
+    size_t  mPmemUsed;
+    int     mPipes;
+    int     mPipesUsed;
+};
+
+// stand-in for one MIO, software codec path
+class SimOutput
+{
+public:
+    SimOutput(VideoOutputManager* manager, SimDisplay* display, const char* name) :
+        mManager(manager), mDisplay(display), mName(name),
+        mOpen(false), mOverlay(false), mSurface(false), mBufferCount(0), mHeapSize(0)
+    {
+        mStream = mManager->attach();
+    }
+
+    ~SimOutput()
+    {
+        close();
+        mManager->detach(mStream);
+    }
+
+    void open(int width, int height)
+    {
+        close();
+        mOpen = true;
+        size_t frameSize = (width * height * 3) / 2;
+
+        if (mManager->reserveOverlay(mStream)) {
+            mBufferCount = mManager->reserveBuffers(mStream, frameSize, BUFFER_COUNT, 1);
+            if (mBufferCount > 0) {
+                if (!mDisplay->allocPmem(frameSize * mBufferCount)) {
+                    violation("pmem pool oversubscribed");
+                    mManager->releaseBuffers(mStream);
+                    mBufferCount = 0;
+                } else {
+                    mHeapSize = frameSize * mBufferCount;
+                }
+            }
+            if (mBufferCount > 0) {
+                if (mDisplay->createOverlay()) {
+                    mOverlay = true;
+                } else {
+                    violation("overlay pipes oversubscribed");
+                }
+            }
+            if (!mOverlay) {
+                if (mHeapSize > 0) mDisplay->freePmem(mHeapSize);
+                mHeapSize = 0;
+                mManager->releaseBuffers(mStream);
+                mManager->releaseOverlay(mStream);
+            }
+        }
+        if (!mOverlay) {
+            // RGB frames to SurfaceFlinger; ashmem if the budget is spent
+            size_t rgbSize = width * height * 2;
+            mBufferCount = mManager->reserveBuffers(mStream, rgbSize, BUFFER_COUNT, 1);
+            if ((mBufferCount > 0) && mDisplay->allocPmem(rgbSize * mBufferCount)) {
+                mHeapSize = rgbSize * mBufferCount;
+            } else {
+                if (mBufferCount > 0) violation("pmem pool oversubscribed");
+                mManager->releaseBuffers(mStream);
+                mBufferCount = BUFFER_COUNT;
+            }
+            mSurface = true;
+        }
+        if (!mOverlay && !mSurface) violation("output has no display path");
+
+        printf("    %-10s %4dx%-4d %s, %d buffer(s), %6u KiB pmem%s\n", mName, width, height,
+               mOverlay ? "overlay" : "surface", mBufferCount, (unsigned)(mHeapSize / 1024),
+               mManager->isPrimary(mStream) ? ", primary" : "");
+    }
+
+    void close()
+    {
+        if (!mOpen) return;
+        if (mOverlay) mDisplay->destroyOverlay();
+        if (mHeapSize > 0) mDisplay->freePmem(mHeapSize);
+        mManager->releaseBuffers(mStream);
+        mManager->releaseOverlay(mStream);
+        mOpen = false;
+        mOverlay = false;
+        mSurface = false;
+        mBufferCount = 0;
+        mHeapSize = 0;
+    }
+
+private:
+    VideoOutputManager* mManager;
+    SimDisplay*         mDisplay;
+    const char*         mName;
+    int                 mStream;
+    bool                mOpen;
+    bool                mOverlay;
+    bool                mSurface;
+    int                 mBufferCount;
+    size_t              mHeapSize;
+};
+
+static void checkIdle(const SimDisplay& display)
+{
+    if ((display.pmemUsed() != 0) || (display.pipesUsed() != 0))
+        violation("pmem or overlays left behind after all outputs closed");
+}
+
+static void playbackAlone(size_t pmem, int overlays)
+{
+    printf("playback alone\n");
+    VideoOutputManager manager(pmem, overlays);
+    SimDisplay display(pmem, overlays);
+    {
+        SimOutput main(&manager, &display, "main");
+        main.open(1280, 720);
+        // resolution change in the middle of the stream
+        main.open(1920, 1088);
+    }
+    checkIdle(display);
+}
+
+static void pictureInPicture(size_t pmem, int overlays)
+{
+    printf("picture-in-picture\n");
+    VideoOutputManager manager(pmem, overlays);
+    SimDisplay display(pmem, overlays);
+    {
+        SimOutput main(&manager, &display, "main");
+        main.open(1280, 720);
+        SimOutput pip(&manager, &display, "pip");
+        pip.open(640, 480);
+        SimOutput pip2(&manager, &display, "pip2");
+        pip2.open(320, 240);
+    }
+    checkIdle(display);
+}
+
+static void previewAndPlayback(size_t pmem, int overlays)
+{
+    printf("camera preview next to playback\n");
+    VideoOutputManager manager(pmem, overlays);
+    SimDisplay display(pmem, overlays);
+    {
+        SimOutput* main = new SimOutput(&manager, &display, "main");
+        main->open(1920, 1088);
+        SimOutput preview(&manager, &display, "preview");
+        preview.open(800, 480);
+        // the preview outlives playback and takes over as primary
+        delete main;
+        preview.open(800, 480);
+    }
+    checkIdle(display);
+}
+
+static void oversubscribed(size_t pmem, int overlays)
+{
+    printf("more outputs than the budget holds\n");
+    VideoOutputManager manager(pmem, overlays);
+    SimDisplay display(pmem, overlays);
+    {
+        SimOutput* outputs[VideoOutputManager::kMaxStreams];
+        char names[VideoOutputManager::kMaxStreams][16];
+        for (int i = 0; i < VideoOutputManager::kMaxStreams; i++) {
+            snprintf(names[i], sizeof(names[i]), "stream%d", i);
+            outputs[i] = new SimOutput(&manager, &display, names[i]);
+            outputs[i]->open(1920, 1088);
+        }
+        for (int i = 0; i < VideoOutputManager::kMaxStreams; i++) delete outputs[i];
+    }
+    checkIdle(display);
+}
+
+int main(int argc, char** argv)
+{
+    size_t pmem = DEFAULT_PMEM_MB;
+    int overlays = DEFAULT_OVERLAYS;
+    int c;
+    while ((c = getopt(argc, argv, "p:o:")) != -1) {
+        switch (c) {
+        case 'p': pmem = atoi(optarg); break;
+        case 'o': overlays = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-p pmem MiB] [-o overlays]\n", argv[0]);
+            return 2;
+        }
+    }
+    printf("%u MiB of pmem, %d overlay(s)\n", (unsigned)pmem, overlays);
+    pmem *= 1024 * 1024;
+
+    playbackAlone(pmem, overlays);
+    pictureInPicture(pmem, overlays);
+    previewAndPlayback(pmem, overlays);
+    oversubscribed(pmem, overlays);
+
+    if (sViolations > 0) {
+        printf("%d violation(s)\n", sViolations);
+        return 1;
+    }
+    printf("no violations\n");
+    return 0;
+}
@@ -0,0 +1,259 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "VideoOutputManager"
+#include <utils/Log.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/properties.h>
+
+#include "video_output_manager.h"
+
+using namespace android;
+
+static pthread_once_t sOnce = PTHREAD_ONCE_INIT;
+static VideoOutputManager* sInstance = NULL;
+
+static void createInstance()
+{
+    char value[PROPERTY_VALUE_MAX];
+    property_get("persist.pv.vo.pmem", value, "24");
+    size_t budget = atoi(value) * 1024 * 1024;
+    property_get("persist.pv.vo.overlays", value, "1");
+    sInstance = new VideoOutputManager(budget, atoi(value));
+}
+
+VideoOutputManager* VideoOutputManager::instance()
+{
+    pthread_once(&sOnce, createInstance);
+    return sInstance;
+}
+
+VideoOutputManager::VideoOutputManager(size_t pmemBudget, int overlays) :
+    mPmemBudget(pmemBudget),
+    mOverlays(overlays),
+    mShrunk(0),
+    mRefusedPmem(0),
+    mRefusedOverlays(0),
+    mTrims(0)
+{
+    memset(mStreams, 0, sizeof(mStreams));
+}
+
+int VideoOutputManager::attach(Trimmer* trimmer)
+{
+    Mutex::Autolock lock(mLock);
+
+    bool others = false;
+    int stream = -1;
+    for (int i = 0; i < kMaxStreams; i++) {
+        if (mStreams[i].attached) {
+            others = true;
+        } else if (stream < 0) {
+            stream = i;
+        }
+    }
+    if (stream < 0) {
+        LOGE("more than %d video outputs", kMaxStreams);
+        return -1;
+    }
+
+    Stream& s = mStreams[stream];
+    s.attached = true;
+    s.primary = !others;
+    s.pmem = 0;
+    s.resident = 0;
+    s.overlay = false;
+    s.trimmer = trimmer;
+    LOGV("stream %d attached (%s)", stream, s.primary ? "primary" : "secondary");
+    return stream;
+}
+
+void VideoOutputManager::detach(int stream)
+{
+    if ((stream < 0) || (stream >= kMaxStreams)) return;
+    Mutex::Autolock trimLock(mTrimLock);
+    Mutex::Autolock lock(mLock);
+    mStreams[stream].attached = false;
+    mStreams[stream].pmem = 0;
+    mStreams[stream].resident = 0;
+    mStreams[stream].overlay = false;
+    mStreams[stream].trimmer = NULL;
+
+    // whoever is left becomes primary for its next configuration
+    int next = -1;
+    for (int i = 0; i < kMaxStreams; i++) {
+        if (!mStreams[i].attached) continue;
+        if (mStreams[i].primary) return;
+        if (next < 0) next = i;
+    }
+    if (next >= 0) mStreams[next].primary = true;
+}
+
+int VideoOutputManager::reserveBuffers(int stream, size_t frameSize, int want, int minCount)
+{
+    if ((stream < 0) || (stream >= kMaxStreams)) return 0;
+
+    bool limited;
+    int count = tryReserve(stream, frameSize, want, minCount, &limited);
+    // idle streams may be sitting on buffers they do not need
+    if (limited && trimOthers(stream)) {
+        count = tryReserve(stream, frameSize, want, minCount, &limited);
+    }
+
+    Mutex::Autolock lock(mLock);
+    if (count == 0) {
+        LOGE("stream %d: no room for %d x %u bytes of frame buffers (%u of %u in use)",
+             stream, minCount, (unsigned)frameSize, (unsigned)usedPmemLocked(), (unsigned)mPmemBudget);
+        mRefusedPmem++;
+    } else if (count < want) {
+        mShrunk++;
+    }
+    LOGV("stream %d: %d of %d frame buffers", stream, count, want);
+    return count;
+}
+
+// limited is set when the budget, not the stream's rank, held it back
+int VideoOutputManager::tryReserve(int stream, size_t frameSize, int want, int minCount, bool* limited)
+{
+    Mutex::Autolock lock(mLock);
+
+    Stream& s = mStreams[stream];
+    s.pmem = 0;
+    size_t available = (mPmemBudget > usedPmemLocked()) ? mPmemBudget - usedPmemLocked() : 0;
+
+    int count = s.primary ? want : minCount;
+    *limited = false;
+    if ((frameSize > 0) && ((size_t)count * frameSize > available)) {
+        count = available / frameSize;
+        *limited = true;
+    }
+    if (count < minCount) return 0;
+
+    s.pmem = count * frameSize;
+    return count;
+}
+
+bool VideoOutputManager::trimOthers(int stream)
+{
+    // one round at a time; a stream reserving from inside its own trim
+    // must not wait for it
+    if (mTrimLock.tryLock() != NO_ERROR) return false;
+
+    Trimmer* trimmers[kMaxStreams];
+    int count = 0;
+    mLock.lock();
+    for (int i = 0; i < kMaxStreams; i++) {
+        if ((i != stream) && mStreams[i].attached && (mStreams[i].trimmer != NULL))
+            trimmers[count++] = mStreams[i].trimmer;
+    }
+    mLock.unlock();
+
+    // called without mLock, trimSlots reserves the smaller share itself
+    int trimmed = 0;
+    for (int i = 0; i < count; i++) {
+        if (trimmers[i]->trimSlots()) trimmed++;
+    }
+
+    mLock.lock();
+    mTrims += trimmed;
+    mLock.unlock();
+    mTrimLock.unlock();
+    return trimmed > 0;
+}
+
+void VideoOutputManager::releaseBuffers(int stream)
+{
+    if ((stream < 0) || (stream >= kMaxStreams)) return;
+    Mutex::Autolock lock(mLock);
+    mStreams[stream].pmem = 0;
+    mStreams[stream].resident = 0;
+}
+
+void VideoOutputManager::setResident(int stream, size_t bytes)
+{
+    if ((stream < 0) || (stream >= kMaxStreams)) return;
+    Mutex::Autolock lock(mLock);
+    mStreams[stream].resident = bytes;
+}
+
+bool VideoOutputManager::reserveOverlay(int stream)
+{
+    if ((stream < 0) || (stream >= kMaxStreams)) return false;
+    Mutex::Autolock lock(mLock);
+
+    Stream& s = mStreams[stream];
+    if (s.overlay) return true;
+    if (usedOverlaysLocked() >= mOverlays) {
+        LOGV("stream %d: no overlay left", stream);
+        mRefusedOverlays++;
+        return false;
+    }
+    s.overlay = true;
+    return true;
+}
+
+void VideoOutputManager::releaseOverlay(int stream)
+{
+    if ((stream < 0) || (stream >= kMaxStreams)) return;
+    Mutex::Autolock lock(mLock);
+    mStreams[stream].overlay = false;
+}
+
+bool VideoOutputManager::isPrimary(int stream) const
+{
+    if ((stream < 0) || (stream >= kMaxStreams)) return false;
+    Mutex::Autolock lock(mLock);
+    return mStreams[stream].primary;
+}
+
+size_t VideoOutputManager::usedPmemLocked() const
+{
+    size_t used = 0;
+    for (int i = 0; i < kMaxStreams; i++) {
+        if (mStreams[i].attached) used += mStreams[i].pmem;
+    }
+    return used;
+}
+
+int VideoOutputManager::usedOverlaysLocked() const
+{
+    int used = 0;
+    for (int i = 0; i < kMaxStreams; i++) {
+        if (mStreams[i].attached && mStreams[i].overlay) used++;
+    }
+    return used;
+}
+
+void VideoOutputManager::print(const char* name) const
+{
+    Mutex::Autolock lock(mLock);
+    LOGE("%s: video outputs use %u of %u bytes of pmem and %d of %d overlays; %lu shrunk, %lu refused pmem, %lu refused overlays, %lu trimmed",
+         name, (unsigned)usedPmemLocked(), (unsigned)mPmemBudget, usedOverlaysLocked(), mOverlays,
+         mShrunk, mRefusedPmem, mRefusedOverlays, mTrims);
+    for (int i = 0; i < kMaxStreams; i++) {
+        const Stream& s = mStreams[i];
+        if (!s.attached) continue;
+        LOGE("%s:   stream %d%s: %u bytes reserved, %u resident%s", name, i,
+             s.primary ? " (primary)" : "", (unsigned)s.pmem, (unsigned)s.resident,
+             s.overlay ? ", overlay" : "");
+    }
+}
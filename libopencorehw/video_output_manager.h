@@ -0,0 +1,114 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef VIDEO_OUTPUT_MANAGER_H_INCLUDED
+#define VIDEO_OUTPUT_MANAGER_H_INCLUDED
+
+#include <stddef.h>
+#include <utils/threads.h>
+
+/*
+ * Shares the frame buffer pmem and the overlay pipes between the video
+ * outputs of one process (picture-in-picture, camera preview next to
+ * playback, ...).
+ *
+ * Every MIO attaches a stream for its lifetime.  The first stream attached
+ * while no other is active is the primary one: it gets the buffer count it
+ * asks for as long as the budget holds it.  Streams attached next to it
+ * are secondary and only get their minimum count.  Overlays go to whoever
+ * asks first; a stream that gets none takes the surface (SurfaceFlinger)
+ * path instead.
+ *
+ * A reservation that cannot be met in full first asks the other streams
+ * to trim: an idle one gives back every frame buffer but the one on
+ * screen.  The streams report what they actually have allocated, which
+ * print() lists per stream.
+ *
+ * The process-wide instance reads its limits from persist.pv.vo.pmem (MiB
+ * of frame buffers, default 24) and persist.pv.vo.overlays (default 1).
+ * Nothing here touches pmem or the overlay itself, so the policy can be
+ * exercised on a host with stand-ins, see tools/video_output_sim.cpp.
+ */
+class VideoOutputManager
+{
+public:
+    // implemented by the MIO, called from whichever thread needs the memory
+    class Trimmer {
+    public:
+        virtual ~Trimmer() {}
+        // give back what is not on screen if idle; true if anything was
+        virtual bool trimSlots() = 0;
+    };
+
+    static VideoOutputManager* instance();
+
+    VideoOutputManager(size_t pmemBudget, int overlays);
+
+    // -1 when kMaxStreams are attached already
+    int attach(Trimmer* trimmer = NULL);
+    // returns everything the stream holds; no trimSlots() call is in
+    // progress or made for it once this returns
+    void detach(int stream);
+
+    // sets how many frame buffers of frameSize bytes the stream keeps in
+    // pmem, replacing what it had: want for a primary stream if the budget
+    // allows, otherwise as many as fit down to minCount.  0 if not even
+    // minCount fit.
+    int reserveBuffers(int stream, size_t frameSize, int want, int minCount);
+    void releaseBuffers(int stream);
+    // bytes of the reservation actually allocated, for print()
+    void setResident(int stream, size_t bytes);
+
+    bool reserveOverlay(int stream);
+    void releaseOverlay(int stream);
+
+    bool isPrimary(int stream) const;
+
+    void print(const char* name) const;
+
+    static const int kMaxStreams = 8;
+
+private:
+    struct Stream {
+        bool            attached;
+        bool            primary;
+        size_t          pmem;
+        size_t          resident;
+        bool            overlay;
+        Trimmer*        trimmer;
+    };
+
+    int tryReserve(int stream, size_t frameSize, int want, int minCount, bool* limited);
+    bool trimOthers(int stream);
+    size_t usedPmemLocked() const;
+    int usedOverlaysLocked() const;
+
+    mutable android::Mutex      mLock;
+    // held while trimmers are called, detach waits on it
+    android::Mutex              mTrimLock;
+    size_t                      mPmemBudget;
+    int                         mOverlays;
+    Stream                      mStreams[kMaxStreams];
+
+    unsigned long               mShrunk;        // reservations given less than asked
+    unsigned long               mRefusedPmem;
+    unsigned long               mRefusedOverlays;
+    unsigned long               mTrims;         // streams that gave buffers back
+};
+
+#endif // VIDEO_OUTPUT_MANAGER_H_INCLUDED
@@ -0,0 +1,79 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef VIDEO_POST_STATS_H_INCLUDED
+#define VIDEO_POST_STATS_H_INCLUDED
+
+#include <utils/Timers.h>
+
+// Wall-clock latency and thread CPU time spent getting each frame onto
+// the display.  Used by the MIOs and the tunneled display sink so the
+// two paths report comparable numbers under persist.debug.pv.statistics:
+// both count from the frame reaching them (writeFrameBuf, the sink's
+// EmptyThisBuffer) to its post.  The time a frame takes through the PV
+// graph to the MIO is not in it; tools/tunnel_bench.cpp times both paths
+// from the decoder.
+class VideoPostStats
+{
+public:
+    VideoPostStats() { reset(); }
+
+    void reset()
+    {
+        mFrames = 0;
+        mLatencySum = 0;
+        mLatencyMax = 0;
+        mCpuSum = 0;
+        mStartTime = 0;
+        mStartCpu = 0;
+    }
+
+    inline void begin()
+    {
+        mStartTime = systemTime(SYSTEM_TIME_MONOTONIC);
+        mStartCpu = systemTime(SYSTEM_TIME_THREAD);
+    }
+
+    inline void end()
+    {
+        nsecs_t latency = systemTime(SYSTEM_TIME_MONOTONIC) - mStartTime;
+        mCpuSum += systemTime(SYSTEM_TIME_THREAD) - mStartCpu;
+        mLatencySum += latency;
+        if (latency > mLatencyMax) mLatencyMax = latency;
+        mFrames++;
+    }
+
+    unsigned long frames() const { return mFrames; }
+
+    void print(const char* name) const
+    {
+        if (mFrames == 0) return;
+        LOGE("%s: post latency avg %.3f ms max %.3f ms, cpu %.3f ms/frame over %lu frames", name,
+             mLatencySum / (1e6 * mFrames), mLatencyMax / 1e6, mCpuSum / (1e6 * mFrames), mFrames);
+    }
+
+private:
+    unsigned long               mFrames;
+    nsecs_t                     mLatencySum;
+    nsecs_t                     mLatencyMax;
+    nsecs_t                     mCpuSum;
+    nsecs_t                     mStartTime;
+    nsecs_t                     mStartCpu;
+};
+
+#endif // VIDEO_POST_STATS_H_INCLUDED
@@ -0,0 +1,389 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YuvRgbConvert"
+#include <utils/Log.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "yuv_rgb_convert.h"
+
+using namespace android;
+
+/*
+ * Coefficients in Q6:
+ *   R = 1.164 (Y - 16)                 + 1.596 (V - 128)
+ *   G = 1.164 (Y - 16) - 0.391 (U - 128) - 0.813 (V - 128)
+ *   B = 1.164 (Y - 16) + 2.018 (U - 128)
+ */
+enum {
+    kYCoef  = 75,
+    kRvCoef = 102,
+    kGuCoef = 25,
+    kGvCoef = 52,
+    kBuCoef = 129
+};
+
+static inline uint8_t clampQ6(int x)
+{
+    x = (x + 32) >> 6;
+    return x < 0 ? 0 : (x > 255 ? 255 : x);
+}
+
+static inline void storePixel(uint8_t* d, int x, int dstFormat, uint8_t r, uint8_t g, uint8_t b)
+{
+    if (dstFormat == RGB_FORMAT_565) {
+        ((uint16_t*)d)[x] = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+    } else {
+        d += x * 4;
+        d[0] = r;
+        d[1] = g;
+        d[2] = b;
+        d[3] = 0xff;
+    }
+}
+
+// plain C, handles any start column and the tail the vector loop leaves
+static void convertSpan(const uint8_t* py, const uint8_t* pu, const uint8_t* pv, int uvStep,
+                        int x, int width, uint8_t* d, int dstFormat)
+{
+    for (; x < width; x++) {
+        int c = (py[x] - 16) * kYCoef;
+        int du = pu[(x >> 1) * uvStep] - 128;
+        int dv = pv[(x >> 1) * uvStep] - 128;
+        storePixel(d, x, dstFormat,
+                   clampQ6(c + dv * kRvCoef),
+                   clampQ6(c - (du * kGuCoef + dv * kGvCoef)),
+                   clampQ6(c + du * kBuCoef));
+    }
+}
+
+#if defined(__ARM_NEON__)
+// 16 pixels per iteration, returns the first column left unconverted
+static int convertSpanNeon(const uint8_t* py, const uint8_t* pu, const uint8_t* pv, int format,
+                           int width, uint8_t* d, int dstFormat)
+{
+    const uint8x8_t k16 = vdup_n_u8(16);
+    const uint8x8_t k128 = vdup_n_u8(128);
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        uint8x16_t y = vld1q_u8(py + x);
+        uint8x8_t u, v;
+        if (format == YUV_FORMAT_I420) {
+            u = vld1_u8(pu + (x >> 1));
+            v = vld1_u8(pv + (x >> 1));
+        } else {
+            // pu points at the first U byte, so NV21 is interleaved the other way round
+            uint8x8x2_t uv = vld2_u8((format == YUV_FORMAT_NV12 ? pu : pv) + x);
+            u = uv.val[format == YUV_FORMAT_NV12 ? 0 : 1];
+            v = uv.val[format == YUV_FORMAT_NV12 ? 1 : 0];
+        }
+
+        int16x8_t du = vreinterpretq_s16_u16(vsubl_u8(u, k128));
+        int16x8_t dv = vreinterpretq_s16_u16(vsubl_u8(v, k128));
+        int16x8_t ruv = vmulq_n_s16(dv, kRvCoef);
+        int16x8_t guv = vmlaq_n_s16(vmulq_n_s16(du, kGuCoef), dv, kGvCoef);
+        int16x8_t buv = vmulq_n_s16(du, kBuCoef);
+
+        // each chroma sample covers two horizontal pixels
+        int16x8x2_t r2 = vzipq_s16(ruv, ruv);
+        int16x8x2_t g2 = vzipq_s16(guv, guv);
+        int16x8x2_t b2 = vzipq_s16(buv, buv);
+
+        for (int h = 0; h < 2; h++) {
+            uint8x8_t yh = h ? vget_high_u8(y) : vget_low_u8(y);
+            int16x8_t c = vmulq_n_s16(vreinterpretq_s16_u16(vsubl_u8(yh, k16)), kYCoef);
+            uint8x8_t r = vqrshrun_n_s16(vqaddq_s16(c, r2.val[h]), 6);
+            uint8x8_t g = vqrshrun_n_s16(vqsubq_s16(c, g2.val[h]), 6);
+            uint8x8_t b = vqrshrun_n_s16(vqaddq_s16(c, b2.val[h]), 6);
+
+            if (dstFormat == RGB_FORMAT_565) {
+                uint16x8_t p = vshll_n_u8(r, 8);
+                p = vsriq_n_u16(p, vshll_n_u8(g, 8), 5);
+                p = vsriq_n_u16(p, vshll_n_u8(b, 8), 11);
+                vst1q_u16((uint16_t*)d + x + h * 8, p);
+            } else {
+                uint8x8x4_t p;
+                p.val[0] = r;
+                p.val[1] = g;
+                p.val[2] = b;
+                p.val[3] = vdup_n_u8(0xff);
+                vst4_u8(d + (x + h * 8) * 4, p);
+            }
+        }
+    }
+    return x;
+}
+#endif
+
+void yuvToRgbRows(const YuvImage& src, int width, int firstRow, int rows,
+                  uint8_t* dst, int dstStride, int dstFormat)
+{
+    // for the semi-planar layouts pu/pv point into the same interleaved row
+    int uvStep = (src.format == YUV_FORMAT_I420) ? 1 : 2;
+
+    for (int row = firstRow; row < firstRow + rows; row++) {
+        const uint8_t* py = src.y + row * src.yStride;
+        const uint8_t* pu;
+        const uint8_t* pv;
+        if (src.format == YUV_FORMAT_I420) {
+            pu = src.u + (row >> 1) * src.uvStride;
+            pv = src.v + (row >> 1) * src.uvStride;
+        } else {
+            const uint8_t* uv = src.u + (row >> 1) * src.uvStride;
+            pu = (src.format == YUV_FORMAT_NV12) ? uv : uv + 1;
+            pv = (src.format == YUV_FORMAT_NV12) ? uv + 1 : uv;
+        }
+        uint8_t* d = dst + row * dstStride;
+
+        int x = 0;
+#if defined(__ARM_NEON__)
+        x = convertSpanNeon(py, pu, pv, src.format, width, d, dstFormat);
+#endif
+        convertSpan(py, pu, pv, uvStep, x, width, d, dstFormat);
+    }
+}
+
+#define ALIGN(x, a)     (((x) + (a) - 1) & ~((a) - 1))
+
+// byte offset of sample (x, y) in a plane of 64x32 tiles, tilesWide x
+// tilesHigh; tiles go in pairs of tile rows in a Z pattern, except for a
+// lone last row which is linear
+static inline size_t tiledOffset(int x, int y, int tilesWide, int tilesHigh)
+{
+    int tx = x >> 6;
+    int ty = y >> 5;
+    size_t tile = tx + (ty & ~1) * tilesWide;
+    if (ty & 1) {
+        tile += (tx & ~3) + 2;
+    } else if (((tilesHigh & 1) == 0) || (ty != tilesHigh - 1)) {
+        tile += (tx + 2) & ~3;
+    }
+    return (tile << 11) + ((y & 31) << 6) + (x & 63);
+}
+
+static inline uint8_t average4(int a, int b, int c, int d)
+{
+    return (a + b + c + d + 2) >> 2;
+}
+
+// source column/row for destination index i; with box set, the first of
+// the two samples averaged, otherwise the nearest one to the centre
+static inline int sourceIndex(int i, int size, int dstSize, bool box)
+{
+    if (box) return (i * size) / dstSize;
+    return ((2 * i + 1) * size) / (2 * dstSize);
+}
+
+bool yuvToRgbScaled(const YuvImage& src, int width, int height,
+                    uint8_t* dst, int dstWidth, int dstHeight, int dstStride, int dstFormat)
+{
+    int chromaWidth = (dstWidth + 1) / 2;
+    int* xmap = static_cast<int*>(malloc(dstWidth * sizeof(int)));
+    uint8_t* rowY = static_cast<uint8_t*>(malloc(dstWidth + 2 * chromaWidth));
+    if ((xmap == NULL) || (rowY == NULL)) {
+        free(xmap);
+        free(rowY);
+        return false;
+    }
+    uint8_t* rowU = rowY + dstWidth;
+    uint8_t* rowV = rowU + chromaWidth;
+
+    // the second sample of a pair is one pixel on, or the same one
+    bool boxX = width >= 2 * dstWidth;
+    bool boxY = height >= 2 * dstHeight;
+    int stepX = boxX ? 1 : 0;
+    for (int x = 0; x < dstWidth; x++) {
+        xmap[x] = sourceIndex(x, width, dstWidth, boxX);
+        if (xmap[x] + stepX >= width) xmap[x] = width - 1 - stepX;
+    }
+
+    bool tiled = (src.format == YUV_FORMAT_NV12_TILED);
+    int tilesWide = ALIGN(src.yStride, 128) >> 6;
+    int lumaTilesHigh = ALIGN(src.tiledHeight, 32) >> 5;
+    int chromaTilesHigh = ALIGN(src.tiledHeight / 2, 32) >> 5;
+
+    for (int dy = 0; dy < dstHeight; dy++) {
+        int y0 = sourceIndex(dy, height, dstHeight, boxY);
+        int y1 = boxY ? y0 + 1 : y0;
+        if (y1 >= height) y0 = y1 = height - 1;
+        int cy = y0 >> 1;
+
+        // gather this row's samples into an I420 style row
+        if (tiled) {
+            for (int x = 0; x < dstWidth; x++) {
+                int x0 = xmap[x];
+                int x1 = x0 + stepX;
+                rowY[x] = average4(src.y[tiledOffset(x0, y0, tilesWide, lumaTilesHigh)],
+                                   src.y[tiledOffset(x1, y0, tilesWide, lumaTilesHigh)],
+                                   src.y[tiledOffset(x0, y1, tilesWide, lumaTilesHigh)],
+                                   src.y[tiledOffset(x1, y1, tilesWide, lumaTilesHigh)]);
+            }
+            for (int x = 0; x < chromaWidth; x++) {
+                const uint8_t* uv = src.u + tiledOffset(xmap[2 * x] & ~1, cy, tilesWide, chromaTilesHigh);
+                rowU[x] = uv[0];
+                rowV[x] = uv[1];
+            }
+        } else {
+            const uint8_t* r0 = src.y + y0 * src.yStride;
+            const uint8_t* r1 = src.y + y1 * src.yStride;
+            for (int x = 0; x < dstWidth; x++) {
+                int x0 = xmap[x];
+                rowY[x] = average4(r0[x0], r0[x0 + stepX], r1[x0], r1[x0 + stepX]);
+            }
+            if (src.format == YUV_FORMAT_I420) {
+                const uint8_t* pu = src.u + cy * src.uvStride;
+                const uint8_t* pv = src.v + cy * src.uvStride;
+                for (int x = 0; x < chromaWidth; x++) {
+                    rowU[x] = pu[xmap[2 * x] >> 1];
+                    rowV[x] = pv[xmap[2 * x] >> 1];
+                }
+            } else {
+                const uint8_t* uv = src.u + cy * src.uvStride;
+                int u = (src.format == YUV_FORMAT_NV12) ? 0 : 1;
+                for (int x = 0; x < chromaWidth; x++) {
+                    const uint8_t* p = uv + (xmap[2 * x] & ~1);
+                    rowU[x] = p[u];
+                    rowV[x] = p[1 - u];
+                }
+            }
+        }
+
+        uint8_t* d = dst + dy * dstStride;
+        int x = 0;
+#if defined(__ARM_NEON__)
+        x = convertSpanNeon(rowY, rowU, rowV, YUV_FORMAT_I420, dstWidth, d, dstFormat);
+#endif
+        convertSpan(rowY, rowU, rowV, 1, x, dstWidth, d, dstFormat);
+    }
+
+    free(xmap);
+    free(rowY);
+    return true;
+}
+
+YuvRgbConverter::YuvRgbConverter(int threads) :
+    mNumWorkers(0),
+    mNextWorker(0),
+    mGeneration(0),
+    mPending(0),
+    mExit(false)
+{
+    if (threads <= 0) {
+        threads = sysconf(_SC_NPROCESSORS_CONF);
+    }
+    if (threads > kMaxWorkers + 1) threads = kMaxWorkers + 1;
+
+    for (int i = 0; i < threads - 1; i++) {
+        if (pthread_create(&mWorkers[mNumWorkers], NULL, workerThread, this) != 0) {
+            LOGE("failed to start conversion worker %d", i);
+            break;
+        }
+        mNumWorkers++;
+    }
+    LOGV("converting with %d thread(s)", mNumWorkers + 1);
+}
+
+YuvRgbConverter::~YuvRgbConverter()
+{
+    mLock.lock();
+    mExit = true;
+    mStart.broadcast();
+    mLock.unlock();
+    for (int i = 0; i < mNumWorkers; i++) {
+        pthread_join(mWorkers[i], NULL);
+    }
+}
+
+void* YuvRgbConverter::workerThread(void* arg)
+{
+    YuvRgbConverter* self = static_cast<YuvRgbConverter*>(arg);
+    self->mLock.lock();
+    int index = self->mNextWorker++;
+    self->mLock.unlock();
+    self->workerLoop(index);
+    return NULL;
+}
+
+void YuvRgbConverter::workerLoop(int index)
+{
+    Mutex::Autolock lock(mLock);
+    // workers start in the constructor, before any frame is handed out
+    uint32_t seen = 0;
+    for (;;) {
+        while (!mExit && (mGeneration == seen)) {
+            mStart.wait(mLock);
+        }
+        if (mExit) break;
+        seen = mGeneration;
+
+        Job job = mJobs[index];
+        mLock.unlock();
+        yuvToRgbRows(*job.src, job.width, job.firstRow, job.rows, job.dst, job.dstStride, job.dstFormat);
+        mLock.lock();
+
+        if (--mPending == 0) mDone.signal();
+    }
+}
+
+void YuvRgbConverter::convert(const YuvImage& src, int width, int height,
+                              uint8_t* dst, int dstStride, int dstFormat)
+{
+    if ((mNumWorkers == 0) || (width * height <= kBandThreshold)) {
+        yuvToRgbRows(src, width, 0, height, dst, dstStride, dstFormat);
+        return;
+    }
+
+    // even band heights keep every chroma row inside one band
+    int bands = mNumWorkers + 1;
+    int bandRows = ((height + bands - 1) / bands + 1) & ~1;
+
+    mLock.lock();
+    int row = bandRows;
+    for (int i = 0; i < mNumWorkers; i++) {
+        Job& job = mJobs[i];
+        job.src = &src;
+        job.width = width;
+        job.firstRow = row < height ? row : height;
+        job.rows = (height - job.firstRow) < bandRows ? (height - job.firstRow) : bandRows;
+        job.dst = dst;
+        job.dstStride = dstStride;
+        job.dstFormat = dstFormat;
+        row += bandRows;
+    }
+    mPending = mNumWorkers;
+    mGeneration++;
+    mStart.broadcast();
+    mLock.unlock();
+
+    // the caller takes the first band
+    yuvToRgbRows(src, width, 0, bandRows < height ? bandRows : height, dst, dstStride, dstFormat);
+
+    mLock.lock();
+    while (mPending > 0) {
+        mDone.wait(mLock);
+    }
+    mLock.unlock();
+}
@@ -0,0 +1,123 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef YUV_RGB_CONVERT_H_INCLUDED
+#define YUV_RGB_CONVERT_H_INCLUDED
+
+#include <stdint.h>
+#include <pthread.h>
+#include <utils/threads.h>
+
+/*
+ * YUV420 to RGB conversion for software composition, used when no overlay
+ * is available and SurfaceFlinger has to be handed RGB buffers.
+ *
+ * BT.601 video range, fixed point with 6 fractional bits so every product
+ * fits a 16 bit lane.  No lookup tables: on NEON targets 16 pixels go
+ * through per iteration with saturating adds doing the clamping, elsewhere
+ * (and for the tail of each row) the same arithmetic runs in C, so both
+ * paths produce identical output.
+ *
+ * Large frames are split into row bands converted in parallel by a small
+ * pool of worker threads owned by the converter.
+ *
+ * yuvToRgbScaled() serves frame grabs: it samples the source at the
+ * destination size one row at a time and runs the same row kernels on the
+ * gathered samples, so only the pixels used are ever read.
+ */
+
+enum {
+    YUV_FORMAT_I420 = 0,    // planar Y, U, V
+    YUV_FORMAT_NV12,        // Y then interleaved U/V
+    YUV_FORMAT_NV21,        // Y then interleaved V/U
+    YUV_FORMAT_NV12_TILED   // NV12 in 64x32 tiles (7x30 decoder), yuvToRgbScaled only
+};
+
+enum {
+    RGB_FORMAT_565 = 0,     // HAL_PIXEL_FORMAT_RGB_565
+    RGB_FORMAT_X8888        // HAL_PIXEL_FORMAT_RGBX_8888
+};
+
+struct YuvImage {
+    const uint8_t*  y;
+    const uint8_t*  u;      // interleaved chroma for NV12/NV21
+    const uint8_t*  v;      // unused for NV12/NV21
+    int             yStride;
+    int             uvStride;
+    int             format;
+    int             tiledHeight;    // NV12_TILED: coded height, yStride is the coded width
+};
+
+// converts rows [firstRow, firstRow + rows) of width pixels; firstRow must be even
+void yuvToRgbRows(const YuvImage& src, int width, int firstRow, int rows,
+                  uint8_t* dst, int dstStride, int dstFormat);
+
+// scales the top-left width x height of src to dstWidth x dstHeight (2x2
+// averaged luma when shrinking by two or more) and converts it; false if
+// the row buffers cannot be allocated
+bool yuvToRgbScaled(const YuvImage& src, int width, int height,
+                    uint8_t* dst, int dstWidth, int dstHeight, int dstStride, int dstFormat);
+
+class YuvRgbConverter
+{
+public:
+    // threads <= 0 picks a count from the number of online cpus
+    YuvRgbConverter(int threads = 0);
+    ~YuvRgbConverter();
+
+    int bytesPerPixel(int dstFormat) const { return dstFormat == RGB_FORMAT_565 ? 2 : 4; }
+
+    // converts a width x height frame; bands are used once the frame is
+    // larger than kBandThreshold pixels
+    void convert(const YuvImage& src, int width, int height,
+                 uint8_t* dst, int dstStride, int dstFormat);
+
+    int threads() const { return mNumWorkers + 1; }
+
+    // roughly half of a 720p frame
+    static const int kBandThreshold = 640 * 720;
+
+private:
+    struct Job {
+        const YuvImage* src;
+        int             width;
+        int             firstRow;
+        int             rows;
+        uint8_t*        dst;
+        int             dstStride;
+        int             dstFormat;
+    };
+
+    static const int kMaxWorkers = 3;
+
+    static void* workerThread(void* arg);
+    void workerLoop(int index);
+
+    android::Mutex              mLock;
+    android::Condition          mStart;
+    android::Condition          mDone;
+    pthread_t                   mWorkers[kMaxWorkers];
+    int                         mNumWorkers;
+    int                         mNextWorker;    // hands out worker indices at startup
+    Job                         mJobs[kMaxWorkers];
+    uint32_t                    mGeneration;    // bumped for every frame handed out
+    int                         mPending;       // bands still being converted
+    bool                        mExit;
+};
+
+#endif // YUV_RGB_CONVERT_H_INCLUDED
@@ -1,24 +1,104 @@
 ifeq ($(call is-board-platform-in-list,msm8960 msm8660 msm7627a msm7630_surf msm7630_fusion),true)
-
 LOCAL_PATH := $(my-dir)
 
-########################
-include $(CLEAR_VARS)
-
 ifeq ($(call is-board-platform,msm7627a),true)
-LOCAL_SRC_FILES := media_profiles_7627a.xml
+MEDIA_PROFILES_XML := media_profiles_7627a.xml
 else ifeq ($(call is-board-platform-in-list,msm8960 msm8660 msm7630_surf msm7630_fusion),true)
-LOCAL_SRC_FILES := media_profiles.xml
+MEDIA_PROFILES_XML := media_profiles.xml
 endif
 
+########################
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := $(MEDIA_PROFILES_XML)
 LOCAL_MODULE := media_profiles.xml
-
 LOCAL_MODULE_TAGS := optional
-
+LOCAL_REQUIRED_MODULES := media_profiles.bin
 # This will install the file in /system/etc
 #
 LOCAL_MODULE_CLASS := ETC
-
 include $(BUILD_PREBUILT)
+
+########################
+# Compiled form of the same file, validated against the DTD at build time
+# and mmapped by libmediaprofiles_table.  Also installed in /system/etc.
+include $(CLEAR_VARS)
+LOCAL_MODULE := media_profiles.bin
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_CLASS := ETC
+LOCAL_MODULE_PATH := $(TARGET_OUT_ETC)
+include $(BUILD_SYSTEM)/base_rules.mk
+
+MEDIA_PROFILES_COMPILER := $(HOST_OUT_EXECUTABLES)/media_profiles_compiler$(HOST_EXECUTABLE_SUFFIX)
+
+$(LOCAL_BUILT_MODULE): PRIVATE_XML := $(LOCAL_PATH)/$(MEDIA_PROFILES_XML)
+$(LOCAL_BUILT_MODULE): $(LOCAL_PATH)/$(MEDIA_PROFILES_XML) $(MEDIA_PROFILES_COMPILER)
+	@echo "Media profiles: $@"
+	@mkdir -p $(dir $@)
+	$(hide) $(MEDIA_PROFILES_COMPILER) $(PRIVATE_XML) $@
+
+media_profiles_table_src_files := \
+	src/media_profiles_parser.cpp \
+	src/media_profiles_table.cpp
+
+########################
+# Runtime loader
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := $(media_profiles_table_src_files)
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/include \
+	external/expat/lib
+LOCAL_SHARED_LIBRARIES := libutils libcutils libexpat
+LOCAL_MODULE := libmediaprofiles_table
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_SHARED_LIBRARY)
+
+########################
+# Build time compiler
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := \
+	$(media_profiles_table_src_files) \
+	tools/media_profiles_compiler.cpp
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/include \
+	external/expat/lib
+LOCAL_STATIC_LIBRARIES := libexpat libutils libcutils liblog
+LOCAL_MODULE := media_profiles_compiler
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+########################
+# Encoder calibration, regenerates the profile limits from measurements.
+# The host build runs against the stand-in core in pvomx/omx_core_stub.
+PV_TOP := external/opencore
+
+media_profiles_calibrate_includes := \
+	$(LOCAL_PATH)/include \
+	external/expat/lib \
+	$(PV_TOP)/extern_libs_v2/khronos/openmax/include \
+	$(PV_TOP)/oscl/oscl/config/android \
+	$(PV_TOP)/oscl/oscl/config/shared \
+	$(PV_TOP)/build_config/opencore_dynamic \
+	$(TARGET_OUT_HEADERS)/libpv
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := tools/media_profiles_calibrate.cpp
+LOCAL_C_INCLUDES := $(media_profiles_calibrate_includes)
+LOCAL_SHARED_LIBRARIES := libmediaprofiles_table libexpat libutils libcutils libdl
+LOCAL_MODULE := media_profiles_calibrate
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+ifeq ($(HOST_OS),linux)
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := \
+	$(media_profiles_table_src_files) \
+	tools/media_profiles_calibrate.cpp
+LOCAL_C_INCLUDES := $(media_profiles_calibrate_includes)
+LOCAL_STATIC_LIBRARIES := libexpat libutils libcutils liblog
+LOCAL_LDLIBS := -ldl -lpthread -lrt
+LOCAL_MODULE := media_profiles_calibrate
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
 endif
 
+endif
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_PROFILES_PARSER_H_INCLUDED
+#define MEDIA_PROFILES_PARSER_H_INCLUDED
+
+#include <utils/Vector.h>
+#include <utils/String8.h>
+
+#include "media_profiles_table.h"
+
+namespace android {
+
+// Everything media_profiles.xml describes, in document order.
+class MediaProfilesData
+{
+public:
+    MediaProfilesData();
+
+    Vector<MediaProfilesCameraRecord>               cameras;
+    Vector<MediaProfilesEncoderProfileRecord>       encoderProfiles;
+    Vector<MediaProfilesImageEncodingRecord>        imageEncoding;
+    Vector<int32_t>                                 encoderFileFormats;
+    Vector<MediaProfilesVideoEncoderCapRecord>      videoEncoderCaps;
+    Vector<MediaProfilesAudioEncoderCapRecord>      audioEncoderCaps;
+    Vector<MediaProfilesDecoderCapRecord>           videoDecoderCaps;
+    Vector<MediaProfilesDecoderCapRecord>           audioDecoderCaps;
+    MediaProfilesVideoEditorCapRecord               videoEditorCap;
+    bool                                            hasVideoEditorCap;
+    Vector<MediaProfilesExportVideoProfileRecord>   exportVideoProfiles;
+};
+
+/*
+ * Parses media_profiles.xml and checks it against the DTD in its internal
+ * subset.
+ *
+ * The shipped files rely on a few things the framework's parser accepts
+ * but the DTD does not declare (vendor qualities, cameraId/startOffsetMs,
+ * a missing Camera element).  Those are reported as warnings, or as
+ * errors in strict mode.  Anything the framework would misread -- bad
+ * numbers, unknown codec or quality names, missing required attributes,
+ * undeclared elements -- is always an error.
+ */
+class MediaProfilesParser
+{
+public:
+    explicit MediaProfilesParser(bool strict = false);
+    ~MediaProfilesParser();
+
+    // returns false if the file could not be read or had errors
+    bool parse(const char* path, MediaProfilesData* data);
+
+    int errors() const { return mErrors; }
+    int warnings() const { return mWarnings; }
+
+    // name <-> id helpers shared with the tools; -1 if unknown
+    static int qualityFromName(const char* name);
+    static const char* qualityName(int quality);
+    static int videoCodecFromName(const char* name);
+    static const char* videoCodecName(int codec);
+    static int audioCodecFromName(const char* name);
+    static const char* audioCodecName(int codec);
+    static int fileFormatFromName(const char* name);
+    static const char* fileFormatName(int format);
+
+private:
+    struct ChildRule {
+        String8     name;
+        bool        required;
+    };
+
+    struct ElementRule {
+        String8             name;
+        bool                empty;
+        Vector<ChildRule>   children;
+    };
+
+    struct AttributeRule {
+        String8             element;
+        String8             name;
+        Vector<String8>     values;     // empty for CDATA
+        bool                required;
+    };
+
+    struct OpenElement {
+        int                 rule;
+        Vector<String8>     children;
+    };
+
+    static void startElementHandler(void* userData, const char* name, const char** atts);
+    static void endElementHandler(void* userData, const char* name);
+    static void elementDeclHandler(void* userData, const char* name, void* model);
+    static void attlistDeclHandler(void* userData, const char* elname, const char* attname,
+                                   const char* attType, const char* dflt, int isRequired);
+
+    void startElement(const char* name, const char** atts);
+    void endElement(const char* name);
+
+    int validateElement(const char* name, const char** atts);
+    void checkChildren(const OpenElement& element);
+    int findElementRule(const char* name) const;
+    const AttributeRule* findAttributeRule(const char* element, const char* name) const;
+
+    const char* getAttribute(const char** atts, const char* name, bool required);
+    int32_t getNumber(const char** atts, const char* name, bool required, int32_t dflt);
+    bool getBool(const char** atts, const char* name);
+    int getId(const char** atts, const char* name, int (*lookup)(const char*), const char* what);
+
+    void error(const char* fmt, ...);
+    void warning(const char* fmt, ...);
+
+    bool                        mStrict;
+    void*                       mParser;
+    const char*                 mPath;
+    int                         mErrors;
+    int                         mWarnings;
+
+    Vector<ElementRule>         mElements;
+    Vector<AttributeRule>       mAttributes;
+    Vector<OpenElement>         mStack;
+
+    MediaProfilesData*          mData;
+    int32_t                     mCurrentCameraId;
+    int                         mCurrentProfile;
+};
+
+}; // namespace android
+
+#endif // MEDIA_PROFILES_PARSER_H_INCLUDED
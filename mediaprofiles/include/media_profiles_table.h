@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_PROFILES_TABLE_H_INCLUDED
+#define MEDIA_PROFILES_TABLE_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Binary form of media_profiles.xml.
+ *
+ * media_profiles_compiler validates the XML against its DTD at build time
+ * and lays the same information out as fixed-size little-endian records,
+ * so the media server can mmap the result instead of running an XML parse
+ * on every start.  Layout:
+ *
+ *   MediaProfilesTableHeader
+ *   section data, each section 4-byte aligned, located through
+ *   MediaProfilesTableHeader::sections[]
+ *
+ * Camcorder profiles are additionally indexed by (cameraId, quality) in
+ * kSectionQualityIndex, an int16 matrix of numCameraIds x qualitySlots
+ * holding the record index or -1, so lookups are constant time.
+ *
+ * Readers must reject a table whose major version differs from
+ * MEDIA_PROFILES_TABLE_VERSION_MAJOR; minor versions only append.
+ */
+
+#define MEDIA_PROFILES_TABLE_MAGIC          0x4250524d  /* "MRPB" */
+#define MEDIA_PROFILES_TABLE_VERSION_MAJOR  1
+#define MEDIA_PROFILES_TABLE_VERSION_MINOR  0
+
+#define MEDIA_PROFILES_TABLE_PATH           "/system/etc/media_profiles.bin"
+#define MEDIA_PROFILES_XML_PATH             "/system/etc/media_profiles.xml"
+
+namespace android {
+
+// Camcorder qualities, mirroring camcorder_quality in media/MediaProfiles.h
+// including the vendor extensions.  Time lapse qualities sit at
+// kQualityTimeLapseBase plus the matching regular quality.
+enum {
+    kQualityLow = 0,
+    kQualityHigh = 1,
+    kQualityQCIF = 2,
+    kQualityCIF = 3,
+    kQuality480P = 4,
+    kQuality720P = 5,
+    kQuality1080P = 6,
+    kQualityQVGA = 7,
+    kQualityFWVGA = 8,
+    kQualityWVGA = 9,
+    kQualityVGA = 10,
+    kQualityWQVGA = 11,
+    kQualityCount = 12,
+
+    kQualityTimeLapseBase = 1000,
+
+    // slots in the quality index: regular qualities then time lapse ones
+    kQualitySlots = 2 * kQualityCount
+};
+
+// Codec and file format ids follow the framework's output_format,
+// video_encoder, audio_encoder and decoder enums.
+enum {
+    kFileFormat3GP = 1,
+    kFileFormatMP4 = 2,
+
+    kVideoCodecH263 = 1,
+    kVideoCodecH264 = 2,
+    kVideoCodecM4V = 3,
+    kVideoCodecWMV = 4,
+
+    kAudioCodecAMRNB = 1,
+    kAudioCodecAMRWB = 2,
+    kAudioCodecAAC = 3,
+    kAudioCodecWMA = 4
+};
+
+enum {
+    kSectionCameras,
+    kSectionEncoderProfiles,
+    kSectionQualityIndex,
+    kSectionImageEncoding,
+    kSectionEncoderFileFormats,
+    kSectionVideoEncoderCaps,
+    kSectionAudioEncoderCaps,
+    kSectionVideoDecoderCaps,
+    kSectionAudioDecoderCaps,
+    kSectionVideoEditorCap,
+    kSectionExportVideoProfiles,
+    kNumSections
+};
+
+struct MediaProfilesSection {
+    uint32_t    offset;     // from the start of the table
+    uint32_t    count;      // number of records
+    uint32_t    recordSize;
+};
+
+struct MediaProfilesTableHeader {
+    uint32_t                magic;
+    uint16_t                versionMajor;
+    uint16_t                versionMinor;
+    uint32_t                totalSize;
+    uint32_t                checksum;       // crc32 of everything after the header
+    uint32_t                numCameraIds;   // highest cameraId + 1
+    uint32_t                qualitySlots;
+    MediaProfilesSection    sections[kNumSections];
+};
+
+struct MediaProfilesCameraRecord {
+    int32_t     cameraId;
+    int32_t     startOffsetMs;      // -1 if not specified
+    int32_t     imageDecodingMemCap;
+    int32_t     previewFrameRate;   // -1 if not specified
+};
+
+struct MediaProfilesEncoderProfileRecord {
+    int32_t     cameraId;
+    int32_t     quality;
+    int32_t     fileFormat;
+    int32_t     duration;
+    int32_t     videoCodec;
+    int32_t     videoBitRate;
+    int32_t     videoWidth;
+    int32_t     videoHeight;
+    int32_t     videoFrameRate;
+    int32_t     audioCodec;
+    int32_t     audioBitRate;
+    int32_t     audioSampleRate;
+    int32_t     audioChannels;
+};
+
+struct MediaProfilesImageEncodingRecord {
+    int32_t     cameraId;
+    int32_t     quality;
+};
+
+struct MediaProfilesVideoEncoderCapRecord {
+    int32_t     codec;
+    int32_t     enabled;
+    int32_t     minBitRate;
+    int32_t     maxBitRate;
+    int32_t     minFrameWidth;
+    int32_t     maxFrameWidth;
+    int32_t     minFrameHeight;
+    int32_t     maxFrameHeight;
+    int32_t     minFrameRate;
+    int32_t     maxFrameRate;
+};
+
+struct MediaProfilesAudioEncoderCapRecord {
+    int32_t     codec;
+    int32_t     enabled;
+    int32_t     minBitRate;
+    int32_t     maxBitRate;
+    int32_t     minSampleRate;
+    int32_t     maxSampleRate;
+    int32_t     minChannels;
+    int32_t     maxChannels;
+};
+
+struct MediaProfilesDecoderCapRecord {
+    int32_t     codec;
+    int32_t     enabled;
+};
+
+struct MediaProfilesVideoEditorCapRecord {
+    int32_t     maxInputFrameWidth;
+    int32_t     maxInputFrameHeight;
+    int32_t     maxOutputFrameWidth;
+    int32_t     maxOutputFrameHeight;
+    int32_t     maxPrefetchYUVFrames;
+};
+
+struct MediaProfilesExportVideoProfileRecord {
+    int32_t     codec;
+    int32_t     profile;
+    int32_t     level;
+};
+
+class MediaProfilesData;
+
+/*
+ * Read-only view of a compiled table.
+ *
+ * open() maps the compiled table when it is present and valid, and
+ * otherwise parses the XML and builds the same table in memory, so
+ * callers see identical results either way.
+ */
+class MediaProfilesTable
+{
+public:
+    static MediaProfilesTable* open(const char* tablePath = MEDIA_PROFILES_TABLE_PATH,
+                                    const char* xmlPath = MEDIA_PROFILES_XML_PATH);
+    ~MediaProfilesTable();
+
+    // serialize parsed profiles; the result is malloc()ed
+    static void* build(const MediaProfilesData& data, size_t* size);
+
+    // check a table image before trusting any offset in it
+    static bool validate(const void* table, size_t size);
+
+    // true if the table was mapped from disk rather than built from XML
+    bool isMapped() const { return mMapped; }
+
+    // constant time; NULL if there is no such profile
+    const MediaProfilesEncoderProfileRecord* getCamcorderProfile(int cameraId, int quality) const;
+
+    const MediaProfilesCameraRecord* getCamera(int cameraId) const;
+
+    // first entry for the codec, which is what the XML based lookup returns
+    const MediaProfilesVideoEncoderCapRecord* getVideoEncoderCap(int codec) const;
+    const MediaProfilesAudioEncoderCapRecord* getAudioEncoderCap(int codec) const;
+    const MediaProfilesVideoEditorCapRecord* getVideoEditorCap() const;
+
+    template<class T>
+    const T* records(int section, size_t* count) const
+    {
+        const MediaProfilesSection& s = header()->sections[section];
+        *count = s.count;
+        return reinterpret_cast<const T*>(mBase + s.offset);
+    }
+
+private:
+    MediaProfilesTable();
+
+    bool map(const char* path);
+    bool loadXml(const char* path);
+
+    const MediaProfilesTableHeader* header() const
+    {
+        return reinterpret_cast<const MediaProfilesTableHeader*>(mBase);
+    }
+
+    const uint8_t*  mBase;
+    size_t          mSize;
+    bool            mMapped;
+};
+
+}; // namespace android
+
+#endif // MEDIA_PROFILES_TABLE_H_INCLUDED
@@ -0,0 +1,673 @@
+/*
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MediaProfilesParser"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+
+#include <expat.h>
+
+#include "media_profiles_parser.h"
+
+namespace android {
+
+struct NameMap {
+    const char* name;
+    int         id;
+};
+
+static const NameMap kQualityNames[] = {
+    {"low",     kQualityLow},
+    {"high",    kQualityHigh},
+    {"qcif",    kQualityQCIF},
+    {"cif",     kQualityCIF},
+    {"480p",    kQuality480P},
+    {"720p",    kQuality720P},
+    {"1080p",   kQuality1080P},
+    {"qvga",    kQualityQVGA},
+    {"fwvga",   kQualityFWVGA},
+    {"wvga",    kQualityWVGA},
+    {"vga",     kQualityVGA},
+    {"wqvga",   kQualityWQVGA},
+    {NULL,      -1}
+};
+
+static const NameMap kVideoCodecNames[] = {
+    {"h263",    kVideoCodecH263},
+    {"h264",    kVideoCodecH264},
+    {"m4v",     kVideoCodecM4V},
+    {"wmv",     kVideoCodecWMV},
+    {NULL,      -1}
+};
+
+static const NameMap kAudioCodecNames[] = {
+    {"amrnb",   kAudioCodecAMRNB},
+    {"amrwb",   kAudioCodecAMRWB},
+    {"aac",     kAudioCodecAAC},
+    {"wma",     kAudioCodecWMA},
+    {NULL,      -1}
+};
+
+static const NameMap kFileFormatNames[] = {
+    {"3gp",     kFileFormat3GP},
+    {"mp4",     kFileFormatMP4},
+    {NULL,      -1}
+};
+
+// attributes the framework reads although the DTD does not declare them
+static const char* kUndeclaredAttributes[][2] = {
+    {"CamcorderProfiles",   "cameraId"},
+    {"CamcorderProfiles",   "startOffsetMs"},
+    {NULL,                  NULL}
+};
+
+static const char kTimeLapsePrefix[] = "timelapse";
+
+static int lookup(const NameMap* map, const char* name)
+{
+    for (; map->name != NULL; map++) {
+        if (!strcmp(map->name, name)) return map->id;
+    }
+    return -1;
+}
+
+static const char* reverseLookup(const NameMap* map, int id)
+{
+    for (; map->name != NULL; map++) {
+        if (map->id == id) return map->name;
+    }
+    return NULL;
+}
+
+MediaProfilesData::MediaProfilesData()
+    : hasVideoEditorCap(false)
+{
+    memset(&videoEditorCap, 0, sizeof(videoEditorCap));
+}
+
+MediaProfilesParser::MediaProfilesParser(bool strict)
+    : mStrict(strict),
+      mParser(NULL),
+      mPath(NULL),
+      mErrors(0),
+      mWarnings(0),
+      mData(NULL),
+      mCurrentCameraId(0),
+      mCurrentProfile(-1)
+{
+}
+
+MediaProfilesParser::~MediaProfilesParser()
+{
+}
+
+int MediaProfilesParser::qualityFromName(const char* name)
+{
+    size_t prefix = sizeof(kTimeLapsePrefix) - 1;
+    if (!strncmp(name, kTimeLapsePrefix, prefix)) {
+        int quality = lookup(kQualityNames, name + prefix);
+        return quality < 0 ? -1 : kQualityTimeLapseBase + quality;
+    }
+    return lookup(kQualityNames, name);
+}
+
+const char* MediaProfilesParser::qualityName(int quality)
+{
+    static const char* kTimeLapseNames[kQualityCount] = {
+        "timelapselow", "timelapsehigh", "timelapseqcif", "timelapsecif",
+        "timelapse480p", "timelapse720p", "timelapse1080p", "timelapseqvga",
+        "timelapsefwvga", "timelapsewvga", "timelapsevga", "timelapsewqvga"
+    };
+    if (quality >= kQualityTimeLapseBase && quality < kQualityTimeLapseBase + kQualityCount) {
+        return kTimeLapseNames[quality - kQualityTimeLapseBase];
+    }
+    return reverseLookup(kQualityNames, quality);
+}
+
+int MediaProfilesParser::videoCodecFromName(const char* name)
+{
+    return lookup(kVideoCodecNames, name);
+}
+
+const char* MediaProfilesParser::videoCodecName(int codec)
+{
+    return reverseLookup(kVideoCodecNames, codec);
+}
+
+int MediaProfilesParser::audioCodecFromName(const char* name)
+{
+    return lookup(kAudioCodecNames, name);
+}
+
+const char* MediaProfilesParser::audioCodecName(int codec)
+{
+    return reverseLookup(kAudioCodecNames, codec);
+}
+
+int MediaProfilesParser::fileFormatFromName(const char* name)
+{
+    return lookup(kFileFormatNames, name);
+}
+
+const char* MediaProfilesParser::fileFormatName(int format)
+{
+    return reverseLookup(kFileFormatNames, format);
+}
+
+void MediaProfilesParser::error(const char* fmt, ...)
+{
+    char msg[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+
+    LOGE("%s:%lu: error: %s", mPath,
+         mParser ? (unsigned long)XML_GetCurrentLineNumber((XML_Parser)mParser) : 0UL, msg);
+    mErrors++;
+}
+
+void MediaProfilesParser::warning(const char* fmt, ...)
+{
+    char msg[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+
+    unsigned long line = mParser ? XML_GetCurrentLineNumber((XML_Parser)mParser) : 0UL;
+    if (mStrict) {
+        LOGE("%s:%lu: error: %s", mPath, line, msg);
+        mErrors++;
+    } else {
+        LOGW("%s:%lu: warning: %s", mPath, line, msg);
+        mWarnings++;
+    }
+}
+
+bool MediaProfilesParser::parse(const char* path, MediaProfilesData* data)
+{
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) {
+        LOGE("cannot open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    XML_Parser parser = XML_ParserCreate(NULL);
+    if (parser == NULL) {
+        LOGE("failed to create XML parser");
+        fclose(fp);
+        return false;
+    }
+
+    mParser = parser;
+    mPath = path;
+    mData = data;
+    mErrors = 0;
+    mWarnings = 0;
+    mElements.clear();
+    mAttributes.clear();
+    mStack.clear();
+
+    XML_SetUserData(parser, this);
+    XML_SetElementHandler(parser, startElementHandler, endElementHandler);
+    XML_SetElementDeclHandler(parser, (XML_ElementDeclHandler)elementDeclHandler);
+    XML_SetAttlistDeclHandler(parser, attlistDeclHandler);
+
+    const int kBufferSize = 512;
+    for (;;) {
+        void* buf = XML_GetBuffer(parser, kBufferSize);
+        if (buf == NULL) {
+            LOGE("failed to allocate XML parse buffer");
+            mErrors++;
+            break;
+        }
+
+        int bytesRead = fread(buf, 1, kBufferSize, fp);
+        if (bytesRead < 0) {
+            LOGE("failed to read %s", path);
+            mErrors++;
+            break;
+        }
+
+        if (XML_ParseBuffer(parser, bytesRead, bytesRead == 0) != XML_STATUS_OK) {
+            error("%s", XML_ErrorString(XML_GetErrorCode(parser)));
+            break;
+        }
+
+        if (bytesRead == 0) break;
+    }
+
+    if (mErrors == 0 && mElements.isEmpty()) {
+        warning("no DTD found, nothing was validated");
+    }
+
+    XML_ParserFree(parser);
+    mParser = NULL;
+    mData = NULL;
+    fclose(fp);
+    return mErrors == 0;
+}
+
+// DTD handling: only the parts of the content model that matter for this
+// file format are kept, i.e. which children an element may have and which
+// of them must appear.
+void MediaProfilesParser::elementDeclHandler(void* userData, const char* name, void* model)
+{
+    MediaProfilesParser* self = static_cast<MediaProfilesParser*>(userData);
+    XML_Content* content = static_cast<XML_Content*>(model);
+
+    ElementRule rule;
+    rule.name.setTo(name);
+    rule.empty = (content->type == XML_CTYPE_EMPTY);
+
+    // walk the model; a child is required only if every path through a
+    // sequence leads to it
+    struct Walker {
+        static void walk(const XML_Content* c, bool required, Vector<ChildRule>& out)
+        {
+            bool optional = (c->quant == XML_CQUANT_OPT || c->quant == XML_CQUANT_REP);
+            required = required && !optional;
+            switch (c->type) {
+            case XML_CTYPE_NAME: {
+                ChildRule child;
+                child.name.setTo(c->name);
+                child.required = required;
+                out.add(child);
+                break;
+            }
+            case XML_CTYPE_SEQ:
+                for (unsigned i = 0; i < c->numchildren; i++) {
+                    walk(&c->children[i], required, out);
+                }
+                break;
+            case XML_CTYPE_CHOICE:
+            case XML_CTYPE_MIXED:
+                for (unsigned i = 0; i < c->numchildren; i++) {
+                    walk(&c->children[i], false, out);
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    };
+    Walker::walk(content, true, rule.children);
+
+    self->mElements.add(rule);
+    XML_FreeContentModel((XML_Parser)self->mParser, content);
+}
+
+void MediaProfilesParser::attlistDeclHandler(void* userData, const char* elname, const char* attname,
+                                             const char* attType, const char* dflt, int isRequired)
+{
+    MediaProfilesParser* self = static_cast<MediaProfilesParser*>(userData);
+
+    AttributeRule rule;
+    rule.element.setTo(elname);
+    rule.name.setTo(attname);
+    rule.required = isRequired && dflt == NULL;
+
+    // enumerations arrive as "(a|b|c)"
+    if (attType[0] == '(') {
+        const char* p = attType + 1;
+        while (*p) {
+            size_t len = strcspn(p, "|)");
+            rule.values.add(String8(p, len));
+            p += len;
+            if (*p) p++;
+        }
+    }
+    self->mAttributes.add(rule);
+}
+
+int MediaProfilesParser::findElementRule(const char* name) const
+{
+    for (size_t i = 0; i < mElements.size(); i++) {
+        if (mElements[i].name == name) return i;
+    }
+    return -1;
+}
+
+const MediaProfilesParser::AttributeRule*
+MediaProfilesParser::findAttributeRule(const char* element, const char* name) const
+{
+    for (size_t i = 0; i < mAttributes.size(); i++) {
+        const AttributeRule& rule = mAttributes[i];
+        if (rule.element == element && rule.name == name) return &rule;
+    }
+    return NULL;
+}
+
+int MediaProfilesParser::validateElement(const char* name, const char** atts)
+{
+    if (mElements.isEmpty()) return -1;
+
+    int ruleIndex = findElementRule(name);
+    if (ruleIndex < 0) {
+        error("element <%s> is not declared", name);
+        return -1;
+    }
+
+    if (!mStack.isEmpty()) {
+        const OpenElement& parent = mStack.top();
+        if (parent.rule >= 0) {
+            const ElementRule& parentRule = mElements[parent.rule];
+            bool allowed = false;
+            for (size_t i = 0; i < parentRule.children.size(); i++) {
+                if (parentRule.children[i].name == name) {
+                    allowed = true;
+                    break;
+                }
+            }
+            if (!allowed) {
+                warning("<%s> is not allowed inside <%s>", name, parentRule.name.string());
+            }
+        }
+    }
+
+    for (int i = 0; atts[i] != NULL; i += 2) {
+        const AttributeRule* rule = findAttributeRule(name, atts[i]);
+        if (rule == NULL) {
+            bool known = false;
+            for (int j = 0; kUndeclaredAttributes[j][0] != NULL; j++) {
+                if (!strcmp(kUndeclaredAttributes[j][0], name) &&
+                    !strcmp(kUndeclaredAttributes[j][1], atts[i])) {
+                    known = true;
+                    break;
+                }
+            }
+            if (known) {
+                warning("attribute %s of <%s> is not declared", atts[i], name);
+            } else {
+                error("unknown attribute %s of <%s>", atts[i], name);
+            }
+            continue;
+        }
+
+        if (rule->values.isEmpty()) continue;
+        bool listed = false;
+        for (size_t j = 0; j < rule->values.size(); j++) {
+            if (rule->values[j] == atts[i + 1]) {
+                listed = true;
+                break;
+            }
+        }
+        // values the framework still understands are checked below when
+        // the attribute is converted
+        if (!listed) {
+            warning("%s=\"%s\" of <%s> is not in the DTD enumeration", atts[i], atts[i + 1], name);
+        }
+    }
+
+    for (size_t i = 0; i < mAttributes.size(); i++) {
+        const AttributeRule& rule = mAttributes[i];
+        if (!rule.required || rule.element != name) continue;
+        bool present = false;
+        for (int j = 0; atts[j] != NULL; j += 2) {
+            if (rule.name == atts[j]) {
+                present = true;
+                break;
+            }
+        }
+        if (!present) {
+            error("<%s> is missing required attribute %s", name, rule.name.string());
+        }
+    }
+
+    return ruleIndex;
+}
+
+void MediaProfilesParser::checkChildren(const OpenElement& element)
+{
+    if (element.rule < 0) return;
+    const ElementRule& rule = mElements[element.rule];
+
+    if (rule.empty && !element.children.isEmpty()) {
+        error("<%s> must be empty", rule.name.string());
+        return;
+    }
+
+    for (size_t i = 0; i < rule.children.size(); i++) {
+        if (!rule.children[i].required) continue;
+        bool seen = false;
+        for (size_t j = 0; j < element.children.size(); j++) {
+            if (element.children[j] == rule.children[i].name) {
+                seen = true;
+                break;
+            }
+        }
+        if (!seen) {
+            warning("<%s> has no <%s>", rule.name.string(), rule.children[i].name.string());
+        }
+    }
+}
+
+const char* MediaProfilesParser::getAttribute(const char** atts, const char* name, bool required)
+{
+    for (int i = 0; atts[i] != NULL; i += 2) {
+        if (!strcmp(atts[i], name)) return atts[i + 1];
+    }
+    // missing required attributes were already reported against the DTD
+    if (required && mElements.isEmpty()) {
+        error("missing attribute %s", name);
+    }
+    return NULL;
+}
+
+int32_t MediaProfilesParser::getNumber(const char** atts, const char* name, bool required, int32_t dflt)
+{
+    const char* value = getAttribute(atts, name, required);
+    if (value == NULL) return dflt;
+
+    char* end;
+    errno = 0;
+    long n = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || errno == ERANGE || n < INT32_MIN || n > INT32_MAX) {
+        error("%s=\"%s\" is not a number", name, value);
+        return dflt;
+    }
+    return n;
+}
+
+bool MediaProfilesParser::getBool(const char** atts, const char* name)
+{
+    const char* value = getAttribute(atts, name, true);
+    if (value == NULL) return false;
+    if (!strcmp(value, "true")) return true;
+    if (strcmp(value, "false")) {
+        error("%s=\"%s\" is not true or false", name, value);
+    }
+    return false;
+}
+
+int MediaProfilesParser::getId(const char** atts, const char* name, int (*lookup)(const char*),
+                               const char* what)
+{
+    const char* value = getAttribute(atts, name, true);
+    if (value == NULL) return -1;
+    int id = lookup(value);
+    if (id < 0) {
+        error("unknown %s \"%s\"", what, value);
+    }
+    return id;
+}
+
+void MediaProfilesParser::startElementHandler(void* userData, const char* name, const char** atts)
+{
+    static_cast<MediaProfilesParser*>(userData)->startElement(name, atts);
+}
+
+void MediaProfilesParser::endElementHandler(void* userData, const char* name)
+{
+    static_cast<MediaProfilesParser*>(userData)->endElement(name);
+}
+
+void MediaProfilesParser::startElement(const char* name, const char** atts)
+{
+    if (!mStack.isEmpty()) {
+        mStack.editTop().children.add(String8(name));
+    }
+    OpenElement open;
+    open.rule = validateElement(name, atts);
+    mStack.add(open);
+
+    MediaProfilesData* data = mData;
+
+    if (!strcmp(name, "CamcorderProfiles")) {
+        MediaProfilesCameraRecord camera;
+        camera.cameraId = getNumber(atts, "cameraId", false, 0);
+        camera.startOffsetMs = getNumber(atts, "startOffsetMs", false, -1);
+        camera.imageDecodingMemCap = 0;
+        camera.previewFrameRate = -1;
+        if (camera.cameraId < 0 || camera.cameraId > 255) {
+            error("cameraId %d out of range", camera.cameraId);
+            camera.cameraId = 0;
+        }
+        for (size_t i = 0; i < data->cameras.size(); i++) {
+            if (data->cameras[i].cameraId == camera.cameraId) {
+                error("cameraId %d is declared twice", camera.cameraId);
+            }
+        }
+        mCurrentCameraId = camera.cameraId;
+        data->cameras.add(camera);
+    } else if (!strcmp(name, "EncoderProfile")) {
+        MediaProfilesEncoderProfileRecord profile;
+        memset(&profile, 0, sizeof(profile));
+        profile.cameraId = mCurrentCameraId;
+        profile.quality = getId(atts, "quality", qualityFromName, "quality");
+        profile.fileFormat = getId(atts, "fileFormat", fileFormatFromName, "file format");
+        profile.duration = getNumber(atts, "duration", true, 0);
+        profile.videoCodec = -1;
+        profile.audioCodec = -1;
+        mCurrentProfile = data->encoderProfiles.add(profile);
+    } else if (!strcmp(name, "Video") || !strcmp(name, "Audio")) {
+        if (mCurrentProfile < 0) {
+            error("<%s> outside <EncoderProfile>", name);
+            return;
+        }
+        MediaProfilesEncoderProfileRecord& profile =
+                data->encoderProfiles.editItemAt(mCurrentProfile);
+        if (name[0] == 'V') {
+            profile.videoCodec = getId(atts, "codec", videoCodecFromName, "video codec");
+            profile.videoBitRate = getNumber(atts, "bitRate", true, 0);
+            profile.videoWidth = getNumber(atts, "width", true, 0);
+            profile.videoHeight = getNumber(atts, "height", true, 0);
+            profile.videoFrameRate = getNumber(atts, "frameRate", true, 0);
+        } else {
+            profile.audioCodec = getId(atts, "codec", audioCodecFromName, "audio codec");
+            profile.audioBitRate = getNumber(atts, "bitRate", true, 0);
+            profile.audioSampleRate = getNumber(atts, "sampleRate", true, 0);
+            profile.audioChannels = getNumber(atts, "channels", true, 0);
+        }
+    } else if (!strcmp(name, "ImageEncoding")) {
+        MediaProfilesImageEncodingRecord image;
+        image.cameraId = mCurrentCameraId;
+        image.quality = getNumber(atts, "quality", true, 0);
+        if (image.quality < 0 || image.quality > 100) {
+            error("image quality %d out of range", image.quality);
+        }
+        data->imageEncoding.add(image);
+    } else if (!strcmp(name, "ImageDecoding")) {
+        if (!data->cameras.isEmpty()) {
+            data->cameras.editTop().imageDecodingMemCap = getNumber(atts, "memCap", true, 0);
+        }
+    } else if (!strcmp(name, "Camera")) {
+        if (!data->cameras.isEmpty()) {
+            data->cameras.editTop().previewFrameRate = getNumber(atts, "previewFrameRate", true, -1);
+        }
+    } else if (!strcmp(name, "EncoderOutputFileFormat")) {
+        int format = getId(atts, "name", fileFormatFromName, "file format");
+        data->encoderFileFormats.add(format);
+    } else if (!strcmp(name, "VideoEncoderCap")) {
+        MediaProfilesVideoEncoderCapRecord cap;
+        cap.codec = getId(atts, "name", videoCodecFromName, "video codec");
+        cap.enabled = getBool(atts, "enabled");
+        cap.minBitRate = getNumber(atts, "minBitRate", true, 0);
+        cap.maxBitRate = getNumber(atts, "maxBitRate", true, 0);
+        cap.minFrameWidth = getNumber(atts, "minFrameWidth", true, 0);
+        cap.maxFrameWidth = getNumber(atts, "maxFrameWidth", true, 0);
+        cap.minFrameHeight = getNumber(atts, "minFrameHeight", true, 0);
+        cap.maxFrameHeight = getNumber(atts, "maxFrameHeight", true, 0);
+        cap.minFrameRate = getNumber(atts, "minFrameRate", true, 0);
+        cap.maxFrameRate = getNumber(atts, "maxFrameRate", true, 0);
+        if (cap.minBitRate > cap.maxBitRate || cap.minFrameWidth > cap.maxFrameWidth ||
+            cap.minFrameHeight > cap.maxFrameHeight || cap.minFrameRate > cap.maxFrameRate) {
+            error("<VideoEncoderCap> has a minimum above its maximum");
+        }
+        data->videoEncoderCaps.add(cap);
+    } else if (!strcmp(name, "AudioEncoderCap")) {
+        MediaProfilesAudioEncoderCapRecord cap;
+        cap.codec = getId(atts, "name", audioCodecFromName, "audio codec");
+        cap.enabled = getBool(atts, "enabled");
+        cap.minBitRate = getNumber(atts, "minBitRate", true, 0);
+        cap.maxBitRate = getNumber(atts, "maxBitRate", true, 0);
+        cap.minSampleRate = getNumber(atts, "minSampleRate", true, 0);
+        cap.maxSampleRate = getNumber(atts, "maxSampleRate", true, 0);
+        cap.minChannels = getNumber(atts, "minChannels", true, 0);
+        cap.maxChannels = getNumber(atts, "maxChannels", true, 0);
+        if (cap.minBitRate > cap.maxBitRate || cap.minSampleRate > cap.maxSampleRate ||
+            cap.minChannels > cap.maxChannels) {
+            error("<AudioEncoderCap> has a minimum above its maximum");
+        }
+        data->audioEncoderCaps.add(cap);
+    } else if (!strcmp(name, "VideoDecoderCap") || !strcmp(name, "AudioDecoderCap")) {
+        MediaProfilesDecoderCapRecord cap;
+        bool video = (name[0] == 'V');
+        cap.codec = getId(atts, "name", video ? videoCodecFromName : audioCodecFromName,
+                          video ? "video codec" : "audio codec");
+        cap.enabled = getBool(atts, "enabled");
+        (video ? data->videoDecoderCaps : data->audioDecoderCaps).add(cap);
+    } else if (!strcmp(name, "VideoEditorCap")) {
+        MediaProfilesVideoEditorCapRecord& cap = data->videoEditorCap;
+        cap.maxInputFrameWidth = getNumber(atts, "maxInputFrameWidth", true, 0);
+        cap.maxInputFrameHeight = getNumber(atts, "maxInputFrameHeight", true, 0);
+        cap.maxOutputFrameWidth = getNumber(atts, "maxOutputFrameWidth", true, 0);
+        cap.maxOutputFrameHeight = getNumber(atts, "maxOutputFrameHeight", true, 0);
+        cap.maxPrefetchYUVFrames = getNumber(atts, "maxPrefetchYUVFrames", true, 0);
+        data->hasVideoEditorCap = true;
+    } else if (!strcmp(name, "ExportVideoProfile")) {
+        MediaProfilesExportVideoProfileRecord profile;
+        profile.codec = getId(atts, "name", videoCodecFromName, "video codec");
+        profile.profile = getNumber(atts, "profile", true, 0);
+        profile.level = getNumber(atts, "level", true, 0);
+        data->exportVideoProfiles.add(profile);
+    }
+}
+
+void MediaProfilesParser::endElement(const char* name)
+{
+    if (!mStack.isEmpty()) {
+        checkChildren(mStack.top());
+        mStack.pop();
+    }
+
+    if (!strcmp(name, "EncoderProfile") && mCurrentProfile >= 0) {
+        const MediaProfilesEncoderProfileRecord& profile = mData->encoderProfiles[mCurrentProfile];
+        if (profile.videoCodec < 0 || profile.audioCodec < 0) {
+            error("<EncoderProfile> needs both <Video> and <Audio>");
+        }
+        mCurrentProfile = -1;
+    }
+}
+
+}; // namespace android
@@ -0,0 +1,388 @@
+/*
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MediaProfilesTable"
+#include <utils/Log.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "media_profiles_table.h"
+#include "media_profiles_parser.h"
+
+namespace android {
+
+static uint32_t crc32(const uint8_t* data, size_t len)
+{
+    static uint32_t table[256];
+    static bool initialized = false;
+    if (!initialized) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        initialized = true;
+    }
+
+    uint32_t crc = 0xffffffff;
+    while (len--) {
+        crc = table[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffff;
+}
+
+static inline int qualitySlot(int quality)
+{
+    if (quality >= 0 && quality < kQualityCount) {
+        return quality;
+    }
+    if (quality >= kQualityTimeLapseBase && quality < kQualityTimeLapseBase + kQualityCount) {
+        return kQualityCount + quality - kQualityTimeLapseBase;
+    }
+    return -1;
+}
+
+static inline uint32_t align4(uint32_t n)
+{
+    return (n + 3) & ~3;
+}
+
+void* MediaProfilesTable::build(const MediaProfilesData& data, size_t* size)
+{
+    uint32_t numCameraIds = 0;
+    for (size_t i = 0; i < data.cameras.size(); i++) {
+        if ((uint32_t)data.cameras[i].cameraId + 1 > numCameraIds) {
+            numCameraIds = data.cameras[i].cameraId + 1;
+        }
+    }
+
+    struct {
+        const void* data;
+        uint32_t count;
+        uint32_t recordSize;
+    } sections[kNumSections];
+
+    sections[kSectionCameras].data = data.cameras.array();
+    sections[kSectionCameras].count = data.cameras.size();
+    sections[kSectionCameras].recordSize = sizeof(MediaProfilesCameraRecord);
+    sections[kSectionEncoderProfiles].data = data.encoderProfiles.array();
+    sections[kSectionEncoderProfiles].count = data.encoderProfiles.size();
+    sections[kSectionEncoderProfiles].recordSize = sizeof(MediaProfilesEncoderProfileRecord);
+    sections[kSectionQualityIndex].data = NULL;     // filled in below
+    sections[kSectionQualityIndex].count = numCameraIds * kQualitySlots;
+    sections[kSectionQualityIndex].recordSize = sizeof(int16_t);
+    sections[kSectionImageEncoding].data = data.imageEncoding.array();
+    sections[kSectionImageEncoding].count = data.imageEncoding.size();
+    sections[kSectionImageEncoding].recordSize = sizeof(MediaProfilesImageEncodingRecord);
+    sections[kSectionEncoderFileFormats].data = data.encoderFileFormats.array();
+    sections[kSectionEncoderFileFormats].count = data.encoderFileFormats.size();
+    sections[kSectionEncoderFileFormats].recordSize = sizeof(int32_t);
+    sections[kSectionVideoEncoderCaps].data = data.videoEncoderCaps.array();
+    sections[kSectionVideoEncoderCaps].count = data.videoEncoderCaps.size();
+    sections[kSectionVideoEncoderCaps].recordSize = sizeof(MediaProfilesVideoEncoderCapRecord);
+    sections[kSectionAudioEncoderCaps].data = data.audioEncoderCaps.array();
+    sections[kSectionAudioEncoderCaps].count = data.audioEncoderCaps.size();
+    sections[kSectionAudioEncoderCaps].recordSize = sizeof(MediaProfilesAudioEncoderCapRecord);
+    sections[kSectionVideoDecoderCaps].data = data.videoDecoderCaps.array();
+    sections[kSectionVideoDecoderCaps].count = data.videoDecoderCaps.size();
+    sections[kSectionVideoDecoderCaps].recordSize = sizeof(MediaProfilesDecoderCapRecord);
+    sections[kSectionAudioDecoderCaps].data = data.audioDecoderCaps.array();
+    sections[kSectionAudioDecoderCaps].count = data.audioDecoderCaps.size();
+    sections[kSectionAudioDecoderCaps].recordSize = sizeof(MediaProfilesDecoderCapRecord);
+    sections[kSectionVideoEditorCap].data = &data.videoEditorCap;
+    sections[kSectionVideoEditorCap].count = data.hasVideoEditorCap ? 1 : 0;
+    sections[kSectionVideoEditorCap].recordSize = sizeof(MediaProfilesVideoEditorCapRecord);
+    sections[kSectionExportVideoProfiles].data = data.exportVideoProfiles.array();
+    sections[kSectionExportVideoProfiles].count = data.exportVideoProfiles.size();
+    sections[kSectionExportVideoProfiles].recordSize = sizeof(MediaProfilesExportVideoProfileRecord);
+
+    uint32_t total = align4(sizeof(MediaProfilesTableHeader));
+    for (int i = 0; i < kNumSections; i++) {
+        total = align4(total + sections[i].count * sections[i].recordSize);
+    }
+
+    uint8_t* table = (uint8_t*)calloc(1, total);
+    if (table == NULL) {
+        LOGE("out of memory building a %u byte table", total);
+        return NULL;
+    }
+
+    MediaProfilesTableHeader* header = (MediaProfilesTableHeader*)table;
+    header->magic = MEDIA_PROFILES_TABLE_MAGIC;
+    header->versionMajor = MEDIA_PROFILES_TABLE_VERSION_MAJOR;
+    header->versionMinor = MEDIA_PROFILES_TABLE_VERSION_MINOR;
+    header->totalSize = total;
+    header->numCameraIds = numCameraIds;
+    header->qualitySlots = kQualitySlots;
+
+    uint32_t offset = align4(sizeof(MediaProfilesTableHeader));
+    for (int i = 0; i < kNumSections; i++) {
+        header->sections[i].offset = offset;
+        header->sections[i].count = sections[i].count;
+        header->sections[i].recordSize = sections[i].recordSize;
+        if (sections[i].data != NULL && sections[i].count > 0) {
+            memcpy(table + offset, sections[i].data, sections[i].count * sections[i].recordSize);
+        }
+        offset = align4(offset + sections[i].count * sections[i].recordSize);
+    }
+
+    // the framework returns the first matching profile, so the index does too
+    int16_t* index = (int16_t*)(table + header->sections[kSectionQualityIndex].offset);
+    for (uint32_t i = 0; i < numCameraIds * kQualitySlots; i++) {
+        index[i] = -1;
+    }
+    for (size_t i = 0; i < data.encoderProfiles.size(); i++) {
+        const MediaProfilesEncoderProfileRecord& profile = data.encoderProfiles[i];
+        int slot = qualitySlot(profile.quality);
+        if (slot < 0 || profile.cameraId < 0 || (uint32_t)profile.cameraId >= numCameraIds) {
+            continue;
+        }
+        int16_t& entry = index[profile.cameraId * kQualitySlots + slot];
+        if (entry >= 0) {
+            LOGW("duplicate profile for camera %d quality %d, keeping the first one",
+                 profile.cameraId, profile.quality);
+            continue;
+        }
+        entry = i;
+    }
+
+    header->checksum = crc32(table + sizeof(MediaProfilesTableHeader),
+                             total - sizeof(MediaProfilesTableHeader));
+    *size = total;
+    return table;
+}
+
+bool MediaProfilesTable::validate(const void* table, size_t size)
+{
+    const MediaProfilesTableHeader* header = (const MediaProfilesTableHeader*)table;
+    if (size < sizeof(MediaProfilesTableHeader)) {
+        LOGE("table too small (%u bytes)", (unsigned)size);
+        return false;
+    }
+    if (header->magic != MEDIA_PROFILES_TABLE_MAGIC) {
+        LOGE("bad table magic 0x%08x", header->magic);
+        return false;
+    }
+    if (header->versionMajor != MEDIA_PROFILES_TABLE_VERSION_MAJOR) {
+        LOGE("unsupported table version %u.%u", header->versionMajor, header->versionMinor);
+        return false;
+    }
+    if (header->totalSize != size || header->qualitySlots != kQualitySlots) {
+        LOGE("table size or layout mismatch");
+        return false;
+    }
+
+    static const uint32_t kRecordSizes[kNumSections] = {
+        sizeof(MediaProfilesCameraRecord),
+        sizeof(MediaProfilesEncoderProfileRecord),
+        sizeof(int16_t),
+        sizeof(MediaProfilesImageEncodingRecord),
+        sizeof(int32_t),
+        sizeof(MediaProfilesVideoEncoderCapRecord),
+        sizeof(MediaProfilesAudioEncoderCapRecord),
+        sizeof(MediaProfilesDecoderCapRecord),
+        sizeof(MediaProfilesDecoderCapRecord),
+        sizeof(MediaProfilesVideoEditorCapRecord),
+        sizeof(MediaProfilesExportVideoProfileRecord),
+    };
+    for (int i = 0; i < kNumSections; i++) {
+        const MediaProfilesSection& s = header->sections[i];
+        if (s.recordSize != kRecordSizes[i] || (s.offset & 3) ||
+            s.offset < sizeof(MediaProfilesTableHeader) || s.offset > size ||
+            s.count > (size - s.offset) / s.recordSize) {
+            LOGE("section %d is out of bounds", i);
+            return false;
+        }
+    }
+    if (header->sections[kSectionQualityIndex].count != header->numCameraIds * kQualitySlots) {
+        LOGE("quality index does not match camera count");
+        return false;
+    }
+
+    uint32_t crc = crc32((const uint8_t*)table + sizeof(MediaProfilesTableHeader),
+                         size - sizeof(MediaProfilesTableHeader));
+    if (crc != header->checksum) {
+        LOGE("table checksum mismatch");
+        return false;
+    }
+
+    // the index is the only thing that points at other records
+    const int16_t* index = (const int16_t*)((const uint8_t*)table +
+                                            header->sections[kSectionQualityIndex].offset);
+    for (uint32_t i = 0; i < header->sections[kSectionQualityIndex].count; i++) {
+        if (index[i] >= (int32_t)header->sections[kSectionEncoderProfiles].count) {
+            LOGE("quality index entry %u out of range", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+MediaProfilesTable::MediaProfilesTable()
+    : mBase(NULL),
+      mSize(0),
+      mMapped(false)
+{
+}
+
+MediaProfilesTable::~MediaProfilesTable()
+{
+    if (mBase == NULL) return;
+    if (mMapped) {
+        munmap((void*)mBase, mSize);
+    } else {
+        free((void*)mBase);
+    }
+}
+
+MediaProfilesTable* MediaProfilesTable::open(const char* tablePath, const char* xmlPath)
+{
+    MediaProfilesTable* table = new MediaProfilesTable();
+    if (tablePath != NULL && table->map(tablePath)) {
+        LOGV("using compiled profiles from %s", tablePath);
+        return table;
+    }
+    if (xmlPath != NULL && table->loadXml(xmlPath)) {
+        LOGW("%s not usable, parsed %s instead", tablePath, xmlPath);
+        return table;
+    }
+    delete table;
+    return NULL;
+}
+
+bool MediaProfilesTable::map(const char* path)
+{
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        LOGV("cannot open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(MediaProfilesTableHeader)) {
+        LOGE("%s is not a profiles table", path);
+        close(fd);
+        return false;
+    }
+
+    void* base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        LOGE("mmap of %s failed: %s", path, strerror(errno));
+        return false;
+    }
+
+    if (!validate(base, st.st_size)) {
+        LOGE("rejecting %s", path);
+        munmap(base, st.st_size);
+        return false;
+    }
+
+    mBase = (const uint8_t*)base;
+    mSize = st.st_size;
+    mMapped = true;
+    return true;
+}
+
+bool MediaProfilesTable::loadXml(const char* path)
+{
+    MediaProfilesData data;
+    MediaProfilesParser parser;
+    if (!parser.parse(path, &data)) {
+        return false;
+    }
+
+    size_t size;
+    void* table = build(data, &size);
+    if (table == NULL) {
+        return false;
+    }
+
+    mBase = (const uint8_t*)table;
+    mSize = size;
+    mMapped = false;
+    return true;
+}
+
+const MediaProfilesEncoderProfileRecord*
+MediaProfilesTable::getCamcorderProfile(int cameraId, int quality) const
+{
+    const MediaProfilesTableHeader* h = header();
+    int slot = qualitySlot(quality);
+    if (slot < 0 || cameraId < 0 || (uint32_t)cameraId >= h->numCameraIds) {
+        return NULL;
+    }
+
+    const int16_t* index = (const int16_t*)(mBase + h->sections[kSectionQualityIndex].offset);
+    int16_t entry = index[cameraId * kQualitySlots + slot];
+    if (entry < 0) {
+        return NULL;
+    }
+    return (const MediaProfilesEncoderProfileRecord*)
+            (mBase + h->sections[kSectionEncoderProfiles].offset) + entry;
+}
+
+const MediaProfilesCameraRecord* MediaProfilesTable::getCamera(int cameraId) const
+{
+    size_t count;
+    const MediaProfilesCameraRecord* cameras =
+            records<MediaProfilesCameraRecord>(kSectionCameras, &count);
+    for (size_t i = 0; i < count; i++) {
+        if (cameras[i].cameraId == cameraId) return &cameras[i];
+    }
+    return NULL;
+}
+
+const MediaProfilesVideoEncoderCapRecord* MediaProfilesTable::getVideoEncoderCap(int codec) const
+{
+    size_t count;
+    const MediaProfilesVideoEncoderCapRecord* caps =
+            records<MediaProfilesVideoEncoderCapRecord>(kSectionVideoEncoderCaps, &count);
+    for (size_t i = 0; i < count; i++) {
+        if (caps[i].codec == codec) return &caps[i];
+    }
+    return NULL;
+}
+
+const MediaProfilesAudioEncoderCapRecord* MediaProfilesTable::getAudioEncoderCap(int codec) const
+{
+    size_t count;
+    const MediaProfilesAudioEncoderCapRecord* caps =
+            records<MediaProfilesAudioEncoderCapRecord>(kSectionAudioEncoderCaps, &count);
+    for (size_t i = 0; i < count; i++) {
+        if (caps[i].codec == codec) return &caps[i];
+    }
+    return NULL;
+}
+
+const MediaProfilesVideoEditorCapRecord* MediaProfilesTable::getVideoEditorCap() const
+{
+    size_t count;
+    const MediaProfilesVideoEditorCapRecord* cap =
+            records<MediaProfilesVideoEditorCapRecord>(kSectionVideoEditorCap, &count);
+    return count ? cap : NULL;
+}
+
+}; // namespace android
@@ -0,0 +1,988 @@
+/*
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Encoder calibration for media_profiles.xml.
+ *
+ *   media_profiles_calibrate [options] input.xml output.xml
+ *
+ * Every distinct video configuration used by an EncoderProfile, and every
+ * VideoEncoderCap at its maximum frame size, is pushed through the OMX
+ * encoder for that codec as fast as the component will take frames.  The
+ * tool reports the sustained frame rate and the bitrate the encoder really
+ * produced, then probes higher bitrates to find the largest one that is
+ * still delivered at full frame rate.
+ *
+ * The output file is the input with only attribute values changed, so
+ * comments, ordering and the DTD survive:
+ *
+ *   EncoderProfile/Video frameRate  lowered to the highest standard rate the
+ *                                   encoder sustains with the requested margin
+ *   EncoderProfile/Video bitRate    clamped to the highest sustained bitrate
+ *   VideoEncoderCap maxFrameRate    same rule as the profiles, never raised
+ *   VideoEncoderCap maxBitRate      set to the highest sustained bitrate
+ *
+ * The OMX core is reached through libqcomm_omx, exactly as PV does.  On a
+ * Linux host the plugin loads the stand-in libOmxCore from pvomx/omx_core_stub;
+ * its OMX_STUB_ENC_* variables model the encoder being calibrated for.
+ */
+
+#define LOG_TAG "media_profiles_calibrate"
+#include <utils/Log.h>
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <expat.h>
+
+#include "OMX_Core.h"
+#include "OMX_Component.h"
+#include "OMX_Video.h"
+#include "pv_omxcore.h"
+#include "omx_interface.h"
+
+#include "media_profiles_parser.h"
+
+using namespace android;
+
+#define DEFAULT_PLUGIN_LIBRARY  "libqcomm_omx.so"
+
+#define DEFAULT_FRAMES          120
+#define DEFAULT_WARMUP          10
+#define DEFAULT_MARGIN_PERCENT  10
+
+// an encoder that delivers less than this share of the requested bitrate
+// is considered unable to sustain it
+#define BITRATE_DELIVERY_PERCENT 90
+
+// per state transition and per frame, generous enough for a loaded device
+#define STATE_TIMEOUT_MS        5000
+#define FRAME_TIMEOUT_MS        2000
+
+typedef OsclAny* (*tpPVGetInterface)();
+typedef void (*tpPVReleaseInterface)(OsclAny*);
+
+static const int kStandardFrameRates[] = { 30, 25, 24, 20, 15, 12, 10, 7, 5 };
+
+// bitrate probes, as a percentage of the configured bitrate
+static const int kBitrateProbes[] = { 100, 125, 150, 200 };
+
+struct OmxCore {
+    void*                   plugin;
+    OsclAny*                iface;
+    tpPVReleaseInterface    release;
+    tpOMX_Init              init;
+    tpOMX_Deinit            deinit;
+    tpOMX_GetHandle         getHandle;
+    tpOMX_FreeHandle        freeHandle;
+    tpOMX_GetComponentsOfRole getComponentsOfRole;
+};
+
+struct EncodeConfig {
+    int     codec;
+    int     width;
+    int     height;
+    int     frameRate;
+    int     bitRate;
+};
+
+struct EncodeResult {
+    bool    ok;
+    double  fps;            // sustained, after warm-up
+    int     achievedBitRate; // at the configured frame rate
+};
+
+struct Measurement {
+    EncodeConfig    config;
+    EncodeResult    result;
+    int             maxBitRate; // highest probe delivered at the sustained rate
+};
+
+struct Options {
+    int     frames;
+    int     warmup;
+    int     margin;
+};
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void deadlineAfter(int ms, struct timespec* ts)
+{
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+template<class T>
+static void initParam(T* param)
+{
+    memset(param, 0, sizeof(T));
+    param->nSize = sizeof(T);
+    param->nVersion.s.nVersionMajor = 1;
+    param->nVersion.s.nVersionMinor = 1;
+}
+
+static const char* encoderRole(int codec)
+{
+    switch (codec) {
+    case kVideoCodecH264: return "video_encoder.avc";
+    case kVideoCodecM4V:  return "video_encoder.mpeg4";
+    case kVideoCodecH263: return "video_encoder.h263";
+    default:              return NULL;
+    }
+}
+
+static OMX_VIDEO_CODINGTYPE encoderCoding(int codec)
+{
+    switch (codec) {
+    case kVideoCodecH264: return OMX_VIDEO_CodingAVC;
+    case kVideoCodecM4V:  return OMX_VIDEO_CodingMPEG4;
+    case kVideoCodecH263: return OMX_VIDEO_CodingH263;
+    default:              return OMX_VIDEO_CodingUnused;
+    }
+}
+
+/*
+ * One encoder instance driven through Loaded -> Executing -> Loaded.
+ */
+class EncoderRun
+{
+public:
+    EncoderRun(const OmxCore& core, const char* component);
+    ~EncoderRun();
+
+    bool run(const EncodeConfig& config, int frames, int warmup, EncodeResult* result);
+
+private:
+    enum { kMaxBuffers = 32 };
+
+    static OMX_ERRORTYPE onEvent(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent,
+                                 OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData);
+    static OMX_ERRORTYPE onEmptyBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData,
+                                           OMX_BUFFERHEADERTYPE* pBuffer);
+    static OMX_ERRORTYPE onFillBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData,
+                                          OMX_BUFFERHEADERTYPE* pBuffer);
+
+    bool configure(const EncodeConfig& config);
+    bool allocateBuffers();
+    void freeBuffers();
+    bool setState(OMX_STATETYPE state);
+    void fillFrame(OMX_BUFFERHEADERTYPE* buffer, int frame);
+
+    const OmxCore&          mCore;
+    const char*             mComponent;
+    OMX_HANDLETYPE          mHandle;
+    OMX_U32                 mInputPort;
+    OMX_U32                 mOutputPort;
+    OMX_PARAM_PORTDEFINITIONTYPE mInputDef;
+    OMX_PARAM_PORTDEFINITIONTYPE mOutputDef;
+
+    OMX_BUFFERHEADERTYPE*   mInput[kMaxBuffers];
+    OMX_U32                 mNumInput;
+    OMX_BUFFERHEADERTYPE*   mOutput[kMaxBuffers];
+    OMX_U32                 mNumOutput;
+
+    pthread_mutex_t         mLock;
+    pthread_cond_t          mCond;
+    OMX_STATETYPE           mState;
+    bool                    mError;
+    bool                    mStreaming;
+    bool                    mEos;
+    OMX_BUFFERHEADERTYPE*   mFreeInput[kMaxBuffers];
+    OMX_U32                 mNumFreeInput;
+
+    int                     mWarmup;
+    int                     mFramesOut;
+    int64_t                 mBytesOut;
+    int64_t                 mWarmupEndNs;
+    int64_t                 mLastOutNs;
+};
+
+EncoderRun::EncoderRun(const OmxCore& core, const char* component)
+    : mCore(core),
+      mComponent(component),
+      mHandle(NULL),
+      mInputPort(0),
+      mOutputPort(1),
+      mNumInput(0),
+      mNumOutput(0),
+      mState(OMX_StateLoaded),
+      mError(false),
+      mStreaming(false),
+      mEos(false),
+      mNumFreeInput(0),
+      mWarmup(0),
+      mFramesOut(0),
+      mBytesOut(0),
+      mWarmupEndNs(0),
+      mLastOutNs(0)
+{
+    pthread_mutex_init(&mLock, NULL);
+    pthread_cond_init(&mCond, NULL);
+}
+
+EncoderRun::~EncoderRun()
+{
+    if (mHandle != NULL) {
+        mCore.freeHandle(mHandle);
+    }
+    pthread_cond_destroy(&mCond);
+    pthread_mutex_destroy(&mLock);
+}
+
+OMX_ERRORTYPE EncoderRun::onEvent(OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent,
+                                  OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData)
+{
+    EncoderRun* self = (EncoderRun*) pAppData;
+    pthread_mutex_lock(&self->mLock);
+    if (eEvent == OMX_EventCmdComplete && nData1 == OMX_CommandStateSet) {
+        self->mState = (OMX_STATETYPE) nData2;
+    } else if (eEvent == OMX_EventError) {
+        LOGE("%s: error 0x%x", self->mComponent, (unsigned) nData1);
+        self->mError = true;
+    } else if (eEvent == OMX_EventBufferFlag && (nData2 & OMX_BUFFERFLAG_EOS)) {
+        self->mEos = true;
+    }
+    pthread_cond_broadcast(&self->mCond);
+    pthread_mutex_unlock(&self->mLock);
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE EncoderRun::onEmptyBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData,
+                                            OMX_BUFFERHEADERTYPE* pBuffer)
+{
+    EncoderRun* self = (EncoderRun*) pAppData;
+    pthread_mutex_lock(&self->mLock);
+    self->mFreeInput[self->mNumFreeInput++] = pBuffer;
+    pthread_cond_broadcast(&self->mCond);
+    pthread_mutex_unlock(&self->mLock);
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE EncoderRun::onFillBufferDone(OMX_HANDLETYPE hComponent, OMX_PTR pAppData,
+                                           OMX_BUFFERHEADERTYPE* pBuffer)
+{
+    EncoderRun* self = (EncoderRun*) pAppData;
+    bool requeue;
+
+    pthread_mutex_lock(&self->mLock);
+    if (pBuffer->nFilledLen > 0 && !(pBuffer->nFlags & OMX_BUFFERFLAG_CODECCONFIG)) {
+        int64_t now = nowNs();
+        self->mFramesOut++;
+        if (self->mFramesOut == self->mWarmup) {
+            self->mWarmupEndNs = now;
+        } else if (self->mFramesOut > self->mWarmup) {
+            self->mBytesOut += pBuffer->nFilledLen;
+        }
+        self->mLastOutNs = now;
+    }
+    if (pBuffer->nFlags & OMX_BUFFERFLAG_EOS) {
+        self->mEos = true;
+    }
+    requeue = self->mStreaming && !self->mEos;
+    pthread_cond_broadcast(&self->mCond);
+    pthread_mutex_unlock(&self->mLock);
+
+    if (requeue) {
+        pBuffer->nFilledLen = 0;
+        pBuffer->nFlags = 0;
+        OMX_FillThisBuffer(hComponent, pBuffer);
+    }
+    return OMX_ErrorNone;
+}
+
+bool EncoderRun::configure(const EncodeConfig& config)
+{
+    OMX_PORT_PARAM_TYPE ports;
+    initParam(&ports);
+    if (OMX_GetParameter(mHandle, OMX_IndexParamVideoInit, &ports) == OMX_ErrorNone &&
+        ports.nPorts >= 2) {
+        mInputPort = ports.nStartPortNumber;
+        mOutputPort = ports.nStartPortNumber + 1;
+    }
+
+    initParam(&mInputDef);
+    mInputDef.nPortIndex = mInputPort;
+    if (OMX_GetParameter(mHandle, OMX_IndexParamPortDefinition, &mInputDef) != OMX_ErrorNone) {
+        return false;
+    }
+    OMX_VIDEO_PORTDEFINITIONTYPE& in = mInputDef.format.video;
+    in.nFrameWidth = config.width;
+    in.nFrameHeight = config.height;
+    in.nStride = config.width;
+    in.nSliceHeight = config.height;
+    in.xFramerate = config.frameRate << 16;
+    in.eColorFormat = OMX_COLOR_FormatYUV420SemiPlanar;
+    in.eCompressionFormat = OMX_VIDEO_CodingUnused;
+    if (OMX_SetParameter(mHandle, OMX_IndexParamPortDefinition, &mInputDef) != OMX_ErrorNone) {
+        LOGE("%s: %dx%d@%d input rejected", mComponent, config.width, config.height, config.frameRate);
+        return false;
+    }
+
+    initParam(&mOutputDef);
+    mOutputDef.nPortIndex = mOutputPort;
+    if (OMX_GetParameter(mHandle, OMX_IndexParamPortDefinition, &mOutputDef) != OMX_ErrorNone) {
+        return false;
+    }
+    OMX_VIDEO_PORTDEFINITIONTYPE& out = mOutputDef.format.video;
+    out.nFrameWidth = config.width;
+    out.nFrameHeight = config.height;
+    out.xFramerate = config.frameRate << 16;
+    out.nBitrate = config.bitRate;
+    out.eCompressionFormat = encoderCoding(config.codec);
+    if (OMX_SetParameter(mHandle, OMX_IndexParamPortDefinition, &mOutputDef) != OMX_ErrorNone) {
+        LOGE("%s: output format rejected", mComponent);
+        return false;
+    }
+
+    OMX_VIDEO_PARAM_BITRATETYPE bitrate;
+    initParam(&bitrate);
+    bitrate.nPortIndex = mOutputPort;
+    bitrate.eControlRate = OMX_Video_ControlRateVariable;
+    bitrate.nTargetBitrate = config.bitRate;
+    if (OMX_SetParameter(mHandle, OMX_IndexParamVideoBitrate, &bitrate) != OMX_ErrorNone) {
+        LOGE("%s: bitrate %d rejected", mComponent, config.bitRate);
+        return false;
+    }
+
+    // the component may have adjusted sizes, strides and buffer counts
+    OMX_GetParameter(mHandle, OMX_IndexParamPortDefinition, &mInputDef);
+    OMX_GetParameter(mHandle, OMX_IndexParamPortDefinition, &mOutputDef);
+    if (mInputDef.nBufferCountActual > kMaxBuffers || mOutputDef.nBufferCountActual > kMaxBuffers) {
+        LOGE("%s: too many buffers requested", mComponent);
+        return false;
+    }
+    return true;
+}
+
+bool EncoderRun::allocateBuffers()
+{
+    for (OMX_U32 i = 0; i < mInputDef.nBufferCountActual; i++) {
+        if (OMX_AllocateBuffer(mHandle, &mInput[i], mInputPort, NULL,
+                               mInputDef.nBufferSize) != OMX_ErrorNone) {
+            return false;
+        }
+        mNumInput++;
+    }
+    for (OMX_U32 i = 0; i < mOutputDef.nBufferCountActual; i++) {
+        if (OMX_AllocateBuffer(mHandle, &mOutput[i], mOutputPort, NULL,
+                               mOutputDef.nBufferSize) != OMX_ErrorNone) {
+            return false;
+        }
+        mNumOutput++;
+    }
+    return true;
+}
+
+void EncoderRun::freeBuffers()
+{
+    for (OMX_U32 i = 0; i < mNumInput; i++) {
+        OMX_FreeBuffer(mHandle, mInputPort, mInput[i]);
+    }
+    for (OMX_U32 i = 0; i < mNumOutput; i++) {
+        OMX_FreeBuffer(mHandle, mOutputPort, mOutput[i]);
+    }
+    mNumInput = 0;
+    mNumOutput = 0;
+}
+
+// Loaded->Idle needs the buffers allocated after the command is sent and
+// Idle->Loaded needs them freed, before either can complete.
+bool EncoderRun::setState(OMX_STATETYPE state)
+{
+    pthread_mutex_lock(&mLock);
+    OMX_STATETYPE from = mState;
+    pthread_mutex_unlock(&mLock);
+
+    if (OMX_SendCommand(mHandle, OMX_CommandStateSet, state, NULL) != OMX_ErrorNone) {
+        return false;
+    }
+    if (from == OMX_StateLoaded && state == OMX_StateIdle && !allocateBuffers()) {
+        LOGE("%s: buffer allocation failed", mComponent);
+        return false;
+    }
+    if (from == OMX_StateIdle && state == OMX_StateLoaded) {
+        freeBuffers();
+    }
+
+    struct timespec deadline;
+    deadlineAfter(STATE_TIMEOUT_MS, &deadline);
+    pthread_mutex_lock(&mLock);
+    while (mState != state && !mError) {
+        if (pthread_cond_timedwait(&mCond, &mLock, &deadline) == ETIMEDOUT) break;
+    }
+    bool ok = (mState == state);
+    pthread_mutex_unlock(&mLock);
+    if (!ok) {
+        LOGE("%s: timed out going to state %d", mComponent, state);
+    }
+    return ok;
+}
+
+// a moving gradient, so encoders that skip static content still work
+void EncoderRun::fillFrame(OMX_BUFFERHEADERTYPE* buffer, int frame)
+{
+    const OMX_VIDEO_PORTDEFINITIONTYPE& video = mInputDef.format.video;
+    OMX_U32 stride = video.nStride > 0 ? video.nStride : video.nFrameWidth;
+    OMX_U32 slice = video.nSliceHeight > 0 ? video.nSliceHeight : video.nFrameHeight;
+    OMX_U32 size = stride * slice * 3 / 2;
+    if (size > buffer->nAllocLen) size = buffer->nAllocLen;
+
+    uint8_t* y = buffer->pBuffer;
+    for (OMX_U32 row = 0; row < slice && (row + 1) * stride <= size; row++) {
+        memset(y + row * stride, (uint8_t) (row + frame * 4), stride);
+    }
+    if (stride * slice < size) {
+        memset(y + stride * slice, 128, size - stride * slice);
+    }
+    buffer->nOffset = 0;
+    buffer->nFilledLen = size;
+}
+
+bool EncoderRun::run(const EncodeConfig& config, int frames, int warmup, EncodeResult* result)
+{
+    static OMX_CALLBACKTYPE callbacks = { onEvent, onEmptyBufferDone, onFillBufferDone };
+
+    result->ok = false;
+    result->fps = 0;
+    result->achievedBitRate = 0;
+
+    if (mCore.getHandle(&mHandle, (OMX_STRING) mComponent, this, &callbacks) != OMX_ErrorNone) {
+        LOGE("cannot instantiate %s", mComponent);
+        mHandle = NULL;
+        return false;
+    }
+
+    bool ok = configure(config) && setState(OMX_StateIdle) &&
+              setState(OMX_StateExecuting);
+
+    if (ok) {
+        mWarmup = warmup;
+        mStreaming = true;
+        for (OMX_U32 i = 0; i < mNumInput; i++) {
+            mFreeInput[i] = mInput[i];
+        }
+        mNumFreeInput = mNumInput;
+        for (OMX_U32 i = 0; i < mNumOutput; i++) {
+            OMX_FillThisBuffer(mHandle, mOutput[i]);
+        }
+
+        int total = warmup + frames;
+        int64_t frameNs = 1000000000LL / config.frameRate;
+        struct timespec deadline;
+
+        for (int frame = 0; frame < total && ok; frame++) {
+            pthread_mutex_lock(&mLock);
+            deadlineAfter(FRAME_TIMEOUT_MS, &deadline);
+            while (mNumFreeInput == 0 && !mError) {
+                if (pthread_cond_timedwait(&mCond, &mLock, &deadline) == ETIMEDOUT) break;
+            }
+            OMX_BUFFERHEADERTYPE* buffer = mNumFreeInput ? mFreeInput[--mNumFreeInput] : NULL;
+            ok = !mError && buffer != NULL;
+            pthread_mutex_unlock(&mLock);
+            if (!ok) {
+                LOGE("%s: encoder stopped taking input at frame %d", mComponent, frame);
+                break;
+            }
+
+            fillFrame(buffer, frame);
+            buffer->nTimeStamp = frame * frameNs / 1000;
+            buffer->nFlags = (frame == total - 1) ? OMX_BUFFERFLAG_EOS : 0;
+            OMX_EmptyThisBuffer(mHandle, buffer);
+        }
+
+        pthread_mutex_lock(&mLock);
+        deadlineAfter(FRAME_TIMEOUT_MS, &deadline);
+        while (ok && mFramesOut < total && !mEos && !mError) {
+            if (pthread_cond_timedwait(&mCond, &mLock, &deadline) == ETIMEDOUT) break;
+        }
+        mStreaming = false;
+        int measured = mFramesOut - warmup;
+        if (ok && measured > 1 && mLastOutNs > mWarmupEndNs) {
+            result->fps = measured * 1e9 / (mLastOutNs - mWarmupEndNs);
+            result->achievedBitRate = (int) (mBytesOut * 8 * config.frameRate / measured);
+            result->ok = true;
+        } else if (ok) {
+            LOGE("%s: only %d of %d frames came out", mComponent, mFramesOut, total);
+        }
+        pthread_mutex_unlock(&mLock);
+    }
+
+    // tear down whatever state we reached
+    pthread_mutex_lock(&mLock);
+    mStreaming = false;
+    OMX_STATETYPE state = mState;
+    pthread_mutex_unlock(&mLock);
+    if (state == OMX_StateExecuting) {
+        setState(OMX_StateIdle);
+        state = OMX_StateIdle;
+    }
+    if (state == OMX_StateIdle) {
+        setState(OMX_StateLoaded);
+    } else {
+        freeBuffers();
+    }
+    mCore.freeHandle(mHandle);
+    mHandle = NULL;
+    return result->ok;
+}
+
+static bool loadCore(const char* pluginPath, OmxCore* core)
+{
+    memset(core, 0, sizeof(*core));
+    core->plugin = dlopen(pluginPath, RTLD_NOW);
+    if (core->plugin == NULL) {
+        fprintf(stderr, "cannot load %s: %s\n", pluginPath, dlerror());
+        return false;
+    }
+
+    tpPVGetInterface getInterface = (tpPVGetInterface) dlsym(core->plugin, "PVGetInterface");
+    core->release = (tpPVReleaseInterface) dlsym(core->plugin, "PVReleaseInterface");
+    if (getInterface == NULL || core->release == NULL) {
+        fprintf(stderr, "%s does not export PVGetInterface/PVReleaseInterface\n", pluginPath);
+        return false;
+    }
+
+    core->iface = getInterface();
+    OMXInterface* omx = core->iface ? (OMXInterface*)
+        ((OsclSharedLibraryInterface*) core->iface)->SharedLibraryLookup(OMX_INTERFACE_ID) : NULL;
+    if (omx == NULL) {
+        fprintf(stderr, "%s could not resolve the OMX core\n", pluginPath);
+        return false;
+    }
+    core->init = omx->GetpOMX_Init();
+    core->deinit = omx->GetpOMX_Deinit();
+    core->getHandle = omx->GetpOMX_GetHandle();
+    core->freeHandle = omx->GetpOMX_FreeHandle();
+    core->getComponentsOfRole = omx->GetpOMX_GetComponentsOfRole();
+    if (!core->init || !core->deinit || !core->getHandle || !core->freeHandle ||
+        !core->getComponentsOfRole) {
+        fprintf(stderr, "%s did not resolve all OMX core entry points\n", pluginPath);
+        return false;
+    }
+    return core->init() == OMX_ErrorNone;
+}
+
+static void unloadCore(OmxCore* core)
+{
+    if (core->deinit) core->deinit();
+    if (core->iface) core->release(core->iface);
+    if (core->plugin) dlclose(core->plugin);
+}
+
+static bool findEncoder(const OmxCore& core, int codec, char* name, size_t size)
+{
+    const char* role = encoderRole(codec);
+    if (role == NULL) return false;
+
+    OMX_U32 count = 0;
+    if (core.getComponentsOfRole((OMX_STRING) role, &count, NULL) != OMX_ErrorNone || count == 0) {
+        return false;
+    }
+
+    OMX_U8* names[16];
+    OMX_U8 storage[16][OMX_MAX_STRINGNAME_SIZE];
+    if (count > 16) count = 16;
+    for (OMX_U32 i = 0; i < count; i++) {
+        names[i] = storage[i];
+    }
+    if (core.getComponentsOfRole((OMX_STRING) role, &count, names) != OMX_ErrorNone || count == 0) {
+        return false;
+    }
+    strncpy(name, (const char*) names[0], size - 1);
+    name[size - 1] = '\0';
+    return true;
+}
+
+static bool sameConfig(const EncodeConfig& a, const EncodeConfig& b)
+{
+    return a.codec == b.codec && a.width == b.width && a.height == b.height &&
+           a.frameRate == b.frameRate && a.bitRate == b.bitRate;
+}
+
+// highest standard frame rate, not above the requested one, that the
+// measured throughput covers with the margin to spare
+static int sustainableFrameRate(int requested, double fps, int margin)
+{
+    double usable = fps * 100 / (100 + margin);
+    if (usable >= requested) return requested;
+    for (size_t i = 0; i < sizeof(kStandardFrameRates) / sizeof(kStandardFrameRates[0]); i++) {
+        if (kStandardFrameRates[i] < requested && kStandardFrameRates[i] <= usable) {
+            return kStandardFrameRates[i];
+        }
+    }
+    return 0;
+}
+
+static const Measurement* measure(const OmxCore& core, Vector<Measurement>& cache,
+                                  const EncodeConfig& config, const Options& options)
+{
+    for (size_t i = 0; i < cache.size(); i++) {
+        if (sameConfig(cache[i].config, config)) return &cache[i];
+    }
+
+    Measurement m;
+    m.config = config;
+    m.result.ok = false;
+    m.maxBitRate = 0;
+
+    char component[OMX_MAX_STRINGNAME_SIZE];
+    const char* codecName = MediaProfilesParser::videoCodecName(config.codec);
+    if (!findEncoder(core, config.codec, component, sizeof(component))) {
+        fprintf(stderr, "no OMX encoder for %s, skipping\n", codecName ? codecName : "?");
+        return &cache.editItemAt(cache.add(m));
+    }
+
+    {
+        EncoderRun run(core, component);
+        run.run(config, options.frames, options.warmup, &m.result);
+    }
+
+    if (m.result.ok) {
+        // probe upwards with shorter runs; the last probe the encoder still
+        // delivers without losing frame rate is its bitrate ceiling here
+        int baseRate = sustainableFrameRate(config.frameRate, m.result.fps, options.margin);
+        for (size_t i = 0; i < sizeof(kBitrateProbes) / sizeof(kBitrateProbes[0]); i++) {
+            EncodeConfig probe = config;
+            probe.bitRate = (int) ((int64_t) config.bitRate * kBitrateProbes[i] / 100);
+            EncodeResult r;
+            if (i == 0) {
+                r = m.result;
+            } else {
+                EncoderRun run(core, component);
+                if (!run.run(probe, options.frames / 2 + 1, options.warmup, &r)) break;
+            }
+            bool delivered = (int64_t) r.achievedBitRate * 100 >=
+                             (int64_t) probe.bitRate * BITRATE_DELIVERY_PERCENT;
+            if (baseRate == 0 || !delivered ||
+                sustainableFrameRate(config.frameRate, r.fps, options.margin) < baseRate) {
+                break;
+            }
+            m.maxBitRate = probe.bitRate;
+        }
+    }
+
+    if (m.result.ok) {
+        printf("%-5s %4dx%-4d @%2d %6d kbps: %6.1f fps sustained (%.2fx), %6d kbps delivered (%d%%), "
+               "ceiling %d kbps\n",
+               codecName, config.width, config.height, config.frameRate, config.bitRate / 1000,
+               m.result.fps, m.result.fps / config.frameRate, m.result.achievedBitRate / 1000,
+               (int) ((int64_t) m.result.achievedBitRate * 100 / config.bitRate),
+               m.maxBitRate / 1000);
+    } else {
+        printf("%-5s %4dx%-4d @%2d %6d kbps: failed\n", codecName, config.width, config.height,
+               config.frameRate, config.bitRate / 1000);
+    }
+    return &cache.editItemAt(cache.add(m));
+}
+
+/*
+ * Attribute level rewriting of the original document.
+ */
+struct TagLocation {
+    String8     name;
+    long        offset;
+    int         length;
+};
+
+struct AttributeEdit {
+    int         tag;
+    String8     attribute;
+    int         value;
+};
+
+static void indexStartElement(void* userData, const char* name, const char** atts)
+{
+    XML_Parser parser = (XML_Parser) ((void**) userData)[0];
+    Vector<TagLocation>* tags = (Vector<TagLocation>*) ((void**) userData)[1];
+    TagLocation tag;
+    tag.name.setTo(name);
+    tag.offset = XML_GetCurrentByteIndex(parser);
+    tag.length = XML_GetCurrentByteCount(parser);
+    tags->add(tag);
+}
+
+static bool indexTags(const char* xml, size_t size, Vector<TagLocation>* tags)
+{
+    XML_Parser parser = XML_ParserCreate(NULL);
+    void* userData[2] = { parser, tags };
+    XML_SetUserData(parser, userData);
+    XML_SetStartElementHandler(parser, indexStartElement);
+    bool ok = XML_Parse(parser, xml, size, 1) == XML_STATUS_OK;
+    XML_ParserFree(parser);
+    return ok;
+}
+
+// index of the n-th start tag with the given name, or -1
+static int findTag(const Vector<TagLocation>& tags, const char* name, int n)
+{
+    for (size_t i = 0; i < tags.size(); i++) {
+        if (tags[i].name == name && n-- == 0) return i;
+    }
+    return -1;
+}
+
+static void addEdit(Vector<AttributeEdit>& edits, int tag, const char* attribute, int value)
+{
+    if (tag < 0) return;
+    AttributeEdit edit;
+    edit.tag = tag;
+    edit.attribute.setTo(attribute);
+    edit.value = value;
+    edits.add(edit);
+}
+
+struct Replacement {
+    size_t      start;      // first byte of the old value
+    size_t      end;        // closing quote
+    int         value;
+};
+
+static bool writeEdited(const char* path, const char* xml, size_t size,
+                        const Vector<TagLocation>& tags, const Vector<AttributeEdit>& edits)
+{
+    // locate every value first, then apply them in document order
+    Vector<Replacement> replacements;
+    for (size_t e = 0; e < edits.size(); e++) {
+        const TagLocation& tag = tags[edits[e].tag];
+        String8 needle(edits[e].attribute);
+        needle.append("=\"");
+        const char* start = xml + tag.offset;
+        const char* end = start + tag.length;
+        const char* found = NULL;
+        for (const char* p = start + 1; p + needle.length() <= end; p++) {
+            if (!strncmp(p, needle.string(), needle.length()) && strchr(" \t\r\n", p[-1])) {
+                found = p;
+                break;
+            }
+        }
+        if (found == NULL) continue;
+        const char* value = found + needle.length();
+        const char* close = (const char*) memchr(value, '"', end - value);
+        if (close == NULL) continue;
+
+        Replacement r;
+        r.start = value - xml;
+        r.end = close - xml;
+        r.value = edits[e].value;
+        size_t at = 0;
+        while (at < replacements.size() && replacements[at].start < r.start) at++;
+        replacements.insertAt(r, at);
+    }
+
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "cannot create %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    size_t pos = 0;
+    for (size_t i = 0; i < replacements.size(); i++) {
+        fwrite(xml + pos, 1, replacements[i].start - pos, fp);
+        fprintf(fp, "%d", replacements[i].value);
+        pos = replacements[i].end;
+    }
+    fwrite(xml + pos, 1, size - pos, fp);
+    return fclose(fp) == 0;
+}
+
+static char* readFile(const char* path, size_t* size)
+{
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char* data = (char*) malloc(len + 1);
+    if (data != NULL && fread(data, 1, len, fp) != (size_t) len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    if (data != NULL) {
+        data[len] = '\0';
+        *size = len;
+    }
+    return data;
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr,
+            "usage: %s [-p plugin] [-f frames] [-w warmup] [-m margin] [-n] input.xml output.xml\n"
+            "  -p  PV OMX plugin to load the core through (default %s)\n"
+            "  -f  measured frames per configuration (default %d)\n"
+            "  -w  warm-up frames excluded from the measurement (default %d)\n"
+            "  -m  frame rate headroom required, in percent (default %d)\n"
+            "  -n  measure and report only, do not write output.xml\n",
+            name, DEFAULT_PLUGIN_LIBRARY, DEFAULT_FRAMES, DEFAULT_WARMUP, DEFAULT_MARGIN_PERCENT);
+}
+
+int main(int argc, char** argv)
+{
+    const char* pluginPath = DEFAULT_PLUGIN_LIBRARY;
+    Options options;
+    options.frames = DEFAULT_FRAMES;
+    options.warmup = DEFAULT_WARMUP;
+    options.margin = DEFAULT_MARGIN_PERCENT;
+    bool dryRun = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:f:w:m:nh")) != -1) {
+        switch (opt) {
+        case 'p': pluginPath = optarg; break;
+        case 'f': options.frames = atoi(optarg); break;
+        case 'w': options.warmup = atoi(optarg); break;
+        case 'm': options.margin = atoi(optarg); break;
+        case 'n': dryRun = true; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (argc - optind != 2 || options.frames < 2 || options.warmup < 1 || options.margin < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    const char* input = argv[optind];
+    const char* output = argv[optind + 1];
+
+    MediaProfilesData data;
+    MediaProfilesParser parser;
+    if (!parser.parse(input, &data)) {
+        fprintf(stderr, "%s: %d error(s)\n", input, parser.errors());
+        return 1;
+    }
+
+    OmxCore core;
+    if (!loadCore(pluginPath, &core)) {
+        unloadCore(&core);
+        return 1;
+    }
+
+    Vector<Measurement> cache;
+    Vector<AttributeEdit> edits;
+    size_t xmlSize = 0;
+    char* xml = readFile(input, &xmlSize);
+    Vector<TagLocation> tags;
+    if (xml == NULL || !indexTags(xml, xmlSize, &tags)) {
+        fprintf(stderr, "cannot re-read %s\n", input);
+        unloadCore(&core);
+        free(xml);
+        return 1;
+    }
+
+    int failures = 0;
+    int changes = 0;
+
+    // caps first, since profiles are clamped to them afterwards
+    Vector<int> capMaxBitRate;
+    for (size_t i = 0; i < data.videoEncoderCaps.size(); i++) {
+        const MediaProfilesVideoEncoderCapRecord& cap = data.videoEncoderCaps[i];
+        capMaxBitRate.add(cap.maxBitRate);
+        if (!cap.enabled || encoderRole(cap.codec) == NULL) continue;
+
+        EncodeConfig config;
+        config.codec = cap.codec;
+        config.width = cap.maxFrameWidth;
+        config.height = cap.maxFrameHeight;
+        config.frameRate = cap.maxFrameRate;
+        config.bitRate = cap.maxBitRate;
+        const Measurement* m = measure(core, cache, config, options);
+        if (!m->result.ok) {
+            failures++;
+            continue;
+        }
+
+        int tag = findTag(tags, "VideoEncoderCap", i);
+        int rate = sustainableFrameRate(cap.maxFrameRate, m->result.fps, options.margin);
+        if (rate > 0 && rate != cap.maxFrameRate) {
+            addEdit(edits, tag, "maxFrameRate", rate);
+            changes++;
+        }
+        if (m->maxBitRate > 0 && m->maxBitRate != cap.maxBitRate) {
+            addEdit(edits, tag, "maxBitRate", m->maxBitRate);
+            capMaxBitRate.editItemAt(i) = m->maxBitRate;
+            changes++;
+        }
+    }
+
+    for (size_t i = 0; i < data.encoderProfiles.size(); i++) {
+        const MediaProfilesEncoderProfileRecord& profile = data.encoderProfiles[i];
+        if (encoderRole(profile.videoCodec) == NULL) continue;
+
+        EncodeConfig config;
+        config.codec = profile.videoCodec;
+        config.width = profile.videoWidth;
+        config.height = profile.videoHeight;
+        config.frameRate = profile.videoFrameRate;
+        config.bitRate = profile.videoBitRate;
+        const Measurement* m = measure(core, cache, config, options);
+        if (!m->result.ok) {
+            failures++;
+            continue;
+        }
+
+        int tag = findTag(tags, "Video", i);
+        int rate = sustainableFrameRate(profile.videoFrameRate, m->result.fps, options.margin);
+        if (rate > 0 && rate != profile.videoFrameRate) {
+            addEdit(edits, tag, "frameRate", rate);
+            changes++;
+        }
+
+        // the profile must stay inside the first cap covering its size
+        int bitRate = profile.videoBitRate;
+        if (m->maxBitRate > 0 && bitRate > m->maxBitRate) bitRate = m->maxBitRate;
+        for (size_t c = 0; c < data.videoEncoderCaps.size(); c++) {
+            const MediaProfilesVideoEncoderCapRecord& cap = data.videoEncoderCaps[c];
+            if (cap.codec == profile.videoCodec && cap.maxFrameWidth >= profile.videoWidth &&
+                cap.maxFrameHeight >= profile.videoHeight) {
+                if (bitRate > capMaxBitRate[c]) bitRate = capMaxBitRate[c];
+                break;
+            }
+        }
+        if (bitRate != profile.videoBitRate) {
+            addEdit(edits, tag, "bitRate", bitRate);
+            changes++;
+        }
+    }
+
+    unloadCore(&core);
+
+    printf("%d configuration(s) measured, %d failed, %d value(s) %s\n", (int) cache.size(), failures,
+           changes, dryRun ? "would change" : "changed");
+
+    bool ok = true;
+    if (!dryRun) {
+        ok = writeEdited(output, xml, xmlSize, tags, edits);
+    }
+    free(xml);
+    return ok && failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Build time compiler for media_profiles.xml.
+ *
+ *   media_profiles_compiler [--strict] [--dump] input.xml output.bin
+ *
+ * Validates the XML against its DTD and writes the binary table that
+ * MediaProfilesTable maps at runtime.  Exits non-zero on any error so a
+ * broken profile file fails the build instead of the media server.
+ */
+
+#define LOG_TAG "media_profiles_compiler"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "media_profiles_parser.h"
+#include "media_profiles_table.h"
+
+using namespace android;
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [--strict] [--dump] input.xml output.bin\n", name);
+    fprintf(stderr, "  --strict  treat DTD deviations the framework tolerates as errors\n");
+    fprintf(stderr, "  --dump    print the compiled camcorder profiles\n");
+}
+
+static const char* name(const char* s)
+{
+    return s ? s : "?";
+}
+
+static void dump(const char* path)
+{
+    MediaProfilesTable* table = MediaProfilesTable::open(path, NULL);
+    if (table == NULL) {
+        fprintf(stderr, "cannot reload %s\n", path);
+        return;
+    }
+
+    size_t count;
+    const MediaProfilesCameraRecord* cameras =
+            table->records<MediaProfilesCameraRecord>(kSectionCameras, &count);
+    for (size_t i = 0; i < count; i++) {
+        printf("camera %d: startOffsetMs %d memCap %d previewFrameRate %d\n",
+               cameras[i].cameraId, cameras[i].startOffsetMs,
+               cameras[i].imageDecodingMemCap, cameras[i].previewFrameRate);
+        for (int q = 0; q < 2 * kQualityTimeLapseBase; q++) {
+            const MediaProfilesEncoderProfileRecord* p =
+                    table->getCamcorderProfile(cameras[i].cameraId, q);
+            if (p == NULL) continue;
+            printf("  %-16s %s %4dx%-4d %2dfps %8d bps, %s %6d bps %5d Hz %dch\n",
+                   name(MediaProfilesParser::qualityName(p->quality)),
+                   name(MediaProfilesParser::videoCodecName(p->videoCodec)),
+                   p->videoWidth, p->videoHeight, p->videoFrameRate, p->videoBitRate,
+                   name(MediaProfilesParser::audioCodecName(p->audioCodec)),
+                   p->audioBitRate, p->audioSampleRate, p->audioChannels);
+        }
+    }
+    delete table;
+}
+
+int main(int argc, char** argv)
+{
+    bool strict = false;
+    bool dumpTable = false;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (!strcmp(argv[i], "--strict")) {
+            strict = true;
+        } else if (!strcmp(argv[i], "--dump") || !strcmp(argv[i], "-d")) {
+            dumpTable = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (argc - i != 2) {
+        usage(argv[0]);
+        return 2;
+    }
+    const char* input = argv[i];
+    const char* output = argv[i + 1];
+
+    MediaProfilesData data;
+    MediaProfilesParser parser(strict);
+    if (!parser.parse(input, &data)) {
+        fprintf(stderr, "%s: %d error(s), %d warning(s)\n", input, parser.errors(), parser.warnings());
+        return 1;
+    }
+
+    size_t size;
+    void* table = MediaProfilesTable::build(data, &size);
+    if (table == NULL) {
+        return 1;
+    }
+
+    FILE* fp = fopen(output, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "cannot create %s: %s\n", output, strerror(errno));
+        free(table);
+        return 1;
+    }
+    bool ok = fwrite(table, 1, size, fp) == size;
+    ok = (fclose(fp) == 0) && ok;
+    free(table);
+    if (!ok) {
+        fprintf(stderr, "failed to write %s\n", output);
+        remove(output);
+        return 1;
+    }
+
+    if (parser.warnings()) {
+        fprintf(stderr, "%s: %d warning(s)\n", input, parser.warnings());
+    }
+    if (dumpTable) {
+        dump(output);
+    }
+    return 0;
+}
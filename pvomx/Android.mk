@@ -11,4 +11,6 @@ LOCAL_MODULE_CLASS :=  ETC
 include $(BUILD_PREBUILT)
 
 include vendor/qcom/android-open/pvomx/omx_core_plugin/Android.mk
+include vendor/qcom/android-open/pvomx/omx_core_stub/Android.mk
+include vendor/qcom/android-open/pvomx/omx_plugin_bench/Android.mk
 endif
@@ -47,3 +47,23 @@ endif
 
 include $(BUILD_SHARED_LIBRARY)
 
+# Host build of the plugin, loaded by omx_plugin_bench against the
+# stand-in core in ../omx_core_stub
+ifeq ($(HOST_OS),linux)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := src/pv_omx_interface.cpp
+
+LOCAL_MODULE := libqcomm_omx
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_C_INCLUDES := \
+    $(PV_INCLUDES)
+
+LOCAL_STATIC_LIBRARIES := liblog
+
+LOCAL_LDLIBS := -ldl
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+endif
@@ -0,0 +1,22 @@
+LOCAL_PATH := $(call my-dir)
+
+# Stand-in for libOmxCore.so so libqcomm_omx can be exercised on a
+# Linux host.  Only built for the host; the target keeps the real core.
+ifeq ($(HOST_OS),linux)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := src/omx_core_stub.cpp
+
+LOCAL_MODULE := libOmxCore
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_C_INCLUDES := \
+    external/opencore/extern_libs_v2/khronos/openmax/include
+
+LOCAL_STATIC_LIBRARIES := liblog
+
+LOCAL_LDLIBS := -lpthread -lrt
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+endif
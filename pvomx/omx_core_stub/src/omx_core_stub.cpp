@@ -0,0 +1,881 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+/*
+ * Stand-in for libOmxCore.so.
+ *
+ * Implements the OMX_* core entry points and a small set of video
+ * decoder/encoder components that do no real coding work.  Each
+ * component simply holds a buffer for a configurable time and then
+ * returns it, so libqcomm_omx and anything layered on it can be
+ * exercised on a Linux host without Qualcomm hardware.
+ *
+ * The output port of a decoder can be tunneled (OMX_SetupTunnel) to a
+ * component that supplies its buffers, like the MIO display sink: filled
+ * buffers then go to the peer's EmptyThisBuffer instead of FillBufferDone,
+ * flushed ones empty, and the peer gives them back with OMX_FillThisBuffer.
+ *
+ * Behaviour is configured from the environment when OMX_Init is called:
+ *
+ *   OMX_STUB_HANDLE_LATENCY_US   delay added to every OMX_GetHandle
+ *   OMX_STUB_DEC_LATENCY_US      fixed per-frame decode latency
+ *   OMX_STUB_DEC_NS_PER_MB       additional decode time per macroblock
+ *   OMX_STUB_DEC_INPUT_BUFFERS   decoder input buffer count
+ *   OMX_STUB_DEC_OUTPUT_BUFFERS  decoder output buffer count
+ *   OMX_STUB_ENC_LATENCY_US      fixed per-frame encode latency
+ *   OMX_STUB_ENC_NS_PER_MB       additional encode time per macroblock
+ *   OMX_STUB_ENC_INPUT_BUFFERS   encoder input buffer count
+ *   OMX_STUB_ENC_OUTPUT_BUFFERS  encoder output buffer count
+ *   OMX_STUB_BUSY_WAIT           if non-zero, spin instead of sleeping so
+ *                                the simulated work shows up as CPU time
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "OmxCoreStub"
+#include <utils/Log.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "OMX_Core.h"
+#include "OMX_Component.h"
+
+#define OMX_STUB_SPEC_VERSION   0x00000101
+#define OMX_STUB_INPUT_PORT     0
+#define OMX_STUB_OUTPUT_PORT    1
+#define OMX_STUB_NUM_PORTS      2
+#define OMX_STUB_MAX_BUFFERS    32
+#define OMX_STUB_QUEUE_SIZE     (4 * OMX_STUB_MAX_BUFFERS)
+
+#define OMX_STUB_DEFAULT_WIDTH  640
+#define OMX_STUB_DEFAULT_HEIGHT 480
+
+enum StubKind {
+    STUB_DECODER,
+    STUB_ENCODER
+};
+
+struct StubComponentInfo {
+    const char*             name;
+    const char*             role;
+    StubKind                kind;
+    OMX_VIDEO_CODINGTYPE    coding;
+};
+
+static const StubComponentInfo kComponents[] = {
+    { "OMX.qcom.stub.video.decoder.avc",   "video_decoder.avc",   STUB_DECODER, OMX_VIDEO_CodingAVC },
+    { "OMX.qcom.stub.video.decoder.mpeg4", "video_decoder.mpeg4", STUB_DECODER, OMX_VIDEO_CodingMPEG4 },
+    { "OMX.qcom.stub.video.decoder.h263",  "video_decoder.h263",  STUB_DECODER, OMX_VIDEO_CodingH263 },
+    { "OMX.qcom.stub.video.encoder.avc",   "video_encoder.avc",   STUB_ENCODER, OMX_VIDEO_CodingAVC },
+    { "OMX.qcom.stub.video.encoder.mpeg4", "video_encoder.mpeg4", STUB_ENCODER, OMX_VIDEO_CodingMPEG4 },
+    { "OMX.qcom.stub.video.encoder.h263",  "video_encoder.h263",  STUB_ENCODER, OMX_VIDEO_CodingH263 },
+};
+static const OMX_U32 kNumComponents = sizeof(kComponents) / sizeof(kComponents[0]);
+
+struct StubTiming {
+    OMX_U32 latencyUs;
+    OMX_U32 nsPerMacroblock;
+    OMX_U32 inputBuffers;
+    OMX_U32 outputBuffers;
+};
+
+static pthread_mutex_t sCoreLock = PTHREAD_MUTEX_INITIALIZER;
+static int sInitCount = 0;
+static OMX_U32 sHandleLatencyUs = 0;
+static bool sBusyWait = false;
+static StubTiming sTiming[2];
+
+enum StubMessageType {
+    MSG_COMMAND,
+    MSG_EMPTY_BUFFER,
+    MSG_FILL_BUFFER,
+    MSG_EXIT
+};
+
+struct StubMessage {
+    StubMessageType         type;
+    OMX_COMMANDTYPE         cmd;
+    OMX_U32                 param;
+    OMX_BUFFERHEADERTYPE*   buffer;
+};
+
+struct StubComponent {
+    OMX_COMPONENTTYPE               handle;
+    const StubComponentInfo*        info;
+    StubTiming                      timing;
+    OMX_CALLBACKTYPE                callbacks;
+    OMX_PTR                         appData;
+    OMX_STATETYPE                   state;
+    OMX_PARAM_PORTDEFINITIONTYPE    ports[OMX_STUB_NUM_PORTS];
+    OMX_U32                         targetBitrate;
+
+    // input port the output port is tunneled to, under lock
+    OMX_HANDLETYPE                  tunnelPeer;
+    OMX_U32                         tunnelPort;
+
+    // buffers owned by the component, waiting to be processed
+    OMX_BUFFERHEADERTYPE*           pendingIn[OMX_STUB_MAX_BUFFERS];
+    OMX_U32                         numPendingIn;
+    OMX_BUFFERHEADERTYPE*           pendingOut[OMX_STUB_MAX_BUFFERS];
+    OMX_U32                         numPendingOut;
+
+    // message queue serviced by the component thread
+    pthread_t                       thread;
+    pthread_mutex_t                 lock;
+    pthread_cond_t                  cond;
+    StubMessage                     queue[OMX_STUB_QUEUE_SIZE];
+    OMX_U32                         queueHead;
+    OMX_U32                         queueCount;
+};
+
+static OMX_U32 readEnv(const char* name, OMX_U32 defaultValue)
+{
+    const char* value = getenv(name);
+    if (value == NULL || *value == '\0') return defaultValue;
+    return strtoul(value, NULL, 0);
+}
+
+static OMX_U32 clampBufferCount(OMX_U32 count)
+{
+    if (count < 1) return 1;
+    if (count > OMX_STUB_MAX_BUFFERS) return OMX_STUB_MAX_BUFFERS;
+    return count;
+}
+
+static void loadTiming()
+{
+    sHandleLatencyUs = readEnv("OMX_STUB_HANDLE_LATENCY_US", 0);
+    sBusyWait = readEnv("OMX_STUB_BUSY_WAIT", 0) != 0;
+
+    StubTiming& dec = sTiming[STUB_DECODER];
+    dec.latencyUs       = readEnv("OMX_STUB_DEC_LATENCY_US", 0);
+    dec.nsPerMacroblock = readEnv("OMX_STUB_DEC_NS_PER_MB", 0);
+    dec.inputBuffers    = clampBufferCount(readEnv("OMX_STUB_DEC_INPUT_BUFFERS", 2));
+    dec.outputBuffers   = clampBufferCount(readEnv("OMX_STUB_DEC_OUTPUT_BUFFERS", 8));
+
+    StubTiming& enc = sTiming[STUB_ENCODER];
+    enc.latencyUs       = readEnv("OMX_STUB_ENC_LATENCY_US", 0);
+    enc.nsPerMacroblock = readEnv("OMX_STUB_ENC_NS_PER_MB", 0);
+    enc.inputBuffers    = clampBufferCount(readEnv("OMX_STUB_ENC_INPUT_BUFFERS", 5));
+    enc.outputBuffers   = clampBufferCount(readEnv("OMX_STUB_ENC_OUTPUT_BUFFERS", 8));
+}
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// simulate work either by sleeping or by burning CPU
+static void simulateWork(int64_t ns)
+{
+    if (ns <= 0) return;
+    if (sBusyWait) {
+        int64_t end = nowNs() + ns;
+        while (nowNs() < end) {
+        }
+        return;
+    }
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000LL;
+    ts.tv_nsec = ns % 1000000000LL;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+static const StubComponentInfo* findComponent(const char* name)
+{
+    for (OMX_U32 i = 0; i < kNumComponents; i++) {
+        if (!strcmp(kComponents[i].name, name)) return &kComponents[i];
+    }
+    return NULL;
+}
+
+static inline StubComponent* toStub(OMX_HANDLETYPE hComponent)
+{
+    return (StubComponent*) ((OMX_COMPONENTTYPE*) hComponent)->pComponentPrivate;
+}
+
+static inline void setVersion(OMX_VERSIONTYPE* version)
+{
+    version->nVersion = OMX_STUB_SPEC_VERSION;
+}
+
+static OMX_U32 frameBytes(const OMX_PARAM_PORTDEFINITIONTYPE& port)
+{
+    return (port.format.video.nFrameWidth * port.format.video.nFrameHeight * 3) / 2;
+}
+
+static OMX_U32 macroblocks(const StubComponent* c)
+{
+    const OMX_VIDEO_PORTDEFINITIONTYPE& video = c->ports[OMX_STUB_INPUT_PORT].format.video;
+    return ((video.nFrameWidth + 15) / 16) * ((video.nFrameHeight + 15) / 16);
+}
+
+// raw ports carry YUV420 semi-planar frames, coded ports carry the bitstream
+static void updatePortSizes(StubComponent* c)
+{
+    OMX_PARAM_PORTDEFINITIONTYPE& raw =
+        c->ports[c->info->kind == STUB_DECODER ? OMX_STUB_OUTPUT_PORT : OMX_STUB_INPUT_PORT];
+    OMX_PARAM_PORTDEFINITIONTYPE& coded =
+        c->ports[c->info->kind == STUB_DECODER ? OMX_STUB_INPUT_PORT : OMX_STUB_OUTPUT_PORT];
+
+    coded.format.video.nFrameWidth = raw.format.video.nFrameWidth;
+    coded.format.video.nFrameHeight = raw.format.video.nFrameHeight;
+    raw.format.video.nStride = raw.format.video.nFrameWidth;
+    raw.format.video.nSliceHeight = raw.format.video.nFrameHeight;
+    raw.nBufferSize = frameBytes(raw);
+    coded.nBufferSize = raw.nBufferSize / 2;
+}
+
+static void initPorts(StubComponent* c)
+{
+    for (OMX_U32 i = 0; i < OMX_STUB_NUM_PORTS; i++) {
+        OMX_PARAM_PORTDEFINITIONTYPE& port = c->ports[i];
+        memset(&port, 0, sizeof(port));
+        port.nSize = sizeof(port);
+        setVersion(&port.nVersion);
+        port.nPortIndex = i;
+        port.eDir = (i == OMX_STUB_INPUT_PORT) ? OMX_DirInput : OMX_DirOutput;
+        port.nBufferCountActual = (i == OMX_STUB_INPUT_PORT) ? c->timing.inputBuffers : c->timing.outputBuffers;
+        port.nBufferCountMin = port.nBufferCountActual;
+        port.bEnabled = OMX_TRUE;
+        port.bPopulated = OMX_FALSE;
+        port.eDomain = OMX_PortDomainVideo;
+        port.format.video.nFrameWidth = OMX_STUB_DEFAULT_WIDTH;
+        port.format.video.nFrameHeight = OMX_STUB_DEFAULT_HEIGHT;
+        port.format.video.xFramerate = 30 << 16;
+        port.nBufferAlignment = 4;
+
+        bool raw = (c->info->kind == STUB_DECODER) == (i == OMX_STUB_OUTPUT_PORT);
+        if (raw) {
+            port.format.video.cMIMEType = (OMX_STRING) "video/raw";
+            port.format.video.eCompressionFormat = OMX_VIDEO_CodingUnused;
+            port.format.video.eColorFormat = OMX_COLOR_FormatYUV420SemiPlanar;
+        } else {
+            port.format.video.cMIMEType = (OMX_STRING) "video/compressed";
+            port.format.video.eCompressionFormat = c->info->coding;
+            port.format.video.eColorFormat = OMX_COLOR_FormatUnused;
+        }
+    }
+    updatePortSizes(c);
+    c->targetBitrate = 4000000;
+}
+
+static void postMessage(StubComponent* c, const StubMessage& msg)
+{
+    pthread_mutex_lock(&c->lock);
+    if (c->queueCount == OMX_STUB_QUEUE_SIZE) {
+        LOGE("%s: message queue overflow", c->info->name);
+    } else {
+        c->queue[(c->queueHead + c->queueCount) % OMX_STUB_QUEUE_SIZE] = msg;
+        c->queueCount++;
+        pthread_cond_signal(&c->cond);
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+static void returnBuffer(StubComponent* c, OMX_BUFFERHEADERTYPE* buffer, bool input)
+{
+    if (input) {
+        c->callbacks.EmptyBufferDone(&c->handle, c->appData, buffer);
+        return;
+    }
+    pthread_mutex_lock(&c->lock);
+    OMX_HANDLETYPE peer = c->tunnelPeer;
+    pthread_mutex_unlock(&c->lock);
+    if (peer != NULL) {
+        OMX_EmptyThisBuffer(peer, buffer);
+    } else {
+        c->callbacks.FillBufferDone(&c->handle, c->appData, buffer);
+    }
+}
+
+// return every buffer held on a port, as required for flush and port disable
+static void flushPort(StubComponent* c, OMX_U32 port)
+{
+    if (port == OMX_STUB_INPUT_PORT || port == OMX_ALL) {
+        for (OMX_U32 i = 0; i < c->numPendingIn; i++) {
+            c->pendingIn[i]->nFilledLen = 0;
+            returnBuffer(c, c->pendingIn[i], true);
+        }
+        c->numPendingIn = 0;
+    }
+    if (port == OMX_STUB_OUTPUT_PORT || port == OMX_ALL) {
+        for (OMX_U32 i = 0; i < c->numPendingOut; i++) {
+            c->pendingOut[i]->nFilledLen = 0;
+            returnBuffer(c, c->pendingOut[i], false);
+        }
+        c->numPendingOut = 0;
+    }
+}
+
+static void processBuffers(StubComponent* c)
+{
+    while (c->state == OMX_StateExecuting && c->numPendingIn > 0 && c->numPendingOut > 0) {
+        OMX_BUFFERHEADERTYPE* in = c->pendingIn[0];
+        OMX_BUFFERHEADERTYPE* out = c->pendingOut[0];
+        memmove(c->pendingIn, c->pendingIn + 1, --c->numPendingIn * sizeof(in));
+        memmove(c->pendingOut, c->pendingOut + 1, --c->numPendingOut * sizeof(out));
+
+        simulateWork((int64_t) c->timing.latencyUs * 1000 +
+                     (int64_t) c->timing.nsPerMacroblock * macroblocks(c));
+
+        OMX_U32 produced;
+        if (c->info->kind == STUB_DECODER) {
+            produced = frameBytes(c->ports[OMX_STUB_OUTPUT_PORT]);
+        } else {
+            // size the coded frame so the stream runs at the target bitrate
+            OMX_U32 fps = c->ports[OMX_STUB_INPUT_PORT].format.video.xFramerate >> 16;
+            produced = c->targetBitrate / 8 / (fps ? fps : 30);
+        }
+        if (in->nFilledLen == 0) produced = 0;
+        out->nOffset = 0;
+        out->nFilledLen = produced < out->nAllocLen ? produced : out->nAllocLen;
+        out->nTimeStamp = in->nTimeStamp;
+        out->nFlags = in->nFlags | OMX_BUFFERFLAG_ENDOFFRAME;
+
+        in->nFilledLen = 0;
+        returnBuffer(c, in, true);
+        returnBuffer(c, out, false);
+
+        if (out->nFlags & OMX_BUFFERFLAG_EOS) {
+            c->callbacks.EventHandler(&c->handle, c->appData, OMX_EventBufferFlag,
+                                      OMX_STUB_OUTPUT_PORT, out->nFlags, NULL);
+        }
+    }
+}
+
+static void handleCommand(StubComponent* c, OMX_COMMANDTYPE cmd, OMX_U32 param)
+{
+    switch (cmd) {
+    case OMX_CommandStateSet: {
+        OMX_STATETYPE newState = (OMX_STATETYPE) param;
+        if (newState == c->state) {
+            c->callbacks.EventHandler(&c->handle, c->appData, OMX_EventError,
+                                      (OMX_U32) OMX_ErrorSameState, 0, NULL);
+            return;
+        }
+        if (newState == OMX_StateIdle || newState == OMX_StateLoaded) {
+            flushPort(c, OMX_ALL);
+        }
+        c->state = newState;
+        c->callbacks.EventHandler(&c->handle, c->appData, OMX_EventCmdComplete,
+                                  OMX_CommandStateSet, newState, NULL);
+        processBuffers(c);
+        break;
+    }
+    case OMX_CommandFlush:
+        flushPort(c, param);
+        if (param == OMX_ALL) {
+            for (OMX_U32 i = 0; i < OMX_STUB_NUM_PORTS; i++) {
+                c->callbacks.EventHandler(&c->handle, c->appData, OMX_EventCmdComplete,
+                                          OMX_CommandFlush, i, NULL);
+            }
+        } else {
+            c->callbacks.EventHandler(&c->handle, c->appData, OMX_EventCmdComplete,
+                                      OMX_CommandFlush, param, NULL);
+        }
+        break;
+    case OMX_CommandPortDisable:
+    case OMX_CommandPortEnable:
+        for (OMX_U32 i = 0; i < OMX_STUB_NUM_PORTS; i++) {
+            if (param != OMX_ALL && param != i) continue;
+            if (cmd == OMX_CommandPortDisable) flushPort(c, i);
+            c->ports[i].bEnabled = (cmd == OMX_CommandPortEnable) ? OMX_TRUE : OMX_FALSE;
+            c->callbacks.EventHandler(&c->handle, c->appData, OMX_EventCmdComplete, cmd, i, NULL);
+        }
+        processBuffers(c);
+        break;
+    default:
+        c->callbacks.EventHandler(&c->handle, c->appData, OMX_EventError,
+                                  (OMX_U32) OMX_ErrorNotImplemented, 0, NULL);
+        break;
+    }
+}
+
+static void* componentThread(void* arg)
+{
+    StubComponent* c = (StubComponent*) arg;
+    for (;;) {
+        pthread_mutex_lock(&c->lock);
+        while (c->queueCount == 0) {
+            pthread_cond_wait(&c->cond, &c->lock);
+        }
+        StubMessage msg = c->queue[c->queueHead];
+        c->queueHead = (c->queueHead + 1) % OMX_STUB_QUEUE_SIZE;
+        c->queueCount--;
+        pthread_mutex_unlock(&c->lock);
+
+        switch (msg.type) {
+        case MSG_EXIT:
+            flushPort(c, OMX_ALL);
+            return NULL;
+        case MSG_COMMAND:
+            handleCommand(c, msg.cmd, msg.param);
+            break;
+        case MSG_EMPTY_BUFFER:
+            c->pendingIn[c->numPendingIn++] = msg.buffer;
+            processBuffers(c);
+            break;
+        case MSG_FILL_BUFFER:
+            c->pendingOut[c->numPendingOut++] = msg.buffer;
+            processBuffers(c);
+            break;
+        }
+    }
+}
+
+/* ======================================================================
+ * component entry points
+ * ====================================================================== */
+
+static OMX_ERRORTYPE StubGetComponentVersion(OMX_HANDLETYPE hComponent, OMX_STRING pComponentName,
+        OMX_VERSIONTYPE* pComponentVersion, OMX_VERSIONTYPE* pSpecVersion, OMX_UUIDTYPE* pComponentUUID)
+{
+    StubComponent* c = toStub(hComponent);
+    strncpy(pComponentName, c->info->name, OMX_MAX_STRINGNAME_SIZE);
+    setVersion(pComponentVersion);
+    setVersion(pSpecVersion);
+    if (pComponentUUID) memset(pComponentUUID, 0, sizeof(*pComponentUUID));
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE StubSendCommand(OMX_HANDLETYPE hComponent, OMX_COMMANDTYPE Cmd,
+        OMX_U32 nParam1, OMX_PTR pCmdData)
+{
+    StubMessage msg;
+    msg.type = MSG_COMMAND;
+    msg.cmd = Cmd;
+    msg.param = nParam1;
+    msg.buffer = NULL;
+    postMessage(toStub(hComponent), msg);
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE StubGetParameter(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nParamIndex, OMX_PTR pParam)
+{
+    StubComponent* c = toStub(hComponent);
+    if (pParam == NULL) return OMX_ErrorBadParameter;
+
+    switch (nParamIndex) {
+    case OMX_IndexParamPortDefinition: {
+        OMX_PARAM_PORTDEFINITIONTYPE* def = (OMX_PARAM_PORTDEFINITIONTYPE*) pParam;
+        if (def->nPortIndex >= OMX_STUB_NUM_PORTS) return OMX_ErrorBadPortIndex;
+        *def = c->ports[def->nPortIndex];
+        return OMX_ErrorNone;
+    }
+    case OMX_IndexParamVideoInit: {
+        OMX_PORT_PARAM_TYPE* ports = (OMX_PORT_PARAM_TYPE*) pParam;
+        ports->nPorts = OMX_STUB_NUM_PORTS;
+        ports->nStartPortNumber = 0;
+        return OMX_ErrorNone;
+    }
+    case OMX_IndexParamVideoPortFormat: {
+        OMX_VIDEO_PARAM_PORTFORMATTYPE* fmt = (OMX_VIDEO_PARAM_PORTFORMATTYPE*) pParam;
+        if (fmt->nPortIndex >= OMX_STUB_NUM_PORTS) return OMX_ErrorBadPortIndex;
+        if (fmt->nIndex > 0) return OMX_ErrorNoMore;
+        const OMX_VIDEO_PORTDEFINITIONTYPE& video = c->ports[fmt->nPortIndex].format.video;
+        fmt->eCompressionFormat = video.eCompressionFormat;
+        fmt->eColorFormat = video.eColorFormat;
+        fmt->xFramerate = video.xFramerate;
+        return OMX_ErrorNone;
+    }
+    case OMX_IndexParamVideoBitrate: {
+        OMX_VIDEO_PARAM_BITRATETYPE* rate = (OMX_VIDEO_PARAM_BITRATETYPE*) pParam;
+        rate->eControlRate = OMX_Video_ControlRateVariable;
+        rate->nTargetBitrate = c->targetBitrate;
+        return OMX_ErrorNone;
+    }
+    case OMX_IndexParamStandardComponentRole: {
+        OMX_PARAM_COMPONENTROLETYPE* role = (OMX_PARAM_COMPONENTROLETYPE*) pParam;
+        strncpy((char*) role->cRole, c->info->role, OMX_MAX_STRINGNAME_SIZE);
+        return OMX_ErrorNone;
+    }
+    default:
+        return OMX_ErrorUnsupportedIndex;
+    }
+}
+
+static OMX_ERRORTYPE StubSetParameter(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nIndex, OMX_PTR pParam)
+{
+    StubComponent* c = toStub(hComponent);
+    if (pParam == NULL) return OMX_ErrorBadParameter;
+
+    switch (nIndex) {
+    case OMX_IndexParamPortDefinition: {
+        const OMX_PARAM_PORTDEFINITIONTYPE* def = (const OMX_PARAM_PORTDEFINITIONTYPE*) pParam;
+        if (def->nPortIndex >= OMX_STUB_NUM_PORTS) return OMX_ErrorBadPortIndex;
+        OMX_PARAM_PORTDEFINITIONTYPE& port = c->ports[def->nPortIndex];
+        if (def->nBufferCountActual < port.nBufferCountMin ||
+            def->nBufferCountActual > OMX_STUB_MAX_BUFFERS)
+            return OMX_ErrorBadParameter;
+        port.nBufferCountActual = def->nBufferCountActual;
+        port.format.video.nFrameWidth = def->format.video.nFrameWidth;
+        port.format.video.nFrameHeight = def->format.video.nFrameHeight;
+        if (def->format.video.xFramerate) port.format.video.xFramerate = def->format.video.xFramerate;
+
+        // the raw port dictates the frame geometry of both ports
+        bool raw = (c->info->kind == STUB_DECODER) == (def->nPortIndex == OMX_STUB_OUTPUT_PORT);
+        if (raw) {
+            c->ports[1 - def->nPortIndex].format.video.xFramerate = port.format.video.xFramerate;
+        } else {
+            OMX_PARAM_PORTDEFINITIONTYPE& other = c->ports[1 - def->nPortIndex];
+            other.format.video.nFrameWidth = port.format.video.nFrameWidth;
+            other.format.video.nFrameHeight = port.format.video.nFrameHeight;
+        }
+        updatePortSizes(c);
+        return OMX_ErrorNone;
+    }
+    case OMX_IndexParamVideoBitrate: {
+        const OMX_VIDEO_PARAM_BITRATETYPE* rate = (const OMX_VIDEO_PARAM_BITRATETYPE*) pParam;
+        if (rate->nTargetBitrate == 0) return OMX_ErrorBadParameter;
+        c->targetBitrate = rate->nTargetBitrate;
+        return OMX_ErrorNone;
+    }
+    case OMX_IndexParamVideoPortFormat:
+    case OMX_IndexParamStandardComponentRole:
+        return OMX_ErrorNone;
+    default:
+        return OMX_ErrorUnsupportedIndex;
+    }
+}
+
+static OMX_ERRORTYPE StubGetConfig(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nIndex, OMX_PTR pConfig)
+{
+    return OMX_ErrorUnsupportedIndex;
+}
+
+static OMX_ERRORTYPE StubSetConfig(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nIndex, OMX_PTR pConfig)
+{
+    return OMX_ErrorUnsupportedIndex;
+}
+
+static OMX_ERRORTYPE StubGetExtensionIndex(OMX_HANDLETYPE hComponent, OMX_STRING cParameterName,
+        OMX_INDEXTYPE* pIndexType)
+{
+    return OMX_ErrorUnsupportedIndex;
+}
+
+static OMX_ERRORTYPE StubGetState(OMX_HANDLETYPE hComponent, OMX_STATETYPE* pState)
+{
+    *pState = toStub(hComponent)->state;
+    return OMX_ErrorNone;
+}
+
+// only the output port of a decoder, and never as the buffer supplier
+static OMX_ERRORTYPE StubComponentTunnelRequest(OMX_HANDLETYPE hComp, OMX_U32 nPort,
+        OMX_HANDLETYPE hTunneledComp, OMX_U32 nTunneledPort, OMX_TUNNELSETUPTYPE* pTunnelSetup)
+{
+    StubComponent* c = toStub(hComp);
+    if (nPort >= OMX_STUB_NUM_PORTS) return OMX_ErrorBadPortIndex;
+    if (c->info->kind != STUB_DECODER || nPort != OMX_STUB_OUTPUT_PORT) return OMX_ErrorTunnelingUnsupported;
+
+    // a NULL peer tears the tunnel down; the peer does that once it has
+    // its buffers back
+    if (hTunneledComp == NULL) {
+        pthread_mutex_lock(&c->lock);
+        c->tunnelPeer = NULL;
+        pthread_mutex_unlock(&c->lock);
+        return OMX_ErrorNone;
+    }
+    if (pTunnelSetup == NULL) return OMX_ErrorBadParameter;
+    if (c->state != OMX_StateLoaded && c->ports[nPort].bEnabled) return OMX_ErrorIncorrectStateOperation;
+
+    pTunnelSetup->nTunnelFlags = 0;
+    pTunnelSetup->eSupplier = OMX_BufferSupplyInput;
+    pthread_mutex_lock(&c->lock);
+    c->tunnelPeer = hTunneledComp;
+    c->tunnelPort = nTunneledPort;
+    pthread_mutex_unlock(&c->lock);
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE newBufferHeader(StubComponent* c, OMX_BUFFERHEADERTYPE** ppBufferHdr,
+        OMX_U32 nPortIndex, OMX_PTR pAppPrivate, OMX_U32 nSizeBytes, OMX_U8* pBuffer)
+{
+    if (nPortIndex >= OMX_STUB_NUM_PORTS) return OMX_ErrorBadPortIndex;
+
+    OMX_BUFFERHEADERTYPE* hdr = (OMX_BUFFERHEADERTYPE*) calloc(1, sizeof(OMX_BUFFERHEADERTYPE));
+    if (hdr == NULL) return OMX_ErrorInsufficientResources;
+    hdr->nSize = sizeof(*hdr);
+    setVersion(&hdr->nVersion);
+    hdr->pBuffer = pBuffer;
+    hdr->nAllocLen = nSizeBytes;
+    hdr->pAppPrivate = pAppPrivate;
+    if (nPortIndex == OMX_STUB_INPUT_PORT) {
+        hdr->nInputPortIndex = nPortIndex;
+    } else {
+        hdr->nOutputPortIndex = nPortIndex;
+    }
+    c->ports[nPortIndex].bPopulated = OMX_TRUE;
+    *ppBufferHdr = hdr;
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE StubUseBuffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE** ppBufferHdr,
+        OMX_U32 nPortIndex, OMX_PTR pAppPrivate, OMX_U32 nSizeBytes, OMX_U8* pBuffer)
+{
+    return newBufferHeader(toStub(hComponent), ppBufferHdr, nPortIndex, pAppPrivate, nSizeBytes, pBuffer);
+}
+
+static OMX_ERRORTYPE StubAllocateBuffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE** ppBuffer,
+        OMX_U32 nPortIndex, OMX_PTR pAppPrivate, OMX_U32 nSizeBytes)
+{
+    OMX_U8* data = (OMX_U8*) malloc(nSizeBytes);
+    if (data == NULL) return OMX_ErrorInsufficientResources;
+    OMX_ERRORTYPE err = newBufferHeader(toStub(hComponent), ppBuffer, nPortIndex, pAppPrivate, nSizeBytes, data);
+    if (err != OMX_ErrorNone) {
+        free(data);
+        return err;
+    }
+    // mark the header as owning its payload
+    (*ppBuffer)->pPlatformPrivate = data;
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE StubFreeBuffer(OMX_HANDLETYPE hComponent, OMX_U32 nPortIndex, OMX_BUFFERHEADERTYPE* pBuffer)
+{
+    if (pBuffer == NULL) return OMX_ErrorBadParameter;
+    free(pBuffer->pPlatformPrivate);
+    free(pBuffer);
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE StubEmptyThisBuffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE* pBuffer)
+{
+    StubComponent* c = toStub(hComponent);
+    if (c->state != OMX_StateExecuting && c->state != OMX_StatePause) return OMX_ErrorIncorrectStateOperation;
+    StubMessage msg;
+    msg.type = MSG_EMPTY_BUFFER;
+    msg.buffer = pBuffer;
+    postMessage(c, msg);
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE StubFillThisBuffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE* pBuffer)
+{
+    StubComponent* c = toStub(hComponent);
+    if (c->state != OMX_StateExecuting && c->state != OMX_StatePause) return OMX_ErrorIncorrectStateOperation;
+    StubMessage msg;
+    msg.type = MSG_FILL_BUFFER;
+    msg.buffer = pBuffer;
+    postMessage(c, msg);
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE StubSetCallbacks(OMX_HANDLETYPE hComponent, OMX_CALLBACKTYPE* pCallbacks, OMX_PTR pAppData)
+{
+    StubComponent* c = toStub(hComponent);
+    if (pCallbacks == NULL) return OMX_ErrorBadParameter;
+    c->callbacks = *pCallbacks;
+    c->appData = pAppData;
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE StubComponentDeInit(OMX_HANDLETYPE hComponent)
+{
+    StubComponent* c = toStub(hComponent);
+    StubMessage msg;
+    msg.type = MSG_EXIT;
+    msg.buffer = NULL;
+    postMessage(c, msg);
+    pthread_join(c->thread, NULL);
+    pthread_cond_destroy(&c->cond);
+    pthread_mutex_destroy(&c->lock);
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE StubUseEGLImage(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE** ppBufferHdr,
+        OMX_U32 nPortIndex, OMX_PTR pAppPrivate, void* eglImage)
+{
+    return OMX_ErrorNotImplemented;
+}
+
+static OMX_ERRORTYPE StubComponentRoleEnum(OMX_HANDLETYPE hComponent, OMX_U8* cRole, OMX_U32 nIndex)
+{
+    if (nIndex > 0) return OMX_ErrorNoMore;
+    strncpy((char*) cRole, toStub(hComponent)->info->role, OMX_MAX_STRINGNAME_SIZE);
+    return OMX_ErrorNone;
+}
+
+/* ======================================================================
+ * core entry points
+ * ====================================================================== */
+
+extern "C" {
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_Init(void)
+{
+    pthread_mutex_lock(&sCoreLock);
+    if (sInitCount++ == 0) loadTiming();
+    pthread_mutex_unlock(&sCoreLock);
+    return OMX_ErrorNone;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_Deinit(void)
+{
+    pthread_mutex_lock(&sCoreLock);
+    if (sInitCount > 0) sInitCount--;
+    pthread_mutex_unlock(&sCoreLock);
+    return OMX_ErrorNone;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_ComponentNameEnum(OMX_STRING cComponentName,
+        OMX_U32 nNameLength, OMX_U32 nIndex)
+{
+    if (nIndex >= kNumComponents) return OMX_ErrorNoMore;
+    strncpy(cComponentName, kComponents[nIndex].name, nNameLength);
+    return OMX_ErrorNone;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_GetHandle(OMX_HANDLETYPE* pHandle, OMX_STRING cComponentName,
+        OMX_PTR pAppData, OMX_CALLBACKTYPE* pCallBacks)
+{
+    if (pHandle == NULL || cComponentName == NULL || pCallBacks == NULL) return OMX_ErrorBadParameter;
+
+    const StubComponentInfo* info = findComponent(cComponentName);
+    if (info == NULL) return OMX_ErrorComponentNotFound;
+
+    simulateWork((int64_t) sHandleLatencyUs * 1000);
+
+    StubComponent* c = new StubComponent;
+    memset(c, 0, sizeof(*c));
+    c->info = info;
+    c->timing = sTiming[info->kind];
+    c->callbacks = *pCallBacks;
+    c->appData = pAppData;
+    c->state = OMX_StateLoaded;
+    initPorts(c);
+
+    OMX_COMPONENTTYPE* h = &c->handle;
+    h->nSize = sizeof(*h);
+    setVersion(&h->nVersion);
+    h->pComponentPrivate = c;
+    h->pApplicationPrivate = pAppData;
+    h->GetComponentVersion = StubGetComponentVersion;
+    h->SendCommand = StubSendCommand;
+    h->GetParameter = StubGetParameter;
+    h->SetParameter = StubSetParameter;
+    h->GetConfig = StubGetConfig;
+    h->SetConfig = StubSetConfig;
+    h->GetExtensionIndex = StubGetExtensionIndex;
+    h->GetState = StubGetState;
+    h->ComponentTunnelRequest = StubComponentTunnelRequest;
+    h->UseBuffer = StubUseBuffer;
+    h->AllocateBuffer = StubAllocateBuffer;
+    h->FreeBuffer = StubFreeBuffer;
+    h->EmptyThisBuffer = StubEmptyThisBuffer;
+    h->FillThisBuffer = StubFillThisBuffer;
+    h->SetCallbacks = StubSetCallbacks;
+    h->ComponentDeInit = StubComponentDeInit;
+    h->UseEGLImage = StubUseEGLImage;
+    h->ComponentRoleEnum = StubComponentRoleEnum;
+
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->cond, NULL);
+    if (pthread_create(&c->thread, NULL, componentThread, c) != 0) {
+        LOGE("%s: could not create component thread", info->name);
+        pthread_cond_destroy(&c->cond);
+        pthread_mutex_destroy(&c->lock);
+        delete c;
+        return OMX_ErrorInsufficientResources;
+    }
+
+    *pHandle = h;
+    return OMX_ErrorNone;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_FreeHandle(OMX_HANDLETYPE hComponent)
+{
+    if (hComponent == NULL) return OMX_ErrorBadParameter;
+    StubComponent* c = toStub(hComponent);
+    StubComponentDeInit(hComponent);
+    delete c;
+    return OMX_ErrorNone;
+}
+
+// the output port is asked first, the input port settles the supplier; a
+// NULL input tears the output's end down
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_SetupTunnel(OMX_HANDLETYPE hOutput, OMX_U32 nPortOutput,
+        OMX_HANDLETYPE hInput, OMX_U32 nPortInput)
+{
+    OMX_COMPONENTTYPE* out = (OMX_COMPONENTTYPE*) hOutput;
+    OMX_COMPONENTTYPE* in = (OMX_COMPONENTTYPE*) hInput;
+    if (out == NULL && in == NULL) return OMX_ErrorBadParameter;
+
+    OMX_TUNNELSETUPTYPE setup;
+    setup.nTunnelFlags = 0;
+    setup.eSupplier = OMX_BufferSupplyUnspecified;
+    OMX_ERRORTYPE err = OMX_ErrorNone;
+    if (out != NULL) err = out->ComponentTunnelRequest(hOutput, nPortOutput, hInput, nPortInput, &setup);
+    if (err == OMX_ErrorNone && in != NULL) {
+        err = in->ComponentTunnelRequest(hInput, nPortInput, hOutput, nPortOutput, &setup);
+        if (err != OMX_ErrorNone && out != NULL)
+            out->ComponentTunnelRequest(hOutput, nPortOutput, NULL, 0, &setup);
+    }
+    return err;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_GetContentPipe(OMX_HANDLETYPE* hPipe, OMX_STRING szURI)
+{
+    return OMX_ErrorNotImplemented;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_GetComponentsOfRole(OMX_STRING role, OMX_U32* pNumComps,
+        OMX_U8** compNames)
+{
+    if (role == NULL || pNumComps == NULL) return OMX_ErrorBadParameter;
+
+    OMX_U32 found = 0;
+    for (OMX_U32 i = 0; i < kNumComponents; i++) {
+        if (strcmp(kComponents[i].role, role)) continue;
+        if (compNames != NULL && found < *pNumComps) {
+            strncpy((char*) compNames[found], kComponents[i].name, OMX_MAX_STRINGNAME_SIZE);
+        }
+        found++;
+    }
+    *pNumComps = found;
+    return OMX_ErrorNone;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_GetRolesOfComponent(OMX_STRING compName, OMX_U32* pNumRoles,
+        OMX_U8** roles)
+{
+    if (compName == NULL || pNumRoles == NULL) return OMX_ErrorBadParameter;
+
+    const StubComponentInfo* info = findComponent(compName);
+    if (info == NULL) return OMX_ErrorComponentNotFound;
+    if (roles != NULL && *pNumRoles > 0) {
+        strncpy((char*) roles[0], info->role, OMX_MAX_STRINGNAME_SIZE);
+    }
+    *pNumRoles = 1;
+    return OMX_ErrorNone;
+}
+
+// accept every configuration; the stub components do not parse bitstreams
+OMX_BOOL OMXConfigParser(OMX_PTR aInputParameters, OMX_PTR aOutputParameters)
+{
+    return OMX_TRUE;
+}
+
+} // extern "C"
@@ -0,0 +1,44 @@
+LOCAL_PATH := $(call my-dir)
+
+PV_TOP := external/opencore
+
+PV_BENCH_INCLUDES := \
+    $(PV_TOP)/extern_libs_v2/khronos/openmax/include \
+    $(PV_TOP)/oscl/oscl/config/android \
+    $(PV_TOP)/oscl/oscl/config/shared \
+    $(PV_TOP)/build_config/opencore_dynamic \
+    $(TARGET_OUT_HEADERS)/libpv
+
+########################
+# Device build, runs against the real libOmxCore.so
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := src/omx_plugin_bench.cpp
+
+LOCAL_MODULE := omx_plugin_bench
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_C_INCLUDES := $(PV_BENCH_INCLUDES)
+
+LOCAL_SHARED_LIBRARIES := libdl
+
+include $(BUILD_EXECUTABLE)
+
+########################
+# Host build, runs against the stand-in core in ../omx_core_stub
+ifeq ($(HOST_OS),linux)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := src/omx_plugin_bench.cpp
+
+LOCAL_MODULE := omx_plugin_bench
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_C_INCLUDES := $(PV_BENCH_INCLUDES)
+
+LOCAL_LDLIBS := -ldl -lpthread -lrt
+
+include $(BUILD_HOST_EXECUTABLE)
+endif
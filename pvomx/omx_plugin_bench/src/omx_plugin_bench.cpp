@@ -0,0 +1,354 @@
+/* ------------------------------------------------------------------
+ * Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+/*
+ * Throughput benchmark for libqcomm_omx.
+ *
+ * Loads the plugin the same way PV does (PVGetInterface/PVReleaseInterface)
+ * and times that against opening the OMX core and resolving its entry
+ * points directly; the difference is what the plugin costs.  Once loaded,
+ * calls go straight to the core through the pointers it resolved, so the
+ * handle churn that follows, from several threads, measures the core.
+ *
+ * The component is the first the core lists for a role, unless one is
+ * named.
+ *
+ * On a Linux host, run it against the stand-in core:
+ *
+ *   LD_LIBRARY_PATH=$ANDROID_HOST_OUT/lib omx_plugin_bench -t 4 -i 2000
+ */
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "pv_omxcore.h"
+#include "omx_interface.h"
+
+#define DEFAULT_PLUGIN_LIBRARY  "libqcomm_omx.so"
+#define DEFAULT_CORE_LIBRARY    "libOmxCore.so"
+#define DEFAULT_ROLE            "video_decoder.avc"
+
+typedef OsclAny* (*tpPVGetInterface)();
+typedef void (*tpPVReleaseInterface)(OsclAny*);
+
+struct CoreEntryPoints {
+    tpOMX_Init                  init;
+    tpOMX_Deinit                deinit;
+    tpOMX_GetHandle             getHandle;
+    tpOMX_FreeHandle            freeHandle;
+    tpOMX_GetComponentsOfRole   getComponentsOfRole;
+};
+
+// the symbols PVOMXInterface resolves when it is created
+static const char* const kCoreSymbols[] = {
+    "OMX_Init", "OMX_Deinit", "OMX_ComponentNameEnum", "OMX_GetHandle", "OMX_FreeHandle",
+    "OMX_GetComponentsOfRole", "OMX_GetRolesOfComponent", "OMX_SetupTunnel",
+    "OMX_GetContentPipe", "OMXConfigParser"
+};
+
+struct ChurnArgs {
+    const CoreEntryPoints*  core;
+    const char*             component;
+    int                     iterations;
+    std::vector<int64_t>    samples;
+    int                     failures;
+};
+
+struct Stats {
+    double  meanNs;
+    int64_t p50Ns;
+    int64_t p99Ns;
+    int64_t maxNs;
+    size_t  count;
+};
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int64_t cpuNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static Stats summarize(std::vector<int64_t>& samples)
+{
+    Stats s;
+    memset(&s, 0, sizeof(s));
+    s.count = samples.size();
+    if (samples.empty()) return s;
+
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (size_t i = 0; i < samples.size(); i++) sum += samples[i];
+    s.meanNs = sum / samples.size();
+    s.p50Ns = samples[samples.size() / 2];
+    s.p99Ns = samples[(samples.size() * 99) / 100];
+    s.maxNs = samples.back();
+    return s;
+}
+
+static void printStats(const char* label, const Stats& s)
+{
+    printf("%-24s n=%-8zu mean=%10.0f ns  p50=%10lld ns  p99=%10lld ns  max=%10lld ns\n",
+           label, s.count, s.meanNs, (long long) s.p50Ns, (long long) s.p99Ns, (long long) s.maxNs);
+}
+
+static OMX_ERRORTYPE onEvent(OMX_HANDLETYPE, OMX_PTR, OMX_EVENTTYPE, OMX_U32, OMX_U32, OMX_PTR)
+{
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE onBufferDone(OMX_HANDLETYPE, OMX_PTR, OMX_BUFFERHEADERTYPE*)
+{
+    return OMX_ErrorNone;
+}
+
+static OMX_CALLBACKTYPE sCallbacks = { onEvent, onBufferDone, onBufferDone };
+
+static void* churnThread(void* arg)
+{
+    ChurnArgs* a = (ChurnArgs*) arg;
+    a->samples.reserve(a->iterations);
+    for (int i = 0; i < a->iterations; i++) {
+        OMX_HANDLETYPE handle = NULL;
+        int64_t start = nowNs();
+        OMX_ERRORTYPE err = a->core->getHandle(&handle, (OMX_STRING) a->component, a, &sCallbacks);
+        if (err == OMX_ErrorNone) err = a->core->freeHandle(handle);
+        a->samples.push_back(nowNs() - start);
+        if (err != OMX_ErrorNone) a->failures++;
+    }
+    return NULL;
+}
+
+// run the handle churn on nThreads threads and return the merged samples
+static bool churn(const CoreEntryPoints& core, const char* component, int nThreads, int iterations,
+                  std::vector<int64_t>* samples, int64_t* cpuTimeNs)
+{
+    std::vector<ChurnArgs> args(nThreads);
+    std::vector<pthread_t> threads(nThreads);
+    int failures = 0;
+
+    int64_t cpuStart = cpuNs();
+    for (int t = 0; t < nThreads; t++) {
+        args[t].core = &core;
+        args[t].component = component;
+        args[t].iterations = iterations;
+        args[t].failures = 0;
+        pthread_create(&threads[t], NULL, churnThread, &args[t]);
+    }
+    for (int t = 0; t < nThreads; t++) {
+        pthread_join(threads[t], NULL);
+        samples->insert(samples->end(), args[t].samples.begin(), args[t].samples.end());
+        failures += args[t].failures;
+    }
+    *cpuTimeNs = cpuNs() - cpuStart;
+
+    if (failures) {
+        fprintf(stderr, "%d of %d handle operations failed for %s\n",
+                failures, nThreads * iterations, component);
+        return false;
+    }
+    return true;
+}
+
+// what PVGetInterface does for the OMX core, without the plugin
+static bool openCore(const char* corePath)
+{
+    void* core = dlopen(corePath, RTLD_NOW);
+    if (core == NULL) return false;
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(kCoreSymbols) / sizeof(kCoreSymbols[0]); i++) {
+        if (dlsym(core, kCoreSymbols[i]) == NULL) ok = false;
+    }
+    dlclose(core);
+    return ok;
+}
+
+// the first component the core lists for role, into name
+static bool componentOfRole(const CoreEntryPoints& core, const char* role, char* name)
+{
+    OMX_U32 count = 0;
+    if ((core.getComponentsOfRole((OMX_STRING) role, &count, NULL) != OMX_ErrorNone) || (count == 0))
+        return false;
+    std::vector<std::vector<OMX_U8> > storage(count, std::vector<OMX_U8>(OMX_MAX_STRINGNAME_SIZE));
+    std::vector<OMX_U8*> names(count);
+    for (OMX_U32 i = 0; i < count; i++) names[i] = &storage[i][0];
+    if (core.getComponentsOfRole((OMX_STRING) role, &count, &names[0]) != OMX_ErrorNone) return false;
+    strncpy(name, (const char*) names[0], OMX_MAX_STRINGNAME_SIZE - 1);
+    name[OMX_MAX_STRINGNAME_SIZE - 1] = '\0';
+    return true;
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr,
+            "usage: %s [-p plugin] [-c core] [-r role | -n component] [-t threads] [-i iterations] [-l loads]\n"
+            "  -p  plugin library (default %s)\n"
+            "  -c  OMX core library opened for the baseline (default %s)\n"
+            "  -r  role of the component to churn (default %s)\n"
+            "  -n  component to churn, instead of one of the role\n"
+            "  -t  number of churn threads (default 4)\n"
+            "  -i  handle create/free cycles per thread (default 1000)\n"
+            "  -l  interface and core load cycles (default 200)\n",
+            name, DEFAULT_PLUGIN_LIBRARY, DEFAULT_CORE_LIBRARY, DEFAULT_ROLE);
+}
+
+int main(int argc, char** argv)
+{
+    const char* pluginPath = DEFAULT_PLUGIN_LIBRARY;
+    const char* corePath = DEFAULT_CORE_LIBRARY;
+    const char* role = DEFAULT_ROLE;
+    const char* component = NULL;
+    int nThreads = 4;
+    int iterations = 1000;
+    int loads = 200;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:c:r:n:t:i:l:h")) != -1) {
+        switch (opt) {
+        case 'p': pluginPath = optarg; break;
+        case 'c': corePath = optarg; break;
+        case 'r': role = optarg; break;
+        case 'n': component = optarg; break;
+        case 't': nThreads = atoi(optarg); break;
+        case 'i': iterations = atoi(optarg); break;
+        case 'l': loads = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (nThreads < 1 || iterations < 1 || loads < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    void* plugin = dlopen(pluginPath, RTLD_NOW);
+    if (plugin == NULL) {
+        fprintf(stderr, "cannot load %s: %s\n", pluginPath, dlerror());
+        return 1;
+    }
+    tpPVGetInterface getInterface = (tpPVGetInterface) dlsym(plugin, "PVGetInterface");
+    tpPVReleaseInterface releaseInterface = (tpPVReleaseInterface) dlsym(plugin, "PVReleaseInterface");
+    if (getInterface == NULL || releaseInterface == NULL) {
+        fprintf(stderr, "%s does not export PVGetInterface/PVReleaseInterface\n", pluginPath);
+        return 1;
+    }
+
+    // keeps the core loaded, so neither timing below includes loading it
+    void* core = dlopen(corePath, RTLD_NOW);
+    if (core == NULL) {
+        fprintf(stderr, "cannot load %s: %s\n", corePath, dlerror());
+        return 1;
+    }
+
+    // 1. interface acquisition through the plugin, against the dlopen and
+    // symbol resolution it wraps
+    std::vector<int64_t> loadSamples;
+    std::vector<int64_t> coreSamples;
+    loadSamples.reserve(loads);
+    coreSamples.reserve(loads);
+    for (int i = 0; i < loads; i++) {
+        int64_t start = nowNs();
+        OsclAny* iface = getInterface();
+        OMXInterface* omx = iface ?
+            (OMXInterface*) ((OsclSharedLibraryInterface*) iface)->SharedLibraryLookup(OMX_INTERFACE_ID) : NULL;
+        releaseInterface(iface);
+        loadSamples.push_back(nowNs() - start);
+        if (omx == NULL) {
+            fprintf(stderr, "plugin could not resolve the OMX core\n");
+            return 1;
+        }
+
+        start = nowNs();
+        bool opened = openCore(corePath);
+        coreSamples.push_back(nowNs() - start);
+        if (!opened) {
+            fprintf(stderr, "%s is missing OMX core entry points\n", corePath);
+            return 1;
+        }
+    }
+
+    // 2. handle churn through the entry points the plugin resolved
+    OsclAny* iface = getInterface();
+    OMXInterface* omx = (OMXInterface*) ((OsclSharedLibraryInterface*) iface)->SharedLibraryLookup(OMX_INTERFACE_ID);
+    if (omx == NULL) {
+        fprintf(stderr, "plugin could not resolve the OMX core\n");
+        return 1;
+    }
+    CoreEntryPoints viaPlugin;
+    viaPlugin.init = omx->GetpOMX_Init();
+    viaPlugin.deinit = omx->GetpOMX_Deinit();
+    viaPlugin.getHandle = omx->GetpOMX_GetHandle();
+    viaPlugin.freeHandle = omx->GetpOMX_FreeHandle();
+    viaPlugin.getComponentsOfRole = omx->GetpOMX_GetComponentsOfRole();
+    if (!viaPlugin.init || !viaPlugin.deinit || !viaPlugin.getHandle || !viaPlugin.freeHandle ||
+        !viaPlugin.getComponentsOfRole) {
+        fprintf(stderr, "plugin did not resolve all OMX core entry points\n");
+        return 1;
+    }
+
+    viaPlugin.init();
+    char roleComponent[OMX_MAX_STRINGNAME_SIZE];
+    if (component == NULL) {
+        if (!componentOfRole(viaPlugin, role, roleComponent)) {
+            fprintf(stderr, "%s has no component for %s\n", corePath, role);
+            viaPlugin.deinit();
+            return 1;
+        }
+        component = roleComponent;
+    }
+    printf("plugin=%s core=%s component=%s threads=%d iterations=%d\n",
+           pluginPath, corePath, component, nThreads, iterations);
+
+    std::vector<int64_t> churnSamples;
+    int64_t churnCpuNs;
+    bool ok = churn(viaPlugin, component, nThreads, iterations, &churnSamples, &churnCpuNs);
+    viaPlugin.deinit();
+
+    releaseInterface(iface);
+    dlclose(core);
+    dlclose(plugin);
+
+    Stats load = summarize(loadSamples);
+    Stats coreLoad = summarize(coreSamples);
+    Stats churnStats = summarize(churnSamples);
+
+    printStats("interface get/release", load);
+    printStats("core dlopen/dlsym", coreLoad);
+    printStats("handle churn", churnStats);
+
+    printf("cpu per handle cycle    %.0f ns\n", churnCpuNs / ((double) nThreads * iterations));
+    printf("plugin overhead         per interface load=%.0f ns\n", load.meanNs - coreLoad.meanNs);
+
+    return ok ? 0 : 1;
+}